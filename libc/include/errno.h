@@ -0,0 +1,10 @@
+#ifndef _ERRNO_H
+#define _ERRNO_H
+
+/* The values are the kernel's own, which are Linux's */
+#include "lib/errno.h"
+
+int* __errno_location(void);
+#define errno (*__errno_location())
+
+#endif
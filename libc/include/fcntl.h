@@ -0,0 +1,15 @@
+#ifndef _FCNTL_H
+#define _FCNTL_H
+
+/* Same values as the kernel's (fs/file.h); the filesystems are read-only */
+#define O_RDONLY    0
+#define O_WRONLY    1
+#define O_RDWR      2
+#define O_ACCMODE   3
+#define O_NONBLOCK  04000 /* eventfd and timerfd files */
+#define O_DIRECTORY 0200000
+#define O_CLOEXEC   02000000
+
+int open(const char* path, int flags, ...);
+
+#endif
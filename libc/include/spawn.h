@@ -0,0 +1,46 @@
+#ifndef _SPAWN_H
+#define _SPAWN_H
+
+#include "sys/proc.h"
+#include <unistd.h>
+
+/* posix_spawn on the kernel's SYS_SPAWN: the child is built straight from
+   the executable, so starting it costs the same whatever the size of the
+   caller. The file actions are collected here and handed over in one go. */
+
+#define POSIX_SPAWN_SETGROUP       SPAWN_SETGROUP /* ByteOS: scheduler group */
+#define POSIX_SPAWN_SETPERSONALITY SPAWN_SETPERSONALITY
+
+typedef struct
+{
+  int                 count;
+  struct spawn_action actions[SPAWN_ACTIONS_MAX];
+} posix_spawn_file_actions_t;
+
+typedef struct
+{
+  struct spawn_attr attr;
+} posix_spawnattr_t;
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t* fa);
+int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* fa);
+int posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* fa, int fd, const char* path,
+                                     int oflag, int mode);
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* fa, int fd);
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* fa, int fd, int newfd);
+
+int posix_spawnattr_init(posix_spawnattr_t* a);
+int posix_spawnattr_destroy(posix_spawnattr_t* a);
+int posix_spawnattr_setflags(posix_spawnattr_t* a, short flags);
+int posix_spawnattr_getflags(const posix_spawnattr_t* a, short* flags);
+int posix_spawnattr_setgroup(posix_spawnattr_t* a, int group);
+int posix_spawnattr_setpersonality(posix_spawnattr_t* a, int personality);
+
+/* These return 0 or an error number (errno is left alone). posix_spawnp
+   looks in /bin for a file name without a '/'. */
+int posix_spawn(pid_t* pid, const char* path, const posix_spawn_file_actions_t* fa,
+                const posix_spawnattr_t* attr, char* const argv[], char* const envp[]);
+int posix_spawnp(pid_t* pid, const char* file, const posix_spawn_file_actions_t* fa,
+                 const posix_spawnattr_t* attr, char* const argv[], char* const envp[]);
+
+#endif
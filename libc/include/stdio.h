@@ -0,0 +1,56 @@
+#ifndef _STDIO_H
+#define _STDIO_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/* Buffered streams. stdout is line buffered, stderr unbuffered, anything
+   else fully buffered; buffers are written out when a line ends (line
+   buffering), when they fill, on fflush, and at exit. */
+
+#define EOF    (-1)
+#define BUFSIZ 4096
+
+#define _IOFBF 0
+#define _IOLBF 1
+#define _IONBF 2
+
+typedef struct __FILE FILE;
+
+extern FILE* stdin;
+extern FILE* stdout;
+extern FILE* stderr;
+
+FILE* fopen(const char* path, const char* mode);
+int   fclose(FILE* f);
+int   fflush(FILE* f); /* NULL: every stream */
+int   setvbuf(FILE* f, char* buf, int mode, size_t size);
+
+size_t fread(void* ptr, size_t size, size_t n, FILE* f);
+size_t fwrite(const void* ptr, size_t size, size_t n, FILE* f);
+
+int   fgetc(FILE* f);
+int   getc(FILE* f);
+int   getchar(void);
+char* fgets(char* s, int size, FILE* f);
+
+int fputc(int c, FILE* f);
+int putc(int c, FILE* f);
+int putchar(int c);
+int fputs(const char* s, FILE* f);
+int puts(const char* s);
+
+int  feof(FILE* f);
+int  ferror(FILE* f);
+void clearerr(FILE* f);
+
+int printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+int fprintf(FILE* f, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+int sprintf(char* s, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+int snprintf(char* s, size_t n, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+int vprintf(const char* fmt, va_list ap);
+int vfprintf(FILE* f, const char* fmt, va_list ap);
+int vsprintf(char* s, const char* fmt, va_list ap);
+int vsnprintf(char* s, size_t n, const char* fmt, va_list ap);
+
+#endif
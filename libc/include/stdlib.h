@@ -0,0 +1,30 @@
+#ifndef _STDLIB_H
+#define _STDLIB_H
+
+#include <stddef.h>
+
+#define EXIT_SUCCESS 0
+#define EXIT_FAILURE 1
+
+/* Small requests are served from per-thread caches of size-classed
+   blocks carved out of the brk heap; big ones get their own mapping */
+void* malloc(size_t size);
+void  free(void* p);
+void* calloc(size_t n, size_t size);
+void* realloc(void* p, size_t size);
+
+/* exit flushes stdio after the atexit handlers and ends every thread */
+__attribute__((noreturn)) void exit(int status);
+__attribute__((noreturn)) void _Exit(int status);
+__attribute__((noreturn)) void abort(void);
+int                            atexit(void (*fn)(void));
+
+int           abs(int x);
+long          labs(long x);
+int           atoi(const char* s);
+long          atol(const char* s);
+long          strtol(const char* s, char** end, int base);
+unsigned long strtoul(const char* s, char** end, int base);
+char*         getenv(const char* name);
+
+#endif
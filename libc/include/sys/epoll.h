@@ -0,0 +1,42 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+#include <stdint.h>
+
+/* Event multiplexing on the kernel's epoll sets. Same values and event
+   layout as the kernel's (fs/eventpoll.h), which are Linux's. */
+
+#define EPOLLIN      0x001
+#define EPOLLOUT     0x004
+#define EPOLLERR     0x008
+#define EPOLLHUP     0x010
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET      (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC 02000000
+
+typedef union epoll_data
+{
+  void*    ptr;
+  int      fd;
+  uint32_t u32;
+  uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event
+{
+  uint32_t     events;
+  epoll_data_t data;
+} __attribute__((packed));
+
+int epoll_create(int size);
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event);
+/* timeout in milliseconds; -1 waits for good, 0 only looks */
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _SYS_EVENTFD_H
+#define _SYS_EVENTFD_H
+
+#include <stdint.h>
+
+/* Event counters; same flags as the kernel's (fs/eventfd.h) */
+
+#define EFD_SEMAPHORE 1
+#define EFD_NONBLOCK  04000
+#define EFD_CLOEXEC   02000000
+
+typedef uint64_t eventfd_t;
+
+int eventfd(unsigned int initval, int flags);
+/* One read or write of the counter: 0, or -1 and errno */
+int eventfd_read(int fd, eventfd_t* value);
+int eventfd_write(int fd, eventfd_t value);
+
+#endif
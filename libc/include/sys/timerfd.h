@@ -0,0 +1,32 @@
+#ifndef _SYS_TIMERFD_H
+#define _SYS_TIMERFD_H
+
+/* Timer files; same flags and layout as the kernel's (fs/timerfd.h). A
+   read returns the expirations since the last one as a uint64_t. */
+
+#define TFD_TIMER_ABSTIME 1
+#define TFD_NONBLOCK      04000
+#define TFD_CLOEXEC       02000000
+
+#ifndef CLOCK_REALTIME
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+#endif
+
+struct timespec
+{
+  long tv_sec;
+  long tv_nsec;
+};
+
+struct itimerspec
+{
+  struct timespec it_interval;
+  struct timespec it_value;
+};
+
+int timerfd_create(int clockid, int flags);
+int timerfd_settime(int fd, int flags, const struct itimerspec* value, struct itimerspec* old);
+int timerfd_gettime(int fd, struct itimerspec* cur);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _UNISTD_H
+#define _UNISTD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STDIN_FILENO  0
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+
+typedef long ssize_t;
+typedef int  pid_t;
+
+ssize_t read(int fd, void* buf, size_t count);
+ssize_t write(int fd, const void* buf, size_t count);
+int     close(int fd);
+int     pipe(int fds[2]);
+
+/* The heap: brk sets the break, sbrk moves it by inc and returns the old
+   one ((void*) -1 on failure) */
+int   brk(void* addr);
+void* sbrk(intptr_t inc);
+
+extern char** environ;
+
+/* Replace the program; return only on failure. There is no fork: vfork
+   borrows the caller's memory until the child execs or calls _exit (it
+   must do nothing else), and the caller sleeps until then. */
+int   execve(const char* path, char* const argv[], char* const envp[]);
+int   execv(const char* path, char* const argv[]);
+pid_t vfork(void);
+
+pid_t        getpid(void);
+unsigned int sleep(unsigned int seconds);
+int          usleep(unsigned int usec);
+
+__attribute__((noreturn)) void _exit(int status);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _UTHREAD_H
+#define _UTHREAD_H
+
+#include <stddef.h>
+
+/* Threads sharing the process's memory and descriptors (native clone).
+   Each gets its own stack mapping, errno and malloc cache. */
+
+typedef struct __uthread* uthread_t;
+
+/* 0, or -1 with errno set */
+int uthread_create(uthread_t* t, void* (*fn)(void*), void* arg);
+/* Wait for t to return and collect fn's result; t is gone afterwards */
+int uthread_join(uthread_t t, void** result);
+/* End the calling thread with result (what returning from fn does) */
+__attribute__((noreturn)) void uthread_exit(void* result);
+uthread_t uthread_self(void);
+
+#endif
@@ -0,0 +1,65 @@
+#include "libc.h"
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define __syscall4(n, a, b, c, d) __syscall6(n, (long) (a), (long) (b), (long) (c), (long) (d), 0, 0)
+
+int epoll_create(int size)
+{
+  if (size <= 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  return epoll_create1(0);
+}
+
+int epoll_create1(int flags)
+{
+  return (int) __syscall_ret(__syscall1(SYS_EPOLL_CREATE, flags));
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+  return (int) __syscall_ret(__syscall4(SYS_EPOLL_CTL, epfd, op, fd, event));
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+{
+  /* the kernel takes nanoseconds */
+  long ns = timeout < 0 ? -1 : (long) timeout * 1000000L;
+  return (int) __syscall_ret(__syscall4(SYS_EPOLL_WAIT, epfd, events, maxevents, ns));
+}
+
+int eventfd(unsigned int initval, int flags)
+{
+  return (int) __syscall_ret(__syscall2(SYS_EVENTFD, initval, flags));
+}
+
+int eventfd_read(int fd, eventfd_t* value)
+{
+  return read(fd, value, sizeof(*value)) == sizeof(*value) ? 0 : -1;
+}
+
+int eventfd_write(int fd, eventfd_t value)
+{
+  return write(fd, &value, sizeof(value)) == sizeof(value) ? 0 : -1;
+}
+
+int timerfd_create(int clockid, int flags)
+{
+  return (int) __syscall_ret(__syscall2(SYS_TIMERFD_CREATE, clockid, flags));
+}
+
+int timerfd_settime(int fd, int flags, const struct itimerspec* value, struct itimerspec* old)
+{
+  return (int) __syscall_ret(__syscall4(SYS_TIMERFD_SETTIME, fd, flags, value, old));
+}
+
+int timerfd_gettime(int fd, struct itimerspec* cur)
+{
+  return (int) __syscall_ret(__syscall2(SYS_TIMERFD_GETTIME, fd, cur));
+}
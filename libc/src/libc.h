@@ -0,0 +1,82 @@
+#ifndef LIBC_LIBC_H
+#define LIBC_LIBC_H
+
+#include "syscall/sysno.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Internals shared by the runtime's translation units. Programs talk the
+   native numbering (syscall/sysno.h) through SYSCALL; the kernel picks it
+   for them from the ELF note crt0.S emits. */
+
+static inline long __syscall6(long n, long a1, long a2, long a3, long a4, long a5, long a6)
+{
+  long              ret;
+  register long r10 asm("r10") = a4;
+  register long r8 asm("r8")   = a5;
+  register long r9 asm("r9")   = a6;
+  asm volatile("syscall"
+               : "=a"(ret)
+               : "a"(n), "D"(a1), "S"(a2), "d"(a3), "r"(r10), "r"(r8), "r"(r9)
+               : "rcx", "r11", "memory");
+  return ret;
+}
+
+static inline long __syscall3(long n, long a1, long a2, long a3)
+{
+  long ret;
+  asm volatile("syscall" : "=a"(ret) : "a"(n), "D"(a1), "S"(a2), "d"(a3) : "rcx", "r11", "memory");
+  return ret;
+}
+
+#define __syscall0(n)       __syscall3(n, 0, 0, 0)
+#define __syscall1(n, a)    __syscall3(n, (long) (a), 0, 0)
+#define __syscall2(n, a, b) __syscall3(n, (long) (a), (long) (b), 0)
+
+/* Negative returns are -errno: store it and return -1 */
+long __syscall_ret(long r);
+
+/* Per-thread block; %fs points at it and its first word points back */
+struct malloc_cache;
+struct __uthread
+{
+  struct __uthread*    self;
+  struct malloc_cache* cache; /* created on the thread's first malloc */
+  int                  errno_value;
+  volatile int         tid;   /* cleared (and futex-woken) when it exits */
+  void* (*fn)(void*);
+  void*                arg;
+  void*                result;
+  void*                stack; /* mapping to drop once joined */
+  size_t               stack_size;
+};
+
+static inline struct __uthread* __self(void)
+{
+  struct __uthread* t;
+  asm("mov %%fs:0, %0" : "=r"(t));
+  return t;
+}
+
+/* start.c: the thread __libc_start ran main on */
+int __is_main_thread(struct __uthread* t);
+
+/* SYS_MMAP protection: VMA_READ | VMA_WRITE (mem/mm.h) */
+#define __PROT_RW 0x3
+
+/* Futex-backed lock: 0 free, 1 held, 2 held with waiters */
+void __lock(volatile int* l);
+void __unlock(volatile int* l);
+
+/* malloc.c: hand a dying thread's cache back to the shared lists */
+void __malloc_thread_exit(struct __uthread* t);
+/* printf.c: format into out (called with runs of output); returns the
+   number of characters produced */
+int __vformat(void (*out)(void* ctx, const char* p, size_t n), void* ctx, const char* fmt,
+              va_list ap);
+
+/* stdio.c: flush every open stream (exit) */
+void __stdio_exit(void);
+
+#endif
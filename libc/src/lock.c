@@ -0,0 +1,26 @@
+#include "libc.h"
+#include "multitasking/futex.h"
+
+/* Uncontended lock and unlock are one atomic each; only a lock that is
+   actually fought over costs a system call (Drepper, "Futexes Are
+   Tricky", mutex #2) */
+
+void __lock(volatile int* l)
+{
+  int c = 0;
+  if (__atomic_compare_exchange_n(l, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;
+  if (c != 2)
+    c = __atomic_exchange_n(l, 2, __ATOMIC_ACQUIRE);
+  while (c)
+  {
+    __syscall6(SYS_FUTEX, (long) l, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, 2, 0, 0, 0);
+    c = __atomic_exchange_n(l, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+void __unlock(volatile int* l)
+{
+  if (__atomic_exchange_n(l, 0, __ATOMIC_RELEASE) == 2)
+    __syscall6(SYS_FUTEX, (long) l, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, 0, 0, 0);
+}
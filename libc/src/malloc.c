@@ -0,0 +1,278 @@
+#include "libc.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Size-classed allocator with per-thread caches.
+
+   Blocks are powers of two from 32 bytes to 64 KiB, each starting with a
+   16-byte header that names its class (so payloads stay 16-byte aligned).
+   A thread allocates from and frees to its own cache without taking any
+   lock; the cache refills from, and spills back to, central free lists a
+   batch at a time, and the central lists are carved out of 256 KiB slabs
+   from the brk heap. Anything bigger than the largest class is a mapping
+   of its own, returned to the kernel on free. */
+
+#define CLASS_MIN_SHIFT 5
+#define NCLASSES        12 /* 32 B .. 64 KiB */
+#define HDR_SIZE        16
+#define SLAB_SIZE       (256 * 1024)
+#define PAGE_SIZE       4096
+#define LARGE_MAGIC     0xB16B10C5ULL /* hdr.tag of a mapped block */
+
+struct hdr
+{
+  uint64_t tag;  /* class index, or LARGE_MAGIC */
+  uint64_t size; /* mapping length of a large block */
+};
+
+struct free_block
+{
+  struct free_block* next;
+};
+
+struct malloc_cache
+{
+  struct free_block* list[NCLASSES];
+  uint32_t           count[NCLASSES];
+};
+
+static struct
+{
+  volatile int         lock;
+  struct free_block*   list[NCLASSES];
+  char*                slab;
+  char*                slab_end;
+  struct malloc_cache* spare; /* caches of exited threads, for new ones */
+} central;
+
+static inline size_t class_size(int c)
+{
+  return (size_t) 1 << (c + CLASS_MIN_SHIFT);
+}
+
+/* Blocks moved per refill or spill: enough to amortize the lock for small
+   classes, few for large ones so memory is not hoarded */
+static inline uint32_t batch(int c)
+{
+  uint32_t n = (uint32_t) (16384 >> (c + CLASS_MIN_SHIFT));
+  return n < 1 ? 1 : n > 64 ? 64 : n;
+}
+
+static int size_class(size_t size)
+{
+  size_t need = size + HDR_SIZE;
+  int    c    = 0;
+  while (c < NCLASSES && class_size(c) < need)
+    ++c;
+  return c; /* NCLASSES: too big for a class */
+}
+
+static void* map(size_t len)
+{
+  long r = __syscall3(SYS_MMAP, 0, (long) len, __PROT_RW);
+  return r < 0 ? NULL : (void*) r;
+}
+
+/* Under central.lock: a fresh slab, from the heap or failing that a
+   mapping (tasks whose break cannot move) */
+static int grow_slab(void)
+{
+  void* p = sbrk(SLAB_SIZE);
+  if (p == (void*) -1)
+    p = map(SLAB_SIZE);
+  if (!p)
+    return -1;
+  central.slab     = p;
+  central.slab_end = (char*) p + SLAB_SIZE;
+  return 0;
+}
+
+static void refill(struct malloc_cache* mc, int c)
+{
+  size_t   sz = class_size(c);
+  uint32_t n  = batch(c);
+
+  __lock(&central.lock);
+  while (n && central.list[c])
+  {
+    struct free_block* b = central.list[c];
+    central.list[c]      = b->next;
+    b->next              = mc->list[c];
+    mc->list[c]          = b;
+    ++mc->count[c];
+    --n;
+  }
+  while (n)
+  {
+    if ((size_t) (central.slab_end - central.slab) < sz && grow_slab() < 0)
+      break;
+    struct free_block* b = (struct free_block*) central.slab;
+    central.slab += sz;
+    b->next     = mc->list[c];
+    mc->list[c] = b;
+    ++mc->count[c];
+    --n;
+  }
+  __unlock(&central.lock);
+}
+
+static void spill(struct malloc_cache* mc, int c, uint32_t n)
+{
+  __lock(&central.lock);
+  while (n-- && mc->list[c])
+  {
+    struct free_block* b = mc->list[c];
+    mc->list[c]          = b->next;
+    b->next              = central.list[c];
+    central.list[c]      = b;
+    --mc->count[c];
+  }
+  __unlock(&central.lock);
+}
+
+static struct malloc_cache* cache(void)
+{
+  struct __uthread* t = __self();
+  if (!t->cache)
+  {
+    /* the cache itself comes from the slab unless an exited thread left
+       one behind */
+    __lock(&central.lock);
+    size_t sz = (sizeof(struct malloc_cache) + 15) & ~(size_t) 15;
+    if (central.spare)
+    {
+      t->cache      = central.spare;
+      central.spare = (struct malloc_cache*) central.spare->list[0];
+    }
+    else if ((size_t) (central.slab_end - central.slab) >= sz || grow_slab() == 0)
+    {
+      t->cache = (struct malloc_cache*) central.slab;
+      central.slab += sz;
+    }
+    if (t->cache)
+      memset(t->cache, 0, sizeof(*t->cache));
+    __unlock(&central.lock);
+  }
+  return t->cache;
+}
+
+void* malloc(size_t size)
+{
+  int c = size_class(size);
+  if (c == NCLASSES)
+  {
+    if (size > ((size_t) -1 >> 1))
+      goto nomem;
+    size_t      len = (size + HDR_SIZE + PAGE_SIZE - 1) & ~(size_t) (PAGE_SIZE - 1);
+    struct hdr* h   = map(len);
+    if (!h)
+      goto nomem;
+    h->tag  = LARGE_MAGIC;
+    h->size = len;
+    return h + 1;
+  }
+
+  struct malloc_cache* mc = cache();
+  if (!mc)
+    goto nomem;
+  if (!mc->list[c])
+  {
+    refill(mc, c);
+    if (!mc->list[c])
+      goto nomem;
+  }
+  struct free_block* b = mc->list[c];
+  mc->list[c]          = b->next;
+  --mc->count[c];
+
+  struct hdr* h = (struct hdr*) b;
+  h->tag        = (uint64_t) c;
+  return h + 1;
+
+nomem:
+  errno = ENOMEM;
+  return NULL;
+}
+
+void free(void* p)
+{
+  if (!p)
+    return;
+  struct hdr* h = (struct hdr*) p - 1;
+  if (h->tag == LARGE_MAGIC)
+  {
+    __syscall2(SYS_MUNMAP, h, h->size);
+    return;
+  }
+
+  int                  c  = (int) h->tag;
+  struct malloc_cache* mc = cache();
+  struct free_block*   b  = (struct free_block*) h;
+  if (!mc)
+  {
+    __lock(&central.lock);
+    b->next         = central.list[c];
+    central.list[c] = b;
+    __unlock(&central.lock);
+    return;
+  }
+  b->next                 = mc->list[c];
+  mc->list[c]             = b;
+  if (++mc->count[c] > 2 * batch(c))
+    spill(mc, c, batch(c));
+}
+
+void* calloc(size_t n, size_t size)
+{
+  size_t total;
+  if (__builtin_mul_overflow(n, size, &total))
+  {
+    errno = ENOMEM;
+    return NULL;
+  }
+  void* p = malloc(total);
+  /* fresh mappings are zero already; recycled blocks are not */
+  if (p && ((struct hdr*) p - 1)->tag != LARGE_MAGIC)
+    memset(p, 0, total);
+  return p;
+}
+
+void* realloc(void* p, size_t size)
+{
+  if (!p)
+    return malloc(size);
+  if (!size)
+  {
+    free(p);
+    return NULL;
+  }
+
+  struct hdr* h   = (struct hdr*) p - 1;
+  size_t      cap = (h->tag == LARGE_MAGIC ? h->size : class_size((int) h->tag)) - HDR_SIZE;
+  if (size <= cap)
+    return p;
+
+  void* q = malloc(size);
+  if (!q)
+    return NULL;
+  memcpy(q, p, cap);
+  free(p);
+  return q;
+}
+
+void __malloc_thread_exit(struct __uthread* t)
+{
+  struct malloc_cache* mc = t->cache;
+  if (!mc)
+    return;
+  for (int c = 0; c < NCLASSES; ++c)
+    if (mc->count[c])
+      spill(mc, c, mc->count[c]);
+  __lock(&central.lock);
+  mc->list[0]   = (struct free_block*) central.spare;
+  central.spare = mc;
+  __unlock(&central.lock);
+  t->cache = NULL;
+}
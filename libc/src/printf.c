@@ -0,0 +1,273 @@
+#include "libc.h"
+#include <stdio.h>
+#include <string.h>
+
+/* The printf engine: %d %i %u %o %x %X %p %s %c %%, with the flags
+   - 0 + and space, width and precision (both may be *) and the hh h l ll
+   z t j length modifiers. Literal text goes out in runs rather than a
+   character at a time. */
+
+#define FL_LEFT  0x1
+#define FL_ZERO  0x2
+#define FL_PLUS  0x4
+#define FL_SPACE 0x8
+
+struct fmt_state
+{
+  void (*out)(void*, const char*, size_t);
+  void*  ctx;
+  size_t count;
+};
+
+static void emit(struct fmt_state* st, const char* p, size_t n)
+{
+  if (n)
+  {
+    st->out(st->ctx, p, n);
+    st->count += n;
+  }
+}
+
+static void pad(struct fmt_state* st, char c, int n)
+{
+  char run[32];
+  memset(run, c, sizeof(run));
+  while (n > 0)
+  {
+    int k = n < (int) sizeof(run) ? n : (int) sizeof(run);
+    emit(st, run, (size_t) k);
+    n -= k;
+  }
+}
+
+static void format_int(struct fmt_state* st, unsigned long long v, int neg, int base, int upper,
+                       int flags, int width, int prec, const char* prefix)
+{
+  const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  char        buf[24];
+  int         len = 0;
+
+  while (v)
+  {
+    buf[sizeof(buf) - 1 - len++] = digits[v % (unsigned) base];
+    v /= (unsigned) base;
+  }
+  if (prec < 0)
+    prec = 1;
+  else
+    flags &= ~FL_ZERO; /* a precision overrides the 0 flag */
+
+  char sign = neg ? '-' : (flags & FL_PLUS) ? '+' : (flags & FL_SPACE) ? ' ' : 0;
+  int  zeros = prec > len ? prec - len : 0;
+  int  plen  = (int) strlen(prefix) + (sign != 0);
+  int  fill  = width - plen - zeros - len;
+
+  if (fill > 0 && (flags & FL_ZERO) && !(flags & FL_LEFT))
+  {
+    zeros += fill;
+    fill = 0;
+  }
+  if (fill > 0 && !(flags & FL_LEFT))
+    pad(st, ' ', fill);
+  if (sign)
+    emit(st, &sign, 1);
+  emit(st, prefix, strlen(prefix));
+  pad(st, '0', zeros);
+  emit(st, buf + sizeof(buf) - len, (size_t) len);
+  if (fill > 0 && (flags & FL_LEFT))
+    pad(st, ' ', fill);
+}
+
+int __vformat(void (*out)(void* ctx, const char* p, size_t n), void* ctx, const char* fmt,
+              va_list ap)
+{
+  struct fmt_state st = {out, ctx, 0};
+
+  while (*fmt)
+  {
+    const char* run = fmt;
+    while (*fmt && *fmt != '%')
+      ++fmt;
+    emit(&st, run, (size_t) (fmt - run));
+    if (!*fmt)
+      break;
+    ++fmt;
+
+    int flags = 0, width = 0, prec = -1, lng = 0;
+    for (;; ++fmt)
+    {
+      if (*fmt == '-')
+        flags |= FL_LEFT;
+      else if (*fmt == '0')
+        flags |= FL_ZERO;
+      else if (*fmt == '+')
+        flags |= FL_PLUS;
+      else if (*fmt == ' ')
+        flags |= FL_SPACE;
+      else
+        break;
+    }
+    if (*fmt == '*')
+    {
+      width = va_arg(ap, int);
+      if (width < 0)
+      {
+        flags |= FL_LEFT;
+        width = -width;
+      }
+      ++fmt;
+    }
+    else
+      while (*fmt >= '0' && *fmt <= '9')
+        width = width * 10 + (*fmt++ - '0');
+    if (*fmt == '.')
+    {
+      ++fmt;
+      prec = 0;
+      if (*fmt == '*')
+      {
+        prec = va_arg(ap, int);
+        ++fmt;
+      }
+      else
+        while (*fmt >= '0' && *fmt <= '9')
+          prec = prec * 10 + (*fmt++ - '0');
+    }
+
+    /* 0 int, -1 short, -2 char, 1 long, 2 long long (size_t and friends
+       are long here) */
+    for (;; ++fmt)
+    {
+      if (*fmt == 'l')
+        ++lng;
+      else if (*fmt == 'h')
+        --lng;
+      else if (*fmt == 'z' || *fmt == 't' || *fmt == 'j')
+        lng = 1;
+      else
+        break;
+    }
+
+    char c = *fmt++;
+    switch (c)
+    {
+    case 'd':
+    case 'i':
+    {
+      long long v = lng > 0 ? (lng > 1 ? va_arg(ap, long long) : va_arg(ap, long)) : va_arg(ap, int);
+      if (lng == -1)
+        v = (short) v;
+      else if (lng < -1)
+        v = (signed char) v;
+      unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+      format_int(&st, u, v < 0, 10, 0, flags, width, prec, "");
+      break;
+    }
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    {
+      unsigned long long v = lng > 0 ? (lng > 1 ? va_arg(ap, unsigned long long)
+                                                : va_arg(ap, unsigned long))
+                                     : va_arg(ap, unsigned int);
+      if (lng == -1)
+        v = (unsigned short) v;
+      else if (lng < -1)
+        v = (unsigned char) v;
+      int base = c == 'u' ? 10 : c == 'o' ? 8 : 16;
+      format_int(&st, v, 0, base, c == 'X', flags & ~(FL_PLUS | FL_SPACE), width, prec, "");
+      break;
+    }
+    case 'p':
+    {
+      void* p = va_arg(ap, void*);
+      format_int(&st, (uintptr_t) p, 0, 16, 0, flags & FL_LEFT, width, -1, "0x");
+      break;
+    }
+    case 's':
+    {
+      const char* s = va_arg(ap, const char*);
+      if (!s)
+        s = "(null)";
+      size_t len = prec >= 0 ? strnlen(s, (size_t) prec) : strlen(s);
+      int    fill = width - (int) len;
+      if (fill > 0 && !(flags & FL_LEFT))
+        pad(&st, ' ', fill);
+      emit(&st, s, len);
+      if (fill > 0 && (flags & FL_LEFT))
+        pad(&st, ' ', fill);
+      break;
+    }
+    case 'c':
+    {
+      char ch = (char) va_arg(ap, int);
+      if (width > 1 && !(flags & FL_LEFT))
+        pad(&st, ' ', width - 1);
+      emit(&st, &ch, 1);
+      if (width > 1 && (flags & FL_LEFT))
+        pad(&st, ' ', width - 1);
+      break;
+    }
+    case '%':
+      emit(&st, "%", 1);
+      break;
+    default:
+      /* unknown conversion: print it as written */
+      emit(&st, "%", 1);
+      if (c)
+        emit(&st, &c, 1);
+      else
+        --fmt;
+      break;
+    }
+  }
+  return (int) st.count;
+}
+
+struct buf_sink
+{
+  char*  s;
+  size_t cap; /* room for characters, the NUL excluded */
+  size_t len;
+};
+
+static void buf_out(void* ctx, const char* p, size_t n)
+{
+  struct buf_sink* b = ctx;
+  if (b->len < b->cap)
+    memcpy(b->s + b->len, p, n < b->cap - b->len ? n : b->cap - b->len);
+  b->len += n;
+}
+
+int vsnprintf(char* s, size_t n, const char* fmt, va_list ap)
+{
+  struct buf_sink b = {s, n ? n - 1 : 0, 0};
+  int             r = __vformat(buf_out, &b, fmt, ap);
+  if (n)
+    s[b.len < b.cap ? b.len : b.cap] = '\0';
+  return r;
+}
+
+int vsprintf(char* s, const char* fmt, va_list ap)
+{
+  return vsnprintf(s, (size_t) -1 >> 1, fmt, ap);
+}
+
+int snprintf(char* s, size_t n, const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  int r = vsnprintf(s, n, fmt, ap);
+  va_end(ap);
+  return r;
+}
+
+int sprintf(char* s, const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  int r = vsnprintf(s, (size_t) -1 >> 1, fmt, ap);
+  va_end(ap);
+  return r;
+}
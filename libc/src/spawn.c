@@ -0,0 +1,117 @@
+#include "libc.h"
+#include <errno.h>
+#include <spawn.h>
+#include <string.h>
+
+#define SPAWNP_PATH_MAX 128
+
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t* fa)
+{
+  fa->count = 0;
+  return 0;
+}
+
+int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* fa)
+{
+  fa->count = 0;
+  return 0;
+}
+
+static int add_action(posix_spawn_file_actions_t* fa, int op, int fd, int src, int oflag,
+                      const char* path)
+{
+  if (fd < 0 || src < 0)
+    return EBADF;
+  if (fa->count == SPAWN_ACTIONS_MAX)
+    return ENOMEM;
+  struct spawn_action* a = &fa->actions[fa->count++];
+  a->op                  = op;
+  a->fd                  = fd;
+  a->src                 = src;
+  a->oflag               = oflag;
+  a->path                = path; /* kept by reference, as POSIX allows */
+  return 0;
+}
+
+int posix_spawn_file_actions_addopen(posix_spawn_file_actions_t* fa, int fd, const char* path,
+                                     int oflag, int mode)
+{
+  (void) mode; /* nothing is ever created */
+  return add_action(fa, SPAWN_ACTION_OPEN, fd, 0, oflag, path);
+}
+
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* fa, int fd)
+{
+  return add_action(fa, SPAWN_ACTION_CLOSE, fd, 0, 0, NULL);
+}
+
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* fa, int fd, int newfd)
+{
+  return add_action(fa, SPAWN_ACTION_DUP2, newfd, fd, 0, NULL);
+}
+
+int posix_spawnattr_init(posix_spawnattr_t* a)
+{
+  memset(a, 0, sizeof(*a));
+  return 0;
+}
+
+int posix_spawnattr_destroy(posix_spawnattr_t* a)
+{
+  (void) a;
+  return 0;
+}
+
+int posix_spawnattr_setflags(posix_spawnattr_t* a, short flags)
+{
+  if (flags & ~(POSIX_SPAWN_SETGROUP | POSIX_SPAWN_SETPERSONALITY))
+    return EINVAL;
+  a->attr.flags = (uint32_t) flags;
+  return 0;
+}
+
+int posix_spawnattr_getflags(const posix_spawnattr_t* a, short* flags)
+{
+  *flags = (short) a->attr.flags;
+  return 0;
+}
+
+int posix_spawnattr_setgroup(posix_spawnattr_t* a, int group)
+{
+  a->attr.group = group;
+  return 0;
+}
+
+int posix_spawnattr_setpersonality(posix_spawnattr_t* a, int personality)
+{
+  a->attr.personality = personality;
+  return 0;
+}
+
+int posix_spawn(pid_t* pid, const char* path, const posix_spawn_file_actions_t* fa,
+                const posix_spawnattr_t* attr, char* const argv[], char* const envp[])
+{
+  long r = __syscall6(SYS_SPAWN, (long) path, (long) argv, (long) envp,
+                      fa ? (long) fa->actions : 0, fa ? fa->count : 0,
+                      attr ? (long) &attr->attr : 0);
+  if (r < 0)
+    return (int) -r;
+  if (pid)
+    *pid = (pid_t) r;
+  return 0;
+}
+
+int posix_spawnp(pid_t* pid, const char* file, const posix_spawn_file_actions_t* fa,
+                 const posix_spawnattr_t* attr, char* const argv[], char* const envp[])
+{
+  char path[SPAWNP_PATH_MAX];
+  if (!strchr(file, '/'))
+  {
+    if (strlen(file) + 6 > sizeof(path))
+      return ENAMETOOLONG;
+    strcpy(path, "/bin/");
+    strcat(path, file);
+    file = path;
+  }
+  return posix_spawn(pid, file, fa, attr, argv, envp);
+}
@@ -0,0 +1,27 @@
+#include "libc.h"
+#include <stdlib.h>
+
+extern int main(int argc, char** argv, char** envp);
+
+char** environ;
+
+/* The initial thread's block; the others live at the top of their stacks */
+static struct __uthread main_thread;
+
+__attribute__((noreturn)) void __libc_start(uint64_t* sp)
+{
+  int    argc = (int) sp[0];
+  char** argv = (char**) (sp + 1);
+
+  environ          = argv + argc + 1;
+  main_thread.self = &main_thread;
+  main_thread.tid  = (int) __syscall0(SYS_GETPID);
+  __syscall1(SYS_SET_TLS, &main_thread);
+
+  exit(main(argc, argv, environ));
+}
+
+int __is_main_thread(struct __uthread* t)
+{
+  return t == &main_thread;
+}
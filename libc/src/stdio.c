@@ -0,0 +1,445 @@
+#include "libc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Streams go one way: stdin and fopen()ed files are read, stdout and
+   stderr written (the filesystems are read-only). A write only reaches
+   the kernel when the buffer fills, at a newline on a line-buffered
+   stream, on fflush or at exit, so printf loops cost one system call per
+   line or per BUFSIZ instead of one per call. */
+
+#define F_EOF     0x1
+#define F_ERR     0x2
+#define F_READ    0x4
+#define F_OWNBUF  0x8 /* buf was malloc'd here */
+
+struct __FILE
+{
+  int          fd;
+  int          flags;
+  int          mode; /* _IOFBF, _IOLBF or _IONBF */
+  char*        buf;
+  size_t       size;
+  size_t       pos; /* writing: bytes buffered; reading: next byte */
+  size_t       len; /* reading: bytes in buf */
+  char         one; /* the buffer of an unbuffered read stream */
+  volatile int lock;
+  FILE*        next; /* every open stream, for fflush(NULL) and exit */
+};
+
+static char stdin_buf[BUFSIZ];
+static char stdout_buf[BUFSIZ];
+
+static FILE f_stderr = {STDERR_FILENO, 0, _IONBF, NULL, 0, 0, 0, 0, 0, NULL};
+static FILE f_stdout = {STDOUT_FILENO, 0, _IOLBF, stdout_buf, BUFSIZ, 0, 0, 0, 0, &f_stderr};
+static FILE f_stdin  = {STDIN_FILENO, F_READ, _IOFBF, stdin_buf, BUFSIZ, 0, 0, 0, 0, &f_stdout};
+
+FILE* stdin  = &f_stdin;
+FILE* stdout = &f_stdout;
+FILE* stderr = &f_stderr;
+
+static FILE*        streams = &f_stdin;
+static volatile int streams_lock;
+
+static int write_all(FILE* f, const char* p, size_t n)
+{
+  while (n)
+  {
+    ssize_t r = write(f->fd, p, n);
+    if (r <= 0)
+    {
+      f->flags |= F_ERR;
+      return EOF;
+    }
+    p += r;
+    n -= (size_t) r;
+  }
+  return 0;
+}
+
+static int flush_unlocked(FILE* f)
+{
+  if ((f->flags & F_READ) || !f->pos)
+    return 0;
+  int r  = write_all(f, f->buf, f->pos);
+  f->pos = 0;
+  return r;
+}
+
+static size_t write_unlocked(FILE* f, const char* p, size_t n)
+{
+  if (f->flags & F_READ)
+  {
+    f->flags |= F_ERR;
+    errno = EBADF;
+    return 0;
+  }
+  if (f->mode == _IONBF || !f->size)
+    return write_all(f, p, n) ? 0 : n;
+
+  if (n > f->size - f->pos)
+  {
+    if (flush_unlocked(f))
+      return 0;
+    if (n >= f->size) /* would not fit anyway: skip the copy */
+      return write_all(f, p, n) ? 0 : n;
+  }
+  memcpy(f->buf + f->pos, p, n);
+  f->pos += n;
+  if (f->mode == _IOLBF && memchr(p, '\n', n) && flush_unlocked(f))
+    return 0;
+  return n;
+}
+
+/* Refill a read stream. Reading the terminal is when a prompt has to be
+   on the screen, so a line-buffered stdout goes out first. */
+static int fill_unlocked(FILE* f)
+{
+  if (!(f->flags & F_READ))
+  {
+    f->flags |= F_ERR;
+    errno = EBADF;
+    return EOF;
+  }
+  if (f->fd == STDIN_FILENO && f_stdout.mode == _IOLBF)
+    fflush(stdout);
+  ssize_t r = read(f->fd, f->buf, f->size);
+  if (r <= 0)
+  {
+    f->flags |= r ? F_ERR : F_EOF;
+    return EOF;
+  }
+  f->pos = 0;
+  f->len = (size_t) r;
+  return 0;
+}
+
+FILE* fopen(const char* path, const char* mode)
+{
+  if (mode[0] != 'r' || strchr(mode, '+'))
+  {
+    errno = EROFS;
+    return NULL;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  FILE* f = calloc(1, sizeof(*f));
+  char* b = malloc(BUFSIZ);
+  if (!f || !b)
+  {
+    free(f);
+    free(b);
+    close(fd);
+    return NULL;
+  }
+  f->fd    = fd;
+  f->flags = F_READ | F_OWNBUF;
+  f->mode  = _IOFBF;
+  f->buf   = b;
+  f->size  = BUFSIZ;
+
+  __lock(&streams_lock);
+  f->next = streams;
+  streams = f;
+  __unlock(&streams_lock);
+  return f;
+}
+
+int fclose(FILE* f)
+{
+  int r = fflush(f);
+  if (close(f->fd) < 0)
+    r = EOF;
+  if (f == stdin || f == stdout || f == stderr)
+    return r;
+
+  __lock(&streams_lock);
+  for (FILE** pp = &streams; *pp; pp = &(*pp)->next)
+    if (*pp == f)
+    {
+      *pp = f->next;
+      break;
+    }
+  __unlock(&streams_lock);
+  if (f->flags & F_OWNBUF)
+    free(f->buf);
+  free(f);
+  return r;
+}
+
+int fflush(FILE* f)
+{
+  if (!f)
+  {
+    int r = 0;
+    __lock(&streams_lock);
+    for (FILE* s = streams; s; s = s->next)
+      if (fflush(s))
+        r = EOF;
+    __unlock(&streams_lock);
+    return r;
+  }
+  __lock(&f->lock);
+  int r = flush_unlocked(f);
+  __unlock(&f->lock);
+  return r;
+}
+
+int setvbuf(FILE* f, char* buf, int mode, size_t size)
+{
+  char* own = NULL;
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return -1;
+  if (mode != _IONBF && !buf)
+  {
+    if (!size)
+      size = BUFSIZ;
+    own = buf = malloc(size);
+    if (!buf)
+      return -1;
+  }
+
+  __lock(&f->lock);
+  flush_unlocked(f);
+  if (f->flags & F_OWNBUF)
+    free(f->buf);
+  f->flags = (f->flags & ~F_OWNBUF) | (own ? F_OWNBUF : 0);
+  if (mode == _IONBF)
+  {
+    /* reads still need somewhere to land: one byte at a time */
+    buf  = (f->flags & F_READ) ? &f->one : NULL;
+    size = (f->flags & F_READ) ? 1 : 0;
+  }
+  f->mode = mode;
+  f->buf  = buf;
+  f->size = size;
+  f->pos  = 0;
+  f->len  = 0;
+  __unlock(&f->lock);
+  return 0;
+}
+
+size_t fwrite(const void* ptr, size_t size, size_t n, FILE* f)
+{
+  size_t total = size * n;
+  if (!total)
+    return 0;
+  __lock(&f->lock);
+  size_t done = write_unlocked(f, ptr, total);
+  __unlock(&f->lock);
+  return done == total ? n : 0;
+}
+
+size_t fread(void* ptr, size_t size, size_t n, FILE* f)
+{
+  size_t total = size * n, done = 0;
+  char*  dst   = ptr;
+  if (!total)
+    return 0;
+  __lock(&f->lock);
+  while (done < total)
+  {
+    if (f->pos < f->len)
+    {
+      size_t k = f->len - f->pos;
+      if (k > total - done)
+        k = total - done;
+      memcpy(dst + done, f->buf + f->pos, k);
+      f->pos += k;
+      done += k;
+    }
+    else if (total - done >= f->size && (f->flags & F_READ))
+    {
+      /* big reads go straight into the caller's buffer */
+      ssize_t r = read(f->fd, dst + done, total - done);
+      if (r <= 0)
+      {
+        f->flags |= r ? F_ERR : F_EOF;
+        break;
+      }
+      done += (size_t) r;
+    }
+    else if (fill_unlocked(f))
+      break;
+  }
+  __unlock(&f->lock);
+  return done / size;
+}
+
+static int getc_unlocked(FILE* f)
+{
+  if (f->pos >= f->len && fill_unlocked(f))
+    return EOF;
+  return (unsigned char) f->buf[f->pos++];
+}
+
+int fgetc(FILE* f)
+{
+  __lock(&f->lock);
+  int c = getc_unlocked(f);
+  __unlock(&f->lock);
+  return c;
+}
+
+int getc(FILE* f)
+{
+  return fgetc(f);
+}
+
+int getchar(void)
+{
+  return fgetc(stdin);
+}
+
+char* fgets(char* s, int size, FILE* f)
+{
+  size_t done = 0;
+  if (size <= 0)
+    return NULL;
+  __lock(&f->lock);
+  while (done < (size_t) size - 1)
+  {
+    if (f->pos >= f->len && fill_unlocked(f))
+      break;
+    /* copy up to the newline in one go */
+    size_t k  = f->len - f->pos;
+    char*  nl = memchr(f->buf + f->pos, '\n', k);
+    if (nl)
+      k = (size_t) (nl - (f->buf + f->pos)) + 1;
+    if (k > (size_t) size - 1 - done)
+      k = (size_t) size - 1 - done;
+    memcpy(s + done, f->buf + f->pos, k);
+    f->pos += k;
+    done += k;
+    if (s[done - 1] == '\n')
+      break;
+  }
+  __unlock(&f->lock);
+  if (!done)
+    return NULL;
+  s[done] = '\0';
+  return s;
+}
+
+int fputc(int c, FILE* f)
+{
+  char ch = (char) c;
+  __lock(&f->lock);
+  size_t done = write_unlocked(f, &ch, 1);
+  __unlock(&f->lock);
+  return done ? (unsigned char) ch : EOF;
+}
+
+int putc(int c, FILE* f)
+{
+  return fputc(c, f);
+}
+
+int putchar(int c)
+{
+  return fputc(c, stdout);
+}
+
+int fputs(const char* s, FILE* f)
+{
+  size_t n = strlen(s);
+  return n && fwrite(s, 1, n, f) != n ? EOF : 0;
+}
+
+int puts(const char* s)
+{
+  size_t n = strlen(s);
+  __lock(&stdout->lock);
+  int r = write_unlocked(stdout, s, n) == n && write_unlocked(stdout, "\n", 1) == 1 ? 0 : EOF;
+  __unlock(&stdout->lock);
+  return r;
+}
+
+int feof(FILE* f)
+{
+  return (f->flags & F_EOF) != 0;
+}
+
+int ferror(FILE* f)
+{
+  return (f->flags & F_ERR) != 0;
+}
+
+void clearerr(FILE* f)
+{
+  f->flags &= ~(F_EOF | F_ERR);
+}
+
+struct file_sink
+{
+  FILE*  f;
+  size_t failed;
+};
+
+static void file_out(void* ctx, const char* p, size_t n)
+{
+  struct file_sink* s = ctx;
+  if (write_unlocked(s->f, p, n) != n)
+    s->failed = 1;
+}
+
+int vfprintf(FILE* f, const char* fmt, va_list ap)
+{
+  struct file_sink s = {f, 0};
+  char             tmp[512];
+  __lock(&f->lock);
+  /* an unbuffered stream still gets each printf as one write */
+  int    unbuf = f->mode == _IONBF && !(f->flags & F_READ);
+  char*  buf   = f->buf;
+  size_t size  = f->size;
+  if (unbuf)
+  {
+    f->mode = _IOFBF;
+    f->buf  = tmp;
+    f->size = sizeof(tmp);
+  }
+  int n = __vformat(file_out, &s, fmt, ap);
+  if (unbuf)
+  {
+    if (flush_unlocked(f))
+      s.failed = 1;
+    f->mode = _IONBF;
+    f->buf  = buf;
+    f->size = size;
+  }
+  __unlock(&f->lock);
+  return s.failed ? -1 : n;
+}
+
+int fprintf(FILE* f, const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vfprintf(f, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+int vprintf(const char* fmt, va_list ap)
+{
+  return vfprintf(stdout, fmt, ap);
+}
+
+int printf(const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vfprintf(stdout, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+void __stdio_exit(void)
+{
+  fflush(NULL);
+}
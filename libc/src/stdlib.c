@@ -0,0 +1,132 @@
+#include "libc.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ATEXIT_MAX 32
+
+static void (*atexit_fns[ATEXIT_MAX])(void);
+static int atexit_count;
+
+int atexit(void (*fn)(void))
+{
+  if (atexit_count == ATEXIT_MAX)
+    return -1;
+  atexit_fns[atexit_count++] = fn;
+  return 0;
+}
+
+void exit(int status)
+{
+  while (atexit_count)
+    atexit_fns[--atexit_count]();
+  __stdio_exit();
+  _exit(status);
+}
+
+void _Exit(int status)
+{
+  _exit(status);
+}
+
+void abort(void)
+{
+  fflush(NULL);
+  write(STDERR_FILENO, "abort\n", 6);
+  _exit(127);
+}
+
+int abs(int x)
+{
+  return x < 0 ? -x : x;
+}
+
+long labs(long x)
+{
+  return x < 0 ? -x : x;
+}
+
+static int digit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A' + 10;
+  return 99;
+}
+
+/* Shared by strtol/strtoul: the magnitude, saturated at limit */
+static unsigned long parse(const char* s, char** end, int base, int* neg, unsigned long limit)
+{
+  const char*   p = s;
+  unsigned long v = 0;
+  int           any = 0, over = 0;
+
+  while (*p == ' ' || (*p >= '\t' && *p <= '\r'))
+    ++p;
+  *neg = 0;
+  if (*p == '-' || *p == '+')
+    *neg = *p++ == '-';
+  if ((base == 0 || base == 16) && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+      digit(p[2]) < 16)
+  {
+    p += 2;
+    base = 16;
+  }
+  else if (base == 0)
+    base = *p == '0' ? 8 : 10;
+
+  for (int d; (d = digit(*p)) < base; ++p)
+  {
+    any = 1;
+    if (v > (limit - (unsigned long) d) / (unsigned long) base)
+      over = 1;
+    else
+      v = v * (unsigned long) base + (unsigned long) d;
+  }
+  if (end)
+    *end = (char*) (any ? p : s);
+  if (over)
+  {
+    errno = ERANGE;
+    return limit;
+  }
+  return v;
+}
+
+long strtol(const char* s, char** end, int base)
+{
+  int           neg;
+  unsigned long v = parse(s, end, base, &neg, (unsigned long) -1 >> 1);
+  return neg ? -(long) v : (long) v;
+}
+
+unsigned long strtoul(const char* s, char** end, int base)
+{
+  int           neg;
+  unsigned long v = parse(s, end, base, &neg, (unsigned long) -1);
+  return neg ? -v : v;
+}
+
+long atol(const char* s)
+{
+  return strtol(s, NULL, 10);
+}
+
+int atoi(const char* s)
+{
+  return (int) strtol(s, NULL, 10);
+}
+
+char* getenv(const char* name)
+{
+  size_t n = strlen(name);
+  for (char** e = environ; e && *e; ++e)
+    if (!strncmp(*e, name, n) && (*e)[n] == '=')
+      return *e + n + 1;
+  return NULL;
+}
@@ -0,0 +1,213 @@
+#include "libc.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bulk copies and fills are single string instructions, as in the
+   kernel's copy routines (mem/uaccess.S) */
+
+void* memcpy(void* dst, const void* src, size_t n)
+{
+  void* d = dst;
+  asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+  return dst;
+}
+
+void* memmove(void* dst, const void* src, size_t n)
+{
+  if ((uintptr_t) dst - (uintptr_t) src >= n)
+    return memcpy(dst, src, n); /* dst below src, or no overlap */
+  char*       d = (char*) dst + n;
+  const char* s = (const char*) src + n;
+  while (n--)
+    *--d = *--s;
+  return dst;
+}
+
+void* memset(void* dst, int c, size_t n)
+{
+  void* d = dst;
+  asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+  return dst;
+}
+
+int memcmp(const void* a, const void* b, size_t n)
+{
+  const unsigned char *p = a, *q = b;
+  for (; n; --n, ++p, ++q)
+    if (*p != *q)
+      return *p - *q;
+  return 0;
+}
+
+void* memchr(const void* s, int c, size_t n)
+{
+  const unsigned char* p = s;
+  for (; n; --n, ++p)
+    if (*p == (unsigned char) c)
+      return (void*) p;
+  return NULL;
+}
+
+size_t strlen(const char* s)
+{
+  const char* p = s;
+  while (*p)
+    ++p;
+  return (size_t) (p - s);
+}
+
+size_t strnlen(const char* s, size_t max)
+{
+  size_t n = 0;
+  while (n < max && s[n])
+    ++n;
+  return n;
+}
+
+int strcmp(const char* a, const char* b)
+{
+  while (*a && *a == *b)
+    ++a, ++b;
+  return (unsigned char) *a - (unsigned char) *b;
+}
+
+int strncmp(const char* a, const char* b, size_t n)
+{
+  for (; n; --n, ++a, ++b)
+    if (*a != *b || !*a)
+      return (unsigned char) *a - (unsigned char) *b;
+  return 0;
+}
+
+char* strcpy(char* dst, const char* src)
+{
+  char* d = dst;
+  while ((*d++ = *src++))
+    ;
+  return dst;
+}
+
+char* strncpy(char* dst, const char* src, size_t n)
+{
+  size_t i = 0;
+  for (; i < n && src[i]; ++i)
+    dst[i] = src[i];
+  for (; i < n; ++i)
+    dst[i] = '\0';
+  return dst;
+}
+
+char* strcat(char* dst, const char* src)
+{
+  strcpy(dst + strlen(dst), src);
+  return dst;
+}
+
+char* strchr(const char* s, int c)
+{
+  for (;; ++s)
+  {
+    if (*s == (char) c)
+      return (char*) s;
+    if (!*s)
+      return NULL;
+  }
+}
+
+char* strrchr(const char* s, int c)
+{
+  const char* last = NULL;
+  for (;; ++s)
+  {
+    if (*s == (char) c)
+      last = s;
+    if (!*s)
+      return (char*) last;
+  }
+}
+
+char* strstr(const char* hay, const char* needle)
+{
+  size_t n = strlen(needle);
+  for (; *hay; ++hay)
+    if (!strncmp(hay, needle, n))
+      return (char*) hay;
+  return n ? NULL : (char*) hay;
+}
+
+size_t strspn(const char* s, const char* accept)
+{
+  size_t n = 0;
+  while (s[n] && strchr(accept, s[n]))
+    ++n;
+  return n;
+}
+
+size_t strcspn(const char* s, const char* reject)
+{
+  size_t n = 0;
+  while (s[n] && !strchr(reject, s[n]))
+    ++n;
+  return n;
+}
+
+char* strtok_r(char* s, const char* delim, char** save)
+{
+  if (!s)
+    s = *save;
+  s += strspn(s, delim);
+  if (!*s)
+  {
+    *save = s;
+    return NULL;
+  }
+  char* end = s + strcspn(s, delim);
+  if (*end)
+    *end++ = '\0';
+  *save = end;
+  return s;
+}
+
+char* strtok(char* s, const char* delim)
+{
+  static char* save;
+  return strtok_r(s, delim, &save);
+}
+
+char* strdup(const char* s)
+{
+  size_t n = strlen(s) + 1;
+  char*  d = malloc(n);
+  return d ? memcpy(d, s, n) : NULL;
+}
+
+char* strerror(int err)
+{
+  switch (err)
+  {
+  case 0: return "Success";
+  case EPERM: return "Operation not permitted";
+  case ENOENT: return "No such file or directory";
+  case EIO: return "I/O error";
+  case ENOEXEC: return "Exec format error";
+  case EBADF: return "Bad file descriptor";
+  case EAGAIN: return "Resource temporarily unavailable";
+  case ENOMEM: return "Out of memory";
+  case EFAULT: return "Bad address";
+  case EBUSY: return "Device or resource busy";
+  case EEXIST: return "File exists";
+  case ENOTDIR: return "Not a directory";
+  case EISDIR: return "Is a directory";
+  case EINVAL: return "Invalid argument";
+  case EMFILE: return "Too many open files";
+  case ENOTTY: return "Not a tty";
+  case EROFS: return "Read-only file system";
+  case EPIPE: return "Broken pipe";
+  case ERANGE: return "Result out of range";
+  case ENAMETOOLONG: return "File name too long";
+  case ENOSYS: return "Function not implemented";
+  case ETIMEDOUT: return "Timed out";
+  default: return "Unknown error";
+  }
+}
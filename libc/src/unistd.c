@@ -0,0 +1,113 @@
+#include "libc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* The break as of the last brk; 0 until the first call asks the kernel */
+static uintptr_t cur_brk;
+static volatile int brk_lock;
+
+long __syscall_ret(long r)
+{
+  if (r < 0 && r > -4096)
+  {
+    errno = (int) -r;
+    return -1;
+  }
+  return r;
+}
+
+int* __errno_location(void)
+{
+  return &__self()->errno_value;
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+  return __syscall_ret(__syscall3(SYS_READ, fd, (long) buf, (long) count));
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+  return __syscall_ret(__syscall3(SYS_WRITE, fd, (long) buf, (long) count));
+}
+
+int open(const char* path, int flags, ...)
+{
+  return (int) __syscall_ret(__syscall2(SYS_OPEN, path, flags));
+}
+
+int close(int fd)
+{
+  return (int) __syscall_ret(__syscall1(SYS_CLOSE, fd));
+}
+
+int pipe(int fds[2])
+{
+  return (int) __syscall_ret(__syscall1(SYS_PIPE, fds));
+}
+
+int execve(const char* path, char* const argv[], char* const envp[])
+{
+  return (int) __syscall_ret(__syscall3(SYS_EXEC, (long) path, (long) argv, (long) envp));
+}
+
+int execv(const char* path, char* const argv[])
+{
+  return execve(path, argv, environ);
+}
+
+pid_t getpid(void)
+{
+  return (pid_t) __syscall0(SYS_GETPID);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+  __syscall1(SYS_SLEEP, (uint64_t) seconds * 1000000000ULL);
+  return 0;
+}
+
+int usleep(unsigned int usec)
+{
+  __syscall1(SYS_SLEEP, (uint64_t) usec * 1000ULL);
+  return 0;
+}
+
+void _exit(int status)
+{
+  for (;;)
+    __syscall1(SYS_EXIT_GROUP, status);
+}
+
+int brk(void* addr)
+{
+  __lock(&brk_lock);
+  cur_brk = (uintptr_t) __syscall1(SYS_BRK, addr);
+  int ok  = cur_brk == (uintptr_t) addr;
+  __unlock(&brk_lock);
+  if (!ok)
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+void* sbrk(intptr_t inc)
+{
+  __lock(&brk_lock);
+  if (!cur_brk)
+    cur_brk = (uintptr_t) __syscall1(SYS_BRK, 0);
+  uintptr_t old = cur_brk;
+  if (inc)
+    cur_brk = (uintptr_t) __syscall1(SYS_BRK, old + inc);
+  int ok = old && cur_brk == old + inc;
+  __unlock(&brk_lock);
+  if (!ok)
+  {
+    errno = ENOMEM;
+    return (void*) -1;
+  }
+  return (void*) old;
+}
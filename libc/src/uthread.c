@@ -0,0 +1,78 @@
+#include "libc.h"
+#include "sys/thread.h"
+#include "multitasking/futex.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <uthread.h>
+
+#define UTHREAD_STACK_SIZE (256 * 1024)
+
+#define UTHREAD_CLONE_FLAGS                                                           \
+  (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SETTLS | \
+   CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID)
+
+extern long __clone(uint64_t flags, void* stack, volatile int* ptid, volatile int* ctid,
+                    uint64_t tls, struct __uthread* t);
+
+/* crt0.S: first C code of a new thread, on its own stack */
+__attribute__((noreturn)) void __uthread_start(struct __uthread* t)
+{
+  uthread_exit(t->fn(t->arg));
+}
+
+int uthread_create(uthread_t* out, void* (*fn)(void*), void* arg)
+{
+  /* one mapping: the stack grows down from the thread block at its top */
+  long r = __syscall3(SYS_MMAP, 0, UTHREAD_STACK_SIZE, __PROT_RW);
+  if (r < 0)
+  {
+    errno = (int) -r;
+    return -1;
+  }
+  char*             base = (char*) r;
+  struct __uthread* t    = (struct __uthread*) (base + UTHREAD_STACK_SIZE) - 1;
+  t->self                = t;
+  t->fn                  = fn;
+  t->arg                 = arg;
+  t->stack               = base;
+  t->stack_size          = UTHREAD_STACK_SIZE;
+
+  void* sp = (void*) ((uintptr_t) t & ~(uintptr_t) 15);
+  r        = __clone(UTHREAD_CLONE_FLAGS, sp, &t->tid, &t->tid, (uint64_t) (uintptr_t) t, t);
+  if (r < 0)
+  {
+    __syscall2(SYS_MUNMAP, base, UTHREAD_STACK_SIZE);
+    errno = (int) -r;
+    return -1;
+  }
+  *out = t;
+  return 0;
+}
+
+int uthread_join(uthread_t t, void** result)
+{
+  /* the kernel zeroes tid and wakes us once the thread is gone for good */
+  int tid;
+  while ((tid = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE)))
+    __syscall6(SYS_FUTEX, (long) &t->tid, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, tid, 0, 0, 0);
+  if (result)
+    *result = t->result;
+  __syscall2(SYS_MUNMAP, t->stack, t->stack_size);
+  return 0;
+}
+
+void uthread_exit(void* result)
+{
+  struct __uthread* t = __self();
+  if (__is_main_thread(t))
+    exit(0);
+  t->result = result;
+  __malloc_thread_exit(t);
+  for (;;)
+    __syscall1(SYS_EXIT, 0);
+}
+
+uthread_t uthread_self(void)
+{
+  return __self();
+}
@@ -0,0 +1,144 @@
+#ifndef BOOT_CPU_H
+#define BOOT_CPU_H
+
+#include <stdint.h>
+
+/* Small inline wrappers around privileged x86-64 instructions shared by the
+   interrupt, timer and scheduler code. */
+
+#define MSR_APIC_BASE     0x1B
+#define MSR_TSC_DEADLINE  0x6E0
+#define MSR_EFER          0xC0000080
+#define MSR_STAR          0xC0000081
+#define MSR_LSTAR         0xC0000082
+#define MSR_SFMASK        0xC0000084
+#define MSR_FS_BASE       0xC0000100
+#define MSR_GS_BASE       0xC0000101
+#define MSR_KERNEL_GS_BASE 0xC0000102
+
+#define EFER_SCE (1ULL << 0) /* SYSCALL/SYSRET enable */
+
+#define CR0_MP              (1ULL << 1)  /* WAIT honours CR0.TS */
+#define CR0_EM              (1ULL << 2)  /* x87 emulation: #UD on FPU/SSE use */
+#define CR0_TS              (1ULL << 3)  /* #NM on the next FPU/SSE use */
+#define CR4_OSFXSR          (1ULL << 9)  /* FXSAVE/FXRSTOR and SSE usable */
+#define CR4_OSXMMEXCPT      (1ULL << 10) /* unmasked SSE exceptions raise #XM */
+#define CR4_FSGSBASE        (1ULL << 16) /* RD/WR{FS,GS}BASE usable */
+#define CPUID7_EBX_FSGSBASE (1U << 0)
+
+static inline uint64_t rdtsc(void)
+{
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+  uint32_t lo, hi;
+  asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val)
+{
+  asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t) val), "d"((uint32_t) (val >> 32)) : "memory");
+}
+
+static inline void cpuid(uint32_t leaf,
+                         uint32_t subleaf,
+                         uint32_t* a,
+                         uint32_t* b,
+                         uint32_t* c,
+                         uint32_t* d)
+{
+  asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(subleaf));
+}
+
+/* Disable interrupts and return the previous RFLAGS so the caller can restore
+   the exact interrupt state (nesting-safe). */
+static inline uint64_t irq_save(void)
+{
+  uint64_t flags;
+  asm volatile("pushfq\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+  return flags;
+}
+
+static inline void irq_restore(uint64_t flags)
+{
+  asm volatile("push %0\n\tpopfq" : : "g"(flags) : "memory", "cc");
+}
+
+static inline int irq_enabled(void)
+{
+  uint64_t flags;
+  asm volatile("pushfq\n\tpop %0" : "=r"(flags));
+  return (flags & (1ULL << 9)) != 0;
+}
+
+static inline uint64_t read_cr0(void)
+{
+  uint64_t cr0;
+  asm volatile("mov %%cr0, %0" : "=r"(cr0));
+  return cr0;
+}
+
+static inline void write_cr0(uint64_t cr0)
+{
+  asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+static inline uint64_t read_cr4(void)
+{
+  uint64_t cr4;
+  asm volatile("mov %%cr4, %0" : "=r"(cr4));
+  return cr4;
+}
+
+static inline void write_cr4(uint64_t cr4)
+{
+  asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+/* Only with CR4_FSGSBASE set; they #UD otherwise */
+static inline uint64_t rdfsbase(void)
+{
+  uint64_t base;
+  asm volatile("rdfsbase %0" : "=r"(base));
+  return base;
+}
+
+static inline void wrfsbase(uint64_t base)
+{
+  asm volatile("wrfsbase %0" : : "r"(base) : "memory");
+}
+
+static inline uint64_t rdgsbase(void)
+{
+  uint64_t base;
+  asm volatile("rdgsbase %0" : "=r"(base));
+  return base;
+}
+
+static inline void wrgsbase(uint64_t base)
+{
+  asm volatile("wrgsbase %0" : : "r"(base) : "memory");
+}
+
+/* The x87/SSE register file, in the 512-byte, 16-aligned FXSAVE layout */
+static inline void fxsave(void* area)
+{
+  asm volatile("fxsave64 %0" : "=m"(*(uint8_t(*)[512]) area));
+}
+
+static inline void fxrstor(const void* area)
+{
+  asm volatile("fxrstor64 %0" : : "m"(*(const uint8_t(*)[512]) area));
+}
+
+static inline void cpu_relax(void)
+{
+  asm volatile("pause" : : : "memory");
+}
+
+#endif
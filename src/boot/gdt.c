@@ -52,10 +52,10 @@ void gdt_init(void)
   gdt[2] = gdt_entry(0, 0, 0x92, 0x0);  // Kernel data
   serial_puts("gdt: set 2\n");
   serial_puts("gdt: about to set 3\n");
-  gdt[3] = gdt_entry(0, 0, 0xFA, 0xA);  // User code
+  gdt[3] = gdt_entry(0, 0, 0xF2, 0x0);  // User data (SYSRET wants it below user code)
   serial_puts("gdt: set 3\n");
   serial_puts("gdt: about to set 4\n");
-  gdt[4] = gdt_entry(0, 0, 0xF2, 0x0);  // User data
+  gdt[4] = gdt_entry(0, 0, 0xFA, 0xA);  // User code
   serial_puts("gdt: set 4\n");
   serial_puts("gdt: about to set 5\n");
   gdt[5] = 0;  // placeholder TSS low
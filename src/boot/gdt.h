@@ -1,6 +1,16 @@
 #ifndef GDT_H
 #define GDT_H
 
+/* Segment selectors. User data sits below user code because SYSRET loads
+   SS from STAR[63:48] + 8 and CS from STAR[63:48] + 16. */
+#define GDT_KERNEL_CS 0x08
+#define GDT_KERNEL_DS 0x10
+#define GDT_USER_DS   0x1B
+#define GDT_USER_CS   0x23
+#define GDT_TSS       0x28
+
+#ifndef __ASSEMBLER__
+
 #include <stdint.h>
 
 struct gdt_ptr {
@@ -10,6 +20,10 @@ struct gdt_ptr {
 
 void gdt_init(void);
 void tss_init(void);
+/* Kernel stack the CPU switches to on a ring 3 -> ring 0 transition */
+void tss_set_rsp0(uint64_t rsp0);
 void gdt_set_tss(uint64_t tss_addr, uint32_t tss_limit);
 
+#endif /* __ASSEMBLER__ */
+
 #endif
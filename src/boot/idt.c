@@ -1,3 +1,4 @@
+#include "boot/lapic.h"
 #include "serial/serial.h"
 #include <stdint.h>
 
@@ -24,6 +25,8 @@ extern void __load_idt_asm(struct idt_ptr* p);
 extern void __isr_stub_80(void);
 extern void __isr_stub_14(void);
 extern void __isr_panic(void);
+extern void __isr_stub_timer(void);
+extern void __isr_stub_spurious(void);
 
 static void set_idt_entry(int n, void* handler, uint16_t sel, uint8_t flags, uint8_t ist)
 {
@@ -84,6 +87,9 @@ void idt_init(void)
   set_idt_entry(0x80, __isr_stub_80, 0x08, 0xEE, 0);
   /* install page fault handler */
   set_idt_entry(14, __isr_stub_14, 0x08, 0x8E, 0);
+  /* local APIC timer and spurious vectors */
+  set_idt_entry(LAPIC_TIMER_VECTOR, __isr_stub_timer, 0x08, 0x8E, 0);
+  set_idt_entry(LAPIC_SPURIOUS_VECTOR, __isr_stub_spurious, 0x08, 0x8E, 0);
   idtp.limit = sizeof(idt) - 1;
   idtp.base  = (uint64_t) (uintptr_t) &idt;
   serial_puts("idt: idtp.limit = ");
@@ -0,0 +1,167 @@
+#include "boot/lapic.h"
+#include "boot/cpu.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+static inline void outb(uint16_t port, uint8_t val)
+{
+  asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+/* xAPIC register offsets; x2APIC MSR = 0x800 + (offset >> 4) */
+#define LAPIC_REG_ID       0x020
+#define LAPIC_REG_EOI      0x0B0
+#define LAPIC_REG_SPURIOUS 0x0F0
+#define LAPIC_REG_LVT_TMR  0x320
+#define LAPIC_REG_TMR_INIT 0x380
+#define LAPIC_REG_TMR_CUR  0x390
+#define LAPIC_REG_TMR_DIV  0x3E0
+
+#define LAPIC_LVT_MASKED       (1U << 16)
+#define LAPIC_LVT_ONESHOT      (0U << 17)
+#define LAPIC_LVT_TSC_DEADLINE (2U << 17)
+
+/* Limine (base revision 0) identity-maps the low 4 GiB, so the default xAPIC
+   MMIO window is directly addressable. */
+#define LAPIC_MMIO_DEFAULT 0xFEE00000ULL
+
+static volatile uint32_t* lapic_mmio   = NULL;
+static int                x2apic       = 0;
+static int                tsc_deadline = 0;
+static int                timer_ok     = 0;
+static uint64_t           lapic_hz     = 0; /* one-shot mode only, after /16 */
+
+static uint32_t lapic_read(uint32_t reg)
+{
+  if (x2apic)
+    return (uint32_t) rdmsr(0x800 + (reg >> 4));
+  return lapic_mmio[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t val)
+{
+  if (x2apic)
+    wrmsr(0x800 + (reg >> 4), val);
+  else
+    lapic_mmio[reg / 4] = val;
+}
+
+/* Measure the LAPIC timer against the (already calibrated) TSC */
+static uint64_t lapic_calibrate(void)
+{
+  lapic_write(LAPIC_REG_TMR_DIV, 0x3); /* divide by 16 */
+  lapic_write(LAPIC_REG_LVT_TMR, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+  lapic_write(LAPIC_REG_TMR_INIT, 0xFFFFFFFF);
+  clock_spin_ns(10 * NSEC_PER_MSEC);
+  uint32_t left = lapic_read(LAPIC_REG_TMR_CUR);
+  lapic_write(LAPIC_REG_TMR_INIT, 0);
+  return (uint64_t) (0xFFFFFFFFU - left) * 100;
+}
+
+int lapic_init(void)
+{
+  serial_puts("lapic: init\n");
+  uint32_t a, b, c, d;
+  cpuid(1, 0, &a, &b, &c, &d);
+  if (!(d & (1U << 9)))
+  {
+    serial_puts("lapic: no local APIC, timers will be polled\n");
+    return -1;
+  }
+
+  /* the legacy PIC would deliver onto exception vectors; mask it for good */
+  outb(0x21, 0xFF);
+  outb(0xA1, 0xFF);
+
+  uint64_t base = rdmsr(MSR_APIC_BASE);
+  if (c & (1U << 21))
+  {
+    x2apic = 1;
+    wrmsr(MSR_APIC_BASE, base | (1ULL << 11) | (1ULL << 10));
+    serial_puts("lapic: x2APIC mode\n");
+  }
+  else
+  {
+    wrmsr(MSR_APIC_BASE, base | (1ULL << 11));
+    uint64_t phys = base & ~0xFFFULL;
+    lapic_mmio    = (volatile uint32_t*) (uintptr_t) (phys ? phys : LAPIC_MMIO_DEFAULT);
+    serial_puts("lapic: xAPIC mode at ");
+    serial_puthex64((uint64_t) (uintptr_t) lapic_mmio);
+  }
+
+  /* software-enable and route spurious interrupts to a harmless vector */
+  lapic_write(LAPIC_REG_SPURIOUS, 0x100 | LAPIC_SPURIOUS_VECTOR);
+
+  tsc_deadline = (c & (1U << 24)) != 0;
+  if (tsc_deadline)
+  {
+    lapic_write(LAPIC_REG_LVT_TMR, LAPIC_LVT_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+    /* SDM: the LVT write must be ordered before the first deadline write */
+    asm volatile("mfence" : : : "memory");
+    wrmsr(MSR_TSC_DEADLINE, 0);
+    serial_puts("lapic: timer in TSC-deadline mode\n");
+  }
+  else
+  {
+    lapic_hz = lapic_calibrate();
+    if (!lapic_hz)
+    {
+      serial_puts("lapic: timer calibration failed\n");
+      return -1;
+    }
+    lapic_write(LAPIC_REG_LVT_TMR, LAPIC_LVT_ONESHOT | LAPIC_TIMER_VECTOR);
+    serial_puts("lapic: timer in one-shot mode, Hz = ");
+    serial_putdec(lapic_hz);
+  }
+
+  timer_ok = 1;
+  return 0;
+}
+
+int lapic_timer_available(void)
+{
+  return timer_ok;
+}
+
+uint32_t lapic_id(void)
+{
+  if (x2apic)
+    return lapic_read(LAPIC_REG_ID);
+  return lapic_mmio ? lapic_read(LAPIC_REG_ID) >> 24 : 0;
+}
+
+void lapic_eoi(void)
+{
+  lapic_write(LAPIC_REG_EOI, 0);
+}
+
+void lapic_timer_program(uint64_t deadline_ns)
+{
+  if (!timer_ok)
+    return;
+
+  if (tsc_deadline)
+  {
+    /* writing 0 disarms; an already-passed deadline fires immediately */
+    wrmsr(MSR_TSC_DEADLINE, deadline_ns ? clock_ns_to_tsc(deadline_ns) : 0);
+    return;
+  }
+
+  if (!deadline_ns)
+  {
+    lapic_write(LAPIC_REG_TMR_INIT, 0);
+    return;
+  }
+
+  uint64_t now   = clock_now_ns();
+  uint64_t delta = deadline_ns > now ? deadline_ns - now : 0;
+  if (delta > 60 * NSEC_PER_SEC)
+    delta = 60 * NSEC_PER_SEC;
+  uint64_t count = (delta / 1000) * lapic_hz / 1000000 + 1;
+  /* an over-long one-shot just wakes early and gets re-armed */
+  if (count > 0xFFFFFFFFULL)
+    count = 0xFFFFFFFFULL;
+  lapic_write(LAPIC_REG_TMR_INIT, (uint32_t) count);
+}
@@ -0,0 +1,24 @@
+#ifndef BOOT_LAPIC_H
+#define BOOT_LAPIC_H
+
+#include <stdint.h>
+
+#define LAPIC_TIMER_VECTOR    0x40
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+/* Enable the local APIC (x2APIC when available) and pick the timer mode */
+int lapic_init(void);
+
+/* Signal end-of-interrupt for the vector currently in service */
+void lapic_eoi(void);
+
+/* Fire LAPIC_TIMER_VECTOR once at absolute monotonic time deadline_ns.
+   A deadline of 0 stops the timer. */
+void lapic_timer_program(uint64_t deadline_ns);
+
+/* 1 when the timer interrupt can be relied on, 0 if timers must be polled */
+int lapic_timer_available(void);
+
+uint32_t lapic_id(void);
+
+#endif
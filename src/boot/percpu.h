@@ -0,0 +1,31 @@
+#ifndef BOOT_PERCPU_H
+#define BOOT_PERCPU_H
+
+/* Per-CPU block reached through GS by the SYSCALL entry stub, which has
+   nothing else to find a kernel stack with. Kernel code runs with the
+   user GS base loaded (the block sits in MSR_KERNEL_GS_BASE), and the stub
+   swaps it in only for the few instructions that switch stacks. */
+
+/* field offsets for the assembly stub */
+#define PERCPU_KERNEL_RSP 0
+#define PERCPU_USER_RSP   8
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+struct percpu
+{
+  uint64_t kernel_rsp; /* top of the running task's kernel stack */
+  uint64_t user_rsp;   /* scratch: user RSP during the stack switch */
+};
+
+extern struct percpu percpu0;
+
+/* Kernel stack for ring 3 -> ring 0 entries, through both the TSS
+   (interrupts, int 0x80) and the SYSCALL stub */
+void percpu_set_kernel_stack(uint64_t top);
+
+#endif /* __ASSEMBLER__ */
+
+#endif
@@ -1,4 +1,5 @@
 #include "boot/gdt.h"
+#include "boot/percpu.h"
 #include "serial/serial.h"
 #include <stddef.h>  // dla size_t
 #include <stdint.h>
@@ -25,6 +26,10 @@ struct __attribute__((packed)) tss_struct
 static struct tss_struct tss;
 extern uint8_t           kernel_stack_top[]; /* defined in entry.S */
 
+struct percpu percpu0;
+_Static_assert(__builtin_offsetof(struct percpu, kernel_rsp) == PERCPU_KERNEL_RSP, "percpu layout");
+_Static_assert(__builtin_offsetof(struct percpu, user_rsp) == PERCPU_USER_RSP, "percpu layout");
+
 void tss_init(void)
 {
   serial_puts("tss: init\n");
@@ -42,7 +47,8 @@ void tss_init(void)
 
   extern uint8_t kernel_stack_top[];
   serial_puts("tss: setting rsp0\n");
-  tss.rsp0 = (uint64_t) (uintptr_t) kernel_stack_top;
+  tss.rsp0           = (uint64_t) (uintptr_t) kernel_stack_top;
+  percpu0.kernel_rsp = tss.rsp0;
   serial_puts("tss: rsp0 set\n");
 
   tss.io_map_base = sizeof(tss);
@@ -53,3 +59,14 @@ void tss_init(void)
   gdt_set_tss((uint64_t) (uintptr_t) &tss, sizeof(tss) - 1);
   serial_puts("tss: gdt_set_tss returned\n");
 }
+
+void tss_set_rsp0(uint64_t rsp0)
+{
+  tss.rsp0 = rsp0;
+}
+
+void percpu_set_kernel_stack(uint64_t top)
+{
+  tss.rsp0           = top;
+  percpu0.kernel_rsp = top;
+}
@@ -74,31 +74,6 @@ long __isoc23_strtol(const char* nptr, char** endptr, int base)
   return strtol(nptr, endptr, base);
 }
 
-/* simple pow and ldexp for stb_image HDR paths; not highly accurate but
- * sufficient */
-#include <math.h>
-
-double pow(double a, double b)
-{  // use a very small naive implementation
-  double res = 1.0;
-  int    ib  = (int) b;
-  for (int i = 0; i < ib; ++i)
-    res *= a;
-  return res;
-}
-
-double ldexp(double x, int exp)
-{
-  /* multiply by 2^exp */
-  if (exp > 0)
-    while (exp--)
-      x *= 2.0;
-  else
-    while (exp++)
-      x /= 2.0;
-  return x;
-}
-
 int abs(int x)
 {
   return x < 0 ? -x : x;
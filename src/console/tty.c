@@ -0,0 +1,386 @@
+#include "console/tty.h"
+#include "console/console.h"
+#include "drivers/keyboard/keyboard.h"
+#include "fs/poll.h"
+#include "lib/errno.h"
+#include "mem/uaccess.h"
+#include "multitasking/preempt.h"
+#include "multitasking/softirq.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include <string.h>
+
+/* The PS/2 controller is polled (the PIC stays masked), so the keyboard is
+   only sampled while someone is blocked reading the terminal or waiting
+   for it to become readable */
+#define TTY_POLL_NS     (10 * NSEC_PER_MSEC)
+#define TTY_POLL_BURST  16
+#define TTY_CHUNK       128
+
+#define CTRL_D 0x04
+#define CTRL_U 0x15
+#define DEL    0x7F
+
+static struct tty       console;
+static struct tty_stats stats;
+
+/* ── Rings (t->lock held) ─────────────────────────────────────────── */
+
+/* Positions run freely and wrap; the sizes are powers of two. src may be
+   a user buffer: returns the bytes taken, -EFAULT if it faulted first. */
+static long ring_put(char* ring, uint32_t size, uint32_t* head, uint32_t tail, const char* src,
+                     size_t len)
+{
+  size_t room = size - (*head - tail);
+  if (len > room)
+    len = room;
+  size_t at    = *head % size;
+  size_t first = len < size - at ? len : size - at;
+  size_t done  = first - __copy_user(ring + at, src, first);
+  if (done == first)
+    done += (len - first) - __copy_user(ring, src + first, len - first);
+  *head += (uint32_t) done;
+  return len && !done ? -EFAULT : (long) done;
+}
+
+static void out_puts(struct tty* t, const char* s, size_t len)
+{
+  /* echo never blocks: it is dropped if output is that far behind */
+  ring_put(t->out, TTY_OUT_SIZE, &t->out_head, t->out_tail, s, len);
+}
+
+static int commit_line(struct tty* t)
+{
+  ring_put(t->in, TTY_IN_SIZE, &t->in_head, t->in_tail, t->line, t->line_len);
+  t->line_len = 0;
+  return 1;
+}
+
+/* ── Line discipline ──────────────────────────────────────────────── */
+
+/* Returns 1 if readers have something new */
+static int discipline(struct tty* t, char c)
+{
+  int echo = t->lflag & TTY_ECHO;
+  if (c == '\r')
+    c = '\n';
+  ++stats.bytes_in;
+
+  if (!(t->lflag & TTY_ICANON))
+  {
+    if (echo)
+      out_puts(t, &c, 1);
+    return ring_put(t->in, TTY_IN_SIZE, &t->in_head, t->in_tail, &c, 1) != 0;
+  }
+
+  switch (c)
+  {
+  case '\b':
+  case DEL:
+    if (t->line_len)
+    {
+      --t->line_len;
+      if (echo)
+        out_puts(t, "\b \b", 3);
+    }
+    return 0;
+  case CTRL_U:
+    for (; t->line_len; --t->line_len)
+      if (echo)
+        out_puts(t, "\b \b", 3);
+    return 0;
+  case CTRL_D:
+    if (t->line_len)
+      return commit_line(t);
+    t->eof = 1;
+    return 1;
+  default:
+    break;
+  }
+
+  /* keep the last slot for the newline */
+  if (c != '\n' && t->line_len == TTY_LINE_MAX - 1)
+    return 0;
+  t->line[t->line_len++] = c;
+  if (echo)
+    out_puts(t, &c, 1);
+  return c == '\n' ? commit_line(t) : 0;
+}
+
+void tty_input(struct tty* t, char c)
+{
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  int      wake  = discipline(t, c);
+  spin_unlock_irqrestore(&t->lock, flags);
+  if (t->lflag & TTY_ECHO)
+    waitqueue_wake_all(&t->out_wait);
+  if (wake)
+    waitqueue_wake_all_sync(&t->rd_wait);
+}
+
+/* ── Keyboard input ───────────────────────────────────────────────── */
+
+/* Someone waits for input: blocked in tty_read or watching rd_wait */
+static int wants_input(const struct tty* t)
+{
+  return t->readers || t->rd_wait.head;
+}
+
+static void tty_input_softirq(void)
+{
+  struct tty* t = &console;
+  if (!wants_input(t))
+    return; /* nobody reading: leave keys to whoever polls the keyboard */
+  for (int i = 0; i < TTY_POLL_BURST; ++i)
+    keyboard_poll();
+  int c;
+  while ((c = keyboard_getchar()) >= 0)
+    tty_input(t, (char) c);
+}
+
+/* timer softirq: interrupts are off */
+static void tty_poll_timer(void* arg)
+{
+  struct tty* t = arg;
+  softirq_raise(SOFTIRQ_INPUT);
+  if (wants_input(t))
+    timer_arm(&t->poll, clock_now_ns() + TTY_POLL_NS);
+}
+
+/* ── Output ───────────────────────────────────────────────────────── */
+
+/* The framebuffer console draws whole lines, so text is held back until
+   its newline (or until a row's worth has piled up) */
+static void fb_putc(struct tty* t, char c)
+{
+  if (c == '\r')
+    return;
+  if (c == '\b')
+  {
+    if (t->fb_len)
+      --t->fb_len;
+    return;
+  }
+  if (c != '\n')
+    t->fb_line[t->fb_len++] = c;
+  if (c == '\n' || t->fb_len == TTY_FB_COLS)
+  {
+    t->fb_line[t->fb_len] = '\0';
+    console_puts(t->fb_line);
+    t->fb_len = 0;
+  }
+}
+
+/* Move one chunk from the ring to the devices; 0 once the ring is empty.
+   The chunk is taken and written under flush_lock, so output stays in
+   order whoever drains. */
+static int drain_chunk(struct tty* t)
+{
+  char chunk[TTY_CHUNK];
+  spin_lock(&t->flush_lock);
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  uint32_t n     = 0;
+  while (n < TTY_CHUNK && t->out_tail != t->out_head)
+    chunk[n++] = t->out[t->out_tail++ % TTY_OUT_SIZE];
+  spin_unlock_irqrestore(&t->lock, flags);
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    serial_putc(chunk[i]);
+    fb_putc(t, chunk[i]);
+  }
+  spin_unlock(&t->flush_lock);
+  waitqueue_wake_all(&t->wr_wait); /* tty_wait_output also waits for this */
+  return n != 0;
+}
+
+/* Push everything buffered out to the devices */
+static void drain(struct tty* t)
+{
+  while (drain_chunk(t))
+    ;
+}
+
+/* The flusher: parks on out_wait while the ring is empty, then writes a
+   chunk per poll so a burst of output shares the workqueue threads with
+   other work instead of holding one for the whole burst */
+static int tty_flush_poll(struct async_task* a)
+{
+  struct tty* t = (struct tty*) ((char*) a - offsetof(struct tty, flusher));
+  ASYNC_BEGIN(a);
+  for (;;)
+  {
+    ASYNC_WAIT_EVENT(a, &t->out_wait, t->out_head != t->out_tail);
+    ++stats.flushes;
+    while (drain_chunk(t))
+      ASYNC_YIELD(a);
+  }
+  ASYNC_END(a);
+}
+
+static int has_room(void* arg)
+{
+  struct tty* t = arg;
+  return t->out_head - t->out_tail < TTY_OUT_SIZE;
+}
+
+static int output_idle(void* arg)
+{
+  struct tty* t = arg;
+  return t->out_head == t->out_tail && !t->flush_lock.locked;
+}
+
+long tty_write(struct tty* t, const void* buf, size_t len)
+{
+  const char* src  = buf;
+  size_t      done = 0;
+  for (;;)
+  {
+    uint64_t flags = spin_lock_irqsave(&t->lock);
+    long     n = ring_put(t->out, TTY_OUT_SIZE, &t->out_head, t->out_tail, src + done, len - done);
+    spin_unlock_irqrestore(&t->lock, flags);
+    if (n < 0)
+    {
+      if (!done)
+        return n;
+      len = done;
+      break;
+    }
+    done += (size_t) n;
+    if (done == len)
+      break;
+
+    ++stats.writer_waits;
+    if (preempt_count())
+      drain(t); /* cannot sleep here (e.g. spliced out of a locked pipe) */
+    else
+    {
+      waitqueue_wake_all(&t->out_wait);
+      waitqueue_wait(&t->wr_wait, has_room, t);
+    }
+  }
+  stats.bytes_out += len;
+  waitqueue_wake_all(&t->out_wait);
+  return (long) len;
+}
+
+void tty_wait_output(struct tty* t)
+{
+  waitqueue_wake_all(&t->out_wait);
+  waitqueue_wait(&t->wr_wait, output_idle, t);
+}
+
+/* ── Reading ──────────────────────────────────────────────────────── */
+
+static int has_input(void* arg)
+{
+  struct tty* t = arg;
+  return t->in_head != t->in_tail || t->eof;
+}
+
+long tty_read(struct tty* t, void* buf, size_t len)
+{
+  char   tmp[TTY_LINE_MAX];
+  size_t n = 0;
+  if (len == 0)
+    return 0;
+  if (len > sizeof(tmp))
+    len = sizeof(tmp);
+
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  while (!has_input(t))
+  {
+    if (t->readers++ == 0)
+      timer_arm(&t->poll, clock_now_ns() + TTY_POLL_NS);
+    spin_unlock_irqrestore(&t->lock, flags);
+    waitqueue_wait(&t->rd_wait, has_input, t);
+    flags = spin_lock_irqsave(&t->lock);
+    --t->readers;
+  }
+  if (t->in_head == t->in_tail)
+    t->eof = 0;
+  while (n < len && t->in_tail != t->in_head)
+  {
+    char c   = t->in[t->in_tail++ % TTY_IN_SIZE];
+    tmp[n++] = c;
+    if (c == '\n' && (t->lflag & TTY_ICANON))
+      break;
+  }
+  spin_unlock_irqrestore(&t->lock, flags);
+
+  /* copied out after unlocking: the user buffer may fault */
+  size_t left = __copy_user(buf, tmp, n);
+  if (left && left == n)
+    return -EFAULT;
+  return (long) (n - left);
+}
+
+uint32_t tty_poll(struct tty* t, struct poll_table* pt)
+{
+  uint32_t mask = 0;
+  poll_wait(pt, &t->rd_wait, POLLIN);
+  poll_wait(pt, &t->wr_wait, POLLOUT);
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  if (has_input(t))
+    mask |= POLLIN;
+  else if (t->rd_wait.head && !timer_pending(&t->poll))
+    timer_arm(&t->poll, clock_now_ns() + TTY_POLL_NS); /* start sampling keys */
+  if (has_room(t))
+    mask |= POLLOUT;
+  spin_unlock_irqrestore(&t->lock, flags);
+  return mask;
+}
+
+/* ── Modes ────────────────────────────────────────────────────────── */
+
+uint32_t tty_get_lflag(struct tty* t)
+{
+  return t->lflag;
+}
+
+void tty_set_lflag(struct tty* t, uint32_t lflag)
+{
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  int      wake  = 0;
+  if ((t->lflag & TTY_ICANON) && !(lflag & TTY_ICANON) && t->line_len)
+    wake = commit_line(t);
+  t->lflag = lflag;
+  spin_unlock_irqrestore(&t->lock, flags);
+  if (wake)
+    waitqueue_wake_all_sync(&t->rd_wait);
+}
+
+void tty_flush_input(struct tty* t)
+{
+  uint64_t flags = spin_lock_irqsave(&t->lock);
+  t->in_tail     = t->in_head;
+  t->line_len    = 0;
+  t->eof         = 0;
+  spin_unlock_irqrestore(&t->lock, flags);
+}
+
+void tty_init(void)
+{
+  struct tty* t = &console;
+  memset(t, 0, sizeof(*t));
+  spin_lock_init(&t->lock);
+  spin_lock_init(&t->flush_lock);
+  /* Linux's default: ISIG | ICANON | ECHO | ECHOE | ECHOK | ECHOCTL | ECHOKE | IEXTEN */
+  t->lflag = 0x8A3B;
+  waitqueue_init(&t->rd_wait);
+  waitqueue_init(&t->wr_wait);
+  waitqueue_init(&t->out_wait);
+  async_init(&t->flusher, tty_flush_poll, NULL);
+  async_spawn(&t->flusher);
+  timer_setup(&t->poll, tty_poll_timer, t);
+  softirq_register(SOFTIRQ_INPUT, tty_input_softirq);
+}
+
+struct tty* tty_console(void)
+{
+  return &console;
+}
+
+void tty_get_stats(struct tty_stats* out)
+{
+  *out = stats;
+}
@@ -0,0 +1,92 @@
+#ifndef CONSOLE_TTY_H
+#define CONSOLE_TTY_H
+
+#include "multitasking/async.h"
+#include "multitasking/spinlock.h"
+#include "multitasking/waitqueue.h"
+#include "time/timer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* The console terminal behind SYS_READ/SYS_WRITE on the console file.
+
+   Output goes into a ring and an async task fans it out to the serial port
+   and the framebuffer console, so a writer returns as soon as its bytes are
+   buffered instead of waiting on the UART byte by byte; it only blocks
+   while the ring is full. Input is fed from the keyboard through a line
+   discipline: canonical mode edits a line at a time (erase, kill, EOF) and
+   hands readers whole lines, raw mode hands over bytes as they are typed.
+   Mode bits are the Linux termios c_lflag ones. */
+
+#define TTY_ICANON 0x0002
+#define TTY_ECHO   0x0008
+
+#define TTY_IN_SIZE   1024
+#define TTY_OUT_SIZE  8192
+#define TTY_LINE_MAX  256
+#define TTY_FB_COLS   128
+
+struct tty
+{
+  spinlock_t lock; /* irqsave: input arrives from softirq context */
+
+  char     in[TTY_IN_SIZE]; /* committed input, ready for readers */
+  uint32_t in_head, in_tail;
+  char     line[TTY_LINE_MAX]; /* canonical line being edited */
+  uint32_t line_len;
+  int      eof; /* ^D on an empty line: the next read returns 0 */
+  uint32_t lflag;
+  int      readers; /* tasks blocked in tty_read; input is routed here */
+
+  char     out[TTY_OUT_SIZE];
+  uint32_t out_head, out_tail;
+
+  spinlock_t flush_lock; /* one drainer at a time: keeps output in order */
+  char       fb_line[TTY_FB_COLS + 1]; /* framebuffer text up to the next '\n' */
+  uint32_t   fb_len;
+
+  struct waitqueue  rd_wait;  /* readers: wait for input or EOF */
+  struct waitqueue  wr_wait;  /* writers: wait for room in out */
+  struct waitqueue  out_wait; /* the flusher: wait for output */
+  struct async_task flusher;
+  struct timer      poll;
+};
+
+struct tty_stats
+{
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t flushes;      /* drain passes run by the flusher task */
+  uint64_t writer_waits; /* writes that found the output ring full */
+};
+
+void tty_init(void);
+struct tty* tty_console(void);
+
+/* Buffer len bytes for output; blocks only while the ring is full. Returns
+   len, or less (-EFAULT if nothing) if buf turns out to be bad. */
+long tty_write(struct tty* t, const void* buf, size_t len);
+/* Block for input: a line (or what fits of it) in canonical mode, whatever
+   has been typed in raw mode. 0 after ^D on an empty line. */
+long tty_read(struct tty* t, void* buf, size_t len);
+
+/* POLL* readiness for the console file (fs/poll.h): POLLIN once a read
+   would not block, POLLOUT while the output ring has room. A watcher on
+   rd_wait keeps the keyboard sampled like a blocked reader does. */
+struct poll_table;
+uint32_t tty_poll(struct tty* t, struct poll_table* pt);
+
+/* Run one character through the line discipline; any context */
+void tty_input(struct tty* t, char c);
+
+uint32_t tty_get_lflag(struct tty* t);
+/* Change ICANON/ECHO; leaving canonical mode commits the pending line */
+void tty_set_lflag(struct tty* t, uint32_t lflag);
+/* Wait until everything written has reached the devices */
+void tty_wait_output(struct tty* t);
+/* Throw away unread input and the line being edited */
+void tty_flush_input(struct tty* t);
+
+void tty_get_stats(struct tty_stats* out);
+
+#endif
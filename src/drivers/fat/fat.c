@@ -123,55 +123,56 @@ static void name_to_83(const char* name, char out[11])
   }
 }
 
-int fat_read_file(const char* name, void** out_buf, size_t* out_len)
+/* Find name in the root directory */
+static int find_entry(const char* name, uint32_t* first_cluster, uint32_t* size, uint8_t* attr)
 {
-  if (!name || !out_buf || !out_len)
-    return -1;
   uint8_t clbuf[4096]; /* allow for up to 8 sectors */
-  uint8_t secbuf[512];
   /* start at root cluster */
-  uint32_t cluster       = root_cluster ? root_cluster : 2;
-  size_t   file_size     = 0;
-  uint32_t first_cluster = 0;
+  uint32_t cluster = root_cluster ? root_cluster : 2;
 
   char want[11];
   name_to_83(name, want);
 
-  while (1)
+  if (read_cluster(cluster, clbuf) != 0)
+    return -1;
+  /* iterate directory entries */
+  for (int off = 0; off < (int) (sectors_per_cluster * 512); off += 32)
   {
-    if (read_cluster(cluster, clbuf) != 0)
-      return -1;
-    /* iterate directory entries */
-    for (int off = 0; off < (int) (sectors_per_cluster * 512); off += 32)
+    uint8_t first = clbuf[off];
+    if (first == 0x00)
+      return -1; /* end of dir */
+    if (first == 0xE5)
+      continue; /* deleted */
+    if (clbuf[off + 11] == 0x0F)
+      continue; /* LFN */
+    /* compare name */
+    if (memcmp(&clbuf[off], want, 11) == 0)
     {
-      uint8_t attr  = clbuf[off + 11];
-      uint8_t first = clbuf[off];
-      if (first == 0x00)
-        return -1; /* end of dir */
-      if (first == 0xE5)
-        continue; /* deleted */
-      if (attr == 0x0F)
-        continue; /* LFN */
-      /* compare name */
-      if (memcmp(&clbuf[off], want, 11) == 0)
+      uint32_t fc = ((uint32_t) clbuf[off + 26]) | ((uint32_t) clbuf[off + 27] << 8);
+      if (fat_size_sectors > 0 && *((uint32_t*) &clbuf[off + 20]) != 0)
       {
-        first_cluster = ((uint32_t) clbuf[off + 26]) | ((uint32_t) clbuf[off + 27] << 8);
-        if (fat_size_sectors > 0 && *((uint32_t*) &clbuf[off + 20]) != 0)
-        {
-          /* FAT32 high word */
-          uint32_t hi = *((uint32_t*) &clbuf[off + 20]);
-          first_cluster |= (hi & 0xFFFF) << 16;
-        }
-        file_size = *((uint32_t*) &clbuf[off + 28]);
-        goto found;
+        /* FAT32 high word */
+        uint32_t hi = *((uint32_t*) &clbuf[off + 20]);
+        fc |= (hi & 0xFFFF) << 16;
       }
+      *first_cluster = fc;
+      *size          = *((uint32_t*) &clbuf[off + 28]);
+      *attr          = clbuf[off + 11];
+      return fc ? 0 : -1;
     }
-    /* TODO: follow cluster chain - naive: assume single cluster dir */
-    break;
   }
+  /* TODO: follow cluster chain - naive: assume single cluster dir */
+  return -1;
+}
 
-found:
-  if (first_cluster == 0)
+int fat_read_file(const char* name, void** out_buf, size_t* out_len)
+{
+  if (!name || !out_buf || !out_len)
+    return -1;
+  uint8_t  clbuf[4096];
+  uint32_t first_cluster, file_size;
+  uint8_t  attr;
+  if (find_entry(name, &first_cluster, &file_size, &attr) != 0)
     return -1;
   /* allocate buffer and read clusters */
   size_t need = (file_size + bytes_per_sector - 1) & ~(bytes_per_sector - 1);
@@ -202,3 +203,80 @@ found:
   *out_len = file_size;
   return 0;
 }
+
+int fat_lookup(const char* path, struct vfs_stat* st)
+{
+  if (!path || !st)
+    return -1;
+  while (*path == '/')
+    ++path;
+  if (!*path)
+  {
+    st->ino    = root_cluster ? root_cluster : 2;
+    st->size   = 0;
+    st->is_dir = 1;
+    return 0;
+  }
+  uint32_t first_cluster, size;
+  uint8_t  attr;
+  if (find_entry(path, &first_cluster, &size, &attr) != 0)
+    return -1;
+  st->ino    = first_cluster;
+  st->size   = size;
+  st->is_dir = (attr & 0x10) != 0;
+  return 0;
+}
+
+int fat_read_page(uint64_t ino, uint64_t index, void* page)
+{
+  uint32_t csize = sectors_per_cluster * bytes_per_sector;
+  if (!csize || csize > VFS_PAGE_SIZE || VFS_PAGE_SIZE % csize)
+    return -1;
+  uint32_t per_page = VFS_PAGE_SIZE / csize;
+  /* naive like fat_read_file: the clusters of a file are contiguous */
+  uint32_t cluster = (uint32_t) ino + (uint32_t) index * per_page;
+  for (uint32_t i = 0; i < per_page; ++i)
+    if (read_cluster(cluster + i, (uint8_t*) page + i * csize) != 0)
+      return -1;
+  return 0;
+}
+
+/* 8.3 directory name back to "name.ext", lower case */
+static void name_from_83(const uint8_t* ent, char out[13])
+{
+  int n = 0;
+  for (int i = 0; i < 8 && ent[i] != ' '; ++i)
+    out[n++] = (ent[i] >= 'A' && ent[i] <= 'Z') ? ent[i] + 32 : ent[i];
+  if (ent[8] != ' ')
+  {
+    out[n++] = '.';
+    for (int i = 8; i < 11 && ent[i] != ' '; ++i)
+      out[n++] = (ent[i] >= 'A' && ent[i] <= 'Z') ? ent[i] + 32 : ent[i];
+  }
+  out[n] = '\0';
+}
+
+int fat_readdir(const char* path, vfs_filldir_fn fill, void* ctx)
+{
+  if (!path || !fill || (path[0] && strcmp(path, "/") != 0))
+    return -1;
+  uint8_t clbuf[4096];
+  /* same limitation as fat_read_file: the root is a single cluster */
+  uint32_t cluster = root_cluster ? root_cluster : 2;
+  if (read_cluster(cluster, clbuf) != 0)
+    return -1;
+  for (int off = 0; off < (int) (sectors_per_cluster * 512); off += 32)
+  {
+    uint8_t attr  = clbuf[off + 11];
+    uint8_t first = clbuf[off];
+    if (first == 0x00)
+      break; /* end of dir */
+    if (first == 0xE5 || first == '.' || attr == 0x0F || (attr & 0x08))
+      continue; /* deleted, dot entries, LFN, volume label */
+    char name[13];
+    name_from_83(&clbuf[off], name);
+    if (fill(ctx, name, *((uint32_t*) &clbuf[off + 28]), (attr & 0x10) != 0))
+      break;
+  }
+  return 0;
+}
@@ -2,8 +2,14 @@
 #define FAT_H
 
 #include <stddef.h>
+#include "fs/vfs.h"
 
 int fat_init(void);
 int fat_read_file(const char *name, void **out_buf, size_t *out_len);
+/* only the root directory ("" or "/") can be listed */
+int fat_readdir(const char *path, vfs_filldir_fn fill, void *ctx);
+/* page cache access; ino is the first cluster */
+int fat_lookup(const char *path, struct vfs_stat *st);
+int fat_read_page(uint64_t ino, uint64_t index, void *page);
 
 #endif
@@ -3,5 +3,7 @@
 
 int keyboard_init(void);
 int keyboard_getchar(void); /* returns ASCII code or -1 if none */
+/* Read one pending scancode from the controller into the buffer, if any */
+void keyboard_poll(void);
 
 #endif
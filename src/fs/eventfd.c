@@ -0,0 +1,126 @@
+#include <stddef.h>
+#include "fs/eventfd.h"
+#include "fs/fdtable.h"
+#include "fs/poll.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/uaccess.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "multitasking/waitqueue.h"
+
+struct eventfd {
+	spinlock_t lock;
+	uint64_t count;
+	int semaphore;
+	struct waitqueue rd_wait; // readers: wait for a non-zero count
+	struct waitqueue wr_wait; // writers: wait for room below EVENTFD_MAX
+};
+
+// What a blocked writer waits for: room for add
+struct eventfd_add {
+	struct eventfd* e;
+	uint64_t add;
+};
+
+static int readable(void* arg) {
+	struct eventfd* e = arg;
+	return e->count != 0;
+}
+
+static int has_room(void* arg) {
+	struct eventfd_add* a = arg;
+	return EVENTFD_MAX - a->e->count >= a->add;
+}
+
+static long eventfd_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	struct eventfd* e = f->data;
+	uint64_t v;
+	(void)off;
+	if (len < sizeof(v))
+		return -EINVAL;
+	for (;;) {
+		spin_lock(&e->lock);
+		if (e->count)
+			break;
+		spin_unlock(&e->lock);
+		if (f->flags & O_NONBLOCK)
+			return -EAGAIN;
+		waitqueue_wait(&e->rd_wait, readable, e);
+	}
+	v = e->semaphore ? 1 : e->count;
+	e->count -= v;
+	spin_unlock(&e->lock);
+	waitqueue_wake_all(&e->wr_wait);
+	return __copy_user(buf, &v, sizeof(v)) ? -EFAULT : (long)sizeof(v);
+}
+
+static long eventfd_write(struct file* f, const void* buf, size_t len, uint64_t* off) {
+	struct eventfd_add a = { f->data, 0 };
+	(void)off;
+	if (len < sizeof(a.add))
+		return -EINVAL;
+	if (__copy_user(&a.add, buf, sizeof(a.add)))
+		return -EFAULT;
+	if (a.add > EVENTFD_MAX)
+		return -EINVAL;
+	for (;;) {
+		spin_lock(&a.e->lock);
+		if (has_room(&a))
+			break;
+		spin_unlock(&a.e->lock);
+		if (f->flags & O_NONBLOCK)
+			return -EAGAIN;
+		waitqueue_wait(&a.e->wr_wait, has_room, &a);
+	}
+	a.e->count += a.add;
+	spin_unlock(&a.e->lock);
+	if (a.add)
+		waitqueue_wake_all(&a.e->rd_wait);
+	return (long)sizeof(a.add);
+}
+
+static uint32_t eventfd_poll(struct file* f, struct poll_table* pt) {
+	struct eventfd* e = f->data;
+	uint32_t mask = 0;
+	poll_wait(pt, &e->rd_wait, POLLIN);
+	poll_wait(pt, &e->wr_wait, POLLOUT);
+	spin_lock(&e->lock);
+	if (e->count)
+		mask |= POLLIN;
+	if (e->count < EVENTFD_MAX)
+		mask |= POLLOUT;
+	spin_unlock(&e->lock);
+	return mask;
+}
+
+static void eventfd_release(struct file* f) {
+	kfree(f->data);
+}
+
+static const struct file_ops eventfd_ops = { eventfd_read, eventfd_write, eventfd_release, NULL, eventfd_poll };
+
+int eventfd_create(uint32_t initval, int flags) {
+	struct fdtable* t = scheduler_get_files();
+	if (flags & ~(EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC))
+		return -EINVAL;
+	if (!t)
+		return -EBADF;
+	struct eventfd* e = kmalloc(sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+	spin_lock_init(&e->lock);
+	e->count = initval;
+	e->semaphore = (flags & EFD_SEMAPHORE) != 0;
+	waitqueue_init(&e->rd_wait);
+	waitqueue_init(&e->wr_wait);
+	struct file* f = file_alloc(&eventfd_ops, O_RDWR | (flags & EFD_NONBLOCK), e, 0600);
+	if (!f) {
+		kfree(e);
+		return -ENOMEM;
+	}
+	int fd = fd_install(t, f, 0, (flags & EFD_CLOEXEC) ? FD_CLOEXEC : 0);
+	if (fd < 0)
+		file_put(f);
+	return fd;
+}
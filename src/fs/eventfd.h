@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include "fs/file.h"
+
+// Event counters: a file around a 64-bit count, for one thread or process
+// to signal another cheaply and for use as an epoll source. A write of v
+// adds v (blocking while the count would pass EVENTFD_MAX); a read blocks
+// until the count is non-zero, then returns it and resets it to zero, or in
+// semaphore mode returns 1 and takes one off. Reads and writes move exactly
+// eight bytes. POLLIN while the count is non-zero, POLLOUT while it is
+// below EVENTFD_MAX.
+
+#define EVENTFD_MAX 0xfffffffffffffffeULL
+
+// Flags, with the Linux values
+#define EFD_SEMAPHORE 1
+#define EFD_NONBLOCK  O_NONBLOCK // -EAGAIN instead of blocking
+#define EFD_CLOEXEC   O_CLOEXEC
+
+// New counter starting at initval; returns its descriptor or -errno
+int eventfd_create(uint32_t initval, int flags);
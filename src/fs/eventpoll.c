@@ -0,0 +1,412 @@
+#include <stddef.h>
+#include "fs/eventpoll.h"
+#include "fs/fdtable.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/uaccess.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include <string.h>
+
+#define EP_QUEUES  2 // wait queues one watch can be parked on (in and out)
+#define EP_PRIVATE (EPOLLET | EPOLLONESHOT) // mode bits, not events
+
+struct eventpoll;
+
+struct epitem {
+	struct poll_table pt; // first: the queue callback gets the watch back
+	struct eventpoll* ep;
+	struct file* file; // not referenced: the watch dies with the file
+	int fd;
+	uint32_t events; // EPOLL* interest and mode; no events once a oneshot fired
+	uint64_t data;
+	int ready; // on ep's ready list
+	struct epitem* next; // ep->items, or the free list
+	struct epitem* rdnext; // ep's ready list
+	struct epitem* file_next; // file->epitems
+	struct waitqueue* wqs[EP_QUEUES];
+	struct wait_entry waits[EP_QUEUES];
+};
+
+struct eventpoll {
+	spinlock_t lock; // irqsave: watches are queued from wake callbacks
+	struct epitem* items;
+	struct epitem* rdhead; // ready list, FIFO
+	struct epitem* rdtail;
+	struct waitqueue wait; // threads in epoll_wait
+	struct waitqueue poll_wait; // sets watching this one
+};
+
+// Guards every file->epitems list; taken before any ep->lock
+static spinlock_t links_lock = SPINLOCK_INIT;
+
+// The kernel heap never frees, so watches are recycled here
+static struct epitem* free_items;
+static spinlock_t free_lock = SPINLOCK_INIT;
+
+static const struct file_ops ep_ops;
+
+static struct eventpoll* file_eventpoll(struct file* f) {
+	return f->ops == &ep_ops ? f->data : NULL;
+}
+
+static struct epitem* item_alloc(void) {
+	spin_lock(&free_lock);
+	struct epitem* it = free_items;
+	if (it)
+		free_items = it->next;
+	spin_unlock(&free_lock);
+	return it ? it : kmalloc(sizeof(*it));
+}
+
+static void item_free(struct epitem* it) {
+	spin_lock(&free_lock);
+	it->next = free_items;
+	free_items = it;
+	spin_unlock(&free_lock);
+}
+
+// Ready list; ep->lock held. Returns 1 if it was not queued yet.
+static int ready_push(struct eventpoll* ep, struct epitem* it) {
+	if (it->ready)
+		return 0;
+	it->ready = 1;
+	it->rdnext = NULL;
+	if (ep->rdtail)
+		ep->rdtail->rdnext = it;
+	else
+		ep->rdhead = it;
+	ep->rdtail = it;
+	return 1;
+}
+
+// Only EPOLL_CTL_DEL and closing take a watch out of the middle
+static void ready_unlink(struct eventpoll* ep, struct epitem* it) {
+	if (!it->ready)
+		return;
+	struct epitem* prev = NULL;
+	for (struct epitem* i = ep->rdhead; i != it; i = i->rdnext)
+		prev = i;
+	if (prev)
+		prev->rdnext = it->rdnext;
+	else
+		ep->rdhead = it->rdnext;
+	if (ep->rdtail == it)
+		ep->rdtail = prev;
+	it->ready = 0;
+}
+
+// New events on ep: one epoll_wait caller takes them (and passes the wake
+// on if it leaves some behind), sets watching ep all hear of it
+static void ep_notify(struct eventpoll* ep) {
+	waitqueue_wake_one(&ep->wait);
+	waitqueue_wake_all(&ep->poll_wait);
+}
+
+// Wake callback of a watched queue; interrupts are off. All it does is
+// queue the watch: epoll_wait polls the file to see what happened.
+static void item_wake(struct wait_entry* e) {
+	struct epitem* it = e->priv;
+	struct eventpoll* ep = it->ep;
+	uint64_t flags = spin_lock_irqsave(&ep->lock);
+	int queued = (it->events & ~EP_PRIVATE) && ready_push(ep, it);
+	spin_unlock_irqrestore(&ep->lock, flags);
+	if (queued)
+		ep_notify(ep);
+}
+
+// poll_table callback: park the watch on wq, a queue at a time per slot
+static void item_queue(struct poll_table* pt, struct waitqueue* wq) {
+	struct epitem* it = (struct epitem*)pt;
+	for (int i = 0; i < EP_QUEUES; i++) {
+		if (!it->wqs[i] || it->wqs[i] == wq) {
+			it->wqs[i] = wq;
+			waitqueue_add(wq, &it->waits[i]);
+			return;
+		}
+	}
+}
+
+// Events of interest ready on the file; re-parks the watch first
+static uint32_t item_poll(struct epitem* it) {
+	return file_poll(it->file, &it->pt) & (it->events | POLLERR | POLLHUP);
+}
+
+static void item_set(struct epitem* it, const struct epoll_event* ev) {
+	it->events = ev->events;
+	it->data = ev->data;
+	it->pt.events = ev->events & ~EP_PRIVATE;
+}
+
+// links_lock and ep->lock held
+static void item_link(struct eventpoll* ep, struct epitem* it, int fd, struct file* f) {
+	it->pt.queue = item_queue;
+	it->ep = ep;
+	it->file = f;
+	it->fd = fd;
+	it->ready = 0;
+	for (int i = 0; i < EP_QUEUES; i++) {
+		it->wqs[i] = NULL;
+		wait_entry_setup(&it->waits[i], item_wake, it);
+	}
+	it->next = ep->items;
+	ep->items = it;
+	it->file_next = f->epitems;
+	f->epitems = it;
+}
+
+// links_lock and ep->lock held
+static void item_remove(struct eventpoll* ep, struct epitem* it) {
+	for (int i = 0; i < EP_QUEUES; i++)
+		waitqueue_remove(&it->waits[i]);
+	ready_unlink(ep, it);
+	struct epitem** pp = &ep->items;
+	while (*pp != it)
+		pp = &(*pp)->next;
+	*pp = it->next;
+	pp = &it->file->epitems;
+	while (*pp != it)
+		pp = &(*pp)->file_next;
+	*pp = it->file_next;
+	item_free(it);
+}
+
+// links_lock and ep->lock held
+static struct epitem* item_find(struct eventpoll* ep, int fd, struct file* f) {
+	for (struct epitem* it = ep->items; it; it = it->next)
+		if (it->fd == fd && it->file == f)
+			return it;
+	return NULL;
+}
+
+// Take up to max events off the ready list; ep->lock held. Every queued
+// watch is polled once: level-triggered ones that are still ready go
+// back on the end, the rest wait for their next wake.
+static int harvest(struct eventpoll* ep, struct epoll_event* out, int max) {
+	struct epitem* list = ep->rdhead;
+	struct epitem* tail = ep->rdtail;
+	int n = 0;
+	ep->rdhead = ep->rdtail = NULL;
+	while (list && n < max) {
+		struct epitem* it = list;
+		list = it->rdnext;
+		it->ready = 0;
+		uint32_t revents = item_poll(it);
+		if (!revents)
+			continue;
+		out[n].events = revents;
+		out[n].data = it->data;
+		n++;
+		if (it->events & EPOLLONESHOT)
+			it->events &= EP_PRIVATE;
+		else if (!(it->events & EPOLLET))
+			ready_push(ep, it);
+	}
+	// what did not fit goes back in front, still in order
+	if (list) {
+		tail->rdnext = ep->rdhead;
+		ep->rdhead = list;
+		if (!ep->rdtail)
+			ep->rdtail = tail;
+	}
+	return n;
+}
+
+static uint32_t ep_poll(struct file* f, struct poll_table* pt) {
+	struct eventpoll* ep = f->data;
+	poll_wait(pt, &ep->poll_wait, POLLIN);
+	uint64_t flags = spin_lock_irqsave(&ep->lock);
+	uint32_t mask = ep->rdhead ? POLLIN : 0;
+	spin_unlock_irqrestore(&ep->lock, flags);
+	return mask;
+}
+
+static void ep_release(struct file* f) {
+	struct eventpoll* ep = f->data;
+	spin_lock(&links_lock);
+	uint64_t flags = spin_lock_irqsave(&ep->lock);
+	while (ep->items)
+		item_remove(ep, ep->items);
+	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&links_lock);
+	kfree(ep);
+}
+
+static const struct file_ops ep_ops = { NULL, NULL, ep_release, NULL, ep_poll };
+
+int epoll_create(int flags) {
+	struct fdtable* t = scheduler_get_files();
+	if (flags & ~EPOLL_CLOEXEC)
+		return -EINVAL;
+	if (!t)
+		return -EBADF;
+	struct eventpoll* ep = kmalloc(sizeof(*ep));
+	if (!ep)
+		return -ENOMEM;
+	memset(ep, 0, sizeof(*ep));
+	spin_lock_init(&ep->lock);
+	waitqueue_init(&ep->wait);
+	waitqueue_init(&ep->poll_wait);
+	struct file* f = file_alloc(&ep_ops, O_RDONLY, ep, 0600);
+	if (!f) {
+		kfree(ep);
+		return -ENOMEM;
+	}
+	int fd = fd_install(t, f, 0, (flags & EPOLL_CLOEXEC) ? FD_CLOEXEC : 0);
+	if (fd < 0)
+		file_put(f);
+	return fd;
+}
+
+static int ep_ctl(struct eventpoll* ep, int op, int fd, struct file* f, const struct epoll_event* ev) {
+	struct epitem* fresh = NULL;
+	if (op == EPOLL_CTL_ADD && !(fresh = item_alloc()))
+		return -ENOMEM;
+	int rc = 0;
+	int queued = 0;
+	spin_lock(&links_lock);
+	uint64_t flags = spin_lock_irqsave(&ep->lock);
+	struct epitem* it = item_find(ep, fd, f);
+	if (op == EPOLL_CTL_ADD && it)
+		rc = -EEXIST;
+	else if (op != EPOLL_CTL_ADD && !it)
+		rc = -ENOENT;
+	else if (op == EPOLL_CTL_DEL)
+		item_remove(ep, it);
+	else {
+		if (op == EPOLL_CTL_ADD) {
+			it = fresh;
+			fresh = NULL;
+			item_link(ep, it, fd, f);
+		}
+		item_set(it, ev);
+		if (item_poll(it))
+			queued = ready_push(ep, it);
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&links_lock);
+	if (fresh)
+		item_free(fresh);
+	if (queued)
+		ep_notify(ep);
+	return rc;
+}
+
+int epoll_ctl(int epfd, int op, int fd, const struct epoll_event* event) {
+	struct epoll_event ev;
+	if (op != EPOLL_CTL_ADD && op != EPOLL_CTL_DEL && op != EPOLL_CTL_MOD)
+		return -EINVAL;
+	if (op != EPOLL_CTL_DEL && copy_from_user(&ev, event, sizeof(ev)))
+		return -EFAULT;
+	struct file* epf = fd_get(scheduler_get_files(), epfd);
+	struct file* f = fd_get(scheduler_get_files(), fd);
+	struct eventpoll* ep = epf ? file_eventpoll(epf) : NULL;
+	int rc;
+	if (!epf || !f)
+		rc = -EBADF;
+	else if (!ep || f == epf)
+		rc = -EINVAL;
+	else
+		rc = ep_ctl(ep, op, fd, f, &ev);
+	if (epf)
+		file_put(epf);
+	if (f)
+		file_put(f);
+	return rc;
+}
+
+struct ep_waiter {
+	int tid;
+	volatile int timed_out;
+	struct wait_entry entry;
+	struct timer* timer; // NULL without a timeout
+};
+
+// timer softirq: interrupts are off
+static void ep_timeout(void* arg) {
+	struct ep_waiter* w = arg;
+	w->timed_out = 1;
+	scheduler_wake(w->tid);
+}
+
+static void ep_waiter_wake(struct wait_entry* e) {
+	scheduler_wake((int)(intptr_t)e->priv);
+}
+
+// scheduler_mark_dead: interrupts are off
+static void ep_waiter_cancel(void* arg) {
+	struct ep_waiter* w = arg;
+	waitqueue_remove(&w->entry);
+	if (w->timer)
+		timer_cancel(w->timer);
+}
+
+static int ep_wait(struct eventpoll* ep, struct epoll_event* out, int max, int64_t timeout_ns) {
+	struct ep_waiter w = { .tid = scheduler_get_current() };
+	struct wait_entry* e = &w.entry;
+	struct timer t;
+	int n;
+	wait_entry_setup(e, ep_waiter_wake, (void*)(intptr_t)w.tid);
+	if (timeout_ns > 0) {
+		timer_setup(&t, ep_timeout, &w);
+		w.timer = &t;
+	}
+	scheduler_set_wait_cancel(ep_waiter_cancel, &w);
+	if (w.timer)
+		timer_arm(&t, clock_now_ns() + (uint64_t)timeout_ns);
+	for (;;) {
+		uint64_t flags = spin_lock_irqsave(&ep->lock);
+		n = harvest(ep, out, max);
+		if (n || !timeout_ns || w.timed_out) {
+			int more = ep->rdhead != NULL;
+			spin_unlock_irqrestore(&ep->lock, flags);
+			if (n && more)
+				waitqueue_wake_one(&ep->wait);
+			break;
+		}
+		// the ready list is empty and stays locked until we are queued,
+		// so a watch queued from here on wakes us
+		waitqueue_add(&ep->wait, e);
+		scheduler_prepare_wait();
+		spin_unlock_irqrestore(&ep->lock, flags);
+		scheduler_wait();
+		waitqueue_remove(e);
+	}
+	if (w.timer)
+		timer_cancel(&t);
+	scheduler_set_wait_cancel(NULL, NULL);
+	return n;
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int64_t timeout_ns) {
+	struct epoll_event out[EPOLL_WAIT_MAX];
+	if (maxevents <= 0)
+		return -EINVAL;
+	if (!access_ok(events, (uint64_t)maxevents * sizeof(out[0])))
+		return -EFAULT;
+	if (maxevents > EPOLL_WAIT_MAX)
+		maxevents = EPOLL_WAIT_MAX;
+	struct file* f = fd_get(scheduler_get_files(), epfd);
+	if (!f)
+		return -EBADF;
+	struct eventpoll* ep = file_eventpoll(f);
+	// events are gathered with the set locked and copied out after
+	int n = ep ? ep_wait(ep, out, maxevents, timeout_ns) : -EINVAL;
+	file_put(f);
+	if (n > 0 && copy_to_user(events, out, (uint64_t)n * sizeof(out[0])))
+		return -EFAULT;
+	return n;
+}
+
+void eventpoll_release_file(struct file* f) {
+	spin_lock(&links_lock);
+	while (f->epitems) {
+		struct eventpoll* ep = f->epitems->ep;
+		uint64_t flags = spin_lock_irqsave(&ep->lock);
+		item_remove(ep, f->epitems);
+		spin_unlock_irqrestore(&ep->lock, flags);
+	}
+	spin_unlock(&links_lock);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "fs/file.h"
+#include "fs/poll.h"
+
+// Event multiplexing: an epoll set is a file watching other open files, so
+// one blocked thread can service pipes, the console, eventfd and timerfd
+// files (and other sets) at once. Each watch parks on the wait queues its
+// file's poll op names (fs/poll.h); a wake only moves the watch onto the
+// set's ready list, so waiting costs the same however many files are
+// watched, and epoll_wait looks at ready watches alone.
+//
+// Level-triggered watches (the default) stay on the ready list while the
+// file is ready; EPOLLET reports a watch once per wake of its queues;
+// EPOLLONESHOT disables it after one report until EPOLL_CTL_MOD. A watch
+// goes away with the last reference to its file, as on Linux.
+
+#define EPOLLIN  POLLIN
+#define EPOLLOUT POLLOUT
+#define EPOLLERR POLLERR
+#define EPOLLHUP POLLHUP
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET      (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+// Most events one epoll_wait returns; more stay queued for the next call
+#define EPOLL_WAIT_MAX 32
+
+// The Linux x86-64 layout
+struct epoll_event {
+	uint32_t events;
+	uint64_t data;
+} __attribute__((packed));
+
+// The system calls, on descriptors of the calling process and user
+// buffers. epoll_create returns the new descriptor; epoll_wait the number
+// of events stored, after blocking for up to timeout_ns (negative: no
+// limit, 0: do not block).
+int epoll_create(int flags);
+int epoll_ctl(int epfd, int op, int fd, const struct epoll_event* event);
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int64_t timeout_ns);
+
+// file_put: drop every watch on f before it goes
+void eventpoll_release_file(struct file* f);
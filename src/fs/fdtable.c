@@ -0,0 +1,143 @@
+#include <stddef.h>
+#include "fs/fdtable.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include <string.h>
+
+struct fdtable* fdtable_create(void) {
+	struct fdtable* t = kmalloc(sizeof(*t));
+	if (!t)
+		return NULL;
+	memset(t, 0, sizeof(*t));
+	t->refcount = 1;
+	spin_lock_init(&t->lock);
+	for (int fd = 0; fd < 3; fd++)
+		t->files[fd] = file_console();
+	return t;
+}
+
+struct fdtable* fdtable_dup(struct fdtable* t) {
+	struct fdtable* n = kmalloc(sizeof(*n));
+	if (!n)
+		return NULL;
+	memset(n, 0, sizeof(*n));
+	n->refcount = 1;
+	spin_lock_init(&n->lock);
+	spin_lock(&t->lock);
+	for (int fd = 0; fd < FDTABLE_MAX; fd++) {
+		if (t->files[fd]) {
+			file_get(t->files[fd]);
+			n->files[fd] = t->files[fd];
+			n->flags[fd] = t->flags[fd];
+		}
+	}
+	spin_unlock(&t->lock);
+	return n;
+}
+
+void fdtable_get(struct fdtable* t) {
+	if (t)
+		__atomic_fetch_add(&t->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void fdtable_put(struct fdtable* t) {
+	if (!t || __atomic_sub_fetch(&t->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	for (int fd = 0; fd < FDTABLE_MAX; fd++)
+		if (t->files[fd])
+			file_put(t->files[fd]);
+	kfree(t);
+}
+
+int fd_install(struct fdtable* t, struct file* f, int min, int flags) {
+	if (min < 0)
+		min = 0;
+	spin_lock(&t->lock);
+	for (int fd = min; fd < FDTABLE_MAX; fd++) {
+		if (!t->files[fd]) {
+			t->files[fd] = f;
+			t->flags[fd] = (uint8_t)flags;
+			spin_unlock(&t->lock);
+			return fd;
+		}
+	}
+	spin_unlock(&t->lock);
+	return -EMFILE;
+}
+
+struct file* fd_get(struct fdtable* t, int fd) {
+	if (!t || fd < 0 || fd >= FDTABLE_MAX)
+		return NULL;
+	spin_lock(&t->lock);
+	struct file* f = t->files[fd];
+	if (f)
+		file_get(f);
+	spin_unlock(&t->lock);
+	return f;
+}
+
+int fd_close(struct fdtable* t, int fd) {
+	if (!t || fd < 0 || fd >= FDTABLE_MAX)
+		return -EBADF;
+	spin_lock(&t->lock);
+	struct file* f = t->files[fd];
+	t->files[fd] = NULL;
+	t->flags[fd] = 0;
+	spin_unlock(&t->lock);
+	if (!f)
+		return -EBADF;
+	// a reader that got f through fd_get keeps it alive
+	file_put(f);
+	return 0;
+}
+
+int fd_dup2(struct fdtable* t, int oldfd, int newfd) {
+	if (!t || oldfd < 0 || oldfd >= FDTABLE_MAX || newfd < 0 || newfd >= FDTABLE_MAX)
+		return -EBADF;
+	spin_lock(&t->lock);
+	struct file* f = t->files[oldfd];
+	struct file* old = NULL;
+	if (f && oldfd != newfd) {
+		file_get(f);
+		old = t->files[newfd];
+		t->files[newfd] = f;
+	}
+	if (f)
+		t->flags[newfd] = 0;
+	spin_unlock(&t->lock);
+	if (!f)
+		return -EBADF;
+	if (old)
+		file_put(old);
+	return newfd;
+}
+
+void fd_close_on_exec(struct fdtable* t) {
+	for (int fd = 0; fd < FDTABLE_MAX; fd++) {
+		int flags = fd_get_flags(t, fd);
+		if (flags > 0 && (flags & FD_CLOEXEC))
+			fd_close(t, fd);
+	}
+}
+
+int fd_get_flags(struct fdtable* t, int fd) {
+	if (!t || fd < 0 || fd >= FDTABLE_MAX)
+		return -EBADF;
+	spin_lock(&t->lock);
+	int ret = t->files[fd] ? t->flags[fd] : -EBADF;
+	spin_unlock(&t->lock);
+	return ret;
+}
+
+int fd_set_flags(struct fdtable* t, int fd, int flags) {
+	if (!t || fd < 0 || fd >= FDTABLE_MAX)
+		return -EBADF;
+	spin_lock(&t->lock);
+	int ret = -EBADF;
+	if (t->files[fd]) {
+		t->flags[fd] = (uint8_t)flags;
+		ret = 0;
+	}
+	spin_unlock(&t->lock);
+	return ret;
+}
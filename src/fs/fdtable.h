@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "fs/file.h"
+#include "multitasking/spinlock.h"
+
+// Per-process descriptor table: small integers naming referenced open
+// files. Tasks of one process share the table; the last fdtable_put()
+// drops every file still open.
+
+#define FDTABLE_MAX 64
+#define FD_CLOEXEC  1 // descriptor flag
+
+struct fdtable {
+	int refcount;
+	spinlock_t lock;
+	struct file* files[FDTABLE_MAX];
+	uint8_t flags[FDTABLE_MAX];
+};
+
+// New table with 0, 1 and 2 on the console; NULL if out of memory
+struct fdtable* fdtable_create(void);
+// Private copy of t for a new process: the same open files, referenced
+// again; NULL if out of memory
+struct fdtable* fdtable_dup(struct fdtable* t);
+void fdtable_get(struct fdtable* t);
+void fdtable_put(struct fdtable* t);
+
+// Install f (taking over the caller's reference) in the lowest free slot
+// >= min; returns the descriptor or -EMFILE
+int fd_install(struct fdtable* t, struct file* f, int min, int flags);
+// Referenced file behind fd, NULL if it is not open
+struct file* fd_get(struct fdtable* t, int fd);
+int fd_close(struct fdtable* t, int fd);
+// Make newfd refer to oldfd's file (closing what newfd had), without
+// FD_CLOEXEC; returns newfd or -EBADF
+int fd_dup2(struct fdtable* t, int oldfd, int newfd);
+// exec: close every descriptor marked FD_CLOEXEC
+void fd_close_on_exec(struct fdtable* t);
+// FD_* flags of fd, or -EBADF
+int fd_get_flags(struct fdtable* t, int fd);
+int fd_set_flags(struct fdtable* t, int fd, int flags);
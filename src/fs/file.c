@@ -0,0 +1,227 @@
+#include <stddef.h>
+#include "console/tty.h"
+#include "fs/eventpoll.h"
+#include "fs/file.h"
+#include "fs/inode.h"
+#include "fs/poll.h"
+#include "fs/vfs.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/uaccess.h"
+#include <string.h>
+
+// The console is the terminal (console/tty.h): input comes through its
+// line discipline and output is buffered and flushed in the background
+static long console_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	(void)f; (void)off;
+	return tty_read(tty_console(), buf, len);
+}
+
+static long console_write(struct file* f, const void* buf, size_t len, uint64_t* off) {
+	(void)f;
+	long n = tty_write(tty_console(), buf, len);
+	*off += (uint64_t)n;
+	return n;
+}
+
+static uint32_t console_poll(struct file* f, struct poll_table* pt) {
+	(void)f;
+	return tty_poll(tty_console(), pt);
+}
+
+static const struct file_ops console_ops = { console_read, console_write, NULL, NULL, console_poll };
+
+// Never released: the count starts at one for the file itself
+static struct file console_file = { 1, O_RDWR, &console_ops, NULL, 0, 0, S_IFCHR | 0620, NULL };
+
+// Regular files read straight out of the page cache
+static long inode_file_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	long n = inode_read(f->data, buf, len, *off);
+	if (n > 0)
+		*off += (uint64_t)n;
+	return n;
+}
+
+static const uint8_t* inode_file_page(struct file* f, uint64_t off) {
+	struct inode* ino = f->data;
+	if (off >= ino->st.size)
+		return NULL;
+	return inode_page(ino, off / VFS_PAGE_SIZE);
+}
+
+static const struct file_ops inode_ops = { inode_file_read, NULL, NULL, inode_file_page, NULL };
+
+// Filesystems without page access hand out whole files, held in memory
+static long mem_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	if (*off >= f->size)
+		return 0;
+	if (len > f->size - *off)
+		len = f->size - *off;
+	size_t left = __copy_user(buf, (const char*)f->data + *off, len);
+	if (left && left == len)
+		return -EFAULT;
+	len -= left;
+	*off += len;
+	return (long)len;
+}
+
+static void mem_release(struct file* f) {
+	kfree(f->data);
+}
+
+static const struct file_ops mem_ops = { mem_read, NULL, mem_release, NULL, NULL };
+
+// Directories are read once at open; size counts the entries in data
+static long dir_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	(void)f; (void)buf; (void)len; (void)off;
+	return -EISDIR;
+}
+
+static const struct file_ops dir_ops = { dir_read, NULL, mem_release, NULL, NULL };
+
+struct dir_fill {
+	struct file_dirent* ents;
+	size_t count;
+	size_t max;
+};
+
+static int dir_fill(void* ctx, const char* name, size_t size, int is_dir) {
+	struct dir_fill* d = ctx;
+	if (d->ents) {
+		if (d->count == d->max)
+			return 1;
+		struct file_dirent* e = &d->ents[d->count];
+		strncpy(e->name, name, FILE_NAME_MAX - 1);
+		e->name[FILE_NAME_MAX - 1] = '\0';
+		e->size = size;
+		e->is_dir = is_dir;
+	}
+	d->count++;
+	return 0;
+}
+
+static int dir_snapshot(const char* path, void** data, size_t* count) {
+	struct dir_fill d = { NULL, 0, 0 };
+	if (vfs_readdir(path, dir_fill, &d) != 0)
+		return -1;
+	d.max = d.count;
+	d.count = 0;
+	d.ents = kmalloc((d.max ? d.max : 1) * sizeof(struct file_dirent));
+	if (!d.ents)
+		return -1;
+	if (vfs_readdir(path, dir_fill, &d) != 0) {
+		kfree(d.ents);
+		return -1;
+	}
+	*data = d.ents;
+	*count = d.count;
+	return 0;
+}
+
+int file_open(const char* path, int flags, struct file** out) {
+	if (!path || !out)
+		return -EFAULT;
+	// the mounted filesystems are read-only
+	if ((flags & O_ACCMODE) != O_RDONLY)
+		return -EROFS;
+	struct file* f = kmalloc(sizeof(*f));
+	if (!f)
+		return -ENOMEM;
+	void* data;
+	size_t size;
+	struct inode* ino = inode_lookup(path);
+	if (ino && !ino->st.is_dir) {
+		if (flags & O_DIRECTORY) {
+			kfree(f);
+			return -ENOTDIR;
+		}
+		f->ops = &inode_ops;
+		f->mode = S_IFREG | 0755;
+		data = ino;
+		size = ino->st.size;
+	} else if (dir_snapshot(path, &data, &size) == 0) {
+		f->ops = &dir_ops;
+		f->mode = S_IFDIR | 0755;
+	} else if (!ino && !(flags & O_DIRECTORY) && vfs_read_file(path, &data, &size) == 0) {
+		f->ops = &mem_ops;
+		f->mode = S_IFREG | 0755;
+	} else {
+		kfree(f);
+		return -ENOENT;
+	}
+	f->refcount = 1;
+	f->flags = flags;
+	f->data = data;
+	f->size = size;
+	f->pos = 0;
+	f->epitems = NULL;
+	*out = f;
+	return 0;
+}
+
+struct file* file_alloc(const struct file_ops* ops, int flags, void* data, uint32_t mode) {
+	struct file* f = kmalloc(sizeof(*f));
+	if (!f)
+		return NULL;
+	f->refcount = 1;
+	f->flags = flags;
+	f->ops = ops;
+	f->data = data;
+	f->size = 0;
+	f->pos = 0;
+	f->mode = mode;
+	f->epitems = NULL;
+	return f;
+}
+
+struct file* file_console(void) {
+	file_get(&console_file);
+	return &console_file;
+}
+
+void file_get(struct file* f) {
+	__atomic_fetch_add(&f->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void file_put(struct file* f) {
+	if (__atomic_sub_fetch(&f->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	if (f->epitems)
+		eventpoll_release_file(f);
+	if (f->ops->release)
+		f->ops->release(f);
+	kfree(f);
+}
+
+long file_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	if ((f->flags & O_ACCMODE) == O_WRONLY || !f->ops->read)
+		return -EBADF;
+	return f->ops->read(f, buf, len, off ? off : &f->pos);
+}
+
+long file_write(struct file* f, const void* buf, size_t len, uint64_t* off) {
+	if ((f->flags & O_ACCMODE) == O_RDONLY || !f->ops->write)
+		return -EBADF;
+	return f->ops->write(f, buf, len, off ? off : &f->pos);
+}
+
+const uint8_t* file_get_page(struct file* f, uint64_t off) {
+	if ((f->flags & O_ACCMODE) == O_WRONLY || !f->ops->get_page)
+		return NULL;
+	return f->ops->get_page(f, off);
+}
+
+uint32_t file_poll(struct file* f, struct poll_table* pt) {
+	if (!f->ops->poll)
+		return POLLIN | POLLOUT;
+	return f->ops->poll(f, pt);
+}
+
+int file_readdir(struct file* f, uint64_t index, struct file_dirent* out) {
+	if (f->ops != &dir_ops)
+		return -ENOTDIR;
+	if (index >= f->size)
+		return 0;
+	*out = ((const struct file_dirent*)f->data)[index];
+	return 1;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Open-file objects. A struct file is what a descriptor refers to: the
+// backing object, an operations table and the current position. Files are
+// reference counted; the last file_put() releases the backing object.
+
+#define O_RDONLY 0
+#define O_WRONLY 1
+#define O_RDWR   2
+#define O_ACCMODE 3
+#define O_NONBLOCK 04000 // honoured by eventfd and timerfd files
+#define O_DIRECTORY 0200000 // fail unless path is a directory
+#define O_CLOEXEC 02000000 // descriptor gets FD_CLOEXEC (fs/fdtable.h)
+
+// File types in mode, with the Linux values
+#define S_IFMT  0170000
+#define S_IFDIR 0040000
+#define S_IFCHR 0020000
+#define S_IFREG 0100000
+#define S_IFIFO 0010000
+
+#define FILE_NAME_MAX 64
+
+struct file;
+struct poll_table;
+struct epitem;
+
+struct file_ops {
+	// off is the position to use and advance; both return bytes or -errno
+	long (*read)(struct file* f, void* buf, size_t len, uint64_t* off);
+	long (*write)(struct file* f, const void* buf, size_t len, uint64_t* off);
+	void (*release)(struct file* f);
+	// Page-aligned kernel address of the cached page holding byte off, valid
+	// for good, so splice can pass it on without copying; NULL if the file
+	// has no such page (it is then read into a buffer instead)
+	const uint8_t* (*get_page)(struct file* f, uint64_t off);
+	// POLL* bits ready now, after registering pt on the queues that signal
+	// a change (fs/poll.h); NULL for files that never block
+	uint32_t (*poll)(struct file* f, struct poll_table* pt);
+};
+
+struct file {
+	int refcount;
+	int flags;
+	const struct file_ops* ops;
+	void* data;
+	size_t size;
+	uint64_t pos; // byte offset, or entry index for a directory
+	uint32_t mode; // S_IF* type and permission bits
+	struct epitem* epitems; // epoll sets watching this file (fs/eventpoll.h)
+};
+
+struct file_dirent {
+	char name[FILE_NAME_MAX];
+	size_t size;
+	int is_dir;
+};
+
+// Open path through the VFS; returns 0 and a referenced file, or -errno.
+// A directory opens as a snapshot of its entries.
+int file_open(const char* path, int flags, struct file** out);
+// A file for an object with no path (a pipe end, an epoll set, ...), with
+// one reference; NULL if out of memory
+struct file* file_alloc(const struct file_ops* ops, int flags, void* data, uint32_t mode);
+// The console (serial); what descriptors 0, 1 and 2 start out as
+struct file* file_console(void);
+
+void file_get(struct file* f);
+void file_put(struct file* f);
+
+// off == NULL uses and advances f->pos
+long file_read(struct file* f, void* buf, size_t len, uint64_t* off);
+long file_write(struct file* f, const void* buf, size_t len, uint64_t* off);
+// Page of f holding byte off (see file_ops.get_page), or NULL
+const uint8_t* file_get_page(struct file* f, uint64_t off);
+// Readiness of f as POLL* bits, registering pt first (see file_ops.poll);
+// files without a poll op are always readable and writable
+uint32_t file_poll(struct file* f, struct poll_table* pt);
+// Entry number index of directory f: 1 if there is one, 0 past the end
+int file_readdir(struct file* f, uint64_t index, struct file_dirent* out);
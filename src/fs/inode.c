@@ -0,0 +1,139 @@
+#include <stddef.h>
+#include "fs/inode.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/uaccess.h"
+#include <string.h>
+
+static struct inode* inodes;
+static spinlock_t inodes_lock = SPINLOCK_INIT;
+static struct inode_stats stats;
+
+static struct inode* find(const char* path) {
+	spin_lock(&inodes_lock);
+	struct inode* i = inodes;
+	while (i && strcmp(i->path, path) != 0)
+		i = i->next;
+	spin_unlock(&inodes_lock);
+	return i;
+}
+
+struct inode* inode_lookup(const char* path) {
+	if (!path)
+		return NULL;
+	// "/name" and "name" are the same file: the filesystems are flat
+	while (path[0] == '/' && path[1])
+		path++;
+	if (strlen(path) >= INODE_PATH_MAX)
+		return NULL;
+	struct inode* i = find(path);
+	if (i)
+		return i;
+
+	// the lookup may do I/O, so it runs unlocked; a racing lookup of the
+	// same path is settled when publishing below
+	struct vfs_stat st;
+	struct vfs_mount* m = vfs_lookup(path, &st);
+	if (!m)
+		return NULL;
+	size_t nr = (st.size + VFS_PAGE_SIZE - 1) / VFS_PAGE_SIZE;
+	i = kmalloc(sizeof(*i));
+	uint8_t** pages = kmalloc((nr ? nr : 1) * sizeof(*pages));
+	if (!i || !pages) {
+		kfree(i);
+		kfree(pages);
+		return NULL;
+	}
+	memset(pages, 0, (nr ? nr : 1) * sizeof(*pages));
+	strcpy(i->path, path);
+	i->mount = m;
+	i->st = st;
+	i->nr_pages = nr;
+	i->pages = pages;
+	spin_lock_init(&i->lock);
+
+	spin_lock(&inodes_lock);
+	struct inode* other = inodes;
+	while (other && strcmp(other->path, path) != 0)
+		other = other->next;
+	if (!other) {
+		i->next = inodes;
+		inodes = i;
+		stats.inodes++;
+	}
+	spin_unlock(&inodes_lock);
+	if (other) {
+		kfree(pages);
+		kfree(i);
+		return other;
+	}
+	return i;
+}
+
+const uint8_t* inode_page(struct inode* i, size_t index) {
+	if (index >= i->nr_pages)
+		return NULL;
+	uint8_t* page = __atomic_load_n(&i->pages[index], __ATOMIC_ACQUIRE);
+	if (page) {
+		__atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+		return page;
+	}
+
+	// read outside the lock; whoever installs first wins
+	uint8_t* raw = kmalloc(2 * VFS_PAGE_SIZE);
+	if (!raw)
+		return NULL;
+	page = (uint8_t*)(((uintptr_t)raw + VFS_PAGE_SIZE - 1) & ~(uintptr_t)(VFS_PAGE_SIZE - 1));
+	if (i->mount->read_page(i->st.ino, index, page) != 0) {
+		kfree(raw);
+		return NULL;
+	}
+	// nothing past the end of the file may leak out of the last page
+	size_t valid = i->st.size - index * VFS_PAGE_SIZE;
+	if (valid < VFS_PAGE_SIZE)
+		memset(page + valid, 0, VFS_PAGE_SIZE - valid);
+	__atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+
+	spin_lock(&i->lock);
+	uint8_t* cur = i->pages[index];
+	if (!cur)
+		__atomic_store_n(&i->pages[index], page, __ATOMIC_RELEASE);
+	spin_unlock(&i->lock);
+	if (cur) {
+		kfree(raw);
+		return cur;
+	}
+	return page;
+}
+
+long inode_read(struct inode* i, void* buf, size_t len, uint64_t off) {
+	if (i->st.is_dir)
+		return -EISDIR;
+	if (off >= i->st.size)
+		return 0;
+	if (len > i->st.size - off)
+		len = i->st.size - off;
+	size_t done = 0;
+	while (done < len) {
+		uint64_t pos = off + done;
+		const uint8_t* page = inode_page(i, pos / VFS_PAGE_SIZE);
+		if (!page)
+			return done ? (long)done : -EIO;
+		size_t in_page = VFS_PAGE_SIZE - pos % VFS_PAGE_SIZE;
+		size_t n = len - done < in_page ? len - done : in_page;
+		// buf may be a user buffer that turns out to be bad
+		size_t left = __copy_user((uint8_t*)buf + done, page + pos % VFS_PAGE_SIZE, n);
+		done += n - left;
+		if (left)
+			return done ? (long)done : -EFAULT;
+	}
+	return (long)done;
+}
+
+void inode_get_stats(struct inode_stats* out) {
+	if (!out)
+		return;
+	out->inodes = __atomic_load_n(&stats.inodes, __ATOMIC_RELAXED);
+	out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+	out->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs/vfs.h"
+#include "multitasking/spinlock.h"
+
+// Page cache. An inode is a file found through vfs_lookup(), looked up
+// once per path and kept for good. Its contents are read a page at a time
+// on first access into page-aligned cache pages, which every open file of
+// the inode shares; reads copy straight out of them.
+
+#define INODE_PATH_MAX 64
+
+struct inode {
+	struct inode* next;
+	char path[INODE_PATH_MAX];
+	struct vfs_mount* mount;
+	struct vfs_stat st;
+	size_t nr_pages;
+	uint8_t** pages; // kernel addresses; NULL until read in
+	spinlock_t lock; // serialises filling pages[]
+};
+
+struct inode_stats {
+	uint64_t inodes;
+	uint64_t hits;   // page accesses served from the cache
+	uint64_t misses; // pages read from the filesystem
+};
+
+// Cached inode for path, NULL if no filesystem with page access has it
+struct inode* inode_lookup(const char* path);
+// Cache page index of i, read in if needed; NULL past the end or on error
+const uint8_t* inode_page(struct inode* i, size_t index);
+// Copy up to len bytes at off into buf; returns the count or -errno
+long inode_read(struct inode* i, void* buf, size_t len, uint64_t off);
+void inode_get_stats(struct inode_stats* out);
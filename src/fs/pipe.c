@@ -0,0 +1,420 @@
+#include <stddef.h>
+#include "fs/pipe.h"
+#include "fs/poll.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include <string.h>
+
+// The kernel heap never frees, so pipe-owned pages are recycled here
+static struct pipe_page* free_pages;
+static spinlock_t pages_lock = SPINLOCK_INIT;
+static struct pipe_stats stats;
+
+struct pipe_page* pipe_page_alloc(void) {
+	spin_lock(&pages_lock);
+	struct pipe_page* pg = free_pages;
+	if (pg)
+		free_pages = pg->next;
+	else
+		stats.pages++;
+	spin_unlock(&pages_lock);
+	if (!pg) {
+		pg = kmalloc(sizeof(*pg));
+		uint8_t* data = kmalloc(PIPE_PAGE_SIZE);
+		if (!pg || !data) {
+			kfree(pg);
+			kfree(data);
+			return NULL;
+		}
+		pg->data = data;
+	}
+	pg->refcount = 1;
+	return pg;
+}
+
+static void page_get(struct pipe_page* pg) {
+	__atomic_fetch_add(&pg->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void pipe_page_put(struct pipe_page* pg) {
+	if (__atomic_sub_fetch(&pg->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	spin_lock(&pages_lock);
+	pg->next = free_pages;
+	free_pages = pg;
+	spin_unlock(&pages_lock);
+}
+
+// Ring helpers; all called with p->lock held
+static struct pipe_buf* buf_at(struct pipe* p, uint32_t i) {
+	return &p->bufs[i % PIPE_BUFFERS];
+}
+
+static int is_full(const struct pipe* p) {
+	return p->head - p->tail == PIPE_BUFFERS;
+}
+
+static void push(struct pipe* p, struct pipe_page* owned, const uint8_t* data, size_t off, size_t len) {
+	struct pipe_buf* b = buf_at(p, p->head++);
+	b->owned = owned;
+	b->data = data;
+	b->off = (uint32_t)off;
+	b->len = (uint32_t)len;
+}
+
+// Drop n bytes from the front of the oldest buffer
+static void consume(struct pipe* p, size_t n) {
+	struct pipe_buf* b = buf_at(p, p->tail);
+	b->off += (uint32_t)n;
+	b->len -= (uint32_t)n;
+	if (b->len == 0) {
+		if (b->owned)
+			pipe_page_put(b->owned);
+		b->owned = NULL;
+		p->tail++;
+	}
+}
+
+static int readable(void* arg) {
+	struct pipe* p = arg;
+	return p->head != p->tail || p->writers == 0;
+}
+
+static int writable(void* arg) {
+	struct pipe* p = arg;
+	return !is_full(p) || p->readers == 0;
+}
+
+// Take p->lock once there is data to read or no writer is left
+static void lock_readable(struct pipe* p) {
+	for (;;) {
+		spin_lock(&p->lock);
+		if (readable(p))
+			return;
+		spin_unlock(&p->lock);
+		waitqueue_wait(&p->rd_wait, readable, p);
+	}
+}
+
+// Take p->lock once a slot is free or no reader is left
+static void lock_writable(struct pipe* p) {
+	for (;;) {
+		spin_lock(&p->lock);
+		if (writable(p))
+			return;
+		spin_unlock(&p->lock);
+		waitqueue_wait(&p->wr_wait, writable, p);
+	}
+}
+
+static long pipe_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	struct pipe* p = f->data;
+	(void)off;
+	if (len == 0)
+		return 0;
+	lock_readable(p);
+	size_t done = 0;
+	long err = 0;
+	while (done < len && p->head != p->tail) {
+		struct pipe_buf* b = buf_at(p, p->tail);
+		size_t n = b->len < len - done ? b->len : len - done;
+		// what a bad buffer cannot take stays in the pipe
+		size_t left = __copy_user((uint8_t*)buf + done, b->data + b->off, n);
+		consume(p, n - left);
+		done += n - left;
+		if (left) {
+			err = -EFAULT;
+			break;
+		}
+	}
+	spin_unlock(&p->lock);
+	if (done)
+		waitqueue_wake_all(&p->wr_wait);
+	return done ? (long)done : err;
+}
+
+// Put up to len bytes of src into p, which is locked and has a free slot
+// or a tail page with room; returns the count taken, 0 if p is full or
+// -ENOMEM
+static long write_some(struct pipe* p, const uint8_t* src, size_t len) {
+	struct pipe_buf* last = p->head != p->tail ? buf_at(p, p->head - 1) : NULL;
+	const uint8_t* lent;
+
+	// whole user pages: lend them instead of copying
+	if (len >= PIPE_PAGE_SIZE && ((uintptr_t)src & (PIPE_PAGE_SIZE - 1)) == 0 && !is_full(p) &&
+	    (lent = mm_lend_page((uintptr_t)src)) != NULL) {
+		push(p, NULL, lent, 0, PIPE_PAGE_SIZE);
+		stats.bytes_spliced += PIPE_PAGE_SIZE;
+		return PIPE_PAGE_SIZE;
+	}
+
+	// small writes fill up the newest page unless tee shares it
+	if (last && last->owned && last->owned->refcount == 1 && last->off + last->len < PIPE_PAGE_SIZE) {
+		size_t room = PIPE_PAGE_SIZE - (last->off + last->len);
+		size_t n = len < room ? len : room;
+		n -= __copy_user(last->owned->data + last->off + last->len, src, n);
+		if (!n)
+			return -EFAULT;
+		last->len += (uint32_t)n;
+		stats.bytes_copied += n;
+		return (long)n;
+	}
+
+	if (is_full(p))
+		return 0;
+	struct pipe_page* pg = pipe_page_alloc();
+	if (!pg)
+		return -ENOMEM;
+	size_t n = len < PIPE_PAGE_SIZE ? len : PIPE_PAGE_SIZE;
+	n -= __copy_user(pg->data, src, n);
+	if (!n) {
+		pipe_page_put(pg);
+		return -EFAULT;
+	}
+	push(p, pg, pg->data, 0, n);
+	stats.bytes_copied += n;
+	return (long)n;
+}
+
+static long pipe_write(struct file* f, const void* buf, size_t len, uint64_t* off) {
+	struct pipe* p = f->data;
+	const uint8_t* src = buf;
+	size_t done = 0;
+	long err = 0;
+	(void)off;
+	while (done < len && !err) {
+		lock_writable(p);
+		if (p->readers == 0) {
+			spin_unlock(&p->lock);
+			err = -EPIPE;
+			break;
+		}
+		long n;
+		while (done < len && (n = write_some(p, src + done, len - done)) != 0) {
+			if (n < 0) {
+				err = n;
+				break;
+			}
+			done += (size_t)n;
+		}
+		spin_unlock(&p->lock);
+		waitqueue_wake_all(&p->rd_wait);
+	}
+	return done ? (long)done : err;
+}
+
+static void pipe_release(struct file* f) {
+	struct pipe* p = f->data;
+	spin_lock(&p->lock);
+	if ((f->flags & O_ACCMODE) == O_WRONLY)
+		p->writers--;
+	else
+		p->readers--;
+	int last = p->readers == 0 && p->writers == 0;
+	if (last)
+		while (p->head != p->tail)
+			consume(p, buf_at(p, p->tail)->len);
+	spin_unlock(&p->lock);
+	if (last) {
+		kfree(p);
+		return;
+	}
+	waitqueue_wake_all(&p->rd_wait);
+	waitqueue_wake_all(&p->wr_wait);
+}
+
+// The read end is woken on data and on the last writer going, the write
+// end on room and on the last reader going
+static uint32_t pipe_poll(struct file* f, struct poll_table* pt) {
+	struct pipe* p = f->data;
+	uint32_t mask = 0;
+	if ((f->flags & O_ACCMODE) == O_WRONLY) {
+		poll_wait(pt, &p->wr_wait, POLLOUT);
+		spin_lock(&p->lock);
+		if (!is_full(p))
+			mask |= POLLOUT;
+		if (p->readers == 0)
+			mask |= POLLERR;
+	} else {
+		poll_wait(pt, &p->rd_wait, POLLIN);
+		spin_lock(&p->lock);
+		if (p->head != p->tail)
+			mask |= POLLIN;
+		if (p->writers == 0)
+			mask |= POLLHUP;
+	}
+	spin_unlock(&p->lock);
+	return mask;
+}
+
+static const struct file_ops pipe_ops = { pipe_read, pipe_write, pipe_release, NULL, pipe_poll };
+
+static struct file* pipe_end(struct pipe* p, int flags) {
+	return file_alloc(&pipe_ops, flags, p, S_IFIFO | 0600);
+}
+
+int pipe_create(struct file** rd, struct file** wr) {
+	struct pipe* p = kmalloc(sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	memset(p, 0, sizeof(*p));
+	spin_lock_init(&p->lock);
+	waitqueue_init(&p->rd_wait);
+	waitqueue_init(&p->wr_wait);
+	struct file* r = pipe_end(p, O_RDONLY);
+	struct file* w = r ? pipe_end(p, O_WRONLY) : NULL;
+	if (!w) {
+		kfree(r);
+		kfree(p);
+		return -ENOMEM;
+	}
+	p->readers = 1;
+	p->writers = 1;
+	__atomic_fetch_add(&stats.pipes, 1, __ATOMIC_RELAXED);
+	*rd = r;
+	*wr = w;
+	return 0;
+}
+
+struct pipe* file_pipe(struct file* f) {
+	return f->ops == &pipe_ops ? f->data : NULL;
+}
+
+long pipe_splice_in(struct pipe* p, struct file* in, uint64_t* off, size_t len) {
+	uint64_t* posp = off ? off : &in->pos;
+	size_t done = 0;
+	long err = 0;
+	while (done < len) {
+		// only the first chunk may wait for room
+		if (done && is_full(p))
+			break;
+		uint64_t pos = *posp;
+		size_t in_page = pos % PIPE_PAGE_SIZE;
+		size_t n = PIPE_PAGE_SIZE - in_page;
+		if (n > len - done)
+			n = len - done;
+
+		struct pipe_page* pg = NULL;
+		const uint8_t* data = file_get_page(in, pos - in_page);
+		if (data) {
+			if (pos >= in->size)
+				break;
+			if (n > in->size - pos)
+				n = in->size - pos;
+			data += in_page;
+		} else {
+			// no page to lend: read into one of ours, outside the lock as
+			// the read may block
+			if (!(pg = pipe_page_alloc())) {
+				err = -ENOMEM;
+				break;
+			}
+			long r = file_read(in, pg->data, n, &pos);
+			if (r <= 0) {
+				pipe_page_put(pg);
+				err = r;
+				break;
+			}
+			n = (size_t)r;
+			data = pg->data;
+		}
+
+		lock_writable(p);
+		if (p->readers == 0) {
+			spin_unlock(&p->lock);
+			if (pg)
+				pipe_page_put(pg);
+			err = -EPIPE;
+			break;
+		}
+		push(p, pg, data, 0, n);
+		if (pg)
+			stats.bytes_copied += n;
+		else
+			stats.bytes_spliced += n;
+		spin_unlock(&p->lock);
+		waitqueue_wake_all(&p->rd_wait);
+		*posp = pg ? pos : pos + n;
+		done += n;
+	}
+	return done ? (long)done : err;
+}
+
+long pipe_splice_out(struct pipe* p, struct file* out, uint64_t* off, size_t len) {
+	size_t done = 0;
+	long err = 0;
+	lock_readable(p);
+	while (done < len && p->head != p->tail) {
+		struct pipe_buf* b = buf_at(p, p->tail);
+		size_t n = b->len < len - done ? b->len : len - done;
+		long w = file_write(out, b->data + b->off, n, off);
+		if (w <= 0) {
+			err = w;
+			break;
+		}
+		consume(p, (size_t)w);
+		done += (size_t)w;
+		if ((size_t)w < n)
+			break;
+	}
+	spin_unlock(&p->lock);
+	if (done)
+		waitqueue_wake_all(&p->wr_wait);
+	return done ? (long)done : err;
+}
+
+// Both locks, taken in address order, once in has data (or no writer) and
+// out has a slot (or no reader)
+static void lock_pair(struct pipe* in, struct pipe* out) {
+	struct pipe* first = in < out ? in : out;
+	struct pipe* second = in < out ? out : in;
+	for (;;) {
+		waitqueue_wait(&in->rd_wait, readable, in);
+		waitqueue_wait(&out->wr_wait, writable, out);
+		spin_lock(&first->lock);
+		spin_lock(&second->lock);
+		if (readable(in) && writable(out))
+			return;
+		spin_unlock(&second->lock);
+		spin_unlock(&first->lock);
+	}
+}
+
+long pipe_move(struct pipe* in, struct pipe* out, size_t len, int keep) {
+	if (in == out)
+		return -EINVAL;
+	lock_pair(in, out);
+	size_t done = 0;
+	long err = 0;
+	if (out->readers == 0)
+		err = -EPIPE;
+	for (uint32_t i = in->tail; !err && done < len && i != in->head && !is_full(out);) {
+		struct pipe_buf* b = buf_at(in, i);
+		size_t n = b->len < len - done ? b->len : len - done;
+		if (b->owned)
+			page_get(b->owned);
+		push(out, b->owned, b->data, b->off, n);
+		if (keep)
+			i++;
+		else {
+			consume(in, n);
+			i = in->tail;
+		}
+		done += n;
+	}
+	stats.bytes_spliced += done;
+	spin_unlock(&(in < out ? out : in)->lock);
+	spin_unlock(&(in < out ? in : out)->lock);
+	if (done) {
+		waitqueue_wake_all(&out->rd_wait);
+		if (!keep)
+			waitqueue_wake_all(&in->wr_wait);
+	}
+	return done ? (long)done : err;
+}
+
+void pipe_get_stats(struct pipe_stats* out) {
+	*out = stats;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs/file.h"
+#include "multitasking/spinlock.h"
+#include "multitasking/waitqueue.h"
+
+// Pipes hold references to pages rather than a byte buffer. A write of
+// whole, page-aligned user pages lends the pages themselves (the writer
+// keeps them copy-on-write); other writes are packed into pipe-owned pages.
+// splice, tee and sendfile (fs/splice.h) pass page-cache pages and pipe
+// buffers along by reference, so bulk data is copied once, into wherever
+// it is finally read.
+
+#define PIPE_BUFFERS   16 // ring slots, each up to one page
+#define PIPE_PAGE_SIZE 4096
+
+// A page the pipe allocated; tee can make several buffers share it.
+// Recycled through a free list once the last buffer lets go.
+struct pipe_page {
+	struct pipe_page* next; // free list
+	int refcount;
+	uint8_t* data;
+};
+
+struct pipe_buf {
+	struct pipe_page* owned; // NULL: data is a lent page that never changes
+	const uint8_t* data;
+	uint32_t off;
+	uint32_t len;
+};
+
+struct pipe {
+	spinlock_t lock;
+	struct pipe_buf bufs[PIPE_BUFFERS];
+	uint32_t head, tail; // data in bufs[tail % N] .. bufs[(head - 1) % N]
+	int readers, writers;
+	struct waitqueue rd_wait; // readers: wait for data or the last writer
+	struct waitqueue wr_wait; // writers: wait for a slot or the last reader
+};
+
+struct pipe_stats {
+	uint64_t pipes;
+	uint64_t pages;         // pipe-owned pages ever allocated
+	uint64_t bytes_copied;  // copied into pipe-owned pages
+	uint64_t bytes_spliced; // passed on by reference instead
+};
+
+// Read and write ends of a new pipe, each with one reference; 0 or -errno
+int pipe_create(struct file** rd, struct file** wr);
+// The pipe behind f, NULL if f is not a pipe end
+struct pipe* file_pipe(struct file* f);
+
+// A page-sized buffer (for bounce copies as well); NULL if out of memory
+struct pipe_page* pipe_page_alloc(void);
+void pipe_page_put(struct pipe_page* pg);
+
+// The transfers below block until they can move something, then move what
+// they can without blocking again. They return the byte count, 0 at end of
+// input, or -errno (-EPIPE once nobody reads the destination pipe).
+
+// File -> pipe. Pages the file can lend go in by reference, anything else
+// is read into pipe-owned pages. off == NULL uses and advances in->pos.
+long pipe_splice_in(struct pipe* p, struct file* in, uint64_t* off, size_t len);
+// Pipe -> file, written straight from the pipe's pages. out must not block:
+// it is written with the pipe locked.
+long pipe_splice_out(struct pipe* p, struct file* out, uint64_t* off, size_t len);
+// Pipe -> pipe by reference: moves the data, or with keep (tee) leaves it
+// in the source as well
+long pipe_move(struct pipe* in, struct pipe* out, size_t len, int keep);
+
+void pipe_get_stats(struct pipe_stats* out);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "multitasking/waitqueue.h"
+
+// Readiness of open files, for event multiplexing (fs/eventpoll.h). A
+// file's poll op hands each wait queue that signals a change in its state
+// to poll_wait() and then returns what is ready now: registering first
+// means a change in between is not missed. Queues are tagged with the
+// events they signal, so a watcher is only parked on the queues its
+// interest needs.
+
+// Event bits, with the Linux values
+#define POLLIN  0x001
+#define POLLOUT 0x004
+#define POLLERR 0x008 // always reported
+#define POLLHUP 0x010 // always reported
+
+struct poll_table {
+	// Called for each queue of interest; may be called again for the same
+	// queue on later polls
+	void (*queue)(struct poll_table* pt, struct waitqueue* wq);
+	uint32_t events; // interest: POLL* bits
+};
+
+// Register pt (which may be NULL: only the current state is wanted) on wq
+// if it is interested in any of events
+static inline void poll_wait(struct poll_table* pt, struct waitqueue* wq, uint32_t events) {
+	if (pt && pt->queue && (events & (pt->events | POLLERR | POLLHUP)))
+		pt->queue(pt, wq);
+}
@@ -0,0 +1,88 @@
+#include <stddef.h>
+#include "fs/pipe.h"
+#include "fs/splice.h"
+#include "lib/errno.h"
+
+long splice_files(struct file* in, uint64_t* in_off, struct file* out, uint64_t* out_off, size_t len) {
+	struct pipe* pin = file_pipe(in);
+	struct pipe* pout = file_pipe(out);
+	if ((in->flags & O_ACCMODE) == O_WRONLY || (out->flags & O_ACCMODE) == O_RDONLY)
+		return -EBADF;
+	if ((pin && in_off) || (pout && out_off))
+		return -ESPIPE;
+	if (pin && pout)
+		return pipe_move(pin, pout, len, 0);
+	if (pin)
+		return pipe_splice_out(pin, out, out_off, len);
+	if (pout)
+		return pipe_splice_in(pout, in, in_off, len);
+	return -EINVAL;
+}
+
+long tee_pipes(struct file* in, struct file* out, size_t len) {
+	struct pipe* pin = file_pipe(in);
+	struct pipe* pout = file_pipe(out);
+	if (!pin || !pout)
+		return -EINVAL;
+	if ((in->flags & O_ACCMODE) == O_WRONLY || (out->flags & O_ACCMODE) == O_RDONLY)
+		return -EBADF;
+	return pipe_move(pin, pout, len, 1);
+}
+
+long sendfile_files(struct file* out, struct file* in, uint64_t* off, size_t count) {
+	if ((in->flags & O_ACCMODE) == O_WRONLY || (out->flags & O_ACCMODE) == O_RDONLY)
+		return -EBADF;
+	if (file_pipe(in))
+		return -EINVAL;
+	struct pipe* pout = file_pipe(out);
+	if (pout)
+		return pipe_splice_in(pout, in, off, count);
+
+	uint64_t* posp = off ? off : &in->pos;
+	struct pipe_page* bounce = NULL;
+	size_t done = 0;
+	long err = 0;
+	while (done < count) {
+		uint64_t pos = *posp;
+		size_t in_page = pos % PIPE_PAGE_SIZE;
+		size_t n = PIPE_PAGE_SIZE - in_page;
+		if (n > count - done)
+			n = count - done;
+
+		const uint8_t* data = file_get_page(in, pos - in_page);
+		if (data) {
+			if (pos >= in->size)
+				break;
+			if (n > in->size - pos)
+				n = in->size - pos;
+			data += in_page;
+		} else {
+			if (!bounce && !(bounce = pipe_page_alloc())) {
+				err = -ENOMEM;
+				break;
+			}
+			uint64_t rpos = pos;
+			long r = file_read(in, bounce->data, n, &rpos);
+			if (r <= 0) {
+				err = r;
+				break;
+			}
+			n = (size_t)r;
+			data = bounce->data;
+		}
+
+		long w = file_write(out, data, n, NULL);
+		if (w <= 0) {
+			err = w;
+			break;
+		}
+		// only what reached out counts as consumed
+		*posp = pos + (uint64_t)w;
+		done += (size_t)w;
+		if ((size_t)w < n)
+			break;
+	}
+	if (bounce)
+		pipe_page_put(bounce);
+	return done ? (long)done : err;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs/file.h"
+
+// Moving data between descriptors without a trip through user memory.
+// Results are byte counts or -errno; a NULL offset uses and advances the
+// file's own position (pipes have none: passing one is -ESPIPE).
+
+// splice(2): one side at least must be a pipe
+long splice_files(struct file* in, uint64_t* in_off, struct file* out, uint64_t* out_off, size_t len);
+// tee(2): duplicate up to len bytes of pipe in into pipe out, leaving them
+// readable in both
+long tee_pipes(struct file* in, struct file* out, size_t len);
+// sendfile(2): up to count bytes of in, from *off if off is given, to out.
+// Page-cache pages are written to out directly.
+long sendfile_files(struct file* out, struct file* in, uint64_t* off, size_t count);
@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include "fs/fdtable.h"
+#include "fs/poll.h"
+#include "fs/timerfd.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/uaccess.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "multitasking/waitqueue.h"
+#include "syscall/sysno.h"
+#include "time/clock.h"
+#include "time/timer.h"
+
+struct timerfd {
+	spinlock_t lock; // irqsave: the timer fires in softirq context
+	struct timer timer;
+	uint64_t next; // absolute expiry in ns, 0 while disarmed
+	uint64_t interval; // ns, 0 for a one-shot
+	uint64_t expirations; // since the last read
+	struct waitqueue rd_wait; // readers: wait for an expiration
+};
+
+// timer softirq: interrupts are off
+static void timerfd_fire(void* arg) {
+	struct timerfd* t = arg;
+	uint64_t now = clock_now_ns();
+	spin_lock(&t->lock);
+	if (t->interval) {
+		uint64_t periods = 1 + (now > t->next ? (now - t->next) / t->interval : 0);
+		t->expirations += periods;
+		t->next += periods * t->interval;
+		timer_arm(&t->timer, t->next);
+	} else {
+		t->expirations++;
+		t->next = 0;
+	}
+	spin_unlock(&t->lock);
+	waitqueue_wake_all(&t->rd_wait);
+}
+
+static int expired(void* arg) {
+	struct timerfd* t = arg;
+	return t->expirations != 0;
+}
+
+static long timerfd_read(struct file* f, void* buf, size_t len, uint64_t* off) {
+	struct timerfd* t = f->data;
+	uint64_t n;
+	(void)off;
+	if (len < sizeof(n))
+		return -EINVAL;
+	for (;;) {
+		uint64_t flags = spin_lock_irqsave(&t->lock);
+		n = t->expirations;
+		t->expirations = 0;
+		spin_unlock_irqrestore(&t->lock, flags);
+		if (n)
+			break;
+		if (f->flags & O_NONBLOCK)
+			return -EAGAIN;
+		waitqueue_wait(&t->rd_wait, expired, t);
+	}
+	return __copy_user(buf, &n, sizeof(n)) ? -EFAULT : (long)sizeof(n);
+}
+
+static uint32_t timerfd_poll(struct file* f, struct poll_table* pt) {
+	struct timerfd* t = f->data;
+	poll_wait(pt, &t->rd_wait, POLLIN);
+	return t->expirations ? POLLIN : 0;
+}
+
+static void timerfd_release(struct file* f) {
+	struct timerfd* t = f->data;
+	uint64_t flags = spin_lock_irqsave(&t->lock);
+	timer_cancel(&t->timer);
+	spin_unlock_irqrestore(&t->lock, flags);
+	kfree(t);
+}
+
+static const struct file_ops timerfd_ops = { timerfd_read, NULL, timerfd_release, NULL, timerfd_poll };
+
+static struct file* get_timerfd(int fd) {
+	struct file* f = fd_get(scheduler_get_files(), fd);
+	if (f && f->ops != &timerfd_ops) {
+		file_put(f);
+		return NULL;
+	}
+	return f;
+}
+
+static int ts_valid(const struct timerfd_timespec* ts) {
+	return ts->tv_sec >= 0 && ts->tv_nsec >= 0 && ts->tv_nsec < (int64_t)NSEC_PER_SEC;
+}
+
+static uint64_t ts_to_ns(const struct timerfd_timespec* ts) {
+	return (uint64_t)ts->tv_sec * NSEC_PER_SEC + (uint64_t)ts->tv_nsec;
+}
+
+static struct timerfd_timespec ns_to_ts(uint64_t ns) {
+	struct timerfd_timespec ts = { (int64_t)(ns / NSEC_PER_SEC), (int64_t)(ns % NSEC_PER_SEC) };
+	return ts;
+}
+
+// t->lock held; an expiry that is due but not yet handled reads as 1 ns
+static void get_spec(const struct timerfd* t, uint64_t now, struct timerfd_itimerspec* out) {
+	out->it_interval = ns_to_ts(t->interval);
+	out->it_value = ns_to_ts(t->next ? (t->next > now ? t->next - now : 1) : 0);
+}
+
+int timerfd_create(int clockid, int flags) {
+	struct fdtable* tab = scheduler_get_files();
+	if (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC)
+		return -EINVAL;
+	if (flags & ~(TFD_NONBLOCK | TFD_CLOEXEC))
+		return -EINVAL;
+	if (!tab)
+		return -EBADF;
+	struct timerfd* t = kmalloc(sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	spin_lock_init(&t->lock);
+	timer_setup(&t->timer, timerfd_fire, t);
+	t->next = 0;
+	t->interval = 0;
+	t->expirations = 0;
+	waitqueue_init(&t->rd_wait);
+	struct file* f = file_alloc(&timerfd_ops, O_RDONLY | (flags & TFD_NONBLOCK), t, 0600);
+	if (!f) {
+		kfree(t);
+		return -ENOMEM;
+	}
+	int fd = fd_install(tab, f, 0, (flags & TFD_CLOEXEC) ? FD_CLOEXEC : 0);
+	if (fd < 0)
+		file_put(f);
+	return fd;
+}
+
+int timerfd_settime(int fd, int flags, const struct timerfd_itimerspec* value, struct timerfd_itimerspec* old) {
+	struct timerfd_itimerspec spec, prev;
+	if (flags & ~TFD_TIMER_ABSTIME)
+		return -EINVAL;
+	if (copy_from_user(&spec, value, sizeof(spec)))
+		return -EFAULT;
+	if (!ts_valid(&spec.it_value) || !ts_valid(&spec.it_interval))
+		return -EINVAL;
+	struct file* f = get_timerfd(fd);
+	if (!f)
+		return -EBADF;
+	struct timerfd* t = f->data;
+	uint64_t first = ts_to_ns(&spec.it_value);
+	uint64_t now = clock_now_ns();
+	uint64_t irq = spin_lock_irqsave(&t->lock);
+	get_spec(t, now, &prev);
+	timer_cancel(&t->timer);
+	t->expirations = 0;
+	t->interval = ts_to_ns(&spec.it_interval);
+	t->next = 0;
+	if (first) {
+		// an absolute time already past fires on the next tick
+		t->next = (flags & TFD_TIMER_ABSTIME) ? first : now + first;
+		timer_arm(&t->timer, t->next);
+	}
+	spin_unlock_irqrestore(&t->lock, irq);
+	file_put(f);
+	if (old && copy_to_user(old, &prev, sizeof(prev)))
+		return -EFAULT;
+	return 0;
+}
+
+int timerfd_gettime(int fd, struct timerfd_itimerspec* cur) {
+	struct timerfd_itimerspec spec;
+	struct file* f = get_timerfd(fd);
+	if (!f)
+		return -EBADF;
+	struct timerfd* t = f->data;
+	uint64_t irq = spin_lock_irqsave(&t->lock);
+	get_spec(t, clock_now_ns(), &spec);
+	spin_unlock_irqrestore(&t->lock, irq);
+	file_put(f);
+	return copy_to_user(cur, &spec, sizeof(spec)) ? -EFAULT : 0;
+}
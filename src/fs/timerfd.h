@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "fs/file.h"
+
+// Timer files: a kernel timer whose expirations are counted in the file,
+// so timeouts can be waited for through epoll next to everything else. A
+// read blocks until the timer has expired, then returns the expirations
+// since the last read as eight bytes. Periodic timers keep their phase:
+// an expiry handled late counts the periods it missed instead of drifting.
+// POLLIN while there are expirations to read.
+
+// Flags, with the Linux values
+#define TFD_NONBLOCK       O_NONBLOCK // read returns -EAGAIN instead of blocking
+#define TFD_CLOEXEC        O_CLOEXEC
+#define TFD_TIMER_ABSTIME  1 // settime: value is a time on the clock, not a delay
+
+// struct timespec and struct itimerspec, with the Linux x86-64 layout
+struct timerfd_timespec {
+	int64_t tv_sec;
+	int64_t tv_nsec;
+};
+
+struct timerfd_itimerspec {
+	struct timerfd_timespec it_interval; // period; 0 for a one-shot
+	struct timerfd_timespec it_value; // first expiry; 0 disarms
+};
+
+// The system calls, on descriptors of the calling process and user
+// buffers. CLOCK_REALTIME and CLOCK_MONOTONIC are the same clock here.
+// create returns the new descriptor; settime resets the expiration count
+// and, given old, stores what was set before, as gettime does.
+int timerfd_create(int clockid, int flags);
+int timerfd_settime(int fd, int flags, const struct timerfd_itimerspec* value, struct timerfd_itimerspec* old);
+int timerfd_gettime(int fd, struct timerfd_itimerspec* cur);
@@ -1,18 +1,91 @@
 #include <stddef.h>
+#include "fs/vfs.h"
 #include "drivers/fat/fat.h"
 #include "drivers/ext/ext.h"
+#include "multitasking/spinlock.h"
+
+// FAT is tried first, then EXT
+static struct vfs_mount ext_mount = { NULL, "ext", ext_read_file, NULL, NULL, NULL, { NULL, NULL } };
+static struct vfs_mount fat_mount = {
+	&ext_mount, "fat", fat_read_file, fat_readdir, fat_lookup, fat_read_page, { NULL, NULL }
+};
+
+static struct vfs_mount* mounts = &fat_mount;
+static spinlock_t mount_lock = SPINLOCK_INIT; // serialises writers only
 
 // Try to read a file from any supported filesystem
 int vfs_read_file(const char* path, void** buf, size_t* len) {
 	if (!path || !buf || !len) return -1;
-	// Try FAT first
-	if (fat_read_file(path, buf, len) == 0)
-		return 0;
-	// Try EXT next
-	if (ext_read_file(path, buf, len) == 0)
+	int ret = -1;
+	rcu_read_lock();
+	for (struct vfs_mount* m = rcu_dereference(mounts); m; m = rcu_dereference(m->next)) {
+		if (m->read_file(path, buf, len) == 0) {
+			ret = 0;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	if (ret == 0)
 		return 0;
 	// Not found
 	*buf = NULL;
 	*len = 0;
 	return -1;
 }
+
+struct vfs_mount* vfs_lookup(const char* path, struct vfs_stat* st) {
+	if (!path || !st) return NULL;
+	struct vfs_mount* found = NULL;
+	rcu_read_lock();
+	for (struct vfs_mount* m = rcu_dereference(mounts); m; m = rcu_dereference(m->next)) {
+		if (m->lookup && m->read_page && m->lookup(path, st) == 0) {
+			found = m;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+int vfs_readdir(const char* path, vfs_filldir_fn fill, void* ctx) {
+	if (!path || !fill) return -1;
+	int ret = -1;
+	rcu_read_lock();
+	for (struct vfs_mount* m = rcu_dereference(mounts); m; m = rcu_dereference(m->next)) {
+		if (m->readdir && m->readdir(path, fill, ctx) == 0) {
+			ret = 0;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+void vfs_mount(struct vfs_mount* m) {
+	if (!m) return;
+	m->next = NULL;
+	spin_lock(&mount_lock);
+	struct vfs_mount** pp = &mounts;
+	while (*pp)
+		pp = &(*pp)->next;
+	// m is fully set up before a lookup can reach it
+	rcu_assign_pointer(*pp, m);
+	spin_unlock(&mount_lock);
+}
+
+int vfs_umount(struct vfs_mount* m) {
+	if (!m) return -1;
+	spin_lock(&mount_lock);
+	struct vfs_mount** pp = &mounts;
+	while (*pp && *pp != m)
+		pp = &(*pp)->next;
+	if (!*pp) {
+		spin_unlock(&mount_lock);
+		return -1;
+	}
+	// lookups already on m still follow m->next, which stays intact
+	rcu_assign_pointer(*pp, m->next);
+	spin_unlock(&mount_lock);
+	synchronize_rcu();
+	return 0;
+}
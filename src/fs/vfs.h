@@ -1,5 +1,53 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include "multitasking/rcu.h"
+
+#define VFS_PAGE_SIZE 4096
+
+// What a lookup learns about a file; ino is the filesystem's own handle
+struct vfs_stat {
+	uint64_t ino;
+	size_t size;
+	int is_dir;
+};
+
+typedef int (*vfs_read_fn)(const char* path, void** buf, size_t* len);
+// Called once per directory entry; a nonzero return stops the listing
+typedef int (*vfs_filldir_fn)(void* ctx, const char* name, size_t size, int is_dir);
+// List the directory at path; 0 on success, -1 if it is not one
+typedef int (*vfs_readdir_fn)(const char* path, vfs_filldir_fn fill, void* ctx);
+// Find path without reading it; 0 on success, -1 if it does not exist
+typedef int (*vfs_lookup_fn)(const char* path, struct vfs_stat* st);
+// Read page index (VFS_PAGE_SIZE bytes) of file ino into page
+typedef int (*vfs_read_page_fn)(uint64_t ino, uint64_t index, void* page);
+
+// A mounted filesystem. Lookups walk the mount list under rcu_read_lock(),
+// so they never wait for a mount or unmount in progress.
+struct vfs_mount {
+	struct vfs_mount* next;
+	const char* name;
+	vfs_read_fn read_file;
+	vfs_readdir_fn readdir; // NULL if the filesystem cannot list directories
+	// Page-granular access for the page cache (fs/inode.h); NULL if the
+	// filesystem can only hand out whole files
+	vfs_lookup_fn lookup;
+	vfs_read_page_fn read_page;
+	struct rcu_head rcu;
+};
+
 // VFS: read a file from any supported filesystem
 int vfs_read_file(const char* path, void** buf, size_t* len);
 
+// Look path up on the first filesystem with page-granular access that has
+// it; returns that mount, or NULL
+struct vfs_mount* vfs_lookup(const char* path, struct vfs_stat* st);
+
+// List a directory through the first filesystem that has it
+int vfs_readdir(const char* path, vfs_filldir_fn fill, void* ctx);
+
+// Append m to the mount list (lookup order is mount order)
+void vfs_mount(struct vfs_mount* m);
+// Unlink m; returns once no lookup can still be using it
+int vfs_umount(struct vfs_mount* m);
@@ -1,5 +1,6 @@
 #include "graphics/framebuffer.h"
 #include "boot/limine.h"
+#include "multitasking/preempt.h"
 #include <stdint.h>
 
 /* ------------------ FRAMEBUFFER ------------------ */
@@ -125,6 +126,8 @@ void framebuffer_draw_rect(uint64_t x, uint64_t y, uint64_t w, uint64_t h, uint3
         pixel[2] = (color >> 16) & 0xFF;
       }
     }
+    /* a full-screen fill takes milliseconds: let a waiting task in */
+    cond_resched();
   }
 }
 
@@ -177,5 +180,6 @@ void framebuffer_blit_rgba(const unsigned char* img, int img_w, int img_h)
 
       src += 4;
     }
+    cond_resched();
   }
 }
@@ -3,7 +3,10 @@
 #include "graphics/font.h"
 #include "graphics/framebuffer.h"
 #include "lib/libc.h"
+#include "mem/alloc.h"
+#include "multitasking/rcu.h"
 #include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
 #include "serial/serial.h"
 #include "string.h"
 
@@ -18,10 +21,70 @@ struct MiaWindow
   int      z;
 };
 
-static struct MiaWindow windows[MAX_WINDOWS];
-static int              next_z   = 1;
-static int              cursor_x = 0, cursor_y = 0; /* cursor position */
-static int              cursor_size = 8;
+/* Stacking order, bottom to top. The painters and hit-testing walk it
+   under rcu_read_lock() while window creation and raising publish a fresh
+   copy under mia_lock, so a frame in progress never sees a half-updated
+   order and never waits for the window manager. */
+struct mia_zorder
+{
+  int             count;
+  MiaWindow*         win[MAX_WINDOWS];
+  struct rcu_head    rcu;
+  struct mia_zorder* next_free;
+};
+
+static struct MiaWindow   windows[MAX_WINDOWS];
+static struct mia_zorder  zorder_empty;
+static struct mia_zorder* zorder   = &zorder_empty;
+static spinlock_t         mia_lock = SPINLOCK_INIT;
+/* kfree does not give memory back, so retired copies are recycled here
+   once no reader can see them; the RCU callback runs from softirq
+   context, hence the irqsave lock */
+static struct mia_zorder* zorder_pool      = NULL;
+static spinlock_t         zorder_pool_lock = SPINLOCK_INIT;
+static int                next_z   = 1;
+static int                cursor_x = 0, cursor_y = 0; /* cursor position */
+static int                cursor_size = 8;
+
+static void zorder_free(struct rcu_head* head)
+{
+  struct mia_zorder* z = container_of(head, struct mia_zorder, rcu);
+  if (z == &zorder_empty)
+    return;
+  uint64_t flags = spin_lock_irqsave(&zorder_pool_lock);
+  z->next_free   = zorder_pool;
+  zorder_pool    = z;
+  spin_unlock_irqrestore(&zorder_pool_lock, flags);
+}
+
+static struct mia_zorder* zorder_alloc(void)
+{
+  uint64_t           flags = spin_lock_irqsave(&zorder_pool_lock);
+  struct mia_zorder* z     = zorder_pool;
+  if (z)
+    zorder_pool = z->next_free;
+  spin_unlock_irqrestore(&zorder_pool_lock, flags);
+  return z ? z : kmalloc(sizeof(*z));
+}
+
+/* Publish a copy of the current order with w moved (or added) on top.
+   Caller holds mia_lock. */
+static int zorder_raise(MiaWindow* w)
+{
+  struct mia_zorder* old = zorder;
+  struct mia_zorder* z   = zorder_alloc();
+  if (!z)
+    return -1;
+  z->count = 0;
+  for (int i = 0; i < old->count; ++i)
+    if (old->win[i] != w)
+      z->win[z->count++] = old->win[i];
+  z->win[z->count++] = w;
+  w->z               = next_z++;
+  rcu_assign_pointer(zorder, z);
+  call_rcu(&old->rcu, zorder_free);
+  return 0;
+}
 
 void mia_init(void)
 {
@@ -53,14 +116,11 @@ MiaWindow* mia_window_create(int x, int y, int w, int h, const char* title)
   if (w <= 0 || h <= 0)
     return NULL;
 
+  spin_lock(&mia_lock);
   for (int i = 0; i < MAX_WINDOWS; ++i)
   {
     if (!windows[i].used)
     {
-      /* volatile write to avoid any surprises */
-      volatile int* pused = &windows[i].used;
-      *pused              = 1;
-
       windows[i].x        = x;
       windows[i].y        = y;
       windows[i].w        = w;
@@ -79,10 +139,15 @@ MiaWindow* mia_window_create(int x, int y, int w, int h, const char* title)
         if (ci == sizeof(windows[i].title) - 2)
           windows[i].title[ci + 1] = '\0';
       }
-      windows[i].z = next_z++;
+      /* readers only reach the window through the new order */
+      if (zorder_raise(&windows[i]) < 0)
+        break;
+      windows[i].used = 1;
+      spin_unlock(&mia_lock);
       return &windows[i];
     }
   }
+  spin_unlock(&mia_lock);
   return NULL;
 }
 
@@ -124,59 +189,43 @@ static void draw_window(MiaWindow* w)
 
 void mia_paint_all(void)
 {
-  /* Paint windows in z-order (lowest z first).  z==0 means unused. */
-  int max_z = 0;
-  for (int i = 0; i < MAX_WINDOWS; ++i)
-    if (windows[i].used && windows[i].z > max_z)
-      max_z = windows[i].z;
-  for (int z = 1; z <= max_z; ++z)
-  {
-    for (int i = 0; i < MAX_WINDOWS; ++i)
-    {
-      if (windows[i].used && windows[i].z == z)
-        draw_window(&windows[i]);
-    }
-  }
+  /* Paint windows in z-order (lowest first) */
+  rcu_read_lock();
+  struct mia_zorder* z = rcu_dereference(zorder);
+  for (int i = 0; i < z->count; ++i)
+    draw_window(z->win[i]);
+  rcu_read_unlock();
 }
 
 /* Paint windows but clip any parts below 'max_h' so a bottom reserved area
    (e.g. for the shell prompt) is preserved. */
 void mia_paint_clipped(int max_h)
 {
-  int max_z = 0;
-  for (int i = 0; i < MAX_WINDOWS; ++i)
-    if (windows[i].used && windows[i].z > max_z)
-      max_z = windows[i].z;
-  for (int z = 1; z <= max_z; ++z)
+  rcu_read_lock();
+  struct mia_zorder* z = rcu_dereference(zorder);
+  for (int i = 0; i < z->count; ++i)
   {
-    for (int i = 0; i < MAX_WINDOWS; ++i)
-    {
-      if (!windows[i].used || windows[i].z != z)
-        continue;
-      int wy = windows[i].y;
-      if (wy >= max_h)
-        continue; /* fully in reserved area */
-      int draw_h = windows[i].h;
-      if (windows[i].y + draw_h > max_h)
-        draw_h = max_h - windows[i].y;
+    MiaWindow* w  = z->win[i];
+    int        wx = w->x, wy = w->y, ww = w->w;
+    if (wy >= max_h)
+      continue; /* fully in reserved area */
+    int draw_h = w->h;
+    if (wy + draw_h > max_h)
+      draw_h = max_h - wy;
 
-      /* title bar */
-      framebuffer_draw_rect(windows[i].x, windows[i].y, windows[i].w, 18, 0x101030);
-      /* title text */
-      psf_draw_text(windows[i].x + 6, windows[i].y + 2, windows[i].title, 0xFFFFFF);
-      /* client area clipped */
-      framebuffer_draw_rect(windows[i].x,
-                            windows[i].y + 18,
-                            windows[i].w,
-                            draw_h > 18 ? draw_h - 18 : 0,
-                            windows[i].color_bg);
-      /* border */
-      framebuffer_draw_rect(windows[i].x, windows[i].y, windows[i].w, 1, 0x000000);
-      framebuffer_draw_rect(windows[i].x, windows[i].y + draw_h - 1, windows[i].w, 1, 0x000000);
-      framebuffer_draw_rect(windows[i].x, windows[i].y, 1, draw_h, 0x000000);
-      framebuffer_draw_rect(windows[i].x + windows[i].w - 1, windows[i].y, 1, draw_h, 0x000000);
-    }
+    /* title bar */
+    framebuffer_draw_rect(wx, wy, ww, 18, 0x101030);
+    /* title text */
+    psf_draw_text(wx + 6, wy + 2, w->title, 0xFFFFFF);
+    /* client area clipped */
+    framebuffer_draw_rect(wx, wy + 18, ww, draw_h > 18 ? draw_h - 18 : 0, w->color_bg);
+    /* border */
+    framebuffer_draw_rect(wx, wy, ww, 1, 0x000000);
+    framebuffer_draw_rect(wx, wy + draw_h - 1, ww, 1, 0x000000);
+    framebuffer_draw_rect(wx, wy, 1, draw_h, 0x000000);
+    framebuffer_draw_rect(wx + ww - 1, wy, 1, draw_h, 0x000000);
   }
+  rcu_read_unlock();
 }
 
 void mia_draw_cursor(void)
@@ -220,31 +269,28 @@ void mia_dump_window(MiaWindow* w)
 
 MiaWindow* mia_window_at(int x, int y)
 {
-  /* find topmost window at coordinates (x,y) by highest z */
-  MiaWindow* best   = NULL;
-  int        best_z = 0;
-  for (int i = 0; i < MAX_WINDOWS; ++i)
+  /* topmost first */
+  MiaWindow* hit = NULL;
+  rcu_read_lock();
+  struct mia_zorder* z = rcu_dereference(zorder);
+  for (int i = z->count - 1; i >= 0 && !hit; --i)
   {
-    if (!windows[i].used)
-      continue;
-    if (x >= windows[i].x && x < windows[i].x + windows[i].w && y >= windows[i].y &&
-        y < windows[i].y + windows[i].h)
-    {
-      if (windows[i].z >= best_z)
-      {
-        best   = &windows[i];
-        best_z = windows[i].z;
-      }
-    }
+    MiaWindow* w = z->win[i];
+    if (x >= w->x && x < w->x + w->w && y >= w->y && y < w->y + w->h)
+      hit = w;
   }
-  return best;
+  rcu_read_unlock();
+  return hit;
 }
 
 void mia_bring_to_front(MiaWindow* w)
 {
   if (!w)
     return;
-  w->z = next_z++;
+  spin_lock(&mia_lock);
+  if (zorder->count == 0 || zorder->win[zorder->count - 1] != w)
+    zorder_raise(w);
+  spin_unlock(&mia_lock);
 }
 
 void mia_get_window_rect(MiaWindow* w, int* x, int* y, int* w_out, int* h_out)
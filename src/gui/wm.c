@@ -4,6 +4,7 @@
 #include "gui/mia.h"
 #include "multitasking/scheduler.h"
 #include "serial/serial.h"
+#include "time/clock.h"
 #include <stdint.h>
 #include <stdio.h>
 
@@ -39,6 +40,10 @@ void wm_proc(void* arg)
   int        offx = 0, offy = 0;
   int        btn_prev = 0;
 
+  /* frame loop: 60 Hz with a 4 ms drawing budget per frame */
+  if (scheduler_set_deadline(scheduler_get_current(), 16666667, 4 * NSEC_PER_MSEC) != 0)
+    serial_puts("wm: deadline class rejected, running round robin\n");
+
   uint8_t pkt[3];
   while (1)
   {
@@ -113,6 +118,6 @@ void wm_proc(void* arg)
     if (cy < (int) framebuffer_get_height() - reserve)
       mia_draw_cursor();
 
-    scheduler_yield();
+    scheduler_wait_next_period();
   }
 }
\ No newline at end of file
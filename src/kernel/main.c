@@ -14,17 +14,30 @@ void paging_mark_heap_mapped(void);
 #include "../lib/stb_image_stub.h"
 #include "../mem/alloc.h"
 #include "../mem/paging.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "boot/gdt.h"
+#include "boot/lapic.h"
 #include "console/console.h"
+#include "console/tty.h"
 #include "drivers/drivers.h"
 #include "gui/mia.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/idle.h"
+#include "multitasking/rcu.h"
 #include "multitasking/scheduler.h"
+#include "multitasking/workqueue.h"
 #include "serial/serial.h"
 #include "shell/shell.h"
+#include "sys/proc.h"
+#include "syscall/syscall.h"
+#include "time/clock.h"
+#include "time/timer.h"
 #include "utils/log.h"
+#include "vdso/vdso.h"
 
 // ────────────────────────────────────────────────
 // Forward declarations
@@ -35,8 +48,6 @@ extern void tss_init(void);
 extern void early_idt_init(void);
 extern void idt_init(void);
 
-extern int kernel_spawn_elf_from_path(const char* path);
-
 // ────────────────────────────────────────────────
 // Helper: draw filled rectangle
 // ────────────────────────────────────────────────
@@ -92,9 +103,7 @@ static void debug_console_task(void* arg)
     serial_putdec(i);
     console_puts("\n");
 
-    for (volatile int j = 0; j < 20000000; j++)
-      ;  // rough delay
-    scheduler_yield();
+    timer_sleep_ns(250 * NSEC_PER_MSEC);
   }
 
   serial_puts("debug_console_task: finished\n");
@@ -120,6 +129,10 @@ static void mover(void* arg)
   int dir = 1;
   int x   = 80;
 
+  /* one frame every 16.6 ms with 4 ms reserved to draw it */
+  if (scheduler_set_deadline(scheduler_get_current(), 16666667, 4 * NSEC_PER_MSEC) != 0)
+    serial_puts("mover: deadline class rejected, running round robin\n");
+
   while (1)
   {
     mia_window_move(w, x, 80);
@@ -139,7 +152,7 @@ static void mover(void* arg)
       dir = -dir;
     }
 
-    scheduler_yield();
+    scheduler_wait_next_period();
   }
 }
 
@@ -216,9 +229,22 @@ void kernel_main(void)
   paging_identity_map_kernel_sections();
   serial_puts("[DEBUG] main: paging_identity_map_kernel_sections returned\n");
   serial_puts("Paging setup complete\n");
+  mm_init();
 
   idt_init();
   log("Full IDT initialized");
+  syscall_init();
+  uaccess_init();
+
+  // ── Time ───────────────────────────────────────
+  clock_init();
+  if (lapic_init() != 0)
+    log("LAPIC timer unavailable – timers will be polled");
+  timer_init();
+  log("Timer wheel initialized");
+  if (vdso_init() != 0)
+    log("vDSO unavailable – user time calls will trap");
+  rcu_init();
 
   asm volatile("sti");  // enable interrupts
   log("Interrupts enabled");
@@ -234,6 +260,13 @@ void kernel_main(void)
   }
   log("Scheduler initialized");
 
+  if (idle_init() < 0)
+    log("WARNING: no idle task – blocked CPU will spin");
+  if (workqueue_init() != 0)
+    log("WARNING: no workqueue workers");
+  tty_init();
+  log("Console TTY initialized");
+
   // ── GUI (MiaUI) ──────────────────────────────────
   mia_init();
   log("MiaUI GUI initialized");
@@ -0,0 +1,127 @@
+#ifndef LIB_ELF_H
+#define LIB_ELF_H
+
+#include <stdint.h>
+
+/* ELF64 structures and constants (System V gABI / x86-64 psABI), only as
+   much as the kernel and its user-side helpers need */
+
+#define EI_NIDENT 16
+#define ELFMAG0   0x7F
+#define ELFMAG1   'E'
+#define ELFMAG2   'L'
+#define ELFMAG3   'F'
+#define ELFCLASS64 2
+#define ELFDATA2LSB 1
+
+#define ET_EXEC 2
+#define ET_DYN  3
+#define EM_X86_64 62
+
+#define PT_NULL    0
+#define PT_LOAD    1
+#define PT_DYNAMIC 2
+#define PT_INTERP  3
+#define PT_NOTE    4
+#define PT_PHDR    6
+#define PT_TLS     7
+
+#define PF_X 0x1
+#define PF_W 0x2
+#define PF_R 0x4
+
+#define DT_NULL   0
+#define DT_HASH   4
+#define DT_STRTAB 5
+#define DT_SYMTAB 6
+
+#define STT_FUNC 2
+#define SHN_UNDEF 0
+
+#define ELF64_ST_TYPE(i) ((i) & 0xF)
+
+/* Programs built against the ByteOS user runtime (libc/) carry this note
+   in a PT_NOTE segment and get the native system call numbering */
+#define ELF_NOTE_BYTEOS "ByteOS"
+#define NT_BYTEOS_ABI   1
+
+/* Auxiliary vector entries passed on the initial process stack */
+#define AT_NULL         0
+#define AT_PHDR         3
+#define AT_PHENT        4
+#define AT_PHNUM        5
+#define AT_PAGESZ       6
+#define AT_BASE         7
+#define AT_FLAGS        8
+#define AT_ENTRY        9
+#define AT_UID          11
+#define AT_EUID         12
+#define AT_GID          13
+#define AT_EGID         14
+#define AT_CLKTCK       17
+#define AT_SECURE       23
+#define AT_RANDOM       25
+#define AT_EXECFN       31
+#define AT_SYSINFO_EHDR 33
+
+typedef struct
+{
+  unsigned char e_ident[EI_NIDENT];
+  uint16_t      e_type;
+  uint16_t      e_machine;
+  uint32_t      e_version;
+  uint64_t      e_entry;
+  uint64_t      e_phoff;
+  uint64_t      e_shoff;
+  uint32_t      e_flags;
+  uint16_t      e_ehsize;
+  uint16_t      e_phentsize;
+  uint16_t      e_phnum;
+  uint16_t      e_shentsize;
+  uint16_t      e_shnum;
+  uint16_t      e_shstrndx;
+} Elf64_Ehdr;
+
+typedef struct
+{
+  uint32_t p_type;
+  uint32_t p_flags;
+  uint64_t p_offset;
+  uint64_t p_vaddr;
+  uint64_t p_paddr;
+  uint64_t p_filesz;
+  uint64_t p_memsz;
+  uint64_t p_align;
+} Elf64_Phdr;
+
+typedef struct
+{
+  int64_t d_tag;
+  uint64_t d_val;
+} Elf64_Dyn;
+
+typedef struct
+{
+  uint32_t      st_name;
+  unsigned char st_info;
+  unsigned char st_other;
+  uint16_t      st_shndx;
+  uint64_t      st_value;
+  uint64_t      st_size;
+} Elf64_Sym;
+
+typedef struct
+{
+  uint32_t n_namesz;
+  uint32_t n_descsz;
+  uint32_t n_type;
+} Elf64_Nhdr;
+
+static inline int elf_check_header(const Elf64_Ehdr* eh)
+{
+  return eh->e_ident[0] == ELFMAG0 && eh->e_ident[1] == ELFMAG1 && eh->e_ident[2] == ELFMAG2 &&
+         eh->e_ident[3] == ELFMAG3 && eh->e_ident[4] == ELFCLASS64 &&
+         eh->e_ident[5] == ELFDATA2LSB && eh->e_machine == EM_X86_64;
+}
+
+#endif
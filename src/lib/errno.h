@@ -0,0 +1,34 @@
+#ifndef LIB_ERRNO_H
+#define LIB_ERRNO_H
+
+/* Error numbers, with the Linux values so results can be passed to user
+   space unchanged. Kernel interfaces that report them return -E*. */
+
+#define EPERM        1
+#define ENOENT       2
+#define EIO          5
+#define E2BIG        7
+#define ENOEXEC      8
+#define EBADF        9
+#define EAGAIN       11
+#define ENOMEM       12
+#define EFAULT       14
+#define EBUSY        16
+#define EEXIST       17
+#define ENODEV       19
+#define ENOTDIR      20
+#define EISDIR       21
+#define EINVAL       22
+#define EMFILE       24
+#define ENOTTY       25
+#define ESPIPE       29
+#define EROFS        30
+#define EPIPE        32
+#define ERANGE       34
+#define ENAMETOOLONG 36
+#define ENOSYS       38
+#define ETIME        62
+#define ETIMEDOUT    110
+#define ECANCELED    125
+
+#endif
@@ -1,5 +1,10 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_STDIO
+/* the kernel is built without SSE or x87 code: integer decoders only */
+#define STBI_NO_SIMD
+#define STBI_NO_HDR
+#define STBI_NO_LINEAR
+#define STBI_NO_PSD
 /* use our kmalloc/kfree */
 #define STBI_MALLOC(x) kmalloc(x)
 #define STBI_FREE(x) kfree(x)
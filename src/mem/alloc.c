@@ -1,10 +1,14 @@
 #include "alloc.h"
+#include "multitasking/spinlock.h"
 #include <stddef.h>
 #include <stdint.h>
 
 /* very small bump allocator with size header so we can implement realloc */
 unsigned char heap[8 * 1024 * 1024] __attribute__((section(".bss"), aligned(16)));
 static size_t heap_off = 0;
+/* irqsave: with full preemption two tasks (or a task and a softirq) can
+   be in here at once and must not be handed the same block */
+static spinlock_t heap_lock = SPINLOCK_INIT;
 
 /* header stored immediately before the returned pointer */
 struct kmalloc_hdr
@@ -18,19 +22,25 @@ void* kmalloc(size_t size)
   size         = (size + 15) & ~15UL;
   size_t hdr   = (sizeof(struct kmalloc_hdr) + 15) & ~15UL;
   size_t total = hdr + size;
+  uint64_t flags = spin_lock_irqsave(&heap_lock);
   if (heap_off + total > sizeof(heap))
+  {
+    spin_unlock_irqrestore(&heap_lock, flags);
     return NULL;
+  }
   struct kmalloc_hdr* h = (struct kmalloc_hdr*) &heap[heap_off];
   h->size               = size;
   void* r               = (void*) ((unsigned char*) h + hdr);
   heap_off += total;
+  size_t off = heap_off;
+  spin_unlock_irqrestore(&heap_lock, flags);
   // Debug output: print heap address and offset
   extern void serial_puts(const char*);
   extern void serial_puthex64(uint64_t);
   serial_puts("kmalloc: heap base = 0x");
   serial_puthex64((uint64_t) (uintptr_t) heap);
   serial_puts(", heap_off = 0x");
-  serial_puthex64((uint64_t) heap_off);
+  serial_puthex64((uint64_t) off);
   serial_puts(", returned ptr = 0x");
   serial_puthex64((uint64_t) (uintptr_t) r);
   serial_puts("\n");
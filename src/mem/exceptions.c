@@ -1,11 +1,42 @@
 #include "serial/serial.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/scheduler.h"
+#include "sys/thread.h"
 
-void page_fault_handler(uint64_t error_code, uint64_t faulting_address)
+// Called from __isr_stub_14; returning resumes at *rip, the faulting
+// instruction unless a fixup moved it
+void page_fault_handler(uint64_t error_code, uint64_t faulting_address, uint64_t cs, uint64_t* rip)
 {
+    // Demand paging: first touch of a mapped range, or a copy-on-write
+    if (mm_handle_fault(faulting_address, error_code) == 0)
+        return;
+
+    // A user copy hit a bad pointer: the copy returns short instead
+    if (!(cs & 3) && uaccess_fixup(rip))
+        return;
+
+    if (cs & 3)
+    {
+        // A bad access from user mode only takes down the process
+        serial_puts("segfault: pid ");
+        serial_putdec(scheduler_get_current());
+        serial_puts(" at 0x");
+        serial_puthex64(faulting_address);
+        serial_puts(" (error=0x");
+        serial_puthex64(error_code);
+        serial_puts(")\n");
+        __asm__ volatile ("sti");
+        thread_vfork_release();
+        scheduler_mark_dead(scheduler_get_current());
+        scheduler_yield();
+        while (1) __asm__ volatile ("hlt");
+    }
+
     serial_puts("PAGE FAULT at 0x");
     serial_puthex64(faulting_address);
     serial_puts(" (error=0x");
     serial_puthex64(error_code);
     serial_puts(")\nHalting.\n");
     while (1) __asm__ volatile ("hlt");
-}
\ No newline at end of file
+}
@@ -0,0 +1,459 @@
+#include "mem/mm.h"
+#include "boot/cpu.h"
+#include "fs/inode.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/paging.h"
+#include "multitasking/preempt.h"
+#include "serial/serial.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* #PF error code bits */
+#define PF_PRESENT 0x1
+#define PF_WRITE   0x2
+#define PF_INSTR   0x10
+
+#define CR0_WP (1ULL << 16) /* supervisor writes honour read-only PTEs */
+
+#define PAGE_SIZE 0x1000ULL
+#define PAGE_UP(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+struct mm              init_mm;
+static struct mm*      loaded_mm = &init_mm;
+static struct mm_stats stats;
+
+static inline uint64_t read_cr3(void)
+{
+  uint64_t cr3;
+  asm volatile("mov %%cr3, %0" : "=r"(cr3));
+  return cr3;
+}
+
+static inline void write_cr3(uint64_t cr3)
+{
+  asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+void mm_init(void)
+{
+  /* copy-on-write has to hold against the kernel too: a read() into a
+     page lent to a pipe must fault and copy, not scribble on the pipe */
+  uint64_t cr0;
+  asm volatile("mov %%cr0, %0" : "=r"(cr0));
+  asm volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_WP) : "memory");
+
+  init_mm.pml4_phys = read_cr3();
+  init_mm.refcount  = 1; /* held by the kernel for good */
+  init_mm.vmas      = NULL;
+  init_mm.brk_start = init_mm.brk = 0;
+  loaded_mm         = &init_mm;
+  serial_puts("mm: init_mm cr3=");
+  serial_puthex64(init_mm.pml4_phys);
+}
+
+struct mm* mm_create(void)
+{
+  struct mm* mm = kmalloc(sizeof(*mm));
+  if (!mm)
+    return NULL;
+  mm->pml4_phys = paging_new_address_space();
+  if (!mm->pml4_phys)
+  {
+    kfree(mm);
+    return NULL;
+  }
+  mm->refcount  = 1;
+  mm->vmas      = NULL;
+  mm->brk_start = mm->brk = 0;
+  return mm;
+}
+
+static int user_range_ok(uint64_t start, uint64_t end)
+{
+  return start >= USER_BASE && start < end && end <= USER_STACK_TOP &&
+         (end <= USER_HOLE_START || start >= USER_HOLE_END);
+}
+
+static int add_vma(struct mm* mm, uint64_t start, uint64_t end, uint32_t prot,
+                   struct inode* inode, const uint8_t* file, uint64_t file_off, uint64_t file_end)
+{
+  if (((start | end | file_off) & (PAGE_SIZE - 1)) || !user_range_ok(start, end))
+    return -EINVAL;
+  struct vma*  prev = NULL;
+  struct vma** pp   = &mm->vmas;
+  while (*pp && (*pp)->end <= start)
+  {
+    prev = *pp;
+    pp   = &(*pp)->next;
+  }
+  if (*pp && (*pp)->start < end)
+    return -EINVAL;
+
+  /* a heap or mmap region growing upwards just extends its vma */
+  if (!inode && !file && prev && !prev->inode && !prev->file && prev->end == start &&
+      prev->prot == prot)
+  {
+    prev->end = end;
+    return 0;
+  }
+
+  struct vma* v = kmalloc(sizeof(*v));
+  if (!v)
+    return -ENOMEM;
+  v->start    = start;
+  v->end      = end;
+  v->prot     = prot;
+  v->inode    = inode;
+  v->file     = file;
+  v->file_off = file_off;
+  v->file_end = inode || file ? file_end : start;
+  v->next     = *pp;
+  *pp         = v;
+  return 0;
+}
+
+int mm_add_vma(struct mm* mm, uint64_t start, uint64_t end, uint32_t prot, const uint8_t* file,
+               uint64_t file_off, uint64_t file_end)
+{
+  return add_vma(mm, start, end, prot, NULL, file, file_off, file_end);
+}
+
+int mm_add_inode_vma(struct mm* mm, uint64_t start, uint64_t end, uint32_t prot,
+                     struct inode* inode, uint64_t file_off, uint64_t file_end)
+{
+  return add_vma(mm, start, end, prot, inode, NULL, file_off, file_end);
+}
+
+static struct vma* find_vma(struct mm* mm, uint64_t addr)
+{
+  for (struct vma* v = mm->vmas; v && v->start <= addr; v = v->next)
+    if (addr < v->end)
+      return v;
+  return NULL;
+}
+
+/* Drop the page table entries of [start, end); the pages themselves stay
+   with the kernel heap, which never frees */
+static void unmap_pages(uint64_t start, uint64_t end)
+{
+  for (uint64_t va = start; va < end; va += PAGE_SIZE)
+  {
+    uint64_t* pte = paging_lookup_pte(va);
+    if (pte && (*pte & PTE_PRESENT))
+    {
+      *pte = 0;
+      asm volatile("invlpg (%0)" : : "r"(va) : "memory");
+    }
+  }
+}
+
+int mm_munmap(struct mm* mm, uint64_t addr, uint64_t len)
+{
+  uint64_t end = PAGE_UP(addr + len);
+  if ((addr & (PAGE_SIZE - 1)) || len == 0 || end < addr || !user_range_ok(addr, end))
+    return -EINVAL;
+
+  /* other tasks sharing mm must not see a half-edited list */
+  preempt_disable();
+  struct vma** pp = &mm->vmas;
+  while (*pp && (*pp)->start < end)
+  {
+    struct vma* v = *pp;
+    if (v->end <= addr)
+    {
+      pp = &v->next;
+      continue;
+    }
+    if (addr > v->start && end < v->end)
+    {
+      /* punch a hole: the tail becomes a vma of its own */
+      struct vma* tail = kmalloc(sizeof(*tail));
+      if (!tail)
+      {
+        preempt_enable();
+        return -ENOMEM;
+      }
+      *tail = *v;
+      tail->start    = end;
+      tail->file_off = v->file_off + (end - v->start);
+      v->end         = addr;
+      v->next        = tail;
+      break;
+    }
+    if (addr <= v->start && end >= v->end)
+    {
+      *pp = v->next;
+      kfree(v);
+      continue;
+    }
+    if (addr <= v->start)
+    {
+      v->file_off += end - v->start;
+      v->start = end;
+    }
+    else
+      v->end = addr;
+    pp = &v->next;
+  }
+  preempt_enable();
+  if (mm == loaded_mm)
+    unmap_pages(addr, end);
+  return 0;
+}
+
+static int range_free(struct mm* mm, uint64_t start, uint64_t end)
+{
+  for (struct vma* v = mm->vmas; v && v->start < end; v = v->next)
+    if (v->end > start)
+      return 0;
+  return 1;
+}
+
+int64_t mm_mmap(struct mm* mm, uint64_t addr, uint64_t len, uint32_t prot, int fixed)
+{
+  uint64_t size = PAGE_UP(len);
+  if (len == 0 || size < len || (addr & (PAGE_SIZE - 1)))
+    return -EINVAL;
+  if (fixed)
+  {
+    if (!user_range_ok(addr, addr + size))
+      return -EINVAL;
+    int rc = mm_munmap(mm, addr, size);
+    if (rc < 0)
+      return rc;
+  }
+  else if (!addr || !user_range_ok(addr, addr + size) || !range_free(mm, addr, addr + size))
+  {
+    /* first fit above USER_MMAP_BASE */
+    addr = USER_MMAP_BASE;
+    for (struct vma* v = mm->vmas; v; v = v->next)
+    {
+      if (v->end <= addr)
+        continue;
+      if (v->start >= addr + size)
+        break;
+      addr = v->end;
+    }
+    if (!user_range_ok(addr, addr + size))
+      return -ENOMEM;
+  }
+
+  preempt_disable();
+  int rc = mm_add_vma(mm, addr, addr + size, prot, NULL, 0, 0);
+  preempt_enable();
+  return rc < 0 ? rc : (int64_t) addr;
+}
+
+uint64_t mm_brk(struct mm* mm, uint64_t addr)
+{
+  if (addr < mm->brk_start)
+    return mm->brk;
+  uint64_t old_end = PAGE_UP(mm->brk);
+  uint64_t new_end = PAGE_UP(addr);
+  if (new_end > old_end)
+  {
+    preempt_disable();
+    int rc = user_range_ok(old_end, new_end)
+                 ? mm_add_vma(mm, old_end, new_end, VMA_READ | VMA_WRITE, NULL, 0, 0)
+                 : -EINVAL;
+    preempt_enable();
+    if (rc < 0)
+      return mm->brk;
+  }
+  else if (new_end < old_end)
+    mm_munmap(mm, new_end, old_end - new_end);
+  mm->brk = addr;
+  return addr;
+}
+
+/* A zeroed page from the kernel heap; returns its kernel address */
+static uint8_t* page_alloc(uint64_t* phys)
+{
+  uint8_t* raw = kmalloc(2 * PAGE_SIZE);
+  if (!raw)
+    return NULL;
+  uint8_t* page = (uint8_t*) (((uintptr_t) raw + PAGE_SIZE - 1) & ~(uintptr_t) (PAGE_SIZE - 1));
+  memset(page, 0, PAGE_SIZE);
+  *phys = paging_get_phys((uint64_t) (uintptr_t) page);
+  return page;
+}
+
+int mm_handle_fault(uint64_t addr, uint64_t err)
+{
+  struct mm*  mm = loaded_mm;
+  struct vma* v  = find_vma(mm, addr);
+  if (!v)
+    return -1;
+  if ((err & PF_WRITE) && !(v->prot & VMA_WRITE))
+    return -1;
+  if ((err & PF_INSTR) && !(v->prot & VMA_EXEC))
+    return -1;
+
+  uint64_t  page  = addr & ~(PAGE_SIZE - 1);
+  uint64_t  flags = PTE_PRESENT | PTE_USER | ((v->prot & VMA_EXEC) ? 0 : PTE_NX);
+  uint64_t* pte   = paging_lookup_pte(page);
+  uint64_t  phys;
+  uint8_t*  copy;
+
+  if (pte && (*pte & PTE_PRESENT))
+  {
+    /* a write to a page still shared with the file image */
+    if (!(err & PF_WRITE) || !(*pte & PTE_COW))
+      return -1;
+    if (!(copy = page_alloc(&phys)))
+      return -1;
+    memcpy(copy, (const void*) page, PAGE_SIZE);
+    ++stats.cow_copies;
+    return paging_map_page(page, phys, flags | PTE_WRITABLE);
+  }
+
+  ++stats.faults;
+  const uint8_t* src = NULL;
+  if (page < v->file_end)
+  {
+    uint64_t off = v->file_off + (page - v->start);
+    if (v->inode && !(src = inode_page(v->inode, off / PAGE_SIZE)))
+      return -1;
+    if (v->file)
+      src = v->file + off;
+  }
+  if (src && page + PAGE_SIZE <= v->file_end)
+  {
+    /* a whole page of file data: share it, read-only until written */
+    if (!(v->prot & VMA_WRITE))
+    {
+      ++stats.shared_maps;
+      return paging_map_page(page, paging_get_phys((uint64_t) (uintptr_t) src), flags);
+    }
+    if (!(err & PF_WRITE))
+    {
+      ++stats.shared_maps;
+      return paging_map_page(page, paging_get_phys((uint64_t) (uintptr_t) src), flags | PTE_COW);
+    }
+  }
+
+  /* private page: zero-fill, plus whatever file data reaches into it */
+  if (!(copy = page_alloc(&phys)))
+    return -1;
+  if (src && page < v->file_end)
+  {
+    uint64_t n = v->file_end - page < PAGE_SIZE ? v->file_end - page : PAGE_SIZE;
+    memcpy(copy, src, n);
+    if (v->prot & VMA_WRITE)
+      ++stats.cow_copies;
+  }
+  return paging_map_page(page, phys, flags | ((v->prot & VMA_WRITE) ? PTE_WRITABLE : 0));
+}
+
+int mm_user_phys(uint64_t addr, uint64_t* phys)
+{
+  struct mm* mm = loaded_mm;
+  if (mm == &init_mm)
+  {
+    /* native tasks run on the kernel's tables with user-accessible pages;
+       anything else is kernel memory */
+    uint64_t* pte = paging_lookup_pte(addr & ~(PAGE_SIZE - 1));
+    if (!pte || (*pte & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER))
+      return -EFAULT;
+    *phys = (*pte & 0x000FFFFFFFFFF000ULL) | (addr & (PAGE_SIZE - 1));
+    return 0;
+  }
+  struct vma* v = find_vma(mm, addr);
+  if (!v)
+    return -EFAULT;
+  uint64_t  page  = addr & ~(PAGE_SIZE - 1);
+  uint64_t* pte   = paging_lookup_pte(page);
+  int       write = (v->prot & VMA_WRITE) != 0;
+  if (!pte || !(*pte & PTE_PRESENT))
+  {
+    if (mm_handle_fault(addr, write ? PF_WRITE : 0) < 0)
+      return -EFAULT;
+  }
+  else if (write && (*pte & PTE_COW))
+  {
+    if (mm_handle_fault(addr, PF_PRESENT | PF_WRITE) < 0)
+      return -EFAULT;
+  }
+  pte   = paging_lookup_pte(page);
+  *phys = (*pte & 0x000FFFFFFFFFF000ULL) | (addr & (PAGE_SIZE - 1));
+  return 0;
+}
+
+const uint8_t* mm_lend_page(uint64_t addr)
+{
+  struct mm* mm = loaded_mm;
+  if ((addr & (PAGE_SIZE - 1)) || mm == &init_mm || !find_vma(mm, addr))
+    return NULL;
+  uint64_t* pte = paging_lookup_pte(addr);
+  if (!pte || (*pte & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER))
+    return NULL;
+  if (*pte & PTE_WRITABLE)
+  {
+    /* the owner's next write copies the page; ours stays as it is now */
+    *pte = (*pte & ~PTE_WRITABLE) | PTE_COW;
+    asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    ++stats.pages_lent;
+  }
+  return paging_phys_to_virt(*pte & 0x000FFFFFFFFFF000ULL);
+}
+
+void mm_get(struct mm* mm)
+{
+  if (!mm)
+    return;
+  uint64_t flags = irq_save();
+  ++mm->refcount;
+  irq_restore(flags);
+}
+
+void mm_put(struct mm* mm)
+{
+  if (!mm)
+    return;
+  uint64_t flags = irq_save();
+  int      last  = --mm->refcount == 0;
+  irq_restore(flags);
+  if (!last || mm == &init_mm)
+    return;
+  /* nothing can have it loaded: whoever ran on it held a reference */
+  serial_puts("mm: freeing address space\n");
+  while (mm->vmas)
+  {
+    struct vma* v = mm->vmas;
+    mm->vmas      = v->next;
+    kfree(v);
+  }
+  kfree(mm);
+}
+
+struct mm* mm_loaded(void)
+{
+  return loaded_mm;
+}
+
+void mm_activate(struct mm* mm)
+{
+  if (mm == loaded_mm)
+  {
+    ++stats.cr3_avoided;
+    return;
+  }
+  write_cr3(mm->pml4_phys);
+  loaded_mm = mm;
+  ++stats.cr3_loads;
+}
+
+void mm_note_avoided(int lazy)
+{
+  ++stats.cr3_avoided;
+  if (lazy)
+    ++stats.lazy_borrows;
+}
+
+void mm_get_stats(struct mm_stats* out)
+{
+  if (out)
+    *out = stats;
+}
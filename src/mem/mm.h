@@ -0,0 +1,126 @@
+#ifndef MEM_MM_H
+#define MEM_MM_H
+
+#include <stdint.h>
+
+/* User address space layout for processes (mm_create). The first GiB and
+   everything from 4 GiB to the stack are free for mappings; 1-4 GiB is the
+   kernel's identity map of low memory. The vvar/vDSO pages sit above the
+   stack (vdso/vvar.h). */
+#define USER_BASE        0x1000ULL
+#define USER_HOLE_START  0x40000000ULL
+#define USER_HOLE_END    0x100000000ULL
+#define USER_STACK_TOP   0x00007FFFFFE00000ULL
+#define USER_STACK_SIZE  (8ULL * 1024 * 1024)
+/* mmap without a fixed address places mappings first-fit from here */
+#define USER_MMAP_BASE   0x00007F0000000000ULL
+
+#define VMA_READ  0x1
+#define VMA_WRITE 0x2
+#define VMA_EXEC  0x4
+
+/* A mapped range, populated page by page on first touch. File-backed
+   ranges take their pages from the inode's page cache (fs/inode.h), or
+   point into a page-aligned in-memory file image for filesystems without
+   page access: read-only ones map those pages directly, so every process
+   running the same file shares them, and writable ones map them
+   copy-on-write. Past file_end (and for anonymous ranges) pages are
+   demand-zero. */
+struct inode;
+struct vma
+{
+  struct vma*    next;
+  uint64_t       start, end; /* page-aligned, end exclusive */
+  uint32_t       prot;       /* VMA_* */
+  struct inode*  inode;      /* page-cache backed file, or NULL */
+  const uint8_t* file;       /* in-memory file image, or NULL */
+  uint64_t       file_off;   /* file offset mapped at start (page-aligned) */
+  uint64_t       file_end;   /* user address where the file data stops */
+};
+
+/* An address space: the PML4 loaded into CR3 plus a reference count.
+   User tasks own one; kernel threads have none and run on whichever
+   address space is already loaded ("lazy TLB"), pinning it with a
+   reference while they borrow it. */
+struct mm
+{
+  uint64_t    pml4_phys; /* CR3 value */
+  int         refcount;
+  struct vma* vmas;      /* sorted by start */
+  uint64_t    brk_start; /* heap: [brk_start, brk), grown by mm_brk */
+  uint64_t    brk;
+};
+
+struct mm_stats
+{
+  uint64_t cr3_loads;    /* switches that had to write CR3 */
+  uint64_t cr3_avoided;  /* switches that kept the loaded address space */
+  uint64_t lazy_borrows; /* of those, kernel threads borrowing an mm */
+  uint64_t faults;       /* pages populated on demand */
+  uint64_t cow_copies;   /* of those, private copies made on a write */
+  uint64_t shared_maps;  /* of those, file pages mapped without a copy */
+  uint64_t pages_lent;   /* writable pages made copy-on-write by mm_lend_page */
+};
+
+/* The boot address space (kernel + identity map); never freed */
+extern struct mm init_mm;
+
+void mm_init(void);
+
+/* New process address space (refcount 1) with nothing mapped in the user
+   half; NULL if out of memory */
+struct mm* mm_create(void);
+
+/* Add [start, end) to mm; fails with -EINVAL if the range is misaligned,
+   outside user space or overlaps an existing vma */
+int mm_add_vma(struct mm* mm, uint64_t start, uint64_t end, uint32_t prot, const uint8_t* file,
+               uint64_t file_off, uint64_t file_end);
+/* Same, backed by the page cache of inode (which is kept for good) */
+int mm_add_inode_vma(struct mm* mm, uint64_t start, uint64_t end, uint32_t prot,
+                     struct inode* inode, uint64_t file_off, uint64_t file_end);
+
+/* The calls below change the mappings of mm, which must be the loaded
+   address space: pages they drop are unmapped through the live tables. */
+
+/* Move the heap end to addr (pages added or removed as needed); returns
+   the new end, or the old one if addr is out of range */
+uint64_t mm_brk(struct mm* mm, uint64_t addr);
+
+/* Anonymous zero-fill mapping of len bytes. With fixed, exactly at addr
+   (replacing what was there); otherwise at addr if that range is free,
+   else wherever it fits. Returns the address or -errno. */
+int64_t mm_mmap(struct mm* mm, uint64_t addr, uint64_t len, uint32_t prot, int fixed);
+
+/* Remove [addr, addr + len) from mm, splitting vmas that straddle it */
+int mm_munmap(struct mm* mm, uint64_t addr, uint64_t len);
+
+/* Page fault on addr in the loaded address space (error code err from the
+   CPU); returns 0 once the page is mapped, -1 if the access is invalid */
+int mm_handle_fault(uint64_t addr, uint64_t err);
+
+/* Physical address behind user address addr in the loaded address space,
+   faulting the page in first. A writable page is made private (any
+   copy-on-write is broken now) so addr keeps this page. 0 or -EFAULT. */
+int mm_user_phys(uint64_t addr, uint64_t* phys);
+
+/* Kernel address of the page-aligned user page at addr in the loaded
+   address space, frozen as it is now: a writable page becomes copy-on-write,
+   so the process sees its own writes from then on and the caller keeps the
+   old contents. NULL unless the page is present in a process mapping. */
+const uint8_t* mm_lend_page(uint64_t addr);
+
+void mm_get(struct mm* mm);
+void mm_put(struct mm* mm);
+
+/* Address space currently loaded in CR3 */
+struct mm* mm_loaded(void);
+
+/* Load mm into CR3 unless it already is; interrupts must be disabled */
+void mm_activate(struct mm* mm);
+
+/* Account a switch that kept the loaded address space */
+void mm_note_avoided(int lazy);
+
+void mm_get_stats(struct mm_stats* out);
+
+#endif
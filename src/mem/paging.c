@@ -1,6 +1,7 @@
 
 #include "paging.h"
 #include "alloc.h"
+#include "multitasking/preempt.h"
 #include "serial/serial.h"
 #include "utils/log.h"
 #include <stddef.h>
@@ -28,7 +29,7 @@ void paging_mark_heap_mapped(void) {
 
 /* Recursive paging constants */
 #define PML4_RECURSIVE_INDEX 510ULL
-#define PML4_RECURSIVE_VADDR 0xFFFFFF7FBFC00000ULL /* PML4[510] → PML4 itself */
+#define PML4_RECURSIVE_VADDR 0xFFFFFF7FBFDFE000ULL /* PML4[510] → PML4 itself */
 
 /* Invalidate TLB for one page */
 static inline void invlpg(void* addr)
@@ -142,7 +143,12 @@ void paging_init(void)
   log("paging_init: done");
 }
 
-/* Helper to get recursive entry for a given level */
+/* Helpers to reach the tables through the recursive slot: every pass
+   through PML4[510] strips one level off the walk. The addresses are
+   canonical because index 510 sets bit 47. */
+#define RECURSIVE_SIGN 0xFFFF000000000000ULL
+#define RECURSIVE_R    PML4_RECURSIVE_INDEX
+
 static inline uint64_t* get_pml4(void)
 {
   return (uint64_t*) PML4_RECURSIVE_VADDR;
@@ -152,7 +158,8 @@ static inline uint64_t* get_pml4(void)
 static inline uint64_t* get_pdpt(uint64_t vaddr)
 {
   uint64_t pml4_idx = (vaddr >> 39) & 0x1FF;
-  return (uint64_t*) (0xFFFFFF7F4000000000ULL | (pml4_idx << 39));
+  return (uint64_t*) (RECURSIVE_SIGN | (RECURSIVE_R << 39) | (RECURSIVE_R << 30) |
+                      (RECURSIVE_R << 21) | (pml4_idx << 12));
 }
 
 /* Get PD for a given vaddr */
@@ -160,7 +167,8 @@ static inline uint64_t* get_pd(uint64_t vaddr)
 {
   uint64_t pml4_idx = (vaddr >> 39) & 0x1FF;
   uint64_t pdpt_idx = (vaddr >> 30) & 0x1FF;
-  return (uint64_t*) (0xFFFFFF7F0000000000ULL | (pml4_idx << 39) | (pdpt_idx << 30));
+  return (uint64_t*) (RECURSIVE_SIGN | (RECURSIVE_R << 39) | (RECURSIVE_R << 30) |
+                      (pml4_idx << 21) | (pdpt_idx << 12));
 }
 
 /* Get PT for a given vaddr */
@@ -169,8 +177,8 @@ static inline uint64_t* get_pt(uint64_t vaddr)
   uint64_t pml4_idx = (vaddr >> 39) & 0x1FF;
   uint64_t pdpt_idx = (vaddr >> 30) & 0x1FF;
   uint64_t pd_idx   = (vaddr >> 21) & 0x1FF;
-  return (uint64_t*) (0xFFFFFF7E0000000000ULL | (pml4_idx << 39) | (pdpt_idx << 30) |
-                      (pd_idx << 21));
+  return (uint64_t*) (RECURSIVE_SIGN | (RECURSIVE_R << 39) | (pml4_idx << 30) | (pdpt_idx << 21) |
+                      (pd_idx << 12));
 }
 
 /* Set the USER bit (bit 2) on all 4KiB pages covering the range [va, va+size) */
@@ -201,6 +209,8 @@ int paging_set_user(void* va, size_t size)
       serial_puts("\n");
       return -1;
     }
+    /* ring 3 needs the U bit at every level of the walk */
+    pml4[pml4_idx] |= 0x4;
 
     uint64_t* pdpt  = get_pdpt(addr);
     uint64_t  pdpte = pdpt[pdpt_idx];
@@ -211,11 +221,11 @@ int paging_set_user(void* va, size_t size)
       serial_puts("\n");
       return -1;
     }
+    pdpt[pdpt_idx] |= 0x4;  // set U bit
 
     /* 1 GiB page */
     if (pdpte & (1ULL << 7))
     {
-      pdpt[pdpt_idx] |= 0x4;  // set U bit
       invlpg((void*) addr);
       continue;
     }
@@ -229,11 +239,11 @@ int paging_set_user(void* va, size_t size)
       serial_puts("\n");
       return -1;
     }
+    pd[pd_idx] |= 0x4;  // set U bit
 
     /* 2 MiB page */
     if (pde & (1ULL << 7))
     {
-      pd[pd_idx] |= 0x4;  // set U bit
       invlpg((void*) addr);
       continue;
     }
@@ -344,8 +354,47 @@ uint64_t alloc_page(void)
   return phys;
 }
 
-/* Map kernel virtual address range to user virtual address range */
-int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size)
+/* Table pages for a user mapping; entries above the leaf get P + W + U so
+   the leaf flags alone decide what ring 3 may do */
+static uint64_t* new_table(uint64_t* entry)
+{
+  uint64_t new_phys = alloc_page();
+  if (!new_phys)
+    return NULL;
+  memset(PHYS_TO_VIRT(new_phys), 0, 0x1000);
+  *entry = new_phys | 0x7;
+  return entry;
+}
+
+/* PTE for va in the loaded address space. With create, missing tables are
+   allocated; otherwise NULL if any level is absent. Huge pages are never
+   user mappings, so they also give NULL. */
+static uint64_t* walk(uint64_t va, int create)
+{
+  uint64_t* pml4     = get_pml4();
+  uint64_t  pml4_idx = (va >> 39) & 0x1FF;
+  uint64_t  pdpt_idx = (va >> 30) & 0x1FF;
+  uint64_t  pd_idx   = (va >> 21) & 0x1FF;
+  uint64_t  pt_idx   = (va >> 12) & 0x1FF;
+
+  if (!(pml4[pml4_idx] & 1) && (!create || !new_table(&pml4[pml4_idx])))
+    return NULL;
+  uint64_t* pdpt = get_pdpt(va);
+  if (!(pdpt[pdpt_idx] & 1) && (!create || !new_table(&pdpt[pdpt_idx])))
+    return NULL;
+  if (pdpt[pdpt_idx] & (1ULL << 7))
+    return NULL;
+  uint64_t* pd = get_pd(va);
+  if (!(pd[pd_idx] & 1) && (!create || !new_table(&pd[pd_idx])))
+    return NULL;
+  if (pd[pd_idx] & (1ULL << 7))
+    return NULL;
+  return &get_pt(va)[pt_idx];
+}
+
+/* Map user_va to the frames behind kernel_va; leaf_flags always include
+   Present + User, Writable only for read/write mappings */
+static int map_user_range(uint64_t user_va, uint64_t kernel_va, size_t size, uint64_t leaf_flags)
 {
   if (user_va == 0 || kernel_va == 0 || size == 0 || (user_va & 0xFFF) != 0 ||
       (kernel_va & 0xFFF) != 0)
@@ -354,8 +403,6 @@ int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size)
     return -1;
   }
 
-  uint64_t* pml4 = get_pml4();
-
   for (uint64_t offset = 0; offset < size; offset += 0x1000)
   {
     uint64_t dst_va = user_va + offset;
@@ -370,58 +417,13 @@ int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size)
       return -1;
     }
 
-    uint64_t pml4_idx = (dst_va >> 39) & 0x1FF;
-    uint64_t pdpt_idx = (dst_va >> 30) & 0x1FF;
-    uint64_t pd_idx   = (dst_va >> 21) & 0x1FF;
-    uint64_t pt_idx   = (dst_va >> 12) & 0x1FF;
-
-    // PML4E
-    if (!(pml4[pml4_idx] & 1))
+    uint64_t* pte = walk(dst_va, 1);
+    if (!pte)
     {
-      uint64_t new_phys = alloc_page();
-      if (!new_phys)
-      {
-        serial_puts("paging_map_user_va: alloc failed for PML4E\n");
-        return -1;
-      }
-      memset(PHYS_TO_VIRT(new_phys), 0, 0x1000);
-      pml4[pml4_idx] = new_phys | 0x7;  // P + W + U
-      invlpg((void*) dst_va);
-    }
-
-    // PDPTE
-    uint64_t* pdpt = get_pdpt(dst_va);
-    if (!(pdpt[pdpt_idx] & 1))
-    {
-      uint64_t new_phys = alloc_page();
-      if (!new_phys)
-      {
-        serial_puts("paging_map_user_va: alloc failed for PDPTE\n");
-        return -1;
-      }
-      memset(PHYS_TO_VIRT(new_phys), 0, 0x1000);
-      pdpt[pdpt_idx] = new_phys | 0x7;
-      invlpg((void*) dst_va);
-    }
-
-    // PDE
-    uint64_t* pd = get_pd(dst_va);
-    if (!(pd[pd_idx] & 1))
-    {
-      uint64_t new_phys = alloc_page();
-      if (!new_phys)
-      {
-        serial_puts("paging_map_user_va: alloc failed for PDE\n");
-        return -1;
-      }
-      memset(PHYS_TO_VIRT(new_phys), 0, 0x1000);
-      pd[pd_idx] = new_phys | 0x7;
-      invlpg((void*) dst_va);
+      serial_puts("paging_map_user_va: alloc failed for page tables\n");
+      return -1;
     }
-
-    // PTE – final mapping, user accessible
-    uint64_t* pt = get_pt(dst_va);
-    pt[pt_idx]   = phys | 0x7;  // Present + Writable + User
+    *pte = phys | leaf_flags;
     invlpg((void*) dst_va);
 
     // Optional: per-page debug (remove in production)
@@ -434,6 +436,66 @@ int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size)
 
   return 0;
 }
+int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size)
+{
+  return map_user_range(user_va, kernel_va, size, 0x7);  // Present + Writable + User
+}
+
+int paging_map_user_va_ro(uint64_t user_va, uint64_t kernel_va, size_t size)
+{
+  return map_user_range(user_va, kernel_va, size, 0x5);  // Present + User
+}
+
+int paging_map_page(uint64_t va, uint64_t phys, uint64_t flags)
+{
+  uint64_t* pte = walk(va, 1);
+  if (!pte)
+    return -1;
+  *pte = (phys & ~0xFFFULL) | flags;
+  invlpg((void*) va);
+  return 0;
+}
+
+uint64_t* paging_lookup_pte(uint64_t va)
+{
+  return walk(va, 0);
+}
+
+uint64_t paging_new_address_space(void)
+{
+  uint64_t pml4_phys = alloc_page();
+  uint64_t pdpt_phys = alloc_page();
+  if (!pml4_phys || !pdpt_phys)
+    return 0;
+  uint64_t* pml4 = PHYS_TO_VIRT(pml4_phys);
+  uint64_t* pdpt = PHYS_TO_VIRT(pdpt_phys);
+  memset(pml4, 0, 0x1000);
+  memset(pdpt, 0, 0x1000);
+
+  /* The kernel half is shared as is; the recursive slot points at the new
+     table itself */
+  uint64_t* cur = get_pml4();
+  for (int i = 256; i < 512; ++i)
+    pml4[i] = cur[i];
+  pml4[PML4_RECURSIVE_INDEX] = pml4_phys | 0x3;
+
+  /* Low memory: keep the identity map from 1 GiB up (LAPIC and other MMIO
+     the kernel reaches through it) but leave the first GiB to the process */
+  if (cur[0] & 1)
+  {
+    uint64_t* cur_pdpt = get_pdpt(0);
+    for (int i = 1; i < 512; ++i)
+      pdpt[i] = cur_pdpt[i];
+  }
+  pml4[0] = pdpt_phys | 0x7;
+  return pml4_phys;
+}
+
+void* paging_phys_to_virt(uint64_t phys)
+{
+  return PHYS_TO_VIRT(phys);
+}
+
 void paging_identity_map_kernel_heap(void)
 {
   serial_puts("[DEBUG] paging_identity_map_kernel_heap: start\n");
@@ -487,6 +549,7 @@ void paging_identity_map_kernel_heap(void)
     pt_va[pt_idx]   = pa | 0x3;  // Present + Writable
     invlpg((void*) va);
     serial_puts("[DEBUG] heap: mapped\n");
+    cond_resched(); /* 2048 pages, each logged over the UART */
   }
   serial_puts("[DEBUG] paging_identity_map_kernel_heap: end\n");
 }
@@ -9,7 +9,30 @@ int paging_set_user(void *va, size_t size);
 uint64_t paging_get_phys(uint64_t va);
 uint64_t alloc_page(void);
 int paging_map_user_va(uint64_t user_va, uint64_t kernel_va, size_t size);
+/* Same, but user mode can only read (and execute) the pages */
+int paging_map_user_va_ro(uint64_t user_va, uint64_t kernel_va, size_t size);
 void paging_map_kernel_va(uint64_t kernel_va, size_t size);
+
+/* Leaf PTE bits beyond the hardware ones */
+#define PTE_PRESENT  0x1ULL
+#define PTE_WRITABLE 0x2ULL
+#define PTE_USER     0x4ULL
+#define PTE_COW      0x200ULL /* software bit: read-only until the first write */
+#define PTE_NX       (1ULL << 63)
+
+/* The following work on the address space loaded in CR3 */
+/* Map one 4 KiB page (va and phys page-aligned), allocating tables */
+int paging_map_page(uint64_t va, uint64_t phys, uint64_t flags);
+/* Leaf PTE for va, or NULL if no page table covers it */
+uint64_t* paging_lookup_pte(uint64_t va);
+
+/* New PML4 sharing the kernel half with the loaded one; returns its
+   physical address, 0 on failure. User space gets the first GiB and
+   everything from 4 GiB up; 1-4 GiB stays the kernel's identity map. */
+uint64_t paging_new_address_space(void);
+/* Kernel address of a kernel-heap page given its physical address (user
+   pages all come from the heap) */
+void* paging_phys_to_virt(uint64_t phys);
 void paging_identity_map_kernel_heap(void);
 
 // Inline helpers for page table walking (must match paging.c)
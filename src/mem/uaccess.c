@@ -0,0 +1,120 @@
+#include "mem/uaccess.h"
+#include "boot/cpu.h"
+#include "lib/errno.h"
+#include "mem/paging.h"
+#include "multitasking/scheduler.h"
+#include "serial/serial.h"
+
+#define PAGE_SIZE 0x1000ULL
+
+struct ex_entry
+{
+  uint64_t insn;
+  uint64_t fixup;
+};
+
+/* linker.ld gathers every __ex_table section between these */
+extern const struct ex_entry _ex_table_start[], _ex_table_end[];
+
+extern long __strncpy_from_user(char* dst, const char* src, long count);
+extern long __get_user_u32(uint32_t* dst, const uint32_t* src);
+
+/* read by __copy_user */
+uint8_t uaccess_erms;
+
+void uaccess_init(void)
+{
+  uint32_t a, b, c, d;
+  cpuid(0, 0, &a, &b, &c, &d);
+  if (a >= 7)
+  {
+    cpuid(7, 0, &a, &b, &c, &d);
+    uaccess_erms = (b & CPUID7_EBX_ERMS) != 0;
+  }
+  serial_puts(uaccess_erms ? "uaccess: rep movsb copies (ERMS)\n"
+                           : "uaccess: rep movsq copies\n");
+}
+
+/* Bytes from addr, up to len, that the calling task may hand the kernel.
+   A task with its own mm owns the user half; ring-3 code on the kernel's
+   tables owns only the pages mapped user-accessible there (mm_user_phys
+   applies the same rule); kernel threads pass kernel buffers. */
+static uint64_t user_span(uint64_t addr, uint64_t len)
+{
+  if (scheduler_get_mm())
+  {
+    if (addr >= USER_SPACE_END)
+      return 0;
+    return len < USER_SPACE_END - addr ? len : USER_SPACE_END - addr;
+  }
+  if (!scheduler_is_user())
+    return len;
+  uint64_t done = 0;
+  while (done < len)
+  {
+    uint64_t  va  = addr + done;
+    uint64_t* pte = va < addr ? NULL : paging_lookup_pte(va & ~(PAGE_SIZE - 1));
+    if (!pte || (*pte & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER))
+      break;
+    done += PAGE_SIZE - (va & (PAGE_SIZE - 1));
+  }
+  return done < len ? done : len;
+}
+
+int access_ok(const void* p, uint64_t len)
+{
+  uint64_t addr = (uint64_t) (uintptr_t) p;
+  return addr + len >= addr && user_span(addr, len) == len;
+}
+
+uint64_t copy_from_user(void* dst, const void* usrc, uint64_t len)
+{
+  if (!access_ok(usrc, len))
+    return len;
+  return __copy_user(dst, usrc, len);
+}
+
+uint64_t copy_to_user(void* udst, const void* src, uint64_t len)
+{
+  if (!access_ok(udst, len))
+    return len;
+  return __copy_user(udst, src, len);
+}
+
+uint64_t clear_user(void* udst, uint64_t len)
+{
+  if (!access_ok(udst, len))
+    return len;
+  return __clear_user(udst, len);
+}
+
+long strncpy_from_user(char* dst, const char* usrc, long count)
+{
+  uint64_t addr = (uint64_t) (uintptr_t) usrc;
+  if (count <= 0)
+    return 0;
+  /* the string may end well before count: only clip where the caller's
+     memory ends */
+  uint64_t span = user_span(addr, (uint64_t) count);
+  if (!span)
+    return -EFAULT;
+  return __strncpy_from_user(dst, usrc, (long) span);
+}
+
+int get_user_u32(uint32_t* val, const uint32_t* uaddr)
+{
+  if (!access_ok(uaddr, sizeof(*uaddr)))
+    return -EFAULT;
+  return (int) __get_user_u32(val, uaddr);
+}
+
+int uaccess_fixup(uint64_t* rip)
+{
+  for (const struct ex_entry* e = _ex_table_start; e < _ex_table_end; ++e)
+    if (e->insn == *rip)
+    {
+      *rip = e->fixup;
+      return 1;
+    }
+  return 0;
+}
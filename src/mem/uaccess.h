@@ -0,0 +1,55 @@
+#ifndef MEM_UACCESS_H
+#define MEM_UACCESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Copies between kernel memory and pointers a system call was handed.
+
+   The range is checked against the user half first (access_ok), and the
+   copy itself runs through rep movsb/stosb with an exception table entry:
+   if it faults on a page mm_handle_fault cannot populate, the page fault
+   handler resumes at the entry's fixup instead of halting, and the copy
+   returns short. With ERMS (enhanced rep movsb) the string instruction is
+   the fastest bulk copy there is; without it the copy moves qwords first.
+
+   Tasks without their own address space (ring-3 code built into the
+   kernel image, like sysbench) have no user half: only the pages mapped
+   user-accessible in the kernel's tables are theirs. Kernel threads pass
+   kernel buffers, which are taken as they are. */
+
+#define USER_SPACE_END 0x0000800000000000ULL /* first non-canonical address */
+
+#define CPUID7_EBX_ERMS (1U << 9)
+
+void uaccess_init(void);
+
+/* 1 if [p, p + len) lies in the calling task's user address range */
+int access_ok(const void* p, uint64_t len);
+
+/* These return the number of bytes NOT copied: 0 on success */
+uint64_t copy_from_user(void* dst, const void* usrc, uint64_t len);
+uint64_t copy_to_user(void* udst, const void* src, uint64_t len);
+uint64_t clear_user(void* udst, uint64_t len);
+
+/* Copy a NUL-terminated string of at most count bytes. Returns its length
+   (without the NUL); count if it did not end within count bytes, which
+   leaves dst unterminated; -EFAULT on a bad pointer. */
+long strncpy_from_user(char* dst, const char* usrc, long count);
+
+/* Read the 32-bit word at uaddr in one load: 0, or -EFAULT if it is not
+   a user address or faults */
+int get_user_u32(uint32_t* val, const uint32_t* uaddr);
+
+/* Unchecked variants for buffers whose range a system call already
+   checked: they only add fault recovery to a plain copy, so the file
+   layer can use them whether a read lands in a kernel or a user buffer */
+uint64_t __copy_user(void* dst, const void* src, uint64_t len);
+uint64_t __clear_user(void* dst, uint64_t len);
+
+/* Page fault in kernel mode that mm_handle_fault could not resolve: if
+   the faulting instruction has an exception table entry, point *rip at
+   its fixup and return 1 */
+int uaccess_fixup(uint64_t* rip);
+
+#endif
@@ -0,0 +1,148 @@
+#include "multitasking/async.h"
+#include "boot/cpu.h"
+#include "multitasking/workqueue.h"
+#include "time/clock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tasks polled per executor run before it re-queues itself, so a flood of
+   async work cannot starve ordinary work items on the same worker */
+#define ASYNC_BATCH 64
+
+static struct async_task* ready_head = NULL;
+static struct async_task* ready_tail = NULL;
+static struct async_stats stats;
+
+static void        executor_run(void* arg);
+static struct work executor_work = {NULL, executor_run, NULL, 0};
+
+/* must be called with interrupts disabled */
+static void ready_push(struct async_task* t)
+{
+  t->queued = 1;
+  t->next   = NULL;
+  if (ready_tail)
+    ready_tail->next = t;
+  else
+    ready_head = t;
+  ready_tail = t;
+  work_queue(&executor_work);
+}
+
+static void async_timer_fire(void* arg)
+{
+  async_wake((struct async_task*) arg);
+}
+
+static void async_wait_fire(struct wait_entry* e)
+{
+  async_wake((struct async_task*) e->priv);
+}
+
+void async_init(struct async_task* t, async_fn fn, async_done_fn on_done)
+{
+  t->next    = NULL;
+  t->fn      = fn;
+  t->on_done = on_done;
+  t->state   = 0;
+  t->queued  = 0;
+  t->done    = 0;
+  wait_entry_setup(&t->wait, async_wait_fire, t);
+  timer_setup(&t->timer, async_timer_fire, t);
+}
+
+void async_spawn(struct async_task* t)
+{
+  uint64_t flags = irq_save();
+  ++stats.spawned;
+  ++stats.in_flight;
+  if (!t->queued)
+    ready_push(t);
+  irq_restore(flags);
+}
+
+void async_wake(struct async_task* t)
+{
+  uint64_t flags = irq_save();
+  if (!t->queued && !t->done)
+    ready_push(t);
+  irq_restore(flags);
+}
+
+static void executor_run(void* arg)
+{
+  (void) arg;
+  for (int n = 0; n < ASYNC_BATCH; ++n)
+  {
+    uint64_t           flags = irq_save();
+    struct async_task* t     = ready_head;
+    if (!t)
+    {
+      irq_restore(flags);
+      break;
+    }
+    ready_head = t->next;
+    if (!ready_head)
+      ready_tail = NULL;
+    t->next   = NULL;
+    t->queued = 0; /* a wake from here on polls it again */
+    ++stats.polls;
+    irq_restore(flags);
+
+    if (t->fn(t) != ASYNC_DONE)
+      continue;
+
+    /* drop wakers that are still armed so they cannot requeue a freed frame */
+    timer_cancel(&t->timer);
+    waitqueue_remove(&t->wait);
+    flags   = irq_save();
+    t->done = 1;
+    ++stats.completed;
+    --stats.in_flight;
+    irq_restore(flags);
+    if (t->on_done)
+      t->on_done(t);
+  }
+  ++stats.executor_runs;
+
+  uint64_t flags = irq_save();
+  if (ready_head)
+    work_queue(&executor_work);
+  irq_restore(flags);
+}
+
+void async_arm_sleep(struct async_task* t, uint64_t ns)
+{
+  timer_arm(&t->timer, clock_now_ns() + ns);
+}
+
+void async_wait_on(struct async_task* t, struct waitqueue* wq)
+{
+  waitqueue_add(wq, &t->wait);
+}
+
+void async_wait_done(struct async_task* t)
+{
+  waitqueue_remove(&t->wait);
+}
+
+int async_completion_ready(struct async_task* t, struct completion* c)
+{
+  uint64_t flags = irq_save();
+  int      ready = c->done;
+  if (ready)
+    waitqueue_remove(&t->wait);
+  else
+    waitqueue_add(&c->wq, &t->wait);
+  irq_restore(flags);
+  return ready;
+}
+
+void async_get_stats(struct async_stats* out)
+{
+  if (!out)
+    return;
+  uint64_t flags = irq_save();
+  *out           = stats;
+  irq_restore(flags);
+}
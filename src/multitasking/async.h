@@ -0,0 +1,124 @@
+#ifndef MULTITASKING_ASYNC_H
+#define MULTITASKING_ASYNC_H
+
+#include "multitasking/waitqueue.h"
+#include "time/timer.h"
+#include <stdint.h>
+
+/* Stackless async kernel tasks.
+
+   An async task is a poll function plus a small frame (struct async_task
+   embedded at the start of the caller's own state struct) instead of a
+   32 KiB pair of stacks. The poll function is written as a resumable state
+   machine with the ASYNC_* macros below; each await stores a resume point
+   and returns ASYNC_PENDING after arming a waker. When the waker fires the
+   task goes back on the executor's ready list, and the executor (a work
+   item, so it runs on the existing workqueue threads) polls it again.
+
+   Locals do not survive an await: anything that must persist lives in the
+   frame struct. Poll functions must never block the thread. */
+
+#define ASYNC_PENDING 0
+#define ASYNC_DONE    1
+
+struct async_task;
+typedef int (*async_fn)(struct async_task*);
+typedef void (*async_done_fn)(struct async_task*);
+
+struct async_task
+{
+  struct async_task* next;    /* executor ready list */
+  async_fn           fn;
+  async_done_fn      on_done; /* optional, runs on the executor after DONE */
+  uint32_t           state;   /* resume point, 0 = start */
+  uint8_t            queued;
+  uint8_t            done;
+  struct wait_entry  wait;    /* waitqueue/completion waker */
+  struct timer       timer;   /* sleep waker */
+};
+
+struct async_stats
+{
+  uint64_t spawned;
+  uint64_t completed;
+  uint64_t polls;
+  uint64_t executor_runs;
+  uint64_t in_flight;
+};
+
+void async_init(struct async_task* t, async_fn fn, async_done_fn on_done);
+
+/* Make t runnable for the first time */
+void async_spawn(struct async_task* t);
+
+/* Put t back on the ready list; safe from IRQ/softirq context and cheap if
+   t is already queued */
+void async_wake(struct async_task* t);
+
+void async_get_stats(struct async_stats* out);
+
+/* Await helpers; use through the macros */
+void async_arm_sleep(struct async_task* t, uint64_t ns);
+void async_wait_on(struct async_task* t, struct waitqueue* wq);
+void async_wait_done(struct async_task* t);
+int  async_completion_ready(struct async_task* t, struct completion* c);
+
+#define ASYNC_BEGIN(t)                                                                             \
+  switch ((t)->state)                                                                              \
+  {                                                                                                \
+  case 0:
+
+#define ASYNC_END(t)                                                                               \
+  }                                                                                                \
+  (t)->state = 0;                                                                                  \
+  return ASYNC_DONE
+
+/* Give other async tasks a turn; resumes on the next executor pass */
+#define ASYNC_YIELD(t)                                                                             \
+  do                                                                                               \
+  {                                                                                                \
+    (t)->state = __LINE__;                                                                         \
+    async_wake(t);                                                                                 \
+    return ASYNC_PENDING;                                                                          \
+  case __LINE__:;                                                                                  \
+  } while (0)
+
+#define ASYNC_SLEEP_NS(t, ns)                                                                      \
+  do                                                                                               \
+  {                                                                                                \
+    async_arm_sleep((t), (ns));                                                                    \
+    (t)->state = __LINE__;                                                                         \
+    __attribute__((fallthrough));                                                                  \
+  case __LINE__:                                                                                   \
+    if (timer_pending(&(t)->timer))                                                                \
+      return ASYNC_PENDING;                                                                        \
+  } while (0)
+
+/* Wait until cond holds; whoever makes it true must wake wq. The waker is
+   queued before cond is re-checked, so a wake in between is not lost. */
+#define ASYNC_WAIT_EVENT(t, wq, cond)                                                              \
+  do                                                                                               \
+  {                                                                                                \
+    (t)->state = __LINE__;                                                                         \
+    __attribute__((fallthrough));                                                                  \
+  case __LINE__:                                                                                   \
+    if (!(cond))                                                                                   \
+    {                                                                                              \
+      async_wait_on((t), (wq));                                                                    \
+      if (!(cond))                                                                                 \
+        return ASYNC_PENDING;                                                                      \
+    }                                                                                              \
+    async_wait_done(t);                                                                            \
+  } while (0)
+
+#define ASYNC_AWAIT_COMPLETION(t, c)                                                               \
+  do                                                                                               \
+  {                                                                                                \
+    (t)->state = __LINE__;                                                                         \
+    __attribute__((fallthrough));                                                                  \
+  case __LINE__:                                                                                   \
+    if (!async_completion_ready((t), (c)))                                                         \
+      return ASYNC_PENDING;                                                                        \
+  } while (0)
+
+#endif
@@ -0,0 +1,349 @@
+#include "multitasking/futex.h"
+#include "boot/cpu.h"
+#include "lib/errno.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+struct futex_key
+{
+  uint64_t space; /* struct mm* for private keys, 0 for physical ones */
+  uint64_t addr;  /* virtual or physical address of the word */
+};
+
+struct futex_bucket;
+
+/* Lives on the waiting task's stack for the duration of futex_wait */
+struct futex_waiter
+{
+  struct futex_waiter* next;
+  struct futex_bucket* bucket; /* changes on requeue, under both locks */
+  struct futex_key     key;
+  uint32_t             bitset;
+  int                  tid;
+  struct timer*        timer; /* NULL without a deadline */
+  volatile int         woken;
+  volatile int         timed_out;
+};
+
+struct futex_bucket
+{
+  spinlock_t           lock;
+  struct futex_waiter* head; /* FIFO */
+};
+
+static struct futex_bucket buckets[FUTEX_HASH_SIZE];
+
+static int get_key(uint32_t* uaddr, int shared, struct futex_key* key)
+{
+  uint64_t addr = (uint64_t) (uintptr_t) uaddr;
+  if (addr & 3)
+    return -EINVAL;
+  if (!access_ok(uaddr, sizeof(*uaddr)))
+    return -EFAULT;
+  /* faults the word in; the reads under the bucket lock still go through
+     get_user_u32, as a sibling thread may unmap it meanwhile */
+  uint64_t phys;
+  if (mm_user_phys(addr, &phys) < 0)
+    return -EFAULT;
+  key->space = shared ? 0 : (uint64_t) (uintptr_t) mm_loaded();
+  key->addr  = shared ? phys : addr;
+  return 0;
+}
+
+static int key_eq(const struct futex_key* a, const struct futex_key* b)
+{
+  return a->space == b->space && a->addr == b->addr;
+}
+
+static struct futex_bucket* bucket_of(const struct futex_key* key)
+{
+  uint64_t h = (key->addr ^ (key->space >> 4)) * 0x9E3779B97F4A7C15ULL;
+  return &buckets[h >> (64 - FUTEX_HASH_BITS)];
+}
+
+/* bucket lock held */
+static void enqueue(struct futex_bucket* b, struct futex_waiter* w)
+{
+  struct futex_waiter** pp = &b->head;
+  while (*pp)
+    pp = &(*pp)->next;
+  w->next   = NULL;
+  w->bucket = b;
+  *pp       = w;
+}
+
+/* bucket lock held; returns 1 if w was still queued */
+static int dequeue(struct futex_bucket* b, struct futex_waiter* w)
+{
+  for (struct futex_waiter** pp = &b->head; *pp; pp = &(*pp)->next)
+    if (*pp == w)
+    {
+      *pp     = w->next;
+      w->next = NULL;
+      return 1;
+    }
+  return 0;
+}
+
+static void lock_pair(struct futex_bucket* a, struct futex_bucket* b)
+{
+  if (a == b)
+    spin_lock(&a->lock);
+  else if (a < b)
+  {
+    spin_lock(&a->lock);
+    spin_lock(&b->lock);
+  }
+  else
+  {
+    spin_lock(&b->lock);
+    spin_lock(&a->lock);
+  }
+}
+
+static void unlock_pair(struct futex_bucket* a, struct futex_bucket* b)
+{
+  spin_unlock(&a->lock);
+  if (a != b)
+    spin_unlock(&b->lock);
+}
+
+/* scheduler_mark_dead: interrupts are off, and no bucket lock can be held
+   as the killed task is not running */
+static void futex_cancel(void* arg)
+{
+  struct futex_waiter* w = arg;
+  if (w->timer)
+    timer_cancel(w->timer);
+  struct futex_bucket* b = w->bucket;
+  spin_lock(&b->lock);
+  dequeue(b, w);
+  spin_unlock(&b->lock);
+}
+
+/* timer softirq: interrupts are off */
+static void futex_timeout(void* arg)
+{
+  struct futex_waiter* w = arg;
+  w->timed_out           = 1;
+  scheduler_wake(w->tid);
+}
+
+int futex_wait(uint32_t* uaddr, uint32_t val, uint64_t deadline, uint32_t bitset, int shared)
+{
+  struct futex_key key;
+  if (!bitset)
+    return -EINVAL;
+  int rc = get_key(uaddr, shared, &key);
+  if (rc < 0)
+    return rc;
+
+  struct futex_waiter w;
+  w.key       = key;
+  w.bitset    = bitset;
+  w.tid       = scheduler_get_current();
+  w.woken     = 0;
+  w.timed_out = 0;
+  w.timer     = NULL;
+  struct timer t;
+  if (deadline)
+  {
+    timer_setup(&t, futex_timeout, &w);
+    w.timer = &t;
+  }
+
+  /* the compare and the enqueue happen under the bucket lock, and wakers
+     take it too, so a wake after the user's store cannot be missed */
+  struct futex_bucket* b = bucket_of(&key);
+  uint32_t             cur;
+  spin_lock(&b->lock);
+  if (get_user_u32(&cur, uaddr) < 0)
+  {
+    spin_unlock(&b->lock);
+    return -EFAULT;
+  }
+  if (cur != val)
+  {
+    spin_unlock(&b->lock);
+    return -EAGAIN;
+  }
+  enqueue(b, &w);
+  scheduler_set_wait_cancel(futex_cancel, &w);
+  uint64_t flags = irq_save();
+  scheduler_prepare_wait();
+  if (deadline)
+    timer_arm(&t, deadline);
+  irq_restore(flags);
+  spin_unlock(&b->lock);
+
+  for (;;)
+  {
+    scheduler_wait();
+    flags = irq_save();
+    if (w.woken || w.timed_out)
+    {
+      irq_restore(flags);
+      break;
+    }
+    /* someone else woke the task: keep waiting */
+    scheduler_prepare_wait();
+    irq_restore(flags);
+  }
+  if (deadline)
+    timer_cancel(&t);
+  scheduler_set_wait_cancel(NULL, NULL);
+  if (w.woken)
+    return 0;
+
+  /* timed out; a requeue may have moved us meanwhile */
+  for (;;)
+  {
+    b = w.bucket;
+    spin_lock(&b->lock);
+    if (b == w.bucket)
+      break;
+    spin_unlock(&b->lock);
+  }
+  int queued = dequeue(b, &w);
+  spin_unlock(&b->lock);
+  return queued ? -ETIMEDOUT : 0;
+}
+
+/* bucket lock held */
+static int wake_matching(struct futex_bucket* b, const struct futex_key* key, int nr, uint32_t bitset)
+{
+  int                   woken = 0;
+  struct futex_waiter** pp    = &b->head;
+  while (*pp && woken < nr)
+  {
+    struct futex_waiter* w = *pp;
+    if (!key_eq(&w->key, key) || !(w->bitset & bitset))
+    {
+      pp = &w->next;
+      continue;
+    }
+    *pp      = w->next;
+    w->next  = NULL;
+    w->woken = 1;
+    scheduler_wake(w->tid);
+    ++woken;
+  }
+  return woken;
+}
+
+int futex_wake(uint32_t* uaddr, int nr, uint32_t bitset, int shared)
+{
+  struct futex_key key;
+  if (!bitset)
+    return -EINVAL;
+  int rc = get_key(uaddr, shared, &key);
+  if (rc < 0)
+    return rc;
+  struct futex_bucket* b = bucket_of(&key);
+  spin_lock(&b->lock);
+  int woken = wake_matching(b, &key, nr, bitset);
+  spin_unlock(&b->lock);
+  return woken;
+}
+
+int futex_requeue(uint32_t* uaddr, uint32_t* uaddr2, int nr_wake, int nr_requeue,
+                  const uint32_t* cmp, int shared)
+{
+  struct futex_key key1, key2;
+  int              rc = get_key(uaddr, shared, &key1);
+  if (rc == 0)
+    rc = get_key(uaddr2, shared, &key2);
+  if (rc < 0)
+    return rc;
+
+  struct futex_bucket* b1 = bucket_of(&key1);
+  struct futex_bucket* b2 = bucket_of(&key2);
+  lock_pair(b1, b2);
+  if (cmp)
+  {
+    uint32_t cur;
+    if (get_user_u32(&cur, uaddr) < 0)
+    {
+      unlock_pair(b1, b2);
+      return -EFAULT;
+    }
+    if (cur != *cmp)
+    {
+      unlock_pair(b1, b2);
+      return -EAGAIN;
+    }
+  }
+  int woken = wake_matching(b1, &key1, nr_wake, FUTEX_BITSET_MATCH_ANY);
+
+  int                   moved = 0;
+  struct futex_waiter** pp    = &b1->head;
+  while (*pp && moved < nr_requeue)
+  {
+    struct futex_waiter* w = *pp;
+    if (!key_eq(&w->key, &key1))
+    {
+      pp = &w->next;
+      continue;
+    }
+    *pp    = w->next;
+    w->key = key2;
+    enqueue(b2, w);
+    ++moved;
+  }
+  unlock_pair(b1, b2);
+  return cmp ? woken + moved : woken;
+}
+
+int64_t futex_syscall(uint32_t* uaddr, int op, uint32_t val, uint64_t timeout, uint32_t* uaddr2,
+                      uint32_t val3)
+{
+  int      shared = !(op & FUTEX_PRIVATE_FLAG);
+  int      cmd    = op & ~(FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME);
+  uint64_t deadline = 0;
+
+  if (cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_BITSET)
+  {
+    struct futex_timespec ts;
+    if (timeout)
+    {
+      if (copy_from_user(&ts, (const void*) (uintptr_t) timeout, sizeof(ts)))
+        return -EFAULT;
+      if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= (int64_t) NSEC_PER_SEC)
+        return -EINVAL;
+      /* FUTEX_WAIT takes a relative timeout, WAIT_BITSET an absolute one;
+         CLOCK_REALTIME and CLOCK_MONOTONIC are the same clock here */
+      deadline = (uint64_t) ts.tv_sec * NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+      if (cmd == FUTEX_WAIT)
+        deadline += clock_now_ns();
+      if (!deadline)
+        deadline = 1;
+    }
+  }
+
+  switch (cmd)
+  {
+  case FUTEX_WAIT:
+    return futex_wait(uaddr, val, deadline, FUTEX_BITSET_MATCH_ANY, shared);
+  case FUTEX_WAIT_BITSET:
+    return futex_wait(uaddr, val, deadline, val3, shared);
+  case FUTEX_WAKE:
+    return futex_wake(uaddr, (int) val, FUTEX_BITSET_MATCH_ANY, shared);
+  case FUTEX_WAKE_BITSET:
+    return futex_wake(uaddr, (int) val, val3, shared);
+  case FUTEX_REQUEUE:
+    return futex_requeue(uaddr, uaddr2, (int) val, (int) (uint32_t) timeout, NULL, shared);
+  case FUTEX_CMP_REQUEUE:
+    return futex_requeue(uaddr, uaddr2, (int) val, (int) (uint32_t) timeout, &val3, shared);
+  default:
+    return -ENOSYS;
+  }
+}
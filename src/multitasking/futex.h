@@ -0,0 +1,54 @@
+#ifndef MULTITASKING_FUTEX_H
+#define MULTITASKING_FUTEX_H
+
+#include <stdint.h>
+
+/* Fast user-space mutexes. A lock lives in a 32-bit user word that user
+   code takes and releases with atomics; it only enters the kernel to sleep
+   while the word still holds the value it saw, or to wake sleepers.
+
+   Waiters hang off a fixed hash table of buckets, keyed by the word's
+   physical address so processes mapping the same page meet on it. With
+   FUTEX_PRIVATE_FLAG the key is the address space plus the virtual address
+   instead, which skips the page table walk and survives copy-on-write.
+   Operation numbers and argument layout are those of Linux futex(2). */
+
+#define FUTEX_WAIT         0
+#define FUTEX_WAKE         1
+#define FUTEX_REQUEUE      3
+#define FUTEX_CMP_REQUEUE  4
+#define FUTEX_WAIT_BITSET  9
+#define FUTEX_WAKE_BITSET  10
+#define FUTEX_PRIVATE_FLAG 128
+#define FUTEX_CLOCK_REALTIME 256
+
+#define FUTEX_BITSET_MATCH_ANY 0xFFFFFFFFu
+
+struct futex_timespec
+{
+  int64_t tv_sec;
+  int64_t tv_nsec;
+};
+
+/* Sleep while *uaddr == val until a wake whose bitset overlaps bitset, or
+   until clock_now_ns() reaches deadline (0: no timeout). 0 when woken,
+   -EAGAIN if the word had changed, -ETIMEDOUT, -EINVAL or -EFAULT. */
+int futex_wait(uint32_t* uaddr, uint32_t val, uint64_t deadline, uint32_t bitset, int shared);
+
+/* Wake up to nr waiters on uaddr whose bitset overlaps bitset; returns how
+   many were woken */
+int futex_wake(uint32_t* uaddr, int nr, uint32_t bitset, int shared);
+
+/* Wake up to nr_wake waiters on uaddr and move up to nr_requeue more over
+   to uaddr2 without waking them. With cmp, fails with -EAGAIN unless
+   *uaddr == *cmp. Returns the number woken, plus the number moved if cmp
+   was given (as Linux does). */
+int futex_requeue(uint32_t* uaddr, uint32_t* uaddr2, int nr_wake, int nr_requeue,
+                  const uint32_t* cmp, int shared);
+
+/* futex(2): op, timeout (or val2 for the requeue operations in the pointer
+   slot), uaddr2 and val3 as Linux passes them; returns a count or -errno */
+int64_t futex_syscall(uint32_t* uaddr, int op, uint32_t val, uint64_t timeout, uint32_t* uaddr2,
+                      uint32_t val3);
+
+#endif
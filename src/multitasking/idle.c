@@ -0,0 +1,122 @@
+#include "multitasking/idle.h"
+#include "multitasking/rcu.h"
+#include "boot/cpu.h"
+#include "boot/lapic.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/softirq.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tickless idle.
+
+   The idle task only runs when pick_next finds nothing else. It expires due
+   timers (which leaves the LAPIC armed one-shot for the next wheel event, so
+   there is no periodic tick to wake us needlessly) and then parks the CPU:
+   with MWAIT it monitors the run-queue doorbell so a wake from another CPU
+   needs no IPI, otherwise it falls back to HLT. Either way an interrupt
+   resumes it immediately. */
+
+/* own cache line: MONITOR triggers on any write to the monitored line */
+static volatile uint64_t doorbell __attribute__((aligned(64)));
+
+static int      use_mwait    = 0;
+static uint32_t mwait_deep   = 0; /* hint for the deepest C-state we use */
+static uint64_t idle_tsc     = 0;
+static uint64_t idle_entries = 0;
+
+/* don't bother with a deeper C-state for naps shorter than this */
+#define IDLE_DEEP_NS (1 * NSEC_PER_MSEC)
+
+static void idle_probe(void)
+{
+  uint32_t a, b, c, d;
+  cpuid(1, 0, &a, &b, &c, &d);
+  if (!(c & (1U << 3)))
+    return;
+  use_mwait = 1;
+
+  /* CPUID 5 EDX: number of C-state sub-states per Cx in 4-bit fields */
+  cpuid(0, 0, &a, &b, &c, &d);
+  if (a >= 5)
+  {
+    cpuid(5, 0, &a, &b, &c, &d);
+    if ((d >> 8) & 0xF)
+      mwait_deep = 0x10; /* C2 */
+  }
+}
+
+static void idle_loop(void* arg)
+{
+  (void) arg;
+  for (;;)
+  {
+    /* bottom halves left over from a busy IRQ exit */
+    softirq_run();
+    timer_run_expired();
+    rcu_check_qs();
+
+    uint64_t flags = irq_save();
+    if (scheduler_has_work())
+    {
+      irq_restore(flags);
+      scheduler_yield();
+      continue;
+    }
+    if (!lapic_timer_available())
+    {
+      /* nothing would wake a halted CPU: keep polling the wheel */
+      irq_restore(flags);
+      continue;
+    }
+
+    uint64_t t0 = rdtsc();
+    if (use_mwait)
+    {
+      uint64_t next = timer_next_event_ns();
+      uint32_t hint = next > clock_now_ns() + IDLE_DEEP_NS ? mwait_deep : 0;
+      asm volatile("monitor" : : "a"(&doorbell), "c"(0), "d"(0));
+      /* a wake between the check and mwait has already hit the doorbell */
+      if (!scheduler_has_work())
+        asm volatile("sti\n\tmwait" : : "a"(hint), "c"(0) : "memory");
+    }
+    else
+    {
+      asm volatile("sti\n\thlt" : : : "memory");
+    }
+    idle_tsc += rdtsc() - t0;
+    ++idle_entries;
+    irq_restore(flags);
+  }
+}
+
+int idle_init(void)
+{
+  idle_probe();
+  serial_puts(use_mwait ? "idle: using MWAIT\n" : "idle: using HLT\n");
+  int tid = task_create(idle_loop, NULL);
+  if (tid < 0)
+  {
+    serial_puts("idle: failed to create idle task\n");
+    return -1;
+  }
+  scheduler_set_idle(tid);
+  return tid;
+}
+
+void idle_kick(void)
+{
+  doorbell = doorbell + 1;
+}
+
+void idle_get_stats(struct idle_stats* out)
+{
+  if (!out)
+    return;
+  out->uptime_ns = clock_now_ns();
+  out->idle_ns   = clock_tsc_to_ns(idle_tsc);
+  out->entries   = idle_entries;
+  out->mwait     = use_mwait;
+}
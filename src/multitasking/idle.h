@@ -0,0 +1,22 @@
+#ifndef MULTITASKING_IDLE_H
+#define MULTITASKING_IDLE_H
+
+#include <stdint.h>
+
+struct idle_stats
+{
+  uint64_t uptime_ns;
+  uint64_t idle_ns;  /* time spent halted in HLT/MWAIT */
+  uint64_t entries;  /* number of times the CPU went idle */
+  int      mwait;    /* 1 when MWAIT is used, 0 for HLT */
+};
+
+/* Probe MONITOR/MWAIT and create the idle task; returns its task id */
+int idle_init(void);
+
+/* Ring the run-queue doorbell: wakes an MWAIT-ing idle loop without an IPI */
+void idle_kick(void);
+
+void idle_get_stats(struct idle_stats* out);
+
+#endif
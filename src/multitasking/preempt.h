@@ -0,0 +1,88 @@
+#ifndef MULTITASKING_PREEMPT_H
+#define MULTITASKING_PREEMPT_H
+
+#include "boot/cpu.h"
+#include <stdint.h>
+
+/* Kernel preemption.
+
+   The preemption model is chosen at build time (cmake -DPREEMPT_MODEL=...):
+     CONFIG_PREEMPT_NONE      tasks only switch where they yield or block
+     CONFIG_PREEMPT_VOLUNTARY  ... and at cond_resched() once the slice is up
+     CONFIG_PREEMPT_FULL      ... and on any IRQ exit, whenever preempt_count
+                              is zero and interrupts were on (the default)
+
+   preempt_count packs the preempt_disable() depth (spinlocks, the scheduler
+   lock) and the softirq nesting; a task is preemptible only when the whole
+   count is zero. */
+
+#if !defined(CONFIG_PREEMPT_NONE) && !defined(CONFIG_PREEMPT_VOLUNTARY) &&                        \
+    !defined(CONFIG_PREEMPT_FULL)
+#define CONFIG_PREEMPT_FULL
+#endif
+
+#define PREEMPT_MASK   0x000000FFU
+#define SOFTIRQ_OFFSET 0x00000100U
+
+/* Per-CPU preemption state; single instance for the BSP */
+struct preempt_cpu
+{
+  volatile uint32_t count;
+  volatile int      need_resched; /* slice expired or a more urgent task woke */
+};
+
+extern struct preempt_cpu preempt_cpu0;
+
+/* Reschedule if preemptible and needed (scheduler.c) */
+void preempt_schedule(void);
+/* IRQ exit path: the interrupted context is switched out if preemptible */
+void preempt_schedule_irq(void);
+
+static inline uint32_t preempt_count(void)
+{
+  return preempt_cpu0.count;
+}
+
+static inline void preempt_disable(void)
+{
+  ++preempt_cpu0.count;
+  asm volatile("" : : : "memory");
+}
+
+static inline void preempt_enable_no_resched(void)
+{
+  asm volatile("" : : : "memory");
+  --preempt_cpu0.count;
+}
+
+static inline void preempt_enable(void)
+{
+  preempt_enable_no_resched();
+#ifdef CONFIG_PREEMPT_FULL
+  if (preempt_cpu0.need_resched && preempt_cpu0.count == 0)
+    preempt_schedule();
+#endif
+}
+
+static inline void set_need_resched(void)
+{
+  preempt_cpu0.need_resched = 1;
+}
+
+static inline int need_resched(void)
+{
+  return preempt_cpu0.need_resched;
+}
+
+/* Explicit preemption point for long kernel loops */
+#ifdef CONFIG_PREEMPT_NONE
+static inline void cond_resched(void) {}
+#else
+static inline void cond_resched(void)
+{
+  if (preempt_cpu0.need_resched && preempt_cpu0.count == 0)
+    preempt_schedule();
+}
+#endif
+
+#endif
@@ -0,0 +1,178 @@
+#include "multitasking/rcu.h"
+#include "boot/cpu.h"
+#include "multitasking/softirq.h"
+#include "multitasking/waitqueue.h"
+#include "serial/serial.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Callbacks move through three lists: next (queued, no grace period asked
+   for yet), wait (waiting for the grace period in progress) and done
+   (ready to run). A grace period ends once the CPU has reported a
+   quiescent state and no task is blocked inside a read-side section.
+   ByteOS runs on the BSP only, so "every CPU" is cpu0. */
+
+static struct rcu_task   boot_task; /* read-side state before the scheduler runs */
+struct rcu_cpu           rcu_cpu0        = {&boot_task};
+static struct rcu_head*  cb_next         = NULL;
+static struct rcu_head** cb_next_tail    = &cb_next;
+static struct rcu_head*  cb_wait         = NULL;
+static struct rcu_head** cb_wait_tail    = &cb_wait;
+static struct rcu_head*  cb_done         = NULL;
+static struct rcu_head** cb_done_tail    = &cb_done;
+static int               gp_active       = 0;
+static int               qs_needed       = 0; /* cpu0 still owes a quiescent state */
+static int               blocked_readers = 0;
+static uint64_t          gp_completed    = 0;
+static uint64_t          cbs_invoked     = 0;
+
+static void rcu_softirq(void);
+
+/* all of the below: interrupts disabled */
+
+static void start_gp(void)
+{
+  if (gp_active || !cb_next)
+    return;
+  *cb_wait_tail = cb_next;
+  cb_wait_tail  = cb_next_tail;
+  cb_next       = NULL;
+  cb_next_tail  = &cb_next;
+  gp_active     = 1;
+  qs_needed     = 1;
+}
+
+static void try_end_gp(void)
+{
+  if (!gp_active || qs_needed || blocked_readers)
+    return;
+  if (cb_wait)
+  {
+    *cb_done_tail = cb_wait;
+    cb_done_tail  = cb_wait_tail;
+    cb_wait       = NULL;
+    cb_wait_tail  = &cb_wait;
+    softirq_raise(SOFTIRQ_RCU);
+  }
+  gp_active = 0;
+  ++gp_completed;
+  start_gp();
+}
+
+static void report_qs(void)
+{
+  if (!gp_active || !qs_needed)
+    return;
+  qs_needed = 0;
+  try_end_gp();
+}
+
+void rcu_init(void)
+{
+  softirq_register(SOFTIRQ_RCU, rcu_softirq);
+  serial_puts("rcu: init\n");
+}
+
+void call_rcu(struct rcu_head* head, rcu_callback_t func)
+{
+  head->next     = NULL;
+  head->func     = func;
+  uint64_t flags = irq_save();
+  *cb_next_tail  = head;
+  cb_next_tail   = &head->next;
+  start_gp();
+  irq_restore(flags);
+}
+
+void rcu_note_context_switch(struct rcu_task* prev, struct rcu_task* next)
+{
+  if (prev && prev->nesting > 0 && !prev->blocked)
+  {
+    prev->blocked = 1;
+    ++blocked_readers;
+  }
+  /* the outgoing task is either outside a section or now accounted as a
+     blocked reader, so the CPU itself has passed a quiescent state */
+  report_qs();
+  rcu_cpu0.cur = next;
+}
+
+void rcu_note_task_exit(struct rcu_task* t)
+{
+  if (t->blocked)
+  {
+    t->blocked = 0;
+    --blocked_readers;
+    try_end_gp();
+  }
+  t->nesting = 0;
+}
+
+void rcu_read_unlock_special(void)
+{
+  uint64_t flags = irq_save();
+  if (rcu_cpu0.cur->blocked)
+  {
+    rcu_cpu0.cur->blocked = 0;
+    --blocked_readers;
+    try_end_gp();
+  }
+  irq_restore(flags);
+}
+
+void rcu_check_qs(void)
+{
+  if (rcu_cpu0.cur->nesting)
+    return;
+  uint64_t flags = irq_save();
+  report_qs();
+  irq_restore(flags);
+}
+
+static void rcu_softirq(void)
+{
+  uint64_t         flags = irq_save();
+  struct rcu_head* list  = cb_done;
+  cb_done                = NULL;
+  cb_done_tail           = &cb_done;
+  irq_restore(flags);
+
+  while (list)
+  {
+    struct rcu_head* next = list->next;
+    list->func(list);
+    ++cbs_invoked;
+    list = next;
+  }
+}
+
+struct rcu_sync
+{
+  struct rcu_head   head;
+  struct completion done;
+};
+
+static void rcu_sync_cb(struct rcu_head* head)
+{
+  struct rcu_sync* s = container_of(head, struct rcu_sync, head);
+  completion_complete(&s->done);
+}
+
+void synchronize_rcu(void)
+{
+  struct rcu_sync s;
+  completion_init(&s.done);
+  call_rcu(&s.head, rcu_sync_cb);
+  completion_wait(&s.done);
+}
+
+void rcu_get_stats(struct rcu_stats* out)
+{
+  if (!out)
+    return;
+  uint64_t flags       = irq_save();
+  out->gp_completed    = gp_completed;
+  out->cbs_invoked     = cbs_invoked;
+  out->blocked_readers = blocked_readers;
+  irq_restore(flags);
+}
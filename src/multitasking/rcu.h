@@ -0,0 +1,97 @@
+#ifndef MULTITASKING_RCU_H
+#define MULTITASKING_RCU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Read-copy-update for read-mostly shared data.
+
+   Readers bracket their walk with rcu_read_lock()/rcu_read_unlock() and load
+   shared pointers with rcu_dereference(); they take no lock and write no
+   shared memory. Writers serialise among themselves, publish a new version
+   with rcu_assign_pointer() and hand the old one to call_rcu(), which runs
+   the callback once every reader that could still see it has finished (a
+   grace period).
+
+   Read-side sections are preemptible and may even block: the nesting count
+   lives in the task, and a task switched out inside a section holds up
+   grace periods until it leaves it. A CPU passes through a quiescent state
+   on every context switch, in the idle loop, and on IRQ exit when the
+   interrupted task is outside any read-side section. */
+
+#ifndef container_of
+#define container_of(ptr, type, member) ((type*) ((char*) (ptr) - offsetof(type, member)))
+#endif
+
+#define rcu_dereference(p)       __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+struct rcu_head;
+typedef void (*rcu_callback_t)(struct rcu_head*);
+
+struct rcu_head
+{
+  struct rcu_head* next;
+  rcu_callback_t   func;
+};
+
+/* Per-task read-side state, embedded in the scheduler's task */
+struct rcu_task
+{
+  int nesting;
+  int blocked; /* switched out inside a section: holds up grace periods */
+};
+
+/* Per-CPU state; single instance for the BSP */
+struct rcu_cpu
+{
+  struct rcu_task* cur; /* read-side state of the running task */
+};
+
+struct rcu_stats
+{
+  uint64_t gp_completed;
+  uint64_t cbs_invoked;
+  int      blocked_readers;
+};
+
+extern struct rcu_cpu rcu_cpu0;
+
+void rcu_init(void);
+
+void rcu_read_unlock_special(void);
+
+static inline void rcu_read_lock(void)
+{
+  ++rcu_cpu0.cur->nesting;
+  asm volatile("" : : : "memory");
+}
+
+static inline void rcu_read_unlock(void)
+{
+  asm volatile("" : : : "memory");
+  if (--rcu_cpu0.cur->nesting == 0 && rcu_cpu0.cur->blocked)
+    rcu_read_unlock_special();
+}
+
+/* Run func(head) after a grace period, from softirq context */
+void call_rcu(struct rcu_head* head, rcu_callback_t func);
+
+/* Block until a grace period has elapsed; not from a read-side section */
+void synchronize_rcu(void);
+
+/* Scheduler hook: prev (may be NULL) is switched out, next in.
+   Interrupts must be disabled. */
+void rcu_note_context_switch(struct rcu_task* prev, struct rcu_task* next);
+
+/* A task that dies inside a read-side section no longer holds up grace
+   periods. Interrupts must be disabled. */
+void rcu_note_task_exit(struct rcu_task* t);
+
+/* Report a quiescent state if the CPU is outside any read-side section
+   (IRQ exit, idle loop) */
+void rcu_check_qs(void);
+
+void rcu_get_stats(struct rcu_stats* out);
+
+#endif
@@ -1,34 +1,152 @@
 #include "multitasking/scheduler.h"
+#include "boot/cpu.h"
+#include "boot/lapic.h"
+#include "boot/percpu.h"
+#include "fs/fdtable.h"
 #include "kernel/kernel.h"
 #include "mem/alloc.h"
+#include "mem/mm.h"
+#include "multitasking/idle.h"
+#include "multitasking/preempt.h"
+#include "multitasking/rcu.h"
+#include "multitasking/waitqueue.h"
+#include "multitasking/workqueue.h"
 #include "serial/serial.h"
+#include "syscall/syscall.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "vdso/vdso.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-#define MAX_TASKS 16
+#define MAX_TASKS SCHED_MAX_TASKS
 #define STACK_SIZE (16 * 1024)
+#define FPU_STATE_SIZE 512 /* FXSAVE area */
+
+/* Directed switches in a row before a handoff falls back to a normal pick,
+   so a producer/consumer pair cannot ping-pong forever and starve the
+   rest of the run queue */
+#define SCHED_MAX_HANDOFF_CHAIN 8
+
+/* Round-robin time slice; preemption points reschedule once it is up */
+#define SCHED_SLICE_NS (4 * NSEC_PER_MSEC)
+
+/* Budget overshoot tolerated before it counts as an overrun: the slice
+   timer fires at the end of the budget, but the switch itself lands a few
+   microseconds later */
+#define SCHED_DL_OVERRUN_SLACK_NS (50 * NSEC_PER_USEC)
+
+/* Bandwidth period limits; a quota below the minimum would throttle the
+   group before it got through a single context switch */
+#define SCHED_GROUP_MIN_PERIOD_NS (1 * NSEC_PER_MSEC)
+#define SCHED_GROUP_MAX_PERIOD_NS (1000 * NSEC_PER_MSEC)
+#define SCHED_GROUP_MIN_QUOTA_NS  (1 * NSEC_PER_MSEC)
+
+/* Per-switch tracing costs milliseconds on the UART; build with
+   -DSCHED_DEBUG to get it back. */
+#ifdef SCHED_DEBUG
+#define sched_trace(s)     serial_puts(s)
+#define sched_trace_dec(v) serial_putdec(v)
+#else
+#define sched_trace(s)     ((void) 0)
+#define sched_trace_dec(v) ((void) 0)
+#endif
 
 typedef void (*task_fn)(void*);
 
-struct task
+/* Deadline class state; period == 0 means the task is round robin */
+struct sched_dl
 {
-  int       used;
-  int       dead;
-  uint64_t* sp;
-  void*     stack;
-  void*     kernel_stack; /* per-task kernel stack for syscall/interrupt handling */
+  uint64_t     period;
+  uint64_t     budget;
+  uint64_t     runtime;   /* consumed in the current period */
+  uint64_t     deadline;  /* absolute end of the current period */
+  int          throttled; /* budget used up: off the CPU until the next period */
+  int          waiting;   /* in scheduler_wait_next_period() */
+  uint64_t     overruns;
+  uint64_t     misses;
+  struct timer timer; /* replenishment / next period start */
 };
 
-static struct task tasks[MAX_TASKS];
-static int         current = -1;
+/* Task group. CPU time is shared between the entities under a group by
+   weighted virtual runtime: each child group is one entity, and the
+   group's own tasks together form one more, of default weight, served
+   round robin. A quota caps the CPU time the whole subtree gets per
+   period; once it is used up the subtree is throttled until the period
+   timer refills it. */
+struct sched_group
+{
+  int          used;
+  int          parent; /* -1 for the root */
+  char         name[SCHED_GROUP_NAME_LEN];
+  uint32_t     weight;
+  uint64_t     vruntime;       /* weighted CPU time, compared among siblings */
+  uint64_t     min_vruntime;   /* floor for children rejoining the competition */
+  uint64_t     local_vruntime; /* the group's own tasks as one entity */
+  uint64_t     quota;          /* 0 = unlimited */
+  uint64_t     period;
+  uint64_t     runtime;        /* consumed in the current period */
+  uint64_t     period_end;
+  int          throttled;
+  uint64_t     throttled_at;
+  uint64_t     usage;
+  uint64_t     nr_periods;
+  uint64_t     nr_throttled;
+  uint64_t     throttled_time;
+  struct timer timer; /* refill at period_end while throttled */
+};
 
-struct scheduler_task_info
+struct task
 {
-  int id;
-  int used;
-  int dead;
+  int                used;
+  int                dead;
+  int                blocked;   /* waiting for scheduler_wake() */
+  wait_cancel_fn     wait_cancel; /* unhooks it from what it waits on, if killed */
+  void*              wait_cancel_arg;
+  int                worker;    /* workqueue worker: report blocking to the pool */
+  int                preempted; /* switched out involuntarily: runnable even if blocked */
+  uint64_t*          sp;
+  void*              stack;
+  void*              kernel_stack; /* per-task kernel stack for syscall/interrupt handling */
+  uint64_t           run_start;    /* clock_now_ns() when it last got the CPU */
+  uint64_t           handoffs_in;  /* directed switches received */
+  uint64_t           handoffs_out; /* directed switches given */
+  struct mm*         mm;           /* own address space; NULL for kernel threads */
+  struct mm*         active_mm;    /* address space it runs on (borrowed if mm is NULL) */
+  struct fdtable*    files;        /* open descriptors; NULL for kernel threads */
+  int                personality;  /* PERSONALITY_* numbering of its syscalls */
+  int                user;         /* runs (or serves) ring-3 code: its pointers are checked */
+  uint64_t           fs_base;      /* user TLS pointer */
+  uint64_t           gs_base;
+  int                tgid;         /* thread group (process): its first task's id */
+  uint32_t*          clear_tid;    /* user word zeroed and futex-woken at exit */
+  int                vfork_parent; /* blocked in vfork until this one execs or exits; -1 if none */
+  struct completion  vfork_done;   /* completed by its own vfork child */
+  struct sched_dl    dl;
+  int                group;
+  struct rcu_task    rcu;
+  struct rcu_head    reap;    /* frees the slot a grace period after death */
+  int                reaping;
+  uint8_t            fpu[FPU_STATE_SIZE] __attribute__((aligned(16))); /* x87/SSE while switched out */
 };
 
+static struct task        tasks[MAX_TASKS];
+static struct sched_group groups[SCHED_MAX_GROUPS];
+static int                current       = -1;
+static int                idle_task     = -1;
+static uint64_t           dl_util_ppm   = 0;  /* admitted deadline utilisation */
+static int                rr_cursor     = -1; /* last task picked by round robin */
+static int                handoff_chain = 0;
+static int                handoff_next  = -1; /* deferred scheduler_yield_to() target */
+static uint64_t           loaded_fs_base = 0; /* what the FS base register holds */
+static uint64_t           loaded_gs_base = 0; /* user GS base (kernel GS is swapped in only on entry) */
+static int                fsgsbase       = 0; /* CR4.FSGSBASE on: {RD,WR}{FS,GS}BASE */
+static uint8_t            fpu_init_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
+static struct timer       slice_timer;
+
+struct preempt_cpu preempt_cpu0;
+
 extern void scheduler_switch(uint64_t** old_sp, uint64_t* new_sp);
 
 /* ======================================================= */
@@ -62,6 +180,7 @@ __attribute__((noreturn)) static void task_trampoline(void)
     serial_puts("task_trampoline: fn is NULL, halting\n");
   }
 
+  scheduler_set_deadline(current, 0, 0); /* give back its reservation */
   tasks[current].dead = 1;
   serial_puts("task_trampoline: marking task as dead\n");
   scheduler_yield();  // Oddaj kontrolę z powrotem do schedulera
@@ -71,18 +190,65 @@ __attribute__((noreturn)) static void task_trampoline(void)
 
 /* ======================================================= */
 
+static void slice_expired(void* arg)
+{
+  (void) arg;
+  set_need_resched();
+}
+
+static void group_timer_fire(void* arg);
+
 int scheduler_init(void)
 {
   serial_puts("scheduler: init start\n");
   for (int i = 0; i < MAX_TASKS; ++i)
   {
-    tasks[i].used = 0;
-    tasks[i].dead = 0;
-    tasks[i].sp   = NULL;
+    tasks[i].used      = 0;
+    tasks[i].dead      = 0;
+    tasks[i].blocked   = 0;
+    tasks[i].worker    = 0;
+    tasks[i].preempted = 0;
+    tasks[i].sp        = NULL;
     // tasks[i].stack = NULL;
     tasks[i].kernel_stack = NULL;
   }
+  for (int g = 0; g < SCHED_MAX_GROUPS; ++g)
+  {
+    groups[g].used = 0;
+    timer_setup(&groups[g].timer, group_timer_fire, (void*) (intptr_t) g);
+  }
+  groups[SCHED_ROOT_GROUP].used   = 1;
+  groups[SCHED_ROOT_GROUP].parent = -1;
+  groups[SCHED_ROOT_GROUP].weight = SCHED_WEIGHT_DEFAULT;
+  strcpy(groups[SCHED_ROOT_GROUP].name, "root");
   current = -1;
+  timer_setup(&slice_timer, slice_expired, NULL);
+
+  /* Each task has its own x87/SSE registers, switched in context_switch.
+     The kernel is built with -mgeneral-regs-only and never touches them
+     itself. New tasks and exec start from the reset state captured here:
+     all exceptions masked, round to nearest. */
+  write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP);
+  write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+  uint32_t mxcsr = 0x1F80;
+  asm volatile("fninit\n\tldmxcsr %0" : : "m"(mxcsr));
+  fxsave(fpu_init_state);
+
+  /* WRFSBASE is far cheaper than WRMSR on the switch path. It also lets
+     user code move its own bases, so with it they are read back when a
+     task is switched out. */
+  uint32_t a, b, c, d;
+  cpuid(0, 0, &a, &b, &c, &d);
+  if (a >= 7)
+  {
+    cpuid(7, 0, &a, &b, &c, &d);
+    if (b & CPUID7_EBX_FSGSBASE)
+    {
+      write_cr4(read_cr4() | CR4_FSGSBASE);
+      fsgsbase = 1;
+      serial_puts("scheduler: FSGSBASE available\n");
+    }
+  }
   serial_puts("scheduler: init done\n");
   return 0;  // Zwracamy 0, aby wskazać sukces
 }
@@ -92,10 +258,457 @@ int scheduler_get_current(void)
 {
   return current;
 }
+static void queue_reap(struct task* t);
+static void vfork_release(int id);
+
 void scheduler_mark_dead(int id)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return;
+  /* killed and exec'd deadline tasks never reach the trampoline's release */
+  scheduler_set_deadline(id, 0, 0);
+  /* a dying vfork child lets its parent go; a dying parent is forgotten
+     by its child, so the slot's next owner gets no stray completion */
+  vfork_release(id);
+  uint64_t flags = irq_save();
+  for (int i = 0; i < MAX_TASKS; ++i)
+    if (tasks[i].used && tasks[i].vfork_parent == id)
+      tasks[i].vfork_parent = -1;
+  /* whatever it waits on lives on its stack, which goes with it */
+  if (id != current && tasks[id].wait_cancel)
+    tasks[id].wait_cancel(tasks[id].wait_cancel_arg);
+  tasks[id].wait_cancel = NULL;
+  tasks[id].dead        = 1;
+  /* the current task is reaped once it has switched away for good */
+  if (id != current)
+    queue_reap(&tasks[id]);
+  irq_restore(flags);
+}
+
+void scheduler_prepare_wait(void)
+{
+  if (current >= 0)
+    tasks[current].blocked = 1;
+}
+
+void scheduler_set_wait_cancel(wait_cancel_fn fn, void* arg)
+{
+  if (current < 0)
+    return;
+  uint64_t flags                = irq_save();
+  tasks[current].wait_cancel     = fn;
+  tasks[current].wait_cancel_arg = arg;
+  irq_restore(flags);
+}
+
+void scheduler_wake(int id)
 {
   if (id >= 0 && id < MAX_TASKS)
-    tasks[id].dead = 1;
+  {
+    tasks[id].blocked = 0;
+    /* a deadline task outranks whatever round-robin task is running */
+    if (tasks[id].dl.period && id != current)
+      set_need_resched();
+    idle_kick();
+  }
+}
+
+void scheduler_set_idle(int id)
+{
+  idle_task = id;
+}
+
+void scheduler_set_worker(int id)
+{
+  if (id >= 0 && id < MAX_TASKS)
+    tasks[id].worker = 1;
+}
+
+static int is_dl(int i)
+{
+  return tasks[i].dl.period != 0;
+}
+
+/* A task preempted between scheduler_prepare_wait() and publishing itself
+   to its waker must still get back to the CPU, or the wake-up is lost */
+static int is_blocked(int i)
+{
+  return tasks[i].blocked && !tasks[i].preempted;
+}
+
+/* Start a new period once the current one is over, keeping the original
+   phase so frame boundaries do not drift */
+static void dl_refresh(struct task* t, uint64_t now)
+{
+  if (now < t->dl.deadline)
+    return;
+  uint64_t late = now - t->dl.deadline;
+  t->dl.deadline += (late / t->dl.period + 1) * t->dl.period;
+  t->dl.runtime   = 0;
+  t->dl.throttled = 0;
+}
+
+static int dl_eligible(int i, uint64_t now)
+{
+  if (!tasks[i].used || tasks[i].dead || is_blocked(i) || !is_dl(i))
+    return 0;
+  dl_refresh(&tasks[i], now);
+  return !tasks[i].dl.throttled;
+}
+
+static void dl_timer_fire(void* arg)
+{
+  int id = (int) (intptr_t) arg;
+  if (tasks[id].dl.waiting)
+    scheduler_wake(id);
+  else
+    idle_kick(); /* replenished: let the idle loop reschedule */
+}
+
+/* ---- task groups ---------------------------------------------------- */
+
+static void account(int id, uint64_t now);
+
+static int group_throttled(int g)
+{
+  for (; g >= 0; g = groups[g].parent)
+    if (groups[g].throttled)
+      return 1;
+  return 0;
+}
+
+/* Roll over to the current period, refilling the quota. Interrupts must
+   be disabled. */
+static void group_refresh(struct sched_group* grp, uint64_t now)
+{
+  if (!grp->quota || now < grp->period_end)
+    return;
+  uint64_t periods = (now - grp->period_end) / grp->period + 1;
+  grp->period_end += periods * grp->period;
+  grp->nr_periods += periods;
+  grp->runtime     = 0;
+  if (grp->throttled)
+  {
+    grp->throttled = 0;
+    grp->throttled_time += now - grp->throttled_at;
+  }
+}
+
+static void group_timer_fire(void* arg)
+{
+  group_refresh(&groups[(int) (intptr_t) arg], clock_now_ns());
+  set_need_resched();
+  idle_kick();
+}
+
+/* Charge delta ns run by a task of group g to g and all its ancestors.
+   Interrupts must be disabled. */
+static void group_charge(int g, uint64_t delta, uint64_t now)
+{
+  groups[g].local_vruntime += delta;
+  for (; g >= 0; g = groups[g].parent)
+  {
+    struct sched_group* grp = &groups[g];
+    grp->usage += delta;
+    grp->vruntime += delta * SCHED_WEIGHT_DEFAULT / grp->weight;
+    if (!grp->quota || grp->throttled)
+      continue;
+    group_refresh(grp, now);
+    grp->runtime += delta;
+    if (grp->runtime >= grp->quota)
+    {
+      grp->throttled    = 1;
+      grp->throttled_at = now;
+      ++grp->nr_throttled;
+      timer_arm(&grp->timer, grp->period_end);
+    }
+  }
+}
+
+/* Shortest quota left over g and its ancestors, capped at slice */
+static uint64_t group_slice(int g, uint64_t slice, uint64_t now)
+{
+  for (; g >= 0; g = groups[g].parent)
+  {
+    struct sched_group* grp = &groups[g];
+    if (!grp->quota)
+      continue;
+    group_refresh(grp, now);
+    if (grp->runtime < grp->quota && grp->quota - grp->runtime < slice)
+      slice = grp->quota - grp->runtime;
+  }
+  return slice;
+}
+
+static int group_valid(int g)
+{
+  return g >= 0 && g < SCHED_MAX_GROUPS && groups[g].used;
+}
+
+int scheduler_group_create(const char* name, int parent, uint32_t weight)
+{
+  if (!name || !name[0] || !group_valid(parent))
+    return -1;
+  if (weight < SCHED_WEIGHT_MIN || weight > SCHED_WEIGHT_MAX)
+    return -1;
+  uint64_t flags = irq_save();
+  for (int g = 0; g < SCHED_MAX_GROUPS; ++g)
+  {
+    if (groups[g].used)
+      continue;
+    struct sched_group* grp = &groups[g];
+    grp->parent             = parent;
+    strncpy(grp->name, name, SCHED_GROUP_NAME_LEN - 1);
+    grp->name[SCHED_GROUP_NAME_LEN - 1] = '\0';
+    grp->weight                         = weight;
+    /* join the siblings level, without credit for time it did not exist */
+    grp->vruntime       = groups[parent].min_vruntime;
+    grp->min_vruntime   = 0;
+    grp->local_vruntime = 0;
+    grp->quota          = 0;
+    grp->period         = 0;
+    grp->runtime        = 0;
+    grp->throttled      = 0;
+    grp->usage          = 0;
+    grp->nr_periods     = 0;
+    grp->nr_throttled   = 0;
+    grp->throttled_time = 0;
+    grp->used           = 1;
+    irq_restore(flags);
+    return g;
+  }
+  irq_restore(flags);
+  return -1;
+}
+
+int scheduler_group_destroy(int gid)
+{
+  if (!group_valid(gid) || gid == SCHED_ROOT_GROUP)
+    return -1;
+  uint64_t flags = irq_save();
+  for (int i = 0; i < MAX_TASKS; ++i)
+  {
+    if (tasks[i].used && !tasks[i].dead && tasks[i].group == gid)
+    {
+      irq_restore(flags);
+      return -1;
+    }
+  }
+  for (int g = 0; g < SCHED_MAX_GROUPS; ++g)
+  {
+    if (groups[g].used && groups[g].parent == gid)
+    {
+      irq_restore(flags);
+      return -1;
+    }
+  }
+  /* dead tasks still waiting to be reaped fall back to the parent */
+  for (int i = 0; i < MAX_TASKS; ++i)
+    if (tasks[i].used && tasks[i].group == gid)
+      tasks[i].group = groups[gid].parent;
+  timer_cancel(&groups[gid].timer);
+  groups[gid].used = 0;
+  irq_restore(flags);
+  return 0;
+}
+
+int scheduler_group_set_weight(int gid, uint32_t weight)
+{
+  if (!group_valid(gid) || weight < SCHED_WEIGHT_MIN || weight > SCHED_WEIGHT_MAX)
+    return -1;
+  groups[gid].weight = weight;
+  return 0;
+}
+
+int scheduler_group_set_bandwidth(int gid, uint64_t quota_ns, uint64_t period_ns)
+{
+  if (!group_valid(gid) || gid == SCHED_ROOT_GROUP)
+    return -1;
+  if (quota_ns && (quota_ns < SCHED_GROUP_MIN_QUOTA_NS || period_ns < SCHED_GROUP_MIN_PERIOD_NS ||
+                   period_ns > SCHED_GROUP_MAX_PERIOD_NS))
+    return -1;
+
+  uint64_t            flags = irq_save();
+  uint64_t            now   = clock_now_ns();
+  struct sched_group* grp   = &groups[gid];
+  timer_cancel(&grp->timer);
+  if (grp->throttled)
+  {
+    grp->throttled = 0;
+    grp->throttled_time += now - grp->throttled_at;
+  }
+  grp->quota      = quota_ns;
+  grp->period     = quota_ns ? period_ns : 0;
+  grp->runtime    = 0;
+  grp->period_end = now + grp->period;
+  irq_restore(flags);
+  set_need_resched();
+  return 0;
+}
+
+int scheduler_group_attach(int gid, int id)
+{
+  if (!group_valid(gid) || id < 0 || id >= MAX_TASKS || !tasks[id].used || tasks[id].dead)
+    return -1;
+  if (id == idle_task)
+    return -1;
+  uint64_t flags = irq_save();
+  /* settle the time run so far with the old group */
+  if (id == current)
+    account(id, clock_now_ns());
+  tasks[id].group = gid;
+  irq_restore(flags);
+  set_need_resched();
+  return 0;
+}
+
+int scheduler_get_groups(struct scheduler_group_info* out, int max)
+{
+  if (!out || max <= 0)
+    return 0;
+  int      count = 0;
+  uint64_t flags = irq_save();
+  for (int g = 0; g < SCHED_MAX_GROUPS && count < max; ++g)
+  {
+    struct sched_group* grp = &groups[g];
+    if (!grp->used)
+      continue;
+    struct scheduler_group_info* o = &out[count++];
+    o->id                          = g;
+    o->parent                      = grp->parent;
+    strcpy(o->name, grp->name);
+    o->weight       = grp->weight;
+    o->quota_ns     = grp->quota;
+    o->period_ns    = grp->period;
+    o->throttled    = grp->throttled;
+    o->usage_ns     = grp->usage;
+    o->nr_periods   = grp->nr_periods;
+    o->nr_throttled = grp->nr_throttled;
+    o->throttled_ns = grp->throttled_time;
+    if (grp->throttled)
+      o->throttled_ns += clock_now_ns() - grp->throttled_at;
+    o->nr_tasks = 0;
+    for (int i = 0; i < MAX_TASKS; ++i)
+      if (tasks[i].used && !tasks[i].dead && tasks[i].group == g)
+        ++o->nr_tasks;
+  }
+  irq_restore(flags);
+  return count;
+}
+
+/* ---------------------------------------------------------------------- */
+
+/* Charge the CPU time since run_start to task id. The slice timer ends a
+   deadline task's turn when its budget runs out; running past it (under
+   CONFIG_PREEMPT_NONE, or with preemption disabled) is recorded as an
+   overrun and the task sits out the rest of the period. Must be called
+   with interrupts disabled. */
+static void account(int id, uint64_t now)
+{
+  struct task* t     = &tasks[id];
+  uint64_t     delta = now - t->run_start;
+  t->run_start       = now;
+  if (!is_dl(id))
+  {
+    if (id != idle_task)
+      group_charge(t->group, delta, now);
+    return;
+  }
+  if (t->dl.throttled)
+    return;
+  t->dl.runtime += delta;
+  if (t->dl.runtime >= t->dl.budget)
+  {
+    if (t->dl.runtime > t->dl.budget + SCHED_DL_OVERRUN_SLACK_NS)
+      ++t->dl.overruns;
+    t->dl.throttled = 1;
+    timer_arm(&t->dl.timer, t->dl.deadline);
+  }
+}
+
+int scheduler_set_deadline(int id, uint64_t period_ns, uint64_t budget_ns)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return -1;
+  if (period_ns && (budget_ns == 0 || budget_ns > period_ns || budget_ns > UINT64_MAX / 1000000))
+    return -1;
+
+  uint64_t     flags = irq_save();
+  struct task* t     = &tasks[id];
+  uint64_t     old   = t->dl.period ? t->dl.budget * 1000000 / t->dl.period : 0;
+  uint64_t     util  = period_ns ? budget_ns * 1000000 / period_ns : 0;
+  if (dl_util_ppm - old + util > SCHED_DL_MAX_UTIL_PPM)
+  {
+    irq_restore(flags);
+    serial_puts("scheduler: deadline admission rejected\n");
+    return -1;
+  }
+  dl_util_ppm = dl_util_ppm - old + util;
+
+  timer_cancel(&t->dl.timer);
+  t->dl.period    = period_ns;
+  t->dl.budget    = budget_ns;
+  t->dl.runtime   = 0;
+  t->dl.throttled = 0;
+  t->dl.waiting   = 0;
+  t->dl.deadline  = clock_now_ns() + period_ns;
+  irq_restore(flags);
+  return 0;
+}
+
+void scheduler_wait_next_period(void)
+{
+  if (current < 0 || !is_dl(current))
+  {
+    scheduler_yield();
+    return;
+  }
+  struct task* t     = &tasks[current];
+  uint64_t     flags = irq_save();
+  if (clock_now_ns() > t->dl.deadline)
+  {
+    /* finished late: the next period has already begun */
+    ++t->dl.misses;
+    irq_restore(flags);
+    scheduler_yield();
+    return;
+  }
+  t->dl.waiting = 1;
+  scheduler_prepare_wait();
+  timer_arm(&t->dl.timer, t->dl.deadline);
+  irq_restore(flags);
+  scheduler_wait();
+  t->dl.waiting = 0;
+}
+
+void scheduler_wait(void)
+{
+  if (current < 0)
+    return;
+  int self = current;
+  if (tasks[self].worker && tasks[self].blocked)
+    workqueue_worker_sleeping(self);
+  while (tasks[current].blocked)
+  {
+    scheduler_yield();
+    if (!tasks[current].blocked)
+      break;
+
+    /* nothing else runnable: sleep until an interrupt (sti;hlt is atomic,
+       so a wake-up between the check and the hlt is not lost) */
+    if (!lapic_timer_available())
+    {
+      /* without a timer interrupt nothing would wake a halted CPU */
+      timer_run_expired();
+      continue;
+    }
+    uint64_t flags = irq_save();
+    if (tasks[current].blocked)
+      asm volatile("sti\n\thlt" : : : "memory");
+    irq_restore(flags);
+  }
+  if (tasks[self].worker)
+    workqueue_worker_running(self);
 }
 
 /* ======================================================= */
@@ -144,8 +757,8 @@ int task_create(task_fn fn, void* arg)
       serial_putdec((uint64_t) (uintptr_t) sp);
       serial_puts("\n");
 
-      /* Reserve 9 qwords for initial registers/args */
-      sp -= 9;
+      /* Reserve 10 qwords for initial registers/flags/args */
+      sp -= 10;
 
       /* Ensure stack does not underflow the allocated region */
       if ((uint8_t*) sp < stack_start)
@@ -168,18 +781,47 @@ int task_create(task_fn fn, void* arg)
       sp[3] = 0;                          /* r13 */
       sp[4] = 0;                          /* r14 */
       sp[5] = 0;                          /* r15 */
-      sp[6] = (uint64_t) task_trampoline; /* ret -> trampoline */
-      sp[7] = (uint64_t) fn;              /* trampoline will see this as fn */
-      sp[8] = (uint64_t) arg;             /* trampoline will see this as arg */
+      sp[6] = 0x202;                      /* rflags: IF set */
+      sp[7] = (uint64_t) task_trampoline; /* ret -> trampoline */
+      sp[8] = (uint64_t) fn;              /* trampoline will see this as fn */
+      sp[9] = (uint64_t) arg;             /* trampoline will see this as arg */
       serial_puts("task_create: prepared stack frame (sp=");
       serial_puthex64((uint64_t) (uintptr_t) sp);
       serial_puts(")\n");
 
-      tasks[i].used         = 1;
       tasks[i].dead         = 0;
+      tasks[i].blocked      = 0;
+      tasks[i].wait_cancel  = NULL;
+      tasks[i].worker       = 0;
+      tasks[i].preempted    = 0;
       tasks[i].sp           = sp;
       tasks[i].stack        = stack;
       tasks[i].kernel_stack = kernel_stack;
+      tasks[i].run_start    = 0;
+      tasks[i].handoffs_in  = 0;
+      tasks[i].handoffs_out = 0;
+      tasks[i].mm           = NULL;
+      tasks[i].active_mm    = NULL;
+      tasks[i].files        = NULL;
+      tasks[i].personality  = PERSONALITY_BYTEOS;
+      tasks[i].user         = 0;
+      tasks[i].fs_base      = 0;
+      tasks[i].gs_base      = 0;
+      tasks[i].tgid         = i;
+      tasks[i].clear_tid    = NULL;
+      tasks[i].vfork_parent = -1;
+      tasks[i].dl.period    = 0;
+      tasks[i].dl.overruns  = 0;
+      tasks[i].dl.misses    = 0;
+      tasks[i].group        = SCHED_ROOT_GROUP;
+      tasks[i].rcu.nesting  = 0;
+      tasks[i].rcu.blocked  = 0;
+      tasks[i].reaping      = 0;
+      memcpy(tasks[i].fpu, fpu_init_state, sizeof(fpu_init_state));
+      syscall_task_reset(i);
+      timer_setup(&tasks[i].dl.timer, dl_timer_fire, (void*) (intptr_t) i);
+      /* publish last: lockless readers of tasks[] test used first */
+      __atomic_store_n(&tasks[i].used, 1, __ATOMIC_RELEASE);
 
       serial_puts("task_create: returning ");
       serial_putdec((uint64_t) i);
@@ -193,69 +835,464 @@ int task_create(task_fn fn, void* arg)
 
 /* ======================================================= */
 
-static int pick_next(void)
+/* fair class; deadline tasks are picked by EDF in pick_next */
+static int runnable(int i)
 {
-  if (current < 0)
+  return tasks[i].used && !tasks[i].dead && !is_blocked(i) && i != idle_task && !is_dl(i) &&
+         !group_throttled(tasks[i].group);
+}
+
+int scheduler_has_work(void)
+{
+  uint64_t now = clock_now_ns();
+  for (int i = 0; i < MAX_TASKS; ++i)
+    if (runnable(i) || dl_eligible(i, now))
+      return 1;
+  return 0;
+}
+
+/* earliest deadline first among deadline tasks with budget left, other
+   than skip */
+static int pick_dl(uint64_t now, int skip)
+{
+  int best = -1;
+  for (int i = 0; i < MAX_TASKS; ++i)
   {
-    for (int i = 0; i < MAX_TASKS; ++i)
-    {
-      if (tasks[i].used && !tasks[i].dead)
-        return i;
-    }
+    if (i != skip && dl_eligible(i, now) &&
+        (best < 0 || tasks[i].dl.deadline < tasks[best].dl.deadline))
+      best = i;
   }
-  else
+  return best;
+}
+
+/* Round robin among the runnable tasks of group g. The rotation continues
+   from the last round-robin pick, not from current: a directed switch
+   must not let its target jump the queue. */
+static int pick_rr(int g)
+{
+  for (int i = 1; i <= MAX_TASKS; ++i)
   {
-    for (int i = 1; i <= MAX_TASKS; ++i)
+    int idx = (rr_cursor + i + MAX_TASKS) % MAX_TASKS;
+    if (runnable(idx) && tasks[idx].group == g)
+      return rr_cursor = idx;
+  }
+  return idle_task;
+}
+
+/* An entity that sat out (blocked, throttled, empty) rejoins at most one
+   slice behind the leaders instead of cashing in the time it missed */
+static uint64_t place(uint64_t* vruntime, uint64_t low)
+{
+  if (*vruntime < low)
+    *vruntime = low;
+  return *vruntime;
+}
+
+/* Walk down from the root, at each level taking the entity with the least
+   weighted runtime, until a group's own tasks win */
+static int pick_fair(void)
+{
+  int nr[SCHED_MAX_GROUPS]    = {0}; /* runnable tasks in each subtree */
+  int local[SCHED_MAX_GROUPS] = {0}; /* runnable tasks directly in each group */
+  for (int i = 0; i < MAX_TASKS; ++i)
+  {
+    if (!runnable(i))
+      continue;
+    ++local[tasks[i].group];
+    for (int g = tasks[i].group; g >= 0; g = groups[g].parent)
+      ++nr[g];
+  }
+  if (!nr[SCHED_ROOT_GROUP])
+    return idle_task;
+
+  int g = SCHED_ROOT_GROUP;
+  for (;;)
+  {
+    struct sched_group* grp  = &groups[g];
+    int                 best = -1; /* -1: the group's own tasks */
+    uint64_t            min  = UINT64_MAX;
+    uint64_t            low  = 0;
+    if (grp->min_vruntime > SCHED_SLICE_NS)
+      low = grp->min_vruntime - SCHED_SLICE_NS;
+    if (local[g])
+      min = place(&grp->local_vruntime, low);
+    for (int c = 0; c < SCHED_MAX_GROUPS; ++c)
     {
-      int idx = (current + i) % MAX_TASKS;
-      if (tasks[idx].used && !tasks[idx].dead)
-        return idx;
+      if (!groups[c].used || groups[c].parent != g || !nr[c])
+        continue;
+      uint64_t v = place(&groups[c].vruntime, low);
+      if (v < min)
+      {
+        min  = v;
+        best = c;
+      }
     }
+    if (min > grp->min_vruntime)
+      grp->min_vruntime = min;
+    if (best < 0)
+      return pick_rr(g);
+    g = best;
   }
-  return -1;
 }
 
-static int sched_lock = 0;
-void       scheduler_lock(void)
+static int pick_next(uint64_t now)
+{
+  int best = pick_dl(now, -1);
+  if (best >= 0)
+    return best;
+  return pick_fair();
+}
+
+void scheduler_lock(void)
 {
-  sched_lock++;
+  preempt_disable();
 }
 void scheduler_unlock(void)
 {
-  if (sched_lock > 0)
-    sched_lock--;
+  if (preempt_count() & PREEMPT_MASK)
+    preempt_enable();
 }
 
-void scheduler_yield(void)
+/* Start the incoming task's slice; a deadline task's slice ends no later
+   than its budget. Interrupts must be disabled. */
+static void arm_slice(int next, uint64_t now)
 {
-  serial_puts("scheduler_yield: entry\n");
-  if (sched_lock > 0)
+#ifdef CONFIG_PREEMPT_NONE
+  (void) next;
+  (void) now;
+#else
+  if (next == idle_task)
   {
-    serial_puts("scheduler_yield: locked\n");
+    timer_cancel(&slice_timer);
     return;
   }
+  uint64_t slice = SCHED_SLICE_NS;
+  if (is_dl(next) && tasks[next].dl.budget - tasks[next].dl.runtime < slice)
+    slice = tasks[next].dl.budget - tasks[next].dl.runtime;
+  else if (!is_dl(next))
+    slice = group_slice(tasks[next].group, slice, now);
+  timer_arm(&slice_timer, now + slice);
+#endif
+}
 
-  int next = pick_next();
-  if (next < 0)
+/* Lazy TLB: a kernel thread never touches user addresses, so it keeps
+   whatever address space is loaded and only pins it. CR3 is written only
+   when a user task needs an address space other than the loaded one. */
+static void switch_mm(struct task* prev, struct task* next)
+{
+  if (next->mm)
   {
-    serial_puts("scheduler_yield: no next task\n");
+    next->active_mm = next->mm;
+    mm_activate(next->mm);
+  }
+  else
+  {
+    next->active_mm = mm_loaded();
+    mm_get(next->active_mm);
+    mm_note_avoided(1);
+  }
+
+  if (!prev)
     return;
+  if (!prev->mm && prev->active_mm)
+  {
+    mm_put(prev->active_mm);
+    prev->active_mm = NULL;
+  }
+  else if (prev->dead && prev->mm)
+  {
+    mm_put(prev->mm);
+    prev->mm = prev->active_mm = NULL;
   }
+}
 
-  if (next == current)
+int scheduler_set_mm(int id, struct mm* mm)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used || id == current)
+    return -1;
+  mm_get(mm);
+  struct mm* old = tasks[id].mm;
+  tasks[id].mm   = mm;
+  mm_put(old);
+  return 0;
+}
+
+int scheduler_set_personality(int id, int personality)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return -1;
+  tasks[id].personality = personality;
+  return 0;
+}
+
+int scheduler_get_personality(void)
+{
+  return current >= 0 ? tasks[current].personality : PERSONALITY_BYTEOS;
+}
+
+int scheduler_set_user(int id, int user)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return -1;
+  tasks[id].user = user;
+  return 0;
+}
+
+int scheduler_is_user(void)
+{
+  return current >= 0 && tasks[current].user;
+}
+
+int scheduler_set_files(int id, struct fdtable* files)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return -1;
+  fdtable_get(files);
+  struct fdtable* old = tasks[id].files;
+  tasks[id].files     = files;
+  fdtable_put(old);
+  return 0;
+}
+
+struct fdtable* scheduler_get_files(void)
+{
+  return current >= 0 ? tasks[current].files : NULL;
+}
+
+static void load_fs_base(uint64_t base)
+{
+  if (fsgsbase)
+    wrfsbase(base);
+  else
+    wrmsr(MSR_FS_BASE, base);
+  loaded_fs_base = base;
+}
+
+static void load_gs_base(uint64_t base)
+{
+  if (fsgsbase)
+    wrgsbase(base);
+  else
+    wrmsr(MSR_GS_BASE, base);
+  loaded_gs_base = base;
+}
+
+void scheduler_set_fs_base(uint64_t base)
+{
+  uint64_t flags = irq_save();
+  if (current >= 0)
+    tasks[current].fs_base = base;
+  load_fs_base(base);
+  irq_restore(flags);
+}
+
+uint64_t scheduler_get_fs_base(void)
+{
+  if (fsgsbase)
+    return rdfsbase();
+  return current >= 0 ? tasks[current].fs_base : 0;
+}
+
+void scheduler_set_gs_base(uint64_t base)
+{
+  uint64_t flags = irq_save();
+  if (current >= 0)
+    tasks[current].gs_base = base;
+  load_gs_base(base);
+  irq_restore(flags);
+}
+
+uint64_t scheduler_get_gs_base(void)
+{
+  if (fsgsbase)
+    return rdgsbase();
+  return current >= 0 ? tasks[current].gs_base : 0;
+}
+
+/* Kernel threads never touch FS or GS, so like the address space they
+   keep whatever bases are loaded. Threads of one process mostly differ in
+   FS only, and a switch between tasks with equal bases writes nothing. */
+static void switch_user_bases(struct task* out, struct task* next)
+{
+  if (fsgsbase && out && out->mm)
   {
-    serial_puts("scheduler_yield: no switch needed\n");
-    return;
+    /* user code may have moved them with WRFSBASE/WRGSBASE */
+    out->fs_base = loaded_fs_base = rdfsbase();
+    out->gs_base = loaded_gs_base = rdgsbase();
   }
+  if (!next->mm)
+    return;
+  if (next->fs_base != loaded_fs_base)
+    load_fs_base(next->fs_base);
+  if (next->gs_base != loaded_gs_base)
+    load_gs_base(next->gs_base);
+}
+
+/* Saved on every switch: user code may have left anything in them, and
+   nothing traps its first use, so there is no cheaper moment to do it */
+static void switch_fpu(struct task* out, struct task* next)
+{
+  if (out == next)
+    return;
+  if (out)
+    fxsave(out->fpu);
+  fxrstor(next->fpu);
+}
+
+void scheduler_inherit_fpu(int id)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used || current < 0)
+    return;
+  /* the registers are the caller's own while it runs */
+  fxsave(tasks[id].fpu);
+}
+
+void scheduler_reset_fpu(void)
+{
+  fxrstor(fpu_init_state);
+}
+
+int scheduler_set_tgid(int id, int tgid)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used)
+    return -1;
+  tasks[id].tgid = tgid;
+  return 0;
+}
+
+int scheduler_get_tgid(void)
+{
+  return current >= 0 ? tasks[current].tgid : -1;
+}
+
+struct mm* scheduler_get_mm(void)
+{
+  return current >= 0 ? tasks[current].mm : NULL;
+}
+
+void scheduler_set_clear_tid(uint32_t* p)
+{
+  if (current >= 0)
+    tasks[current].clear_tid = p;
+}
+
+uint32_t* scheduler_get_clear_tid(void)
+{
+  return current >= 0 ? tasks[current].clear_tid : NULL;
+}
+
+void scheduler_exec_mm(struct mm* mm)
+{
+  mm_get(mm);
+  preempt_disable();
+  struct task* t   = &tasks[current];
+  struct mm*   old = t->mm;
+  t->mm            = mm;
+  t->active_mm     = mm;
+  mm_activate(mm);
+  preempt_enable();
+  mm_put(old);
+}
+
+int scheduler_set_vfork_parent(int id)
+{
+  if (id < 0 || id >= MAX_TASKS || !tasks[id].used || current < 0 || id == current)
+    return -1;
+  uint64_t flags = irq_save();
+  completion_init(&tasks[current].vfork_done);
+  tasks[id].vfork_parent = current;
+  irq_restore(flags);
+  return 0;
+}
+
+void scheduler_vfork_wait(void)
+{
+  if (current >= 0)
+    completion_wait(&tasks[current].vfork_done);
+}
+
+static void vfork_release(int id)
+{
+  uint64_t flags         = irq_save();
+  int      parent        = tasks[id].vfork_parent;
+  tasks[id].vfork_parent = -1;
+  if (parent >= 0)
+    completion_complete(&tasks[parent].vfork_done);
+  irq_restore(flags);
+}
+
+void scheduler_vfork_release(void)
+{
+  if (current >= 0)
+    vfork_release(current);
+}
+
+int scheduler_kill_thread_group(int tgid)
+{
+  int killed = 0;
+  for (int i = 0; i < MAX_TASKS; ++i)
+    if (i != current && tasks[i].used && !tasks[i].dead && tasks[i].tgid == tgid)
+    {
+      scheduler_mark_dead(i);
+      ++killed;
+    }
+  return killed;
+}
+
+/* RCU callback: nothing can be running on a dead task's stacks once a
+   grace period has passed since it was switched out for the last time */
+static void task_reap(struct rcu_head* head)
+{
+  struct task* t = container_of(head, struct task, reap);
+  fdtable_put(t->files);
+  t->files = NULL;
+  /* killed before it got to switch away as a dead task (or never ran) */
+  mm_put(t->mm);
+  t->mm = t->active_mm = NULL;
+  kfree(t->stack);
+  kfree(t->kernel_stack);
+  t->stack        = NULL;
+  t->kernel_stack = NULL;
+  t->sp           = NULL;
+  __atomic_store_n(&t->used, 0, __ATOMIC_RELEASE);
+}
+
+/* interrupts must be disabled */
+static void queue_reap(struct task* t)
+{
+  if (t->reaping)
+    return;
+  t->reaping = 1;
+  rcu_note_task_exit(&t->rcu);
+  call_rcu(&t->reap, task_reap);
+}
+
+/* Switch from current to next; interrupts must be disabled */
+static void context_switch(int next, uint64_t now)
+{
+  struct task* out = current >= 0 ? &tasks[current] : NULL;
+  /* out's stack stays in use until the switch below; RCU callbacks only
+     run from softirq context, which cannot happen before then */
+  if (out && out->dead)
+    queue_reap(out);
+  rcu_note_context_switch(out ? &out->rcu : NULL, &tasks[next].rcu);
+
+  tasks[next].run_start = now;
+  switch_mm(out, &tasks[next]);
+  switch_user_bases(out, &tasks[next]);
+  switch_fpu(out, &tasks[next]);
+  /* ring 3 -> ring 0 entries land on the task's own kernel stack */
+  percpu_set_kernel_stack((uint64_t) (uintptr_t) tasks[next].kernel_stack + STACK_SIZE);
 
   int prev = current;
   current  = next;
+  vdso_note_switch(tasks[next].tgid, tasks[next].personality);
 
-  serial_puts("scheduler_yield: switching from ");
-  serial_putdec((uint64_t) prev);
-  serial_puts(" to ");
-  serial_putdec((uint64_t) current);
-  serial_puts("\n");
+  sched_trace("scheduler_yield: switching from ");
+  sched_trace_dec((uint64_t) prev);
+  sched_trace(" to ");
+  sched_trace_dec((uint64_t) current);
+  sched_trace("\n");
 
   if (prev >= 0)
   {
@@ -266,7 +1303,126 @@ void scheduler_yield(void)
     uint64_t* dummy = NULL;
     scheduler_switch(&dummy, tasks[next].sp);
   }
-  serial_puts("scheduler_yield: switched\n");
+}
+
+void scheduler_yield(void)
+{
+  sched_trace("scheduler_yield: entry\n");
+  if (preempt_count())
+  {
+    sched_trace("scheduler_yield: locked\n");
+    return;
+  }
+
+  uint64_t flags = irq_save();
+  uint64_t now   = clock_now_ns();
+  if (current >= 0)
+    account(current, now);
+
+  int next = pick_next(now);
+  if (next < 0)
+  {
+    sched_trace("scheduler_yield: no next task\n");
+    irq_restore(flags);
+    return;
+  }
+
+  handoff_chain             = 0;
+  handoff_next              = -1;
+  preempt_cpu0.need_resched = 0;
+  arm_slice(next, now);
+  if (next == current)
+  {
+    sched_trace("scheduler_yield: no switch needed\n");
+    irq_restore(flags);
+    return;
+  }
+  context_switch(next, now);
+  irq_restore(flags);
+  sched_trace("scheduler_yield: switched\n");
+}
+
+/* May the CPU go straight to id without breaking the scheduling
+   guarantees? Interrupts must be disabled. */
+static int handoff_allowed(int id, uint64_t now)
+{
+  if (id < 0 || id >= MAX_TASKS || id == current || id == idle_task)
+    return 0;
+  if (!tasks[id].used || tasks[id].dead || is_blocked(id))
+    return 0;
+  if (handoff_chain >= SCHED_MAX_HANDOFF_CHAIN)
+    return 0;
+  /* never jump ahead of a deadline task that is owed the CPU (the caller
+     itself is giving the CPU away, so it does not count) */
+  int dl = pick_dl(now, current);
+  if (dl >= 0 && dl != id)
+    return 0;
+  if (is_dl(id) && !dl_eligible(id, now))
+    return 0;
+  if (!is_dl(id) && group_throttled(tasks[id].group))
+    return 0;
+  return 1;
+}
+
+int scheduler_yield_to(int id)
+{
+  if (current < 0)
+    return 0;
+  if (preempt_count())
+  {
+    /* softirq or preemption off: the switch happens at the next
+       preemption point (IRQ exit for a wake from a bottom half) */
+    handoff_next = id;
+    set_need_resched();
+    return 0;
+  }
+
+  uint64_t flags = irq_save();
+  uint64_t now   = clock_now_ns();
+  account(current, now);
+  if (!handoff_allowed(id, now))
+  {
+    irq_restore(flags);
+    scheduler_yield();
+    return 0;
+  }
+  ++handoff_chain;
+  ++tasks[current].handoffs_out;
+  ++tasks[id].handoffs_in;
+  handoff_next              = -1;
+  preempt_cpu0.need_resched = 0;
+  arm_slice(id, now);
+  context_switch(id, now);
+  irq_restore(flags);
+  return 1;
+}
+
+static void preempt_switch(void)
+{
+  int self             = current;
+  tasks[self].preempted = 1;
+  if (handoff_next >= 0)
+    scheduler_yield_to(handoff_next);
+  else
+    scheduler_yield();
+  tasks[self].preempted = 0;
+}
+
+void preempt_schedule(void)
+{
+  if (!preempt_cpu0.need_resched || preempt_cpu0.count || current < 0 || !irq_enabled())
+    return;
+  preempt_switch();
+}
+
+void preempt_schedule_irq(void)
+{
+#ifdef CONFIG_PREEMPT_FULL
+  /* interrupts are off here but were on in the interrupted context */
+  if (!preempt_cpu0.need_resched || preempt_cpu0.count || current < 0)
+    return;
+  preempt_switch();
+#endif
 }
 
 int scheduler_get_tasks(struct scheduler_task_info* out, int max)
@@ -276,16 +1432,27 @@ int scheduler_get_tasks(struct scheduler_task_info* out, int max)
 
   int count = 0;
 
+  rcu_read_lock();
   for (int i = 0; i < MAX_TASKS && count < max; ++i)
   {
-    if (tasks[i].used)
+    if (__atomic_load_n(&tasks[i].used, __ATOMIC_ACQUIRE))
     {
-      out[count].id   = i;
-      out[count].used = tasks[i].used;
-      out[count].dead = tasks[i].dead;
+      out[count].id        = i;
+      out[count].used      = tasks[i].used;
+      out[count].dead      = tasks[i].dead;
+      out[count].blocked   = tasks[i].blocked;
+      out[count].deadline  = is_dl(i);
+      out[count].period_ns = tasks[i].dl.period;
+      out[count].budget_ns = tasks[i].dl.budget;
+      out[count].overruns  = tasks[i].dl.overruns;
+      out[count].misses    = tasks[i].dl.misses;
+      out[count].handoffs  = tasks[i].handoffs_in;
+      out[count].group     = tasks[i].group;
+      out[count].tgid      = tasks[i].tgid;
       count++;
     }
   }
+  rcu_read_unlock();
 
   return count;
 }
@@ -298,17 +1465,25 @@ void scheduler_run(void)
 
   while (1)
   {
-    current = pick_next();
+    current = pick_next(clock_now_ns());
     if (current < 0)
     {
       serial_puts("scheduler: no tasks to run\n");
       break;
     }
 
-    serial_puts("scheduler: switching to task ");
-    serial_putdec((uint64_t) current);
-    serial_puts("\n");
+    sched_trace("scheduler: switching to task ");
+    sched_trace_dec((uint64_t) current);
+    sched_trace("\n");
 
+    tasks[current].run_start = clock_now_ns();
+    arm_slice(current, tasks[current].run_start);
+    rcu_note_context_switch(NULL, &tasks[current].rcu);
+    vdso_note_switch(tasks[current].tgid, tasks[current].personality);
+    switch_mm(NULL, &tasks[current]);
+    switch_user_bases(NULL, &tasks[current]);
+    switch_fpu(NULL, &tasks[current]);
+    percpu_set_kernel_stack((uint64_t) (uintptr_t) tasks[current].kernel_stack + STACK_SIZE);
     uint64_t* dummy = NULL;
     scheduler_switch(&dummy, tasks[current].sp);
   }
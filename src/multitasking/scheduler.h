@@ -9,6 +9,38 @@ struct scheduler_task_info {
     int id;
     int used;
     int dead;
+    int blocked;
+    int deadline;      /* 1 if in the deadline class */
+    uint64_t period_ns;
+    uint64_t budget_ns;
+    uint64_t overruns; /* periods in which the budget was exceeded */
+    uint64_t misses;   /* jobs that finished after their deadline */
+    uint64_t handoffs; /* directed switches received */
+    int group;
+    int tgid;
+};
+
+#define SCHED_MAX_TASKS       16
+#define SCHED_MAX_GROUPS      8
+#define SCHED_GROUP_NAME_LEN  16
+#define SCHED_ROOT_GROUP      0
+#define SCHED_WEIGHT_DEFAULT  1024
+#define SCHED_WEIGHT_MIN      2
+#define SCHED_WEIGHT_MAX      262144
+
+struct scheduler_group_info {
+    int id;
+    int parent;
+    char name[SCHED_GROUP_NAME_LEN];
+    uint32_t weight;
+    uint64_t quota_ns;     /* 0 = unlimited */
+    uint64_t period_ns;
+    int throttled;
+    int nr_tasks;
+    uint64_t usage_ns;
+    uint64_t nr_periods;
+    uint64_t nr_throttled; /* periods in which the quota ran out */
+    uint64_t throttled_ns;
 };
 
 int scheduler_init(void); 
@@ -17,7 +49,104 @@ void scheduler_run(void);
 void scheduler_yield(void);
 int scheduler_get_current(void);
 void scheduler_mark_dead(int id);
+/* Blocking: mark the current task as waiting, publish it to whoever will
+   wake it (timer, wait queue), then call scheduler_wait(). A wake that races
+   in between simply makes scheduler_wait() return immediately. */
+void scheduler_prepare_wait(void);
+void scheduler_wait(void);
+/* For the duration of a wait: how to take the calling task off the wait
+   queue, futex or timer it is hooked on (which live on its stack) should
+   it be killed meanwhile. scheduler_mark_dead runs fn(arg) with
+   interrupts disabled; pass NULL once the wait is over. */
+typedef void (*wait_cancel_fn)(void *arg);
+void scheduler_set_wait_cancel(wait_cancel_fn fn, void *arg);
+void scheduler_wake(int id);
+/* The idle task only runs when nothing else is runnable */
+void scheduler_set_idle(int id);
+/* Workqueue workers get notified when they block/resume inside a work item */
+void scheduler_set_worker(int id);
+int scheduler_has_work(void);
+/* Deadline class (EDF): the task is guaranteed budget_ns of CPU in every
+   period_ns and always runs ahead of ordinary tasks while it has budget.
+   Admission fails (-1) if the total reserved utilisation would exceed
+   SCHED_DL_MAX_UTIL_PPM. period_ns == 0 returns the task to round robin. */
+#define SCHED_DL_MAX_UTIL_PPM 950000
+int scheduler_set_deadline(int id, uint64_t period_ns, uint64_t budget_ns);
+/* End of the current job: block until the next period starts */
+void scheduler_wait_next_period(void);
+/* Directed yield: switch straight to task id instead of the next task in
+   the rotation; a producer uses it to hand the CPU to its consumer. The
+   rotation order is unaffected, handoffs never overtake a deadline task
+   that still has budget, and a chain of SCHED_MAX_HANDOFF_CHAIN handoffs
+   in a row falls back to a normal pick. Returns 1 if the CPU went to id,
+   0 if it fell back to scheduler_yield(). From a softirq or with
+   preemption disabled the switch is deferred to the next preemption
+   point and 0 is returned. Never call it from hard-IRQ context. */
+int scheduler_yield_to(int id);
+/* Give task id its own address space (takes a reference); tasks without
+   one are kernel threads and borrow the loaded address space */
+struct mm;
+int scheduler_set_mm(int id, struct mm *mm);
+/* Syscall numbering of task id (PERSONALITY_*); tasks start native */
+int scheduler_set_personality(int id, int personality);
+int scheduler_get_personality(void);
+/* Task id runs ring-3 code, or works on behalf of a task that does: user
+   pointers it is handed are checked even when it has no mm of its own */
+int scheduler_set_user(int id, int user);
+int scheduler_is_user(void);
+/* x87/SSE registers: task id starts with a copy of the running task's
+   (clone), or the running task goes back to the reset state (exec) */
+void scheduler_inherit_fpu(int id);
+void scheduler_reset_fpu(void);
+/* Descriptor table of task id (takes a reference, dropped when the task
+   is reaped); NULL for tasks that have none */
+struct fdtable;
+int scheduler_set_files(int id, struct fdtable *files);
+struct fdtable *scheduler_get_files(void);
+/* TLS: the running task's FS and GS bases. They are reloaded on a switch
+   only when the incoming user task's differ from the loaded ones, with
+   WRFSBASE/WRGSBASE when the CPU has FSGSBASE and WRMSR otherwise. */
+void scheduler_set_fs_base(uint64_t base);
+uint64_t scheduler_get_fs_base(void);
+void scheduler_set_gs_base(uint64_t base);
+uint64_t scheduler_get_gs_base(void);
+/* Threads: tasks sharing an address space (and usually descriptors) form
+   a thread group whose id is the first task's; that is the pid user code
+   sees, the task id its tid */
+int scheduler_set_tgid(int id, int tgid);
+int scheduler_get_tgid(void);
+/* The running task's own address space, NULL for kernel threads */
+struct mm *scheduler_get_mm(void);
+/* set_tid_address / CLONE_CHILD_CLEARTID word of the running task */
+void scheduler_set_clear_tid(uint32_t *p);
+uint32_t *scheduler_get_clear_tid(void);
+/* exec: make mm the running task's address space and load it, dropping
+   the one it had (its own, or its vfork parent's) */
+void scheduler_exec_mm(struct mm *mm);
+/* vfork: the running task becomes task id's parent and, in
+   scheduler_vfork_wait(), waits until id stops borrowing its address
+   space by exec, exit or being killed (scheduler_vfork_release() on the
+   child's side). The completion lives in the parent's task, and a parent
+   killed first is dropped from the child. */
+int scheduler_set_vfork_parent(int id);
+void scheduler_vfork_wait(void);
+void scheduler_vfork_release(void);
+/* Mark every other task of thread group tgid dead; returns how many */
+int scheduler_kill_thread_group(int tgid);
 int scheduler_get_tasks(struct scheduler_task_info *out, int max);
+/* Task groups (CPU bandwidth control). Sibling groups share their parent's
+   CPU time in proportion to their weights; a quota of quota_ns per
+   period_ns caps a whole subtree, which is throttled until its next period
+   once the quota is used up. Tasks start in the root group. Deadline
+   tasks are scheduled by their own reservation and ignore groups. */
+int scheduler_group_create(const char *name, int parent, uint32_t weight);
+/* Fails while the group still has live tasks or child groups */
+int scheduler_group_destroy(int gid);
+int scheduler_group_set_weight(int gid, uint32_t weight);
+/* quota_ns == 0 removes the limit */
+int scheduler_group_set_bandwidth(int gid, uint64_t quota_ns, uint64_t period_ns);
+int scheduler_group_attach(int gid, int id);
+int scheduler_get_groups(struct scheduler_group_info *out, int max);
 void scheduler_lock(void);
 void scheduler_unlock(void);
 
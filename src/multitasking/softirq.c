@@ -0,0 +1,89 @@
+#include "multitasking/softirq.h"
+#include "boot/cpu.h"
+#include "multitasking/preempt.h"
+#include "multitasking/rcu.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* A bottom half that keeps re-raising itself must not starve the interrupted
+   task forever; whatever is left after this many passes waits for the next
+   IRQ exit or the idle loop. */
+#define SOFTIRQ_MAX_RESTART 10
+
+/* Per-CPU softirq state. ByteOS only brings up the BSP, so there is exactly
+   one instance. */
+struct softirq_cpu
+{
+  volatile uint32_t pending;
+  int               active; /* nesting guard: IRQs are on while handlers run */
+  uint64_t          count[NR_SOFTIRQS];
+};
+
+static struct softirq_cpu cpu0;
+static softirq_fn         handlers[NR_SOFTIRQS];
+
+void softirq_register(int nr, softirq_fn fn)
+{
+  if (nr >= 0 && nr < NR_SOFTIRQS)
+    handlers[nr] = fn;
+}
+
+void softirq_raise(int nr)
+{
+  if (nr < 0 || nr >= NR_SOFTIRQS)
+    return;
+  uint64_t flags = irq_save();
+  cpu0.pending |= 1U << nr;
+  irq_restore(flags);
+}
+
+int softirq_pending(void)
+{
+  return cpu0.pending != 0;
+}
+
+void softirq_run(void)
+{
+  uint64_t flags = irq_save();
+  if (cpu0.active || !cpu0.pending)
+  {
+    irq_restore(flags);
+    return;
+  }
+  cpu0.active = 1;
+
+  for (int pass = 0; pass < SOFTIRQ_MAX_RESTART && cpu0.pending; ++pass)
+  {
+    uint32_t pending = cpu0.pending;
+    cpu0.pending     = 0;
+    preempt_cpu0.count += SOFTIRQ_OFFSET; /* handlers must not be preempted */
+    asm volatile("sti" : : : "memory");
+    for (int nr = 0; nr < NR_SOFTIRQS; ++nr)
+    {
+      if (!(pending & (1U << nr)) || !handlers[nr])
+        continue;
+      handlers[nr]();
+      ++cpu0.count[nr];
+    }
+    asm volatile("cli" : : : "memory");
+    preempt_cpu0.count -= SOFTIRQ_OFFSET;
+  }
+
+  cpu0.active = 0;
+  irq_restore(flags);
+}
+
+void irq_exit(void)
+{
+  if (cpu0.pending && !cpu0.active)
+    softirq_run();
+  rcu_check_qs();
+  preempt_schedule_irq();
+}
+
+uint64_t softirq_count(int nr)
+{
+  if (nr < 0 || nr >= NR_SOFTIRQS)
+    return 0;
+  return cpu0.count[nr];
+}
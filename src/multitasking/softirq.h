@@ -0,0 +1,36 @@
+#ifndef MULTITASKING_SOFTIRQ_H
+#define MULTITASKING_SOFTIRQ_H
+
+#include <stdint.h>
+
+/* Bottom halves: hard-IRQ handlers acknowledge the device, raise one of these
+   and return; the handler then runs on IRQ exit with interrupts enabled.
+   Raising an already-pending vector is free, so bursts get batched. */
+enum
+{
+  SOFTIRQ_TIMER = 0, /* timer wheel expiry */
+  SOFTIRQ_BLOCK,     /* disk request completion */
+  SOFTIRQ_INPUT,     /* keyboard/mouse decoding */
+  SOFTIRQ_RCU,       /* RCU callbacks after a grace period */
+  NR_SOFTIRQS
+};
+
+typedef void (*softirq_fn)(void);
+
+void softirq_register(int nr, softirq_fn fn);
+
+/* Mark nr pending; safe from any context */
+void softirq_raise(int nr);
+
+/* Run pending bottom halves unless already inside one */
+void softirq_run(void);
+
+int softirq_pending(void);
+
+/* Called by the IRQ stub after the hard-IRQ handler returns; runs bottom
+   halves, then preempts the interrupted task if it is due */
+void irq_exit(void);
+
+uint64_t softirq_count(int nr);
+
+#endif
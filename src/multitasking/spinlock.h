@@ -0,0 +1,52 @@
+#ifndef MULTITASKING_SPINLOCK_H
+#define MULTITASKING_SPINLOCK_H
+
+#include "boot/cpu.h"
+#include "multitasking/preempt.h"
+#include <stdint.h>
+
+/* Spinlocks disable preemption while held. The _irqsave variants also
+   keep interrupts off, for data shared with IRQ or softirq context. */
+
+typedef struct
+{
+  volatile int locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT {0}
+
+static inline void spin_lock_init(spinlock_t* l)
+{
+  l->locked = 0;
+}
+
+static inline void spin_lock(spinlock_t* l)
+{
+  preempt_disable();
+  while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE))
+    cpu_relax();
+}
+
+static inline void spin_unlock(spinlock_t* l)
+{
+  __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+  preempt_enable();
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t* l)
+{
+  uint64_t flags = irq_save();
+  preempt_disable();
+  while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE))
+    cpu_relax();
+  return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* l, uint64_t flags)
+{
+  __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+  irq_restore(flags);
+  preempt_enable();
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include "multitasking/waitqueue.h"
+#include "boot/cpu.h"
+#include "multitasking/scheduler.h"
+#include <stddef.h>
+#include <stdint.h>
+
+void waitqueue_init(struct waitqueue* wq)
+{
+  wq->head = NULL;
+}
+
+void wait_entry_setup(struct wait_entry* e, wait_fn fn, void* priv)
+{
+  e->next = NULL;
+  e->wq   = NULL;
+  e->fn   = fn;
+  e->priv = priv;
+}
+
+void waitqueue_add(struct waitqueue* wq, struct wait_entry* e)
+{
+  uint64_t flags = irq_save();
+  if (!e->wq)
+  {
+    /* append: wake_one then serves waiters in FIFO order */
+    struct wait_entry** pp = &wq->head;
+    while (*pp)
+      pp = &(*pp)->next;
+    e->next = NULL;
+    e->wq   = wq;
+    *pp     = e;
+  }
+  irq_restore(flags);
+}
+
+/* interrupts must be disabled */
+static void unlink_entry(struct wait_entry* e)
+{
+  struct wait_entry** pp = &e->wq->head;
+  while (*pp && *pp != e)
+    pp = &(*pp)->next;
+  if (*pp)
+    *pp = e->next;
+  e->next = NULL;
+  e->wq   = NULL;
+}
+
+void waitqueue_remove(struct wait_entry* e)
+{
+  uint64_t flags = irq_save();
+  if (e->wq)
+    unlink_entry(e);
+  irq_restore(flags);
+}
+
+static void wake_thread(struct wait_entry* e)
+{
+  scheduler_wake((int) (intptr_t) e->priv);
+}
+
+/* Wake up to max waiters; with thread non-NULL the first thread woken is
+   stored there for a handoff */
+static int wake_n(struct waitqueue* wq, int max, int* thread)
+{
+  int      woken = 0;
+  uint64_t flags = irq_save();
+  while (wq->head && woken < max)
+  {
+    struct wait_entry* e = wq->head;
+    unlink_entry(e);
+    if (thread && *thread < 0 && e->fn == wake_thread)
+      *thread = (int) (intptr_t) e->priv;
+    if (e->fn)
+      e->fn(e);
+    ++woken;
+  }
+  irq_restore(flags);
+  return woken;
+}
+
+int waitqueue_wake_one(struct waitqueue* wq)
+{
+  return wake_n(wq, 1, NULL);
+}
+
+int waitqueue_wake_all(struct waitqueue* wq)
+{
+  return wake_n(wq, 0x7FFFFFFF, NULL);
+}
+
+int waitqueue_wake_all_sync(struct waitqueue* wq)
+{
+  int tid   = -1;
+  int woken = wake_n(wq, 0x7FFFFFFF, &tid);
+  if (tid >= 0)
+    scheduler_yield_to(tid);
+  return woken;
+}
+
+/* scheduler_mark_dead: interrupts are off */
+static void cancel_wait(void* arg)
+{
+  struct wait_entry* e = arg;
+  if (e->wq)
+    unlink_entry(e);
+}
+
+void waitqueue_wait(struct waitqueue* wq, int (*cond)(void*), void* arg)
+{
+  struct wait_entry e;
+  wait_entry_setup(&e, wake_thread, (void*) (intptr_t) scheduler_get_current());
+  scheduler_set_wait_cancel(cancel_wait, &e);
+  for (;;)
+  {
+    uint64_t flags = irq_save();
+    if (cond(arg))
+    {
+      if (e.wq)
+        unlink_entry(&e);
+      irq_restore(flags);
+      scheduler_set_wait_cancel(NULL, NULL);
+      return;
+    }
+    waitqueue_add(wq, &e);
+    scheduler_prepare_wait();
+    irq_restore(flags);
+    scheduler_wait();
+  }
+}
+
+void completion_init(struct completion* c)
+{
+  c->done = 0;
+  waitqueue_init(&c->wq);
+}
+
+void completion_reinit(struct completion* c)
+{
+  c->done = 0;
+}
+
+void completion_complete(struct completion* c)
+{
+  uint64_t flags = irq_save();
+  c->done        = 1;
+  waitqueue_wake_all(&c->wq);
+  irq_restore(flags);
+}
+
+static int completion_is_done(void* arg)
+{
+  return ((struct completion*) arg)->done;
+}
+
+void completion_wait(struct completion* c)
+{
+  waitqueue_wait(&c->wq, completion_is_done, c);
+}
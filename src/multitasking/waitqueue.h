@@ -0,0 +1,60 @@
+#ifndef MULTITASKING_WAITQUEUE_H
+#define MULTITASKING_WAITQUEUE_H
+
+#include <stdint.h>
+
+/* Wait queues: a list of wake callbacks. Blocked threads and async tasks
+   both park here; the waker does not care which kind it is waking.
+   Waking removes the entry (auto-remove), so a waiter re-arms if it has to
+   wait again. */
+
+struct wait_entry;
+typedef void (*wait_fn)(struct wait_entry*);
+
+struct waitqueue
+{
+  struct wait_entry* head;
+};
+
+struct wait_entry
+{
+  struct wait_entry* next;
+  struct waitqueue*  wq; /* NULL when not queued */
+  wait_fn            fn;
+  void*              priv;
+};
+
+void waitqueue_init(struct waitqueue* wq);
+void wait_entry_setup(struct wait_entry* e, wait_fn fn, void* priv);
+
+/* Add/remove with interrupts disabled internally; add is a no-op if e is
+   already queued somewhere */
+void waitqueue_add(struct waitqueue* wq, struct wait_entry* e);
+void waitqueue_remove(struct wait_entry* e);
+
+/* Returns the number of waiters woken */
+int waitqueue_wake_one(struct waitqueue* wq);
+int waitqueue_wake_all(struct waitqueue* wq);
+/* Wake all waiters and hand the CPU straight to the first thread among
+   them (scheduler_yield_to), for producer -> consumer handoffs. From a
+   softirq the switch happens on IRQ exit; never call it from hard-IRQ
+   context. */
+int waitqueue_wake_all_sync(struct waitqueue* wq);
+
+/* Block the calling thread until cond(arg) is true. cond is evaluated with
+   interrupts disabled after the waiter is queued, so no wake is lost. */
+void waitqueue_wait(struct waitqueue* wq, int (*cond)(void*), void* arg);
+
+/* One-shot completion event, e.g. for an I/O request */
+struct completion
+{
+  volatile int     done;
+  struct waitqueue wq;
+};
+
+void completion_init(struct completion* c);
+void completion_complete(struct completion* c);
+void completion_wait(struct completion* c);
+void completion_reinit(struct completion* c);
+
+#endif
@@ -0,0 +1,195 @@
+#include "multitasking/workqueue.h"
+#include "boot/cpu.h"
+#include "multitasking/scheduler.h"
+#include "serial/serial.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Concurrency management, after Linux's cmwq: nr_running counts workers that
+   are executing and not blocked. Queueing only wakes a worker when nothing
+   is running, so bursts are drained in one go by one thread. If the running
+   worker blocks inside a work item with more work queued, an idle worker is
+   woken (or a new one spawned, up to WQ_MAX_WORKERS) so the queue keeps
+   moving without oversubscribing the CPU. */
+
+#define WQ_MAX_WORKERS 4
+#define WQ_MIN_WORKERS 2
+
+struct worker
+{
+  int tid;
+  int busy; /* executing a work item */
+  int idle; /* parked waiting for work */
+};
+
+static struct worker workers[WQ_MAX_WORKERS];
+static int           nr_workers  = 0;
+static int           nr_running  = 0;
+static int           nr_idle     = 0;
+static int           max_running = 0;
+static struct work*  wq_head     = NULL;
+static struct work*  wq_tail     = NULL;
+static uint64_t      nr_queued   = 0;
+static uint64_t      nr_executed = 0;
+
+static void worker_loop(void* arg);
+
+/* must be called with interrupts disabled */
+static void wake_idle_worker(void)
+{
+  for (int i = 0; i < nr_workers; ++i)
+  {
+    if (workers[i].idle)
+    {
+      workers[i].idle = 0;
+      --nr_idle;
+      ++nr_running;
+      scheduler_wake(workers[i].tid);
+      return;
+    }
+  }
+}
+
+static int spawn_worker(void)
+{
+  if (nr_workers >= WQ_MAX_WORKERS)
+    return -1;
+  struct worker* w = &workers[nr_workers];
+  w->busy          = 0;
+  w->idle          = 0;
+  int tid          = task_create(worker_loop, w);
+  if (tid < 0)
+    return -1;
+  w->tid = tid;
+  scheduler_set_worker(tid);
+  uint64_t flags = irq_save();
+  ++nr_workers;
+  ++nr_running;
+  irq_restore(flags);
+  return tid;
+}
+
+static void worker_loop(void* arg)
+{
+  struct worker* me = (struct worker*) arg;
+  for (;;)
+  {
+    uint64_t     flags = irq_save();
+    struct work* w     = wq_head;
+    if (!w)
+    {
+      me->idle = 1;
+      ++nr_idle;
+      --nr_running;
+      scheduler_prepare_wait();
+      irq_restore(flags);
+      scheduler_wait();
+      continue;
+    }
+    wq_head = w->next;
+    if (!wq_head)
+      wq_tail = NULL;
+    w->next    = NULL;
+    w->pending = 0; /* may be re-queued while it runs */
+    me->busy   = 1;
+    if (nr_running > max_running)
+      max_running = nr_running;
+    irq_restore(flags);
+
+    w->fn(w->arg);
+
+    me->busy = 0;
+    ++nr_executed;
+  }
+}
+
+static struct worker* find_worker(int tid)
+{
+  for (int i = 0; i < nr_workers; ++i)
+    if (workers[i].tid == tid)
+      return &workers[i];
+  return NULL;
+}
+
+void workqueue_worker_sleeping(int tid)
+{
+  struct worker* me = find_worker(tid);
+  if (!me || !me->busy)
+    return;
+  uint64_t flags = irq_save();
+  --nr_running;
+  int need = wq_head && nr_running == 0;
+  if (need && nr_idle)
+  {
+    wake_idle_worker();
+    need = 0;
+  }
+  irq_restore(flags);
+  if (need)
+    spawn_worker();
+}
+
+void workqueue_worker_running(int tid)
+{
+  struct worker* me = find_worker(tid);
+  if (!me || !me->busy)
+    return;
+  uint64_t flags = irq_save();
+  ++nr_running;
+  irq_restore(flags);
+}
+
+int workqueue_init(void)
+{
+  serial_puts("workqueue: init\n");
+  for (int i = 0; i < WQ_MIN_WORKERS; ++i)
+  {
+    if (spawn_worker() < 0)
+    {
+      serial_puts("workqueue: failed to spawn worker\n");
+      return nr_workers ? 0 : -1;
+    }
+  }
+  return 0;
+}
+
+void work_setup(struct work* w, work_fn fn, void* arg)
+{
+  w->next    = NULL;
+  w->fn      = fn;
+  w->arg     = arg;
+  w->pending = 0;
+}
+
+int work_queue(struct work* w)
+{
+  uint64_t flags = irq_save();
+  if (w->pending)
+  {
+    irq_restore(flags);
+    return 0;
+  }
+  w->pending = 1;
+  w->next    = NULL;
+  if (wq_tail)
+    wq_tail->next = w;
+  else
+    wq_head = w;
+  wq_tail = w;
+  ++nr_queued;
+  if (nr_running == 0)
+    wake_idle_worker();
+  irq_restore(flags);
+  return 1;
+}
+
+void workqueue_get_stats(struct workqueue_stats* out)
+{
+  if (!out)
+    return;
+  out->queued      = nr_queued;
+  out->executed    = nr_executed;
+  out->workers     = nr_workers;
+  out->running     = nr_running;
+  out->max_running = max_running;
+}
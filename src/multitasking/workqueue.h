@@ -0,0 +1,44 @@
+#ifndef MULTITASKING_WORKQUEUE_H
+#define MULTITASKING_WORKQUEUE_H
+
+#include <stdint.h>
+
+/* Kernel workqueue: process-context deferral for work that may block (disk
+   I/O, allocation, compositing). Items run on a small pool of kernel worker
+   threads; the pool keeps one worker runnable while there is work and brings
+   in another only when the running one blocks. */
+
+typedef void (*work_fn)(void*);
+
+struct work
+{
+  struct work* next;
+  work_fn      fn;
+  void*        arg;
+  int          pending;
+};
+
+struct workqueue_stats
+{
+  uint64_t queued;
+  uint64_t executed;
+  int      workers;
+  int      running;
+  int      max_running;
+};
+
+int workqueue_init(void);
+
+void work_setup(struct work* w, work_fn fn, void* arg);
+
+/* Queue w unless it is already pending; safe from IRQ/softirq context.
+   Returns 1 if queued, 0 if it was already pending. */
+int work_queue(struct work* w);
+
+void workqueue_get_stats(struct workqueue_stats* out);
+
+/* Scheduler hooks for concurrency management (worker tasks only) */
+void workqueue_worker_sleeping(int tid);
+void workqueue_worker_running(int tid);
+
+#endif
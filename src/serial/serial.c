@@ -1,6 +1,11 @@
 #include "serial/serial.h"
+#include "multitasking/spinlock.h"
 #include <stdint.h>
 
+/* One writer at a time, so lines from preempted tasks do not interleave
+   mid-string; irqsave because interrupt handlers log too */
+static spinlock_t serial_lock = SPINLOCK_INIT;
+
 static inline void outb(uint16_t port, uint8_t val)
 {
   asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
@@ -24,7 +29,8 @@ void serial_init(void)
   outb(COM1 + 4, 0x0B);  // IRQs enabled, RTS/DSR set
 }
 
-void serial_putc(char c)
+/* serial_lock held */
+static void put_locked(char c)
 {
   const uint16_t COM1 = 0x3F8;
   while ((inb(COM1 + 5) & 0x20) == 0)
@@ -33,21 +39,37 @@ void serial_putc(char c)
   outb(COM1 + 0, (uint8_t) c);
 }
 
-void serial_puts(const char* s)
+static void puts_locked(const char* s)
 {
   while (*s)
-    serial_putc(*s++);
+    put_locked(*s++);
+}
+
+void serial_putc(char c)
+{
+  uint64_t flags = spin_lock_irqsave(&serial_lock);
+  put_locked(c);
+  spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+void serial_puts(const char* s)
+{
+  uint64_t flags = spin_lock_irqsave(&serial_lock);
+  puts_locked(s);
+  spin_unlock_irqrestore(&serial_lock, flags);
 }
 
 void serial_puthex64(uint64_t v)
 {
-  const char* hex = "0123456789ABCDEF";
-  serial_puts("0x");
+  const char* hex   = "0123456789ABCDEF";
+  uint64_t    flags = spin_lock_irqsave(&serial_lock);
+  puts_locked("0x");
   for (int i = 15; i >= 0; --i)
   {
-    serial_putc(hex[(v >> (i * 4)) & 0xF]);
+    put_locked(hex[(v >> (i * 4)) & 0xF]);
   }
-  serial_puts("\n");
+  puts_locked("\n");
+  spin_unlock_irqrestore(&serial_lock, flags);
 }
 
 void serial_putdec(uint64_t v)
@@ -55,17 +77,15 @@ void serial_putdec(uint64_t v)
   char buf[32];
   int  i = 0;
   if (v == 0)
-  {
-    serial_putc('0');
-    serial_puts("\n");
-    return;
-  }
+    buf[i++] = '0';
   while (v)
   {
     buf[i++] = '0' + (v % 10);
     v /= 10;
   }
+  uint64_t flags = spin_lock_irqsave(&serial_lock);
   for (int j = i - 1; j >= 0; --j)
-    serial_putc(buf[j]);
-  serial_puts("\n");
+    put_locked(buf[j]);
+  puts_locked("\n");
+  spin_unlock_irqrestore(&serial_lock, flags);
 }
@@ -1,16 +1,233 @@
 #include "shell/shell.h"
 #include "compat/panic.h"
 #include "console/console.h"
+#include "console/tty.h"
 #include "drivers/keyboard/keyboard.h"
+#include "fs/inode.h"
+#include "fs/pipe.h"
 #include "graphics/font.h"
 #include "graphics/framebuffer.h"
+#include "lib/libc.h"
+#include "mem/mm.h"
+#include "multitasking/async.h"
+#include "multitasking/idle.h"
+#include "multitasking/rcu.h"
 #include "multitasking/scheduler.h"
 #include "serial/serial.h"
+#include "sys/proc.h"
+#include "syscall/syscall.h"
+#include "syscall/sysno.h"
+#include "syscall/uring.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include "userspace/sysbench.h"
 #include <stdint.h>
 #include <string.h>
 
-/* declare kernel helper to spawn ELF by path */
-extern int kernel_spawn_elf_from_path(const char* path);
+#define SHELL_EXEC_ARGS 8
+
+/* Copy the next space-separated word of s into out; returns the rest */
+static const char* next_word(const char* s, char* out, size_t max)
+{
+  while (*s == ' ')
+    ++s;
+  size_t n = 0;
+  while (*s && *s != ' ')
+  {
+    if (n + 1 < max)
+      out[n++] = *s;
+    ++s;
+  }
+  out[n] = '\0';
+  return s;
+}
+
+static void shell_group(const char* args)
+{
+  char cmd[16], a[SCHED_GROUP_NAME_LEN], b[24], c[24];
+  args = next_word(args, cmd, sizeof(cmd));
+  args = next_word(args, a, sizeof(a));
+  args = next_word(args, b, sizeof(b));
+  next_word(args, c, sizeof(c));
+
+  int rc = 0;
+  if (strcmp(cmd, "new") == 0 && a[0])
+  {
+    int parent = b[0] ? atoi(b) : SCHED_ROOT_GROUP;
+    int weight = c[0] ? atoi(c) : SCHED_WEIGHT_DEFAULT;
+    rc         = scheduler_group_create(a, parent, (uint32_t) weight);
+    if (rc >= 0)
+      console_printf("group: created %s as %d\n", a, rc);
+  }
+  else if (strcmp(cmd, "del") == 0 && a[0])
+    rc = scheduler_group_destroy(atoi(a));
+  else if (strcmp(cmd, "weight") == 0 && b[0])
+    rc = scheduler_group_set_weight(atoi(a), (uint32_t) atoi(b));
+  else if (strcmp(cmd, "quota") == 0 && b[0])
+  {
+    /* quota and period in microseconds; "group quota <gid> 0" lifts it */
+    uint64_t quota  = (uint64_t) strtol(b, NULL, 10) * NSEC_PER_USEC;
+    uint64_t period = (uint64_t) (c[0] ? strtol(c, NULL, 10) : 100000) * NSEC_PER_USEC;
+    rc              = scheduler_group_set_bandwidth(atoi(a), quota, period);
+  }
+  else if (strcmp(cmd, "move") == 0 && b[0])
+    rc = scheduler_group_attach(atoi(b), atoi(a));
+  else
+  {
+    console_puts("usage: group new <name> [parent] [weight] | del <gid> | weight <gid> <w>\n"
+                 "       group quota <gid> <us> [period us] | move <pid> <gid>\n");
+    return;
+  }
+  if (rc < 0)
+    console_puts("group: failed\n");
+}
+
+/* Upper bound, in ns, of the histogram bucket holding the q-th percentile */
+/* Linux calls share names with native ones; tell them apart */
+static const char* abi_prefix(int slot)
+{
+  return slot >= SYSCALL_LINUX_BASE ? "linux/" : "";
+}
+
+static uint64_t syscall_percentile_ns(const struct syscall_stat* s, uint64_t q)
+{
+  uint64_t want = (s->calls * q + 99) / 100, seen = 0;
+  for (int b = 0; b < SYSCALL_HIST_BUCKETS; ++b)
+  {
+    seen += s->hist[b];
+    if (seen >= want)
+      return clock_tsc_to_ns(2ULL << (b + SYSCALL_HIST_SHIFT));
+  }
+  return clock_tsc_to_ns(s->max_cycles);
+}
+
+/* systop [pid|reset]: syscalls sorted by total time spent in the kernel */
+static void shell_systop(const char* args)
+{
+  char arg[16];
+  next_word(args, arg, sizeof(arg));
+  if (strcmp(arg, "reset") == 0)
+  {
+    syscall_reset_stats();
+    return;
+  }
+
+  /* static: one entry per slot of both personalities is too big for the stack */
+  static struct syscall_stat st[NR_SYSCALL_SLOTS];
+  int                        n = syscall_get_stats(st, NR_SYSCALL_SLOTS);
+  if (arg[0])
+  {
+    int pid = atoi(arg);
+    for (int i = 0; i < n; ++i)
+    {
+      uint64_t calls = syscall_task_calls(pid, st[i].nr);
+      if (calls)
+        console_printf("%s%s %lu\n", abi_prefix(st[i].nr), st[i].name, (unsigned long) calls);
+    }
+    return;
+  }
+
+  /* insertion sort by total cycles, busiest first */
+  for (int i = 1; i < n; ++i)
+  {
+    struct syscall_stat key = st[i];
+    int                 j   = i - 1;
+    for (; j >= 0 && st[j].cycles < key.cycles; --j)
+      st[j + 1] = st[j];
+    st[j + 1] = key;
+  }
+  for (int i = 0; i < n && i < 10; ++i)
+  {
+    if (!st[i].calls)
+      break;
+    console_printf("%s%s calls=%lu errors=%lu total=%lu us avg=%lu ns p99<=%lu ns max=%lu ns\n",
+                   abi_prefix(st[i].nr),
+                   st[i].name,
+                   (unsigned long) st[i].calls,
+                   (unsigned long) st[i].errors,
+                   (unsigned long) (clock_tsc_to_ns(st[i].cycles) / NSEC_PER_USEC),
+                   (unsigned long) clock_tsc_to_ns(st[i].cycles / st[i].calls),
+                   (unsigned long) syscall_percentile_ns(&st[i], 99),
+                   (unsigned long) clock_tsc_to_ns(st[i].max_cycles));
+  }
+  if (syscall_unknown_calls())
+    console_printf("unknown calls=%lu\n", (unsigned long) syscall_unknown_calls());
+}
+
+/* exec [-g group] path [args...]: spawn a program, its words as argv */
+static void shell_exec(const char* args)
+{
+  char              words[SHELL_EXEC_ARGS][64];
+  const char*       argv[SHELL_EXEC_ARGS + 1];
+  struct spawn_attr attr = {0, SCHED_ROOT_GROUP, 0};
+  int               argc = 0;
+
+  args = next_word(args, words[0], sizeof(words[0]));
+  if (strcmp(words[0], "-g") == 0)
+  {
+    args = next_word(args, words[0], sizeof(words[0]));
+    attr.flags |= SPAWN_SETGROUP;
+    attr.group = atoi(words[0]);
+    args       = next_word(args, words[0], sizeof(words[0]));
+  }
+  while (words[argc][0] && argc < SHELL_EXEC_ARGS)
+  {
+    argv[argc] = words[argc];
+    if (++argc < SHELL_EXEC_ARGS)
+      args = next_word(args, words[argc], sizeof(words[argc]));
+  }
+  argv[argc] = NULL;
+  if (!argc)
+  {
+    console_puts("usage: exec [-g group] path [args...]\n");
+    return;
+  }
+
+  console_printf("exec: %s\n", argv[0]);
+  int tid = proc_spawn(argv[0], argv, NULL, NULL, 0, &attr);
+  if (tid < 0)
+    console_printf("exec: failed to spawn (%d)\n", tid);
+  else
+    console_printf("exec: spawned pid=%d\n", tid);
+}
+
+/* strace [on|off|clear]: without an argument, dump the newest trace entries */
+static void shell_strace(const char* args)
+{
+  char arg[16];
+  next_word(args, arg, sizeof(arg));
+  if (strcmp(arg, "on") == 0)
+    syscall_trace_enable(1);
+  else if (strcmp(arg, "off") == 0)
+    syscall_trace_enable(0);
+  else if (strcmp(arg, "clear") == 0)
+    syscall_trace_clear();
+  else if (arg[0])
+    console_puts("usage: strace [on|off|clear]\n");
+  else
+  {
+    struct syscall_trace_entry tr[16];
+    int                        n = syscall_trace_read(tr, 16);
+    for (int i = 0; i < n; ++i)
+    {
+      const char* name  = syscall_name(tr[i].nr);
+      int         nargs = name ? syscall_nargs(tr[i].nr) : SYSCALL_MAX_ARGS;
+      if (name)
+        console_printf("[%d] %s%s(", tr[i].tid, abi_prefix(tr[i].nr), name);
+      else if (tr[i].nr >= SYSCALL_LINUX_BASE)
+        console_printf("[%d] linux/syscall_%d(", tr[i].tid, tr[i].nr - SYSCALL_LINUX_BASE);
+      else
+        console_printf("[%d] syscall_%d(", tr[i].tid, tr[i].nr);
+      for (int a = 0; a < nargs; ++a)
+        console_printf(a ? ", 0x%lx" : "0x%lx", (unsigned long) tr[i].args[a]);
+      console_printf(") = %ld <%lu ns>\n",
+                     (long) tr[i].ret,
+                     (unsigned long) clock_tsc_to_ns(tr[i].cycles));
+    }
+    if (!syscall_trace_enabled())
+      console_puts("strace: tracing is off\n");
+  }
+}
 
 void shell_proc(void* arg)
 {
@@ -44,8 +261,9 @@ void shell_proc(void* arg)
 
     if (c == -1)
     {
-      // Slight delay and yield
-      scheduler_yield();
+      // The keyboard is polled: nap between polls so an idle shell lets the
+      // CPU halt instead of spinning through scheduler_yield
+      timer_sleep_ns(10 * NSEC_PER_MSEC);
       continue;
     }
 
@@ -71,7 +289,8 @@ void shell_proc(void* arg)
 
       if (strcmp(line, "help") == 0)
       {
-        console_puts("commands: help echo ps clear exit panic\n");
+        console_puts(
+            "commands: help echo ps group uptime sysbench systop strace clear exit panic\n");
       }
       else if (strncmp(line, "echo ", 5) == 0)
       {
@@ -84,8 +303,128 @@ void shell_proc(void* arg)
         int                        n = scheduler_get_tasks(tasks, 16);
         for (int i = 0; i < n; ++i)
         {
-          console_printf("pid=%d used=%d dead=%d\n", tasks[i].id, tasks[i].used, tasks[i].dead);
+          console_printf("pid=%d used=%d dead=%d blocked=%d",
+                         tasks[i].id,
+                         tasks[i].used,
+                         tasks[i].dead,
+                         tasks[i].blocked);
+          if (tasks[i].deadline)
+            console_printf(" dl=%lu/%lu us overruns=%lu misses=%lu",
+                           (unsigned long) (tasks[i].budget_ns / NSEC_PER_USEC),
+                           (unsigned long) (tasks[i].period_ns / NSEC_PER_USEC),
+                           (unsigned long) tasks[i].overruns,
+                           (unsigned long) tasks[i].misses);
+          if (tasks[i].handoffs)
+            console_printf(" handoffs=%lu", (unsigned long) tasks[i].handoffs);
+          if (tasks[i].group != SCHED_ROOT_GROUP)
+            console_printf(" group=%d", tasks[i].group);
+          console_puts("\n");
         }
+        struct scheduler_group_info groups[SCHED_MAX_GROUPS];
+        int                         ng = scheduler_get_groups(groups, SCHED_MAX_GROUPS);
+        for (int i = 0; i < ng; ++i)
+        {
+          console_printf("group=%d %s parent=%d weight=%u tasks=%d cpu=%lu ms",
+                         groups[i].id,
+                         groups[i].name,
+                         groups[i].parent,
+                         (unsigned) groups[i].weight,
+                         groups[i].nr_tasks,
+                         (unsigned long) (groups[i].usage_ns / NSEC_PER_MSEC));
+          if (groups[i].quota_ns)
+            console_printf(" quota=%lu/%lu us throttled=%lu/%lu periods (%lu ms)%s",
+                           (unsigned long) (groups[i].quota_ns / NSEC_PER_USEC),
+                           (unsigned long) (groups[i].period_ns / NSEC_PER_USEC),
+                           (unsigned long) groups[i].nr_throttled,
+                           (unsigned long) groups[i].nr_periods,
+                           (unsigned long) (groups[i].throttled_ns / NSEC_PER_MSEC),
+                           groups[i].throttled ? " [throttled]" : "");
+          console_puts("\n");
+        }
+      }
+      else if (strncmp(line, "group", 5) == 0 && (line[5] == ' ' || line[5] == '\0'))
+      {
+        shell_group(line + 5);
+      }
+      else if (strcmp(line, "uptime") == 0)
+      {
+        struct idle_stats st;
+        idle_get_stats(&st);
+        uint64_t up_ms   = st.uptime_ns / NSEC_PER_MSEC;
+        uint64_t idle_ms = st.idle_ns / NSEC_PER_MSEC;
+        console_printf("up %lu ms, idle %lu ms (%lu%%) via %s, %lu idle entries\n",
+                       (unsigned long) up_ms,
+                       (unsigned long) idle_ms,
+                       (unsigned long) (up_ms ? idle_ms * 100 / up_ms : 0),
+                       st.mwait ? "mwait" : "hlt",
+                       (unsigned long) st.entries);
+        struct async_stats as;
+        async_get_stats(&as);
+        console_printf("async: %lu in flight, %lu done, %lu polls\n",
+                       (unsigned long) as.in_flight,
+                       (unsigned long) as.completed,
+                       (unsigned long) as.polls);
+        struct mm_stats ms;
+        mm_get_stats(&ms);
+        console_printf("mm: %lu cr3 loads, %lu avoided (%lu lazy)\n",
+                       (unsigned long) ms.cr3_loads,
+                       (unsigned long) ms.cr3_avoided,
+                       (unsigned long) ms.lazy_borrows);
+        console_printf("mm: %lu demand faults, %lu shared file pages, %lu private copies\n",
+                       (unsigned long) ms.faults,
+                       (unsigned long) ms.shared_maps,
+                       (unsigned long) ms.cow_copies);
+        struct inode_stats is;
+        inode_get_stats(&is);
+        console_printf("pagecache: %lu inodes, %lu hits, %lu misses\n",
+                       (unsigned long) is.inodes,
+                       (unsigned long) is.hits,
+                       (unsigned long) is.misses);
+        struct pipe_stats ps;
+        pipe_get_stats(&ps);
+        console_printf("pipes: %lu created, %lu pages, %lu bytes copied, %lu spliced, %lu pages lent\n",
+                       (unsigned long) ps.pipes,
+                       (unsigned long) ps.pages,
+                       (unsigned long) ps.bytes_copied,
+                       (unsigned long) ps.bytes_spliced,
+                       (unsigned long) ms.pages_lent);
+        struct tty_stats ts;
+        tty_get_stats(&ts);
+        console_printf("tty: %lu bytes out in %lu flushes, %lu writer waits, %lu bytes in\n",
+                       (unsigned long) ts.bytes_out,
+                       (unsigned long) ts.flushes,
+                       (unsigned long) ts.writer_waits,
+                       (unsigned long) ts.bytes_in);
+        struct rcu_stats rs;
+        rcu_get_stats(&rs);
+        console_printf("rcu: %lu grace periods, %lu callbacks, %d blocked readers\n",
+                       (unsigned long) rs.gp_completed,
+                       (unsigned long) rs.cbs_invoked,
+                       rs.blocked_readers);
+        struct uring_stats us;
+        uring_get_stats(&us);
+        console_printf("uring: %d rings, %lu enters, %lu submitted, %lu completed, %lu wakeups\n",
+                       us.rings,
+                       (unsigned long) us.enters,
+                       (unsigned long) us.submitted,
+                       (unsigned long) us.completed,
+                       (unsigned long) us.poll_wakeups);
+      }
+      else if (strcmp(line, "sysbench") == 0)
+      {
+        int tid = sysbench_spawn();
+        if (tid < 0)
+          console_puts("sysbench: unavailable\n");
+        else
+          console_printf("sysbench: pid=%d, results on serial\n", tid);
+      }
+      else if (strncmp(line, "systop", 6) == 0 && (line[6] == ' ' || line[6] == '\0'))
+      {
+        shell_systop(line + 6);
+      }
+      else if (strncmp(line, "strace", 6) == 0 && (line[6] == ' ' || line[6] == '\0'))
+      {
+        shell_strace(line + 6);
       }
       else if (strcmp(line, "clear") == 0)
       {
@@ -94,13 +433,7 @@ void shell_proc(void* arg)
       }
       else if (strncmp(line, "exec ", 5) == 0)
       {
-        const char* path = line + 5;
-        console_printf("exec: %s\n", path);
-        int tid = kernel_spawn_elf_from_path(path);
-        if (tid < 0)
-          console_puts("exec: failed to spawn\n");
-        else
-          console_printf("exec: spawned pid=%d\n", tid);
+        shell_exec(line + 5);
       }
       else if (strcmp(line, "exit") == 0)
       {
@@ -1,8 +1,566 @@
-#include <stdint.h>
+#include "sys/proc.h"
+#include "boot/cpu.h"
+#include "fs/fdtable.h"
+#include "fs/inode.h"
+#include "fs/vfs.h"
+#include "lib/elf.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/preempt.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
 #include "serial/serial.h"
+#include "sys/thread.h"
+#include "syscall/sysno.h"
+#include "userspace/enter_user.h"
+#include "vdso/vdso.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
-int64_t kernel_spawn_elf_from_path(const char* path)
+#define PAGE_SIZE     0x1000ULL
+#define PAGE_MASK     (PAGE_SIZE - 1)
+#define EXEC_PATH_MAX 64
+#define EXEC_MAX_PHNUM 64
+/* Load bias for position-independent executables */
+#define ET_DYN_BASE 0x0000555555554000ULL
+
+/* An executable: its headers, read once, and where its pages come from.
+   On a filesystem with page access that is the inode's page cache, so
+   PT_LOAD pages map straight from cache pages and nothing is copied;
+   otherwise it is a page-aligned copy of the file. Images are cached by
+   path and never dropped, so every later exec of the same file shares its
+   text pages and its read-only data until written. */
+struct elf_image
 {
-    serial_puts("[stub] spawn ELF: "); serial_puts(path); serial_puts(" → not implemented\n");
+  struct elf_image* next;
+  char              path[EXEC_PATH_MAX];
+  struct inode*     inode; /* page-cache backed, or NULL */
+  const uint8_t*    data;  /* private copy when there is no inode */
+  size_t            size;
+  Elf64_Ehdr        eh;
+  Elf64_Phdr        ph[EXEC_MAX_PHNUM];
+};
+
+static struct elf_image* images;
+static spinlock_t        images_lock = SPINLOCK_INIT;
+
+/* What the new task needs to finish the exec on its own address space */
+struct exec_start
+{
+  const struct elf_image* img;
+  uint64_t                entry;
+  uint64_t                phdr; /* user address of the program headers */
+  uint16_t                phnum;
+  int                     argc;
+  int                     envc;
+  size_t                  strings_len;
+  char                    strings[SPAWN_ARGS_MAX]; /* argv then envp, NUL-separated */
+};
+
+static const struct elf_image* image_lookup(const char* path)
+{
+  spin_lock(&images_lock);
+  struct elf_image* img = images;
+  while (img && strcmp(img->path, path) != 0)
+    img = img->next;
+  spin_unlock(&images_lock);
+  return img;
+}
+
+/* Copy len bytes at off out of the file; 0, or -1 if they are not all there */
+static int image_read(const struct elf_image* img, void* buf, size_t len, uint64_t off)
+{
+  if (off > img->size || len > img->size - off)
     return -1;
-}
\ No newline at end of file
+  if (img->inode)
+    return inode_read(img->inode, buf, len, off) == (long) len ? 0 : -1;
+  memcpy(buf, img->data + off, len);
+  return 0;
+}
+
+static const struct elf_image* image_get(const char* path)
+{
+  const struct elf_image* found = image_lookup(path);
+  if (found)
+    return found;
+
+  /* only filesystems without page access get a private copy */
+  if (strlen(path) >= EXEC_PATH_MAX)
+    return NULL;
+  struct inode* ino = inode_lookup(path);
+  void*         buf = NULL;
+  size_t        len;
+  if (ino)
+  {
+    if (ino->st.is_dir)
+      return NULL;
+    len = ino->st.size;
+  }
+  else if (vfs_read_file(path, &buf, &len) != 0)
+    return NULL;
+  struct elf_image* img = kmalloc(sizeof(*img));
+  if (!img)
+  {
+    kfree(buf);
+    return NULL;
+  }
+  img->inode = ino;
+  img->data  = NULL;
+  img->size  = len;
+  if (!ino)
+  {
+    uint8_t* raw = kmalloc(len + PAGE_SIZE);
+    if (!raw)
+    {
+      kfree(buf);
+      kfree(img);
+      return NULL;
+    }
+    uint8_t* data = (uint8_t*) (((uintptr_t) raw + PAGE_MASK) & ~(uintptr_t) PAGE_MASK);
+    memcpy(data, buf, len);
+    kfree(buf);
+    img->data = data;
+  }
+
+  /* headers that do not fit are left zero for validate() to reject */
+  const Elf64_Ehdr* eh = &img->eh;
+  memset(&img->eh, 0, sizeof(img->eh));
+  if (len >= sizeof(img->eh) && image_read(img, &img->eh, sizeof(img->eh), 0) != 0)
+  {
+    kfree(img);
+    return NULL;
+  }
+  if (eh->e_phentsize == sizeof(Elf64_Phdr) && eh->e_phnum <= EXEC_MAX_PHNUM &&
+      eh->e_phoff <= len && eh->e_phnum * sizeof(Elf64_Phdr) <= len - eh->e_phoff &&
+      image_read(img, img->ph, eh->e_phnum * sizeof(Elf64_Phdr), eh->e_phoff) != 0)
+  {
+    kfree(img);
+    return NULL;
+  }
+  strcpy(img->path, path);
+
+  spin_lock(&images_lock);
+  img->next = images;
+  images    = img;
+  spin_unlock(&images_lock);
+  return img;
+}
+
+static int validate(const struct elf_image* img)
+{
+  const Elf64_Ehdr* eh = &img->eh;
+  if (img->size < sizeof(*eh) || !elf_check_header(eh))
+    return -ENOEXEC;
+  if ((eh->e_type != ET_EXEC && eh->e_type != ET_DYN) || eh->e_phentsize != sizeof(Elf64_Phdr) ||
+      eh->e_phnum == 0 || eh->e_phnum > EXEC_MAX_PHNUM || eh->e_phoff > img->size ||
+      eh->e_phnum * sizeof(Elf64_Phdr) > img->size - eh->e_phoff)
+    return -ENOEXEC;
+
+  const Elf64_Phdr* ph    = img->ph;
+  int               loads = 0;
+  for (int i = 0; i < eh->e_phnum; ++i)
+  {
+    /* static executables only: there is no dynamic linker to hand off to */
+    if (ph[i].p_type == PT_INTERP)
+      return -ENOEXEC;
+    if (ph[i].p_type != PT_LOAD)
+      continue;
+    if (ph[i].p_filesz > ph[i].p_memsz || ph[i].p_offset > img->size ||
+        ph[i].p_filesz > img->size - ph[i].p_offset ||
+        ph[i].p_vaddr + ph[i].p_memsz < ph[i].p_vaddr ||
+        (ph[i].p_offset & PAGE_MASK) != (ph[i].p_vaddr & PAGE_MASK))
+      return -ENOEXEC;
+    ++loads;
+  }
+  return loads ? 0 : -ENOEXEC;
+}
+
+/* PERSONALITY_BYTEOS if a PT_NOTE segment carries the ByteOS ABI note,
+   which the user runtime's crt0 emits; everything else is a Linux binary */
+static int image_personality(const struct elf_image* img)
+{
+  const Elf64_Ehdr* eh = &img->eh;
+  const Elf64_Phdr* ph = img->ph;
+  for (int i = 0; i < eh->e_phnum; ++i)
+  {
+    /* the ABI note comes first; a long note segment is only scanned in part */
+    uint64_t notes[32];
+    size_t   len = ph[i].p_filesz < sizeof(notes) ? ph[i].p_filesz : sizeof(notes);
+    if (ph[i].p_type != PT_NOTE || image_read(img, notes, len, ph[i].p_offset) != 0)
+      continue;
+    const uint8_t* p   = (const uint8_t*) notes;
+    const uint8_t* end = p + len;
+    while ((size_t) (end - p) >= sizeof(Elf64_Nhdr))
+    {
+      const Elf64_Nhdr* n     = (const Elf64_Nhdr*) p;
+      size_t            name  = (n->n_namesz + 3) & ~3U;
+      size_t            desc  = (n->n_descsz + 3) & ~3U;
+      const char*       label = (const char*) (n + 1);
+      if (name + desc > (size_t) (end - p) - sizeof(*n))
+        break;
+      if (n->n_type == NT_BYTEOS_ABI && n->n_namesz == sizeof(ELF_NOTE_BYTEOS) &&
+          memcmp(label, ELF_NOTE_BYTEOS, sizeof(ELF_NOTE_BYTEOS)) == 0)
+        return PERSONALITY_BYTEOS;
+      p += sizeof(*n) + name + desc;
+    }
+  }
+  return PERSONALITY_LINUX;
+}
+
+/* Describe the PT_LOAD segments to mm; nothing is mapped until touched */
+static int load_segments(struct mm* mm, const struct elf_image* img, uint64_t bias,
+                         struct exec_start* st)
+{
+  const Elf64_Ehdr* eh = &img->eh;
+  const Elf64_Phdr* ph = img->ph;
+  st->img              = img;
+  st->entry            = eh->e_entry + bias;
+  st->phnum            = eh->e_phnum;
+  st->phdr             = 0;
+
+  for (int i = 0; i < eh->e_phnum; ++i)
+  {
+    if (ph[i].p_type == PT_PHDR)
+      st->phdr = ph[i].p_vaddr + bias;
+    if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0)
+      continue;
+    uint64_t va    = ph[i].p_vaddr + bias;
+    uint64_t start = va & ~PAGE_MASK;
+    uint64_t end   = (va + ph[i].p_memsz + PAGE_MASK) & ~PAGE_MASK;
+    uint32_t prot  = ((ph[i].p_flags & PF_R) ? VMA_READ : 0) |
+                    ((ph[i].p_flags & PF_W) ? VMA_WRITE : 0) |
+                    ((ph[i].p_flags & PF_X) ? VMA_EXEC : 0);
+    uint64_t off = ph[i].p_offset & ~PAGE_MASK;
+    int      rc  = img->inode
+                       ? mm_add_inode_vma(mm, start, end, prot, img->inode, off, va + ph[i].p_filesz)
+                       : mm_add_vma(mm, start, end, prot, img->data, off, va + ph[i].p_filesz);
+    if (rc < 0)
+      return rc;
+    /* the heap starts right after the highest segment */
+    if (end > mm->brk_start)
+      mm->brk_start = mm->brk = end;
+    /* without PT_PHDR, find the headers inside a loaded segment */
+    if (!st->phdr && eh->e_phoff >= ph[i].p_offset &&
+        eh->e_phoff < ph[i].p_offset + ph[i].p_filesz)
+      st->phdr = va + (eh->e_phoff - ph[i].p_offset);
+  }
+  return mm_add_vma(mm,
+                    USER_STACK_TOP - USER_STACK_SIZE,
+                    USER_STACK_TOP,
+                    VMA_READ | VMA_WRITE,
+                    NULL,
+                    0,
+                    0);
+}
+
+/* Append one user string to st->strings */
+static int add_string(struct exec_start* st, const char* src)
+{
+  size_t room = sizeof(st->strings) - st->strings_len;
+  long   len  = strncpy_from_user(st->strings + st->strings_len, src, (long) room);
+  if (len < 0)
+    return (int) len;
+  if ((size_t) len == room)
+    return -E2BIG;
+  st->strings_len += (size_t) len + 1;
+  return 0;
+}
+
+static int add_vector(struct exec_start* st, const char* const* vec, int* count)
+{
+  for (int i = 0; vec; ++i)
+  {
+    const char* s;
+    if (copy_from_user(&s, &vec[i], sizeof(s)))
+      return -EFAULT;
+    if (!s)
+      break;
+    if (st->argc + st->envc >= SPAWN_ARGV_MAX)
+      return -E2BIG;
+    int rc = add_string(st, s);
+    if (rc < 0)
+      return rc;
+    ++*count;
+  }
+  return 0;
+}
+
+/* Everything that can fail, done while the caller is still intact: find
+   the image, gather the strings and describe the image to a new address
+   space */
+static int exec_prepare(const char* path, const char* const* argv, const char* const* envp,
+                        struct exec_start** st_out, struct mm** mm_out)
+{
+  if (!path)
+    return -EFAULT;
+  const struct elf_image* img = image_get(path);
+  if (!img)
+  {
+    serial_puts("exec: cannot read ");
+    serial_puts(path);
+    serial_puts("\n");
+    return -ENOENT;
+  }
+  int rc = validate(img);
+  if (rc < 0)
+  {
+    serial_puts("exec: not a static x86-64 ELF executable\n");
+    return rc;
+  }
+
+  struct exec_start* st = kmalloc(sizeof(*st));
+  if (!st)
+    return -ENOMEM;
+  st->argc        = 0;
+  st->envc        = 0;
+  st->strings_len = 0;
+  if (argv)
+    rc = add_vector(st, argv, &st->argc);
+  else
+  {
+    /* argv[0] defaults to the path: a kernel copy, and shorter than
+       EXEC_PATH_MAX since image_get found it */
+    size_t len = strlen(path) + 1;
+    memcpy(st->strings, path, len);
+    st->strings_len = len;
+    st->argc        = 1;
+  }
+  if (rc == 0)
+    rc = add_vector(st, envp, &st->envc);
+  if (rc < 0)
+  {
+    kfree(st);
+    return rc;
+  }
+
+  struct mm* mm = mm_create();
+  if (!mm)
+  {
+    kfree(st);
+    return -ENOMEM;
+  }
+  uint64_t bias = img->eh.e_type == ET_DYN ? ET_DYN_BASE : 0;
+  rc            = load_segments(mm, img, bias, st);
+  if (rc < 0)
+  {
+    mm_put(mm);
+    kfree(st);
+    return rc;
+  }
+  *st_out = st;
+  *mm_out = mm;
+  return 0;
+}
+
+/* Push n bytes onto the user stack being built; the pages fault in as the
+   kernel writes them */
+static uint64_t push_bytes(uint64_t sp, const void* src, size_t n)
+{
+  sp -= n;
+  memcpy((void*) sp, src, n);
+  return sp;
+}
+
+/* On the new address space: map the vDSO, lay out argc/argv/envp/auxv at
+   the top of the stack and drop to ring 3 */
+__attribute__((noreturn)) static void exec_enter(struct exec_start* st)
+{
+  uint64_t vdso = vdso_map() == 0 ? vdso_base() : 0;
+
+  uint64_t sp      = USER_STACK_TOP;
+  uint64_t strings = sp = push_bytes(sp, st->strings, st->strings_len);
+  uint64_t execfn  = sp = push_bytes(sp, st->img->path, strlen(st->img->path) + 1);
+  uint64_t seed[2] = {rdtsc(), rdtsc() * 0x9E3779B97F4A7C15ULL};
+  uint64_t random  = sp = push_bytes(sp & ~0xFULL, seed, sizeof(seed));
+
+  uint64_t auxv[][2] = {
+      {AT_PHDR, st->phdr},
+      {AT_PHENT, sizeof(Elf64_Phdr)},
+      {AT_PHNUM, st->phnum},
+      {AT_PAGESZ, PAGE_SIZE},
+      {AT_BASE, 0},
+      {AT_FLAGS, 0},
+      {AT_ENTRY, st->entry},
+      {AT_UID, 0},
+      {AT_EUID, 0},
+      {AT_GID, 0},
+      {AT_EGID, 0},
+      {AT_CLKTCK, 100},
+      {AT_SECURE, 0},
+      {AT_RANDOM, random},
+      {AT_EXECFN, execfn},
+      {AT_SYSINFO_EHDR, vdso},
+      {AT_NULL, 0},
+  };
+  /* argc, argv[], NULL, envp[], NULL, then auxv; rsp must end up 16-byte
+     aligned pointing at argc */
+  uint64_t head[SPAWN_ARGV_MAX + 3];
+  size_t   words = 0;
+  uint64_t str   = strings;
+  head[words++]  = (uint64_t) st->argc;
+  for (int i = 0; i < st->argc + st->envc; ++i)
+  {
+    if (i == st->argc)
+      head[words++] = 0;
+    head[words++] = str;
+    str += strlen(st->strings + (str - strings)) + 1;
+  }
+  if (st->envc == 0)
+    head[words++] = 0;
+  head[words++] = 0;
+
+  sp &= ~0xFULL;
+  if ((words + sizeof(auxv) / 8) & 1)
+    sp -= 8;
+  sp = push_bytes(sp, auxv, sizeof(auxv));
+  sp = push_bytes(sp, head, words * 8);
+
+  uint64_t entry = st->entry;
+  serial_puts("exec: starting ");
+  serial_puts(st->img->path);
+  serial_puts("\n");
+  kfree(st);
+  enter_user_mode(entry, sp);
+}
+
+/* Runs as the new process, on its own address space */
+static void exec_start_task(void* arg)
+{
+  exec_enter(arg);
+}
+
+/* Apply the spawn file actions to the child's table */
+static int apply_actions(struct fdtable* t, const struct spawn_action* actions, int nactions)
+{
+  for (int i = 0; i < nactions; ++i)
+  {
+    const struct spawn_action* a = &actions[i];
+    int                        rc;
+    switch (a->op)
+    {
+    case SPAWN_ACTION_CLOSE:
+      rc = fd_close(t, a->fd);
+      break;
+    case SPAWN_ACTION_DUP2:
+      rc = fd_dup2(t, a->src, a->fd);
+      break;
+    case SPAWN_ACTION_OPEN:
+    {
+      char         path[EXEC_PATH_MAX];
+      struct file* f;
+      long         len = a->path ? strncpy_from_user(path, a->path, sizeof(path)) : -EFAULT;
+      if (len < 0)
+        return (int) len;
+      if (len == (long) sizeof(path))
+        return -ENAMETOOLONG;
+      rc = file_open(path, a->oflag, &f);
+      if (rc < 0)
+        return rc;
+      int fd = fd_install(t, f, 0, 0);
+      if (fd < 0)
+      {
+        file_put(f);
+        return fd;
+      }
+      rc = fd;
+      if (fd != a->fd)
+      {
+        rc = fd_dup2(t, fd, a->fd);
+        fd_close(t, fd);
+      }
+      break;
+    }
+    default:
+      rc = -EINVAL;
+    }
+    if (rc < 0)
+      return rc;
+  }
+  return 0;
+}
+
+int proc_spawn(const char* path, const char* const* argv, const char* const* envp,
+               const struct spawn_action* actions, int nactions, const struct spawn_attr* attr)
+{
+  struct exec_start* st;
+  struct mm*         mm;
+  if (nactions < 0 || nactions > SPAWN_ACTIONS_MAX)
+    return -EINVAL;
+  int rc = exec_prepare(path, argv, envp, &st, &mm);
+  if (rc < 0)
+    return rc;
+
+  /* user callers pass their descriptors on; the kernel's children get a
+     fresh console table */
+  struct fdtable* parent = scheduler_get_files();
+  struct fdtable* files  = parent ? fdtable_dup(parent) : fdtable_create();
+  rc                     = files ? apply_actions(files, actions, nactions) : -ENOMEM;
+  if (rc < 0)
+  {
+    mm_put(mm);
+    fdtable_put(files);
+    kfree(st);
+    return rc;
+  }
+  int personality = image_personality(st->img);
+  if (attr && (attr->flags & SPAWN_SETPERSONALITY))
+    personality = attr->personality;
+
+  /* the task must not run before it has its address space; programs
+     from disk talk the Linux syscall ABI unless built for ours */
+  preempt_disable();
+  int tid = task_create(exec_start_task, st);
+  if (tid >= 0)
+  {
+    scheduler_set_mm(tid, mm);
+    scheduler_set_files(tid, files);
+    scheduler_set_personality(tid, personality);
+    /* a bad group undoes the spawn before the child ever runs */
+    if (attr && (attr->flags & SPAWN_SETGROUP) && scheduler_group_attach(attr->group, tid) < 0)
+    {
+      scheduler_mark_dead(tid);
+      tid = -EINVAL;
+    }
+  }
+  preempt_enable();
+  mm_put(mm);
+  fdtable_put(files);
+  if (tid < 0)
+  {
+    kfree(st);
+    return tid == -EINVAL ? tid : -ENOMEM;
+  }
+  return tid;
+}
+
+int proc_exec(const char* path, const char* const* argv, const char* const* envp)
+{
+  struct exec_start* st;
+  struct mm*         mm;
+  if (!scheduler_get_mm())
+    return -EINVAL; /* kernel threads have no program to replace */
+  int rc = exec_prepare(path, argv, envp, &st, &mm);
+  if (rc < 0)
+    return rc;
+
+  /* point of no return: the process becomes the new program */
+  scheduler_kill_thread_group(scheduler_get_tgid());
+  fd_close_on_exec(scheduler_get_files());
+  scheduler_exec_mm(mm);
+  mm_put(mm);
+  thread_vfork_release();
+  scheduler_set_personality(scheduler_get_current(), image_personality(st->img));
+  scheduler_set_fs_base(0);
+  scheduler_set_gs_base(0);
+  scheduler_set_clear_tid(NULL);
+  scheduler_reset_fpu();
+  exec_enter(st);
+}
+
+int kernel_spawn_elf_from_path(const char* path)
+{
+  return proc_spawn(path, NULL, NULL, NULL, 0, NULL);
+}
@@ -0,0 +1,61 @@
+#ifndef SYS_PROC_H
+#define SYS_PROC_H
+
+#include <stdint.h>
+
+/* Process creation. A new process is built straight from the executable:
+   segments are mapped lazily from a shared in-memory copy of the file, so
+   startup only pays for the pages the process touches and nothing of the
+   creator's address space is copied or even looked at. There is no fork;
+   a program that wants fork-then-exec gets vfork (CLONE_VFORK, which
+   borrows the address space until exec) or, better, proc_spawn.
+
+   The path is a kernel string. argv and envp are NULL-terminated string
+   arrays (a NULL argv stands for just the path) and, like the paths of
+   open actions, are read through the uaccess copies: they may point into
+   the calling process or, for kernel callers, anywhere. */
+
+#define SPAWN_ARGS_MAX    2048 /* bytes of argv and envp strings together */
+#define SPAWN_ARGV_MAX    64   /* argv plus envp entries */
+#define SPAWN_ACTIONS_MAX 16
+
+/* File actions, applied in order to the child's descriptor table (a copy
+   of the creator's, or 0, 1 and 2 on the console for kernel callers) */
+#define SPAWN_ACTION_OPEN  0 /* open path with oflag as fd */
+#define SPAWN_ACTION_CLOSE 1 /* close fd */
+#define SPAWN_ACTION_DUP2  2 /* make fd a copy of src */
+
+struct spawn_action
+{
+  int32_t     op;
+  int32_t     fd;
+  int32_t     src;
+  int32_t     oflag;
+  const char* path;
+};
+
+/* Attributes */
+#define SPAWN_SETGROUP       0x1 /* start in scheduler group attr.group */
+#define SPAWN_SETPERSONALITY 0x2 /* attr.personality instead of the ELF note's */
+
+struct spawn_attr
+{
+  uint32_t flags;
+  int32_t  group;
+  int32_t  personality;
+};
+
+/* Start path as a new process. Returns its task id, or -errno if the
+   program cannot be loaded or an action fails. */
+int proc_spawn(const char* path, const char* const* argv, const char* const* envp,
+               const struct spawn_action* actions, int nactions, const struct spawn_attr* attr);
+
+/* Replace the calling user task's program with path. Descriptors marked
+   FD_CLOEXEC are closed, the other threads of the process end, and a vfork
+   parent resumes. Returns only on failure, with the caller untouched. */
+int proc_exec(const char* path, const char* const* argv, const char* const* envp);
+
+/* proc_spawn(path, NULL, NULL, NULL, 0, NULL) */
+int kernel_spawn_elf_from_path(const char* path);
+
+#endif
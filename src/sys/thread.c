@@ -0,0 +1,163 @@
+#include "sys/thread.h"
+#include "fs/fdtable.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/futex.h"
+#include "multitasking/preempt.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/waitqueue.h"
+#include "syscall/syscall.h"
+#include "userspace/enter_user.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLONE_SUPPORTED                                                                        \
+  (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_VFORK | CLONE_THREAD |            \
+   CLONE_SYSVSEM | CLONE_SETTLS | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID |                 \
+   CLONE_DETACHED | CLONE_CHILD_SETTID)
+#define CSIGNAL 0xFF /* exit signal in the low byte; there are no signals */
+
+struct clone_start
+{
+  struct syscall_frame frame; /* the parent's, with the child's rax and rsp */
+  uint64_t             flags;
+  uint64_t             fs_base;
+  uint64_t             gs_base;
+  int*                 ctid;
+};
+
+/* The tid words are user memory: probe with a fault-safe read and write
+   back, so a read-only or unmapped word fails the clone with -EFAULT */
+static int tid_word_ok(int* uaddr)
+{
+  int v;
+  return !copy_from_user(&v, uaddr, sizeof(v)) && !copy_to_user(uaddr, &v, sizeof(v));
+}
+
+/* Runs as the new thread, on the shared address space */
+static void clone_start_task(void* arg)
+{
+  struct clone_start st = *(struct clone_start*) arg;
+  kfree(arg);
+
+  scheduler_set_fs_base(st.fs_base);
+  scheduler_set_gs_base(st.gs_base);
+  if (st.flags & CLONE_CHILD_SETTID)
+  {
+    /* checked by thread_clone; a sibling unmapping it since is ignored */
+    int tid = scheduler_get_current();
+    copy_to_user(st.ctid, &tid, sizeof(tid));
+  }
+  if (st.flags & CLONE_CHILD_CLEARTID)
+    scheduler_set_clear_tid((uint32_t*) st.ctid);
+  enter_user_frame(&st.frame);
+}
+
+int thread_clone(uint64_t flags, uint64_t stack, int* ptid, int* ctid, uint64_t tls)
+{
+  if ((flags & ~(uint64_t) (CLONE_SUPPORTED | CSIGNAL)) || !(flags & CLONE_VM))
+    return -EINVAL;
+  /* threads share everything; a vfork child only borrows the memory */
+  if ((flags & CLONE_THREAD) && !(flags & CLONE_FILES))
+    return -EINVAL;
+  if ((flags & CLONE_SETTLS) && tls >= USER_STACK_TOP)
+    return -EPERM;
+  if ((flags & CLONE_PARENT_SETTID) && !tid_word_ok(ptid))
+    return -EFAULT;
+  if ((flags & (CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID)) && !tid_word_ok(ctid))
+    return -EFAULT;
+
+  struct syscall_frame* parent = syscall_user_frame();
+  if (!(parent->cs & 3))
+    return -EINVAL; /* not called from user mode */
+
+  struct fdtable* files = scheduler_get_files();
+  if (files && !(flags & CLONE_FILES))
+  {
+    files = fdtable_dup(files);
+    if (!files)
+      return -ENOMEM;
+  }
+  else
+    fdtable_get(files);
+
+  struct clone_start* st = kmalloc(sizeof(*st));
+  if (!st)
+  {
+    fdtable_put(files);
+    return -ENOMEM;
+  }
+  st->frame     = *parent;
+  st->frame.rax = 0;
+  if (stack)
+    st->frame.rsp = stack;
+  st->flags   = flags;
+  st->fs_base = (flags & CLONE_SETTLS) ? tls : scheduler_get_fs_base();
+  st->gs_base = scheduler_get_gs_base();
+  st->ctid    = ctid;
+
+  /* the thread must not run before it has the address space */
+  preempt_disable();
+  int tid = task_create(clone_start_task, st);
+  if (tid >= 0)
+  {
+    if (scheduler_get_mm())
+      scheduler_set_mm(tid, scheduler_get_mm());
+    scheduler_set_files(tid, files);
+    scheduler_set_personality(tid, scheduler_get_personality());
+    scheduler_set_user(tid, scheduler_is_user());
+    scheduler_inherit_fpu(tid);
+    scheduler_set_tgid(tid, (flags & CLONE_THREAD) ? scheduler_get_tgid() : tid);
+    if (flags & CLONE_VFORK)
+      scheduler_set_vfork_parent(tid);
+    /* probed above; the child exists by now, so as on Linux a sibling
+       unmapping the word meanwhile goes unreported */
+    if (flags & CLONE_PARENT_SETTID)
+      copy_to_user(ptid, &tid, sizeof(tid));
+  }
+  preempt_enable();
+  fdtable_put(files);
+  if (tid < 0)
+  {
+    kfree(st);
+    return -EAGAIN;
+  }
+  /* the child runs on our memory, maybe on our stack: stay out of its way
+     until it has an address space of its own */
+  if (flags & CLONE_VFORK)
+    scheduler_vfork_wait();
+  return tid;
+}
+
+void thread_vfork_release(void)
+{
+  scheduler_vfork_release();
+}
+
+void thread_exit(void)
+{
+  /* pthread_join waits for the kernel to clear the tid word; wake both
+     kinds of waiter, since the key depends on FUTEX_PRIVATE_FLAG */
+  uint32_t* ctid = scheduler_get_clear_tid();
+  uint32_t  zero = 0;
+  /* a word that cannot be cleared any more is skipped, as on Linux */
+  if (ctid && !copy_to_user(ctid, &zero, sizeof(zero)))
+  {
+    futex_wake(ctid, 1, FUTEX_BITSET_MATCH_ANY, 0);
+    futex_wake(ctid, 1, FUTEX_BITSET_MATCH_ANY, 1);
+  }
+  thread_vfork_release();
+  /* reaped once it has switched away for good */
+  scheduler_mark_dead(scheduler_get_current());
+  scheduler_yield();
+  for (;;)
+    asm volatile("hlt");
+}
+
+void thread_exit_group(void)
+{
+  scheduler_kill_thread_group(scheduler_get_tgid());
+  thread_exit();
+}
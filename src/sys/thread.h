@@ -0,0 +1,39 @@
+#ifndef SYS_THREAD_H
+#define SYS_THREAD_H
+
+#include <stdint.h>
+
+/* clone(2) flags, with the Linux values. The new task always shares the
+   address space: it is a thread, or with CLONE_VFORK a child process that
+   borrows the address space until it execs (there is no fork). Without
+   CLONE_FILES it gets a copy of the descriptor table. */
+#define CLONE_VM             0x00000100
+#define CLONE_FS             0x00000200
+#define CLONE_FILES          0x00000400
+#define CLONE_SIGHAND        0x00000800
+#define CLONE_VFORK          0x00004000 /* parent sleeps until the child execs or exits */
+#define CLONE_THREAD         0x00010000 /* same thread group (getpid) */
+#define CLONE_SYSVSEM        0x00040000
+#define CLONE_SETTLS         0x00080000 /* FS base = tls */
+#define CLONE_PARENT_SETTID  0x00100000 /* *ptid = tid, in the parent */
+#define CLONE_CHILD_CLEARTID 0x00200000 /* at exit: *ctid = 0, futex wake */
+#define CLONE_DETACHED       0x00400000
+#define CLONE_CHILD_SETTID   0x01000000 /* *ctid = tid, in the child */
+
+/* New thread of the calling user task. It returns to user mode where the
+   caller does, with the caller's registers except rax = 0 and, if stack
+   is not 0, rsp = stack; the bases and personality are inherited. Must be
+   called from a system call. Returns the new tid or -errno; with
+   CLONE_VFORK, only once the child has exec'd or exited. */
+int thread_clone(uint64_t flags, uint64_t stack, int* ptid, int* ctid, uint64_t tls);
+
+/* A vfork child is done with its parent's address space (exec, exit or a
+   fatal fault): let the parent run again. No-op for other tasks. */
+void thread_vfork_release(void);
+
+/* End the calling thread: clear and wake its clear-tid word, then die */
+__attribute__((noreturn)) void thread_exit(void);
+/* End every thread of the calling task's thread group */
+__attribute__((noreturn)) void thread_exit_group(void);
+
+#endif
@@ -0,0 +1,1020 @@
+// linux.c – Linux x86-64 system calls for ELF programs loaded from disk
+#include "syscall/linux.h"
+#include "console/tty.h"
+#include "fs/eventfd.h"
+#include "fs/eventpoll.h"
+#include "fs/fdtable.h"
+#include "fs/file.h"
+#include "fs/pipe.h"
+#include "fs/splice.h"
+#include "fs/timerfd.h"
+#include "lib/errno.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/futex.h"
+#include "multitasking/scheduler.h"
+#include "sys/proc.h"
+#include "sys/thread.h"
+#include "time/clock.h"
+#include "time/timer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define AT_FDCWD        -100
+#define AT_EMPTY_PATH   0x1000
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC  0x4
+#define MAP_SHARED    0x01
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+
+#define F_DUPFD         0
+#define F_GETFD         1
+#define F_SETFD         2
+#define F_GETFL         3
+#define F_SETFL         4
+#define F_DUPFD_CLOEXEC 1030
+
+#define TCGETS     0x5401
+#define TCSETS     0x5402
+#define TCSETSW    0x5403
+#define TCSETSF    0x5404
+#define TIOCGPGRP  0x540F
+#define TIOCGWINSZ 0x5413
+
+#define ARCH_SET_FS 0x1002
+#define ARCH_GET_FS 0x1003
+#define ARCH_SET_GS 0x1001
+#define ARCH_GET_GS 0x1004
+
+#define DT_DIR 4
+#define DT_REG 8
+
+#define PATH_MAX_LEN 128
+
+struct linux_stat
+{
+    uint64_t st_dev;
+    uint64_t st_ino;
+    uint64_t st_nlink;
+    uint32_t st_mode;
+    uint32_t st_uid;
+    uint32_t st_gid;
+    uint32_t pad0;
+    uint64_t st_rdev;
+    int64_t  st_size;
+    int64_t  st_blksize;
+    int64_t  st_blocks;
+    uint64_t st_atime, st_atime_nsec;
+    uint64_t st_mtime, st_mtime_nsec;
+    uint64_t st_ctime, st_ctime_nsec;
+    int64_t  unused[3];
+};
+
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t  d_off;
+    uint16_t d_reclen;
+    uint8_t  d_type;
+    char     d_name[];
+};
+
+struct linux_utsname
+{
+    char sysname[65];
+    char nodename[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+    char domainname[65];
+};
+
+struct linux_termios
+{
+    uint32_t c_iflag;
+    uint32_t c_oflag;
+    uint32_t c_cflag;
+    uint32_t c_lflag;
+    uint8_t  c_line;
+    uint8_t  c_cc[19];
+};
+
+struct linux_winsize
+{
+    uint16_t ws_row;
+    uint16_t ws_col;
+    uint16_t ws_xpixel;
+    uint16_t ws_ypixel;
+};
+
+struct linux_iovec
+{
+    void*    base;
+    uint64_t len;
+};
+
+struct linux_timespec
+{
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+// ────────────────────────────────────────────────
+// Helpers
+// ────────────────────────────────────────────────
+
+static struct file* get_file(int fd)
+{
+    return fd_get(scheduler_get_files(), fd);
+}
+
+// Paths name files on the mounted filesystems, which only have a root
+// directory: drop leading "/" and "./", and make "" or "." the root itself
+static int resolve_path(const char* path, char* out)
+{
+    if (!path)
+        return -EFAULT;
+    for (;;)
+    {
+        if (path[0] == '/')
+            path++;
+        else if (path[0] == '.' && path[1] == '/')
+            path += 2;
+        else
+            break;
+    }
+    if (!path[0] || (path[0] == '.' && !path[1]))
+        path = "/";
+    if (strlen(path) >= PATH_MAX_LEN)
+        return -ENAMETOOLONG;
+    strcpy(out, path);
+    return 0;
+}
+
+// The console is the only terminal
+static int is_tty(const struct file* f)
+{
+    return (f->mode & S_IFMT) == S_IFCHR;
+}
+
+static void fill_stat(const struct file* f, struct linux_stat* st)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_dev     = 1;
+    st->st_ino     = (uint64_t)(uintptr_t)f->data;
+    st->st_nlink   = 1;
+    st->st_mode    = f->mode;
+    st->st_size    = (f->mode & S_IFMT) == S_IFREG ? (int64_t)f->size : 0;
+    st->st_blksize = 4096;
+    st->st_blocks  = (st->st_size + 511) / 512;
+    if (is_tty(f))
+        st->st_rdev = (4 << 8) | 1; // tty1
+}
+
+// ────────────────────────────────────────────────
+// Files
+// ────────────────────────────────────────────────
+
+static uint64_t linux_read(const uint64_t* args)
+{
+    // ssize_t read(int fd, void *buf, size_t count)
+    if (!access_ok((void*)args[1], args[2]))
+        return -EFAULT;
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    long ret = file_read(f, (void*)args[1], (size_t)args[2], NULL);
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+static uint64_t linux_write(const uint64_t* args)
+{
+    // ssize_t write(int fd, const void *buf, size_t count)
+    if (!access_ok((const void*)args[1], args[2]))
+        return -EFAULT;
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    long ret = file_write(f, (const void*)args[1], (size_t)args[2], NULL);
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+static uint64_t do_iov(const uint64_t* args, int write)
+{
+    // ssize_t readv/writev(int fd, const struct iovec *iov, int iovcnt)
+    const struct linux_iovec* iov = (const struct linux_iovec*)args[1];
+    int                       cnt = (int)args[2];
+    if (cnt < 0 || cnt > 1024)
+        return -EINVAL;
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    long total = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+        struct linux_iovec v;
+        long               n;
+        if (copy_from_user(&v, &iov[i], sizeof(v)))
+            n = -EFAULT;
+        else if (!v.len)
+            continue;
+        else if (!access_ok(v.base, v.len))
+            n = -EFAULT;
+        else
+            n = write ? file_write(f, v.base, v.len, NULL) : file_read(f, v.base, v.len, NULL);
+        if (n < 0)
+        {
+            if (!total)
+                total = n;
+            break;
+        }
+        total += n;
+        if ((uint64_t)n < v.len)
+            break;
+    }
+    file_put(f);
+    return (uint64_t)total;
+}
+
+static uint64_t linux_readv(const uint64_t* args)
+{
+    return do_iov(args, 0);
+}
+
+static uint64_t linux_writev(const uint64_t* args)
+{
+    return do_iov(args, 1);
+}
+
+// Copy a path argument in; the length, or -EFAULT / -ENAMETOOLONG
+static long copy_path(char* kpath, const char* upath)
+{
+    if (!upath)
+        return -EFAULT;
+    long len = strncpy_from_user(kpath, upath, PATH_MAX_LEN);
+    if (len == PATH_MAX_LEN)
+        return -ENAMETOOLONG;
+    return len;
+}
+
+// kpath has been copied in already
+static int open_path(int dirfd, const char* kpath, int flags)
+{
+    char path[PATH_MAX_LEN];
+    int  rc = resolve_path(kpath, path);
+    if (rc < 0)
+        return rc;
+    // relative paths resolve from the root whatever dirfd is, so it only
+    // has to be a directory
+    if (kpath[0] != '/' && dirfd != AT_FDCWD)
+    {
+        struct file* dir = get_file(dirfd);
+        if (!dir)
+            return -EBADF;
+        int is_dir = (dir->mode & S_IFMT) == S_IFDIR;
+        file_put(dir);
+        if (!is_dir)
+            return -ENOTDIR;
+    }
+
+    struct file* f;
+    rc = file_open(path, flags & (O_ACCMODE | O_DIRECTORY), &f);
+    if (rc < 0)
+        return rc;
+    int fd = fd_install(scheduler_get_files(), f, 0, (flags & O_CLOEXEC) ? FD_CLOEXEC : 0);
+    if (fd < 0)
+        file_put(f);
+    return fd;
+}
+
+static int do_openat(int dirfd, const char* upath, int flags)
+{
+    char kpath[PATH_MAX_LEN];
+    long len = copy_path(kpath, upath);
+    if (len < 0)
+        return (int)len;
+    return open_path(dirfd, kpath, flags);
+}
+
+static uint64_t linux_open(const uint64_t* args)
+{
+    // int open(const char *path, int flags, mode_t mode)
+    return (uint64_t)(int64_t)do_openat(AT_FDCWD, (const char*)args[0], (int)args[1]);
+}
+
+static uint64_t linux_openat(const uint64_t* args)
+{
+    // int openat(int dirfd, const char *path, int flags, mode_t mode)
+    return (uint64_t)(int64_t)do_openat((int)args[0], (const char*)args[1], (int)args[2]);
+}
+
+static uint64_t linux_close(const uint64_t* args)
+{
+    // int close(int fd)
+    return (uint64_t)(int64_t)fd_close(scheduler_get_files(), (int)args[0]);
+}
+
+static uint64_t do_pipe(int* ufds, int flags)
+{
+    struct fdtable* t = scheduler_get_files();
+    struct file *   rd, *wr;
+    if (!ufds)
+        return -EFAULT;
+    if (flags & ~O_CLOEXEC)
+        return -EINVAL; // no O_NONBLOCK or O_DIRECT pipes
+    int fdflags = (flags & O_CLOEXEC) ? FD_CLOEXEC : 0;
+    int rc      = pipe_create(&rd, &wr);
+    if (rc < 0)
+        return (uint64_t)(int64_t)rc;
+    int rfd = fd_install(t, rd, 0, fdflags);
+    int wfd = rfd < 0 ? rfd : fd_install(t, wr, 0, fdflags);
+    if (wfd < 0)
+    {
+        if (rfd >= 0)
+            fd_close(t, rfd);
+        else
+            file_put(rd);
+        file_put(wr);
+        return (uint64_t)(int64_t)wfd;
+    }
+    int fds[2] = {rfd, wfd};
+    if (copy_to_user(ufds, fds, sizeof(fds)))
+    {
+        fd_close(t, rfd);
+        fd_close(t, wfd);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static uint64_t linux_pipe(const uint64_t* args)
+{
+    // int pipe(int fds[2])
+    return do_pipe((int*)args[0], 0);
+}
+
+static uint64_t linux_pipe2(const uint64_t* args)
+{
+    // int pipe2(int fds[2], int flags)
+    return do_pipe((int*)args[0], (int)args[1]);
+}
+
+static uint64_t linux_splice(const uint64_t* args)
+{
+    // ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+    //                size_t len, unsigned flags) – the SPLICE_F_* hints are
+    // ignored: pages always move by reference
+    uint64_t* uoff_in  = (uint64_t*)args[1];
+    uint64_t* uoff_out = (uint64_t*)args[3];
+    uint64_t  off_in, off_out;
+    if ((uoff_in && copy_from_user(&off_in, uoff_in, sizeof(off_in))) ||
+        (uoff_out && copy_from_user(&off_out, uoff_out, sizeof(off_out))))
+        return -EFAULT;
+    struct file* in  = get_file((int)args[0]);
+    struct file* out = get_file((int)args[2]);
+    long         rc  = -EBADF;
+    if (in && out)
+        rc = splice_files(in, uoff_in ? &off_in : NULL, out, uoff_out ? &off_out : NULL,
+                          (size_t)args[4]);
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    if (rc > 0 && ((uoff_in && copy_to_user(uoff_in, &off_in, sizeof(off_in))) ||
+                   (uoff_out && copy_to_user(uoff_out, &off_out, sizeof(off_out)))))
+        rc = -EFAULT;
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t linux_tee(const uint64_t* args)
+{
+    // ssize_t tee(int fd_in, int fd_out, size_t len, unsigned flags)
+    struct file* in  = get_file((int)args[0]);
+    struct file* out = get_file((int)args[1]);
+    long         rc  = in && out ? tee_pipes(in, out, (size_t)args[2]) : -EBADF;
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t linux_sendfile(const uint64_t* args)
+{
+    // ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+    uint64_t* uoff = (uint64_t*)args[2];
+    uint64_t  off;
+    if (uoff && copy_from_user(&off, uoff, sizeof(off)))
+        return -EFAULT;
+    struct file* out = get_file((int)args[0]);
+    struct file* in  = get_file((int)args[1]);
+    long         rc  = in && out ? sendfile_files(out, in, uoff ? &off : NULL, (size_t)args[3]) : -EBADF;
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    if (rc > 0 && uoff && copy_to_user(uoff, &off, sizeof(off)))
+        rc = -EFAULT;
+    return (uint64_t)(int64_t)rc;
+}
+
+static int do_fstat(int fd, struct linux_stat* ust)
+{
+    struct linux_stat st;
+    struct file*      f = get_file(fd);
+    if (!f)
+        return -EBADF;
+    fill_stat(f, &st);
+    file_put(f);
+    return copy_to_user(ust, &st, sizeof(st)) ? -EFAULT : 0;
+}
+
+static int do_stat(int dirfd, const char* upath, struct linux_stat* ust, int flags)
+{
+    char kpath[PATH_MAX_LEN];
+    if (!ust)
+        return -EFAULT;
+    long len = copy_path(kpath, upath);
+    if (len < 0)
+        return (int)len;
+    if (!len && (flags & AT_EMPTY_PATH))
+        return do_fstat(dirfd, ust);
+    int fd = open_path(dirfd, kpath, O_RDONLY);
+    if (fd < 0)
+        return fd;
+    int rc = do_fstat(fd, ust);
+    fd_close(scheduler_get_files(), fd);
+    return rc;
+}
+
+static uint64_t linux_stat(const uint64_t* args)
+{
+    // int stat(const char *path, struct stat *st); lstat is the same, as
+    // there are no symlinks
+    return (uint64_t)(int64_t)do_stat(AT_FDCWD, (const char*)args[0],
+                                      (struct linux_stat*)args[1], 0);
+}
+
+static uint64_t linux_fstat(const uint64_t* args)
+{
+    // int fstat(int fd, struct stat *st)
+    if (!args[1])
+        return -EFAULT;
+    return (uint64_t)(int64_t)do_fstat((int)args[0], (struct linux_stat*)args[1]);
+}
+
+static uint64_t linux_newfstatat(const uint64_t* args)
+{
+    // int newfstatat(int dirfd, const char *path, struct stat *st, int flags)
+    return (uint64_t)(int64_t)do_stat((int)args[0], (const char*)args[1],
+                                      (struct linux_stat*)args[2], (int)args[3]);
+}
+
+static uint64_t linux_lseek(const uint64_t* args)
+{
+    // off_t lseek(int fd, off_t offset, int whence)
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    int64_t off = (int64_t)args[1];
+    int64_t base;
+    switch ((int)args[2])
+    {
+    case SEEK_SET: base = 0; break;
+    case SEEK_CUR: base = (int64_t)f->pos; break;
+    case SEEK_END: base = (int64_t)f->size; break;
+    default: base = -1; break;
+    }
+    int64_t ret;
+    if (is_tty(f))
+        ret = -ESPIPE;
+    else if (base < 0 || base + off < 0)
+        ret = -EINVAL;
+    else
+        ret = (int64_t)(f->pos = (uint64_t)(base + off));
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+static uint64_t linux_getdents64(const uint64_t* args)
+{
+    // ssize_t getdents64(int fd, void *dirp, size_t count)
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    uint8_t* buf   = (uint8_t*)args[1];
+    size_t   count = (size_t)args[2];
+    size_t   used  = 0;
+    int64_t  ret   = 0;
+    struct file_dirent ent;
+    uint64_t           rec[(sizeof(struct linux_dirent64) + FILE_NAME_MAX + 7) / 8];
+    int                rc;
+    while ((rc = file_readdir(f, f->pos, &ent)) > 0)
+    {
+        size_t namelen = strlen(ent.name);
+        size_t reclen  = (offsetof(struct linux_dirent64, d_name) + namelen + 1 + 7) & ~(size_t)7;
+        if (used + reclen > count)
+        {
+            if (!used)
+                ret = -EINVAL; // buffer too small for one entry
+            break;
+        }
+        // built here, then copied out whole
+        struct linux_dirent64* d = (struct linux_dirent64*)rec;
+        memset(rec, 0, reclen);
+        d->d_ino    = f->pos + 1;
+        d->d_off    = (int64_t)f->pos + 1;
+        d->d_reclen = (uint16_t)reclen;
+        d->d_type   = ent.is_dir ? DT_DIR : DT_REG;
+        memcpy(d->d_name, ent.name, namelen + 1);
+        if (copy_to_user(buf + used, rec, reclen))
+        {
+            rc = -EFAULT;
+            break;
+        }
+        used += reclen;
+        f->pos++;
+    }
+    if (rc < 0)
+        ret = rc;
+    file_put(f);
+    return (uint64_t)(ret < 0 ? ret : (int64_t)used);
+}
+
+static uint64_t linux_ioctl(const uint64_t* args)
+{
+    // int ioctl(int fd, unsigned long request, void *arg) – the terminal
+    // requests a libc needs for isatty() and line buffering
+    struct file* f = get_file((int)args[0]);
+    if (!f)
+        return -EBADF;
+    int tty = is_tty(f);
+    file_put(f);
+    if (!tty)
+        return -ENOTTY;
+
+    void* arg = (void*)args[2];
+    switch (args[1])
+    {
+    case TCGETS:
+    {
+        struct linux_termios t;
+        memset(&t, 0, sizeof(t));
+        t.c_iflag = 0x500;            // ICRNL | IXON
+        t.c_oflag = 0x5;              // OPOST | ONLCR
+        t.c_cflag = 0xBF;             // B38400 | CS8 | CREAD
+        t.c_lflag = tty_get_lflag(tty_console());
+        t.c_cc[0] = 3;                // VINTR ^C
+        t.c_cc[1] = 0x1C;             // VQUIT
+        t.c_cc[2] = 0x7F;             // VERASE
+        t.c_cc[3] = 0x15;             // VKILL ^U
+        t.c_cc[4] = 4;                // VEOF ^D
+        t.c_cc[6] = 1;                // VMIN
+        return copy_to_user(arg, &t, sizeof(t)) ? -EFAULT : 0;
+    }
+    case TCSETS:
+    case TCSETSW:
+    case TCSETSF:
+    {
+        // Only ICANON and ECHO change anything; the other flags are kept
+        // so TCGETS hands back what was set
+        struct linux_termios t;
+        if (copy_from_user(&t, arg, sizeof(t)))
+            return -EFAULT;
+        if (args[1] != TCSETS)
+            tty_wait_output(tty_console());
+        if (args[1] == TCSETSF)
+            tty_flush_input(tty_console());
+        tty_set_lflag(tty_console(), t.c_lflag);
+        return 0;
+    }
+    case TIOCGWINSZ:
+    {
+        struct linux_winsize ws = {25, 80, 0, 0};
+        return copy_to_user(arg, &ws, sizeof(ws)) ? -EFAULT : 0;
+    }
+    case TIOCGPGRP:
+    {
+        int32_t pgrp = scheduler_get_current();
+        return copy_to_user(arg, &pgrp, sizeof(pgrp)) ? -EFAULT : 0;
+    }
+    default:
+        return -ENOTTY;
+    }
+}
+
+static uint64_t linux_fcntl(const uint64_t* args)
+{
+    // int fcntl(int fd, int cmd, ... arg)
+    struct fdtable* t  = scheduler_get_files();
+    int             fd = (int)args[0];
+    switch ((int)args[1])
+    {
+    case F_DUPFD:
+    case F_DUPFD_CLOEXEC:
+    {
+        struct file* f = fd_get(t, fd);
+        if (!f)
+            return -EBADF;
+        int nfd = fd_install(t, f, (int)args[2], (int)args[1] == F_DUPFD_CLOEXEC ? FD_CLOEXEC : 0);
+        if (nfd < 0)
+            file_put(f);
+        return (uint64_t)(int64_t)nfd;
+    }
+    case F_GETFD:
+        return (uint64_t)(int64_t)fd_get_flags(t, fd);
+    case F_SETFD:
+        return (uint64_t)(int64_t)fd_set_flags(t, fd, (int)args[2] & FD_CLOEXEC);
+    case F_GETFL:
+    {
+        struct file* f = fd_get(t, fd);
+        if (!f)
+            return -EBADF;
+        int flags = f->flags;
+        file_put(f);
+        return (uint64_t)(int64_t)flags;
+    }
+    case F_SETFL:
+        return 0; // no status flags (O_APPEND, O_NONBLOCK) apply yet
+    default:
+        return -EINVAL;
+    }
+}
+
+static uint64_t linux_getcwd(const uint64_t* args)
+{
+    // char *getcwd(char *buf, size_t size) – returns the length
+    size_t size = (size_t)args[1];
+    if (!args[0])
+        return -EFAULT;
+    if (size < 2)
+        return -ERANGE;
+    return copy_to_user((void*)args[0], "/", 2) ? -EFAULT : 2;
+}
+
+// ────────────────────────────────────────────────
+// Memory
+// ────────────────────────────────────────────────
+
+static uint64_t linux_mmap(const uint64_t* args)
+{
+    // void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+    // Anonymous memory only: the filesystems have no page cache to map
+    uint64_t addr  = args[0];
+    int      prot  = (int)args[2];
+    int      flags = (int)args[3];
+    if (!(flags & MAP_ANONYMOUS))
+        return -ENODEV;
+    if (!(flags & (MAP_SHARED | MAP_PRIVATE)))
+        return -EINVAL;
+    uint32_t vprot = ((prot & PROT_READ) ? VMA_READ : 0) | ((prot & PROT_WRITE) ? VMA_WRITE : 0) |
+                     ((prot & PROT_EXEC) ? VMA_EXEC : 0);
+    return (uint64_t)mm_mmap(mm_loaded(), addr, args[1], vprot, (flags & MAP_FIXED) != 0);
+}
+
+static uint64_t linux_munmap(const uint64_t* args)
+{
+    // int munmap(void *addr, size_t len)
+    return (uint64_t)(int64_t)mm_munmap(mm_loaded(), args[0], args[1]);
+}
+
+static uint64_t linux_brk(const uint64_t* args)
+{
+    // void *brk(void *addr) – returns the (possibly unchanged) break
+    return mm_brk(mm_loaded(), args[0]);
+}
+
+// ────────────────────────────────────────────────
+// Process
+// ────────────────────────────────────────────────
+
+static uint64_t linux_exit(const uint64_t* args)
+{
+    // void exit(int status) – ends the calling thread only
+    (void)args;
+    thread_exit();
+}
+
+static uint64_t linux_exit_group(const uint64_t* args)
+{
+    // void exit_group(int status)
+    (void)args;
+    thread_exit_group();
+}
+
+static uint64_t linux_getpid(const uint64_t* args)
+{
+    // pid_t getpid(void) – the thread group
+    (void)args;
+    return (uint64_t)scheduler_get_tgid();
+}
+
+static uint64_t linux_gettid(const uint64_t* args)
+{
+    // pid_t gettid(void)
+    (void)args;
+    return (uint64_t)scheduler_get_current();
+}
+
+static uint64_t linux_set_tid_address(const uint64_t* args)
+{
+    // pid_t set_tid_address(int *tidptr) – cleared and futex-woken at exit
+    scheduler_set_clear_tid((uint32_t*)args[0]);
+    return (uint64_t)scheduler_get_current();
+}
+
+static uint64_t linux_clone(const uint64_t* args)
+{
+    // long clone(unsigned long flags, void *stack, int *parent_tid,
+    //            int *child_tid, unsigned long tls)
+    return (uint64_t)(int64_t)thread_clone(args[0], args[1], (int*)args[2], (int*)args[3], args[4]);
+}
+
+static uint64_t linux_vfork(const uint64_t* args)
+{
+    // pid_t vfork(void) – the child runs on our memory until it execs or
+    // exits; we sleep until then
+    (void)args;
+    return (uint64_t)(int64_t)thread_clone(CLONE_VM | CLONE_VFORK, 0, NULL, NULL, 0);
+}
+
+static uint64_t linux_execve(const uint64_t* args)
+{
+    // int execve(const char *path, char *const argv[], char *const envp[])
+    char kpath[PATH_MAX_LEN];
+    long len = copy_path(kpath, (const char*)args[0]);
+    if (len < 0)
+        return (uint64_t)len;
+    return (uint64_t)(int64_t)proc_exec(kpath, (const char* const*)args[1], (const char* const*)args[2]);
+}
+
+static uint64_t linux_zero(const uint64_t* args)
+{
+    // getppid and the uid/gid calls: everything runs as root under the
+    // kernel
+    (void)args;
+    return 0;
+}
+
+static uint64_t linux_rt_sigaction(const uint64_t* args)
+{
+    // int rt_sigaction(int sig, const struct sigaction *act,
+    //                  struct sigaction *old, size_t sigsetsize)
+    // There are no signals yet: accept handlers, report the default one
+    if (args[3] != 8)
+        return -EINVAL;
+    if (args[2] && clear_user((void*)args[2], 24 + args[3]))
+        return -EFAULT;
+    return 0;
+}
+
+static uint64_t linux_rt_sigprocmask(const uint64_t* args)
+{
+    // int rt_sigprocmask(int how, const sigset_t *set, sigset_t *old,
+    //                    size_t sigsetsize)
+    if (args[3] != 8)
+        return -EINVAL;
+    if (args[2] && clear_user((void*)args[2], args[3]))
+        return -EFAULT;
+    return 0;
+}
+
+static uint64_t linux_arch_prctl(const uint64_t* args)
+{
+    // int arch_prctl(int code, unsigned long addr) – the TLS pointers in FS
+    // and GS
+    switch ((int)args[0])
+    {
+    case ARCH_SET_FS:
+        if (args[1] >= USER_STACK_TOP)
+            return -EPERM;
+        scheduler_set_fs_base(args[1]);
+        return 0;
+    case ARCH_GET_FS:
+    {
+        uint64_t base = scheduler_get_fs_base();
+        return copy_to_user((void*)args[1], &base, sizeof(base)) ? -EFAULT : 0;
+    }
+    case ARCH_SET_GS:
+        if (args[1] >= USER_STACK_TOP)
+            return -EPERM;
+        scheduler_set_gs_base(args[1]);
+        return 0;
+    case ARCH_GET_GS:
+    {
+        uint64_t base = scheduler_get_gs_base();
+        return copy_to_user((void*)args[1], &base, sizeof(base)) ? -EFAULT : 0;
+    }
+    default:
+        return -EINVAL;
+    }
+}
+
+static uint64_t linux_uname(const uint64_t* args)
+{
+    // int uname(struct utsname *buf)
+    struct linux_utsname u;
+    if (!args[0])
+        return -EFAULT;
+    memset(&u, 0, sizeof(u));
+    strcpy(u.sysname, "Linux");
+    strcpy(u.nodename, "byteos");
+    strcpy(u.release, "4.4.0-byteos");
+    strcpy(u.version, "ByteOS");
+    strcpy(u.machine, "x86_64");
+    strcpy(u.domainname, "(none)");
+    return copy_to_user((void*)args[0], &u, sizeof(u)) ? -EFAULT : 0;
+}
+
+static uint64_t linux_sched_yield(const uint64_t* args)
+{
+    (void)args;
+    scheduler_yield();
+    return 0;
+}
+
+static uint64_t linux_nanosleep(const uint64_t* args)
+{
+    // int nanosleep(const struct timespec *req, struct timespec *rem)
+    struct linux_timespec req;
+    if (!args[0] || copy_from_user(&req, (const void*)args[0], sizeof(req)))
+        return -EFAULT;
+    if (req.tv_sec < 0 || req.tv_nsec < 0 || req.tv_nsec >= (int64_t)NSEC_PER_SEC)
+        return -EINVAL;
+    timer_sleep_ns((uint64_t)req.tv_sec * NSEC_PER_SEC + (uint64_t)req.tv_nsec);
+    return 0;
+}
+
+static uint64_t linux_futex(const uint64_t* args)
+{
+    // long futex(uint32_t *uaddr, int op, uint32_t val,
+    //            const struct timespec *timeout, uint32_t *uaddr2, uint32_t val3)
+    return (uint64_t)futex_syscall((uint32_t*)args[0], (int)args[1], (uint32_t)args[2], args[3],
+                                   (uint32_t*)args[4], (uint32_t)args[5]);
+}
+
+static uint64_t linux_epoll_create(const uint64_t* args)
+{
+    // int epoll_create(int size) – the size is only a hint, but must be > 0
+    if ((int)args[0] <= 0)
+        return -EINVAL;
+    return (uint64_t)(int64_t)epoll_create(0);
+}
+
+static uint64_t linux_epoll_create1(const uint64_t* args)
+{
+    // int epoll_create1(int flags)
+    return (uint64_t)(int64_t)epoll_create((int)args[0]);
+}
+
+static uint64_t linux_epoll_ctl(const uint64_t* args)
+{
+    // int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+    return (uint64_t)(int64_t)epoll_ctl((int)args[0], (int)args[1], (int)args[2],
+                                        (const struct epoll_event*)args[3]);
+}
+
+static uint64_t linux_epoll_wait(const uint64_t* args)
+{
+    // int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+    //                int timeout_ms)
+    int     ms = (int)args[3];
+    int64_t ns = ms < 0 ? -1 : (int64_t)ms * (int64_t)NSEC_PER_MSEC;
+    return (uint64_t)(int64_t)epoll_wait((int)args[0], (struct epoll_event*)args[1], (int)args[2], ns);
+}
+
+static uint64_t linux_epoll_pwait(const uint64_t* args)
+{
+    // int epoll_pwait(int epfd, struct epoll_event *events, int maxevents,
+    //                 int timeout_ms, const sigset_t *sigmask, size_t sigsetsize)
+    // – there are no signals, so the mask changes nothing
+    return linux_epoll_wait(args);
+}
+
+static uint64_t linux_eventfd(const uint64_t* args)
+{
+    // int eventfd(unsigned int initval)
+    return (uint64_t)(int64_t)eventfd_create((uint32_t)args[0], 0);
+}
+
+static uint64_t linux_eventfd2(const uint64_t* args)
+{
+    // int eventfd2(unsigned int initval, int flags)
+    return (uint64_t)(int64_t)eventfd_create((uint32_t)args[0], (int)args[1]);
+}
+
+static uint64_t linux_timerfd_create(const uint64_t* args)
+{
+    // int timerfd_create(int clockid, int flags)
+    return (uint64_t)(int64_t)timerfd_create((int)args[0], (int)args[1]);
+}
+
+static uint64_t linux_timerfd_settime(const uint64_t* args)
+{
+    // int timerfd_settime(int fd, int flags, const struct itimerspec *new,
+    //                     struct itimerspec *old)
+    return (uint64_t)(int64_t)timerfd_settime((int)args[0], (int)args[1],
+                                              (const struct timerfd_itimerspec*)args[2],
+                                              (struct timerfd_itimerspec*)args[3]);
+}
+
+static uint64_t linux_timerfd_gettime(const uint64_t* args)
+{
+    // int timerfd_gettime(int fd, struct itimerspec *cur)
+    return (uint64_t)(int64_t)timerfd_gettime((int)args[0], (struct timerfd_itimerspec*)args[1]);
+}
+
+static uint64_t linux_clock_gettime(const uint64_t* args)
+{
+    // int clock_gettime(clockid_t clk, struct timespec *ts) – the vDSO
+    // handles the common clocks; everything else reads the one clock too
+    struct linux_timespec ts;
+    switch ((int)args[0])
+    {
+    case 0: // CLOCK_REALTIME
+    case 1: // CLOCK_MONOTONIC
+    case 4: // CLOCK_MONOTONIC_RAW
+    case 5: // CLOCK_REALTIME_COARSE
+    case 6: // CLOCK_MONOTONIC_COARSE
+    case 7: // CLOCK_BOOTTIME
+        break;
+    default:
+        return -EINVAL;
+    }
+    if (!args[1])
+        return -EFAULT;
+    uint64_t ns = clock_now_ns();
+    ts.tv_sec   = (int64_t)(ns / NSEC_PER_SEC);
+    ts.tv_nsec  = (int64_t)(ns % NSEC_PER_SEC);
+    return copy_to_user((void*)args[1], &ts, sizeof(ts)) ? -EFAULT : 0;
+}
+
+const struct syscall_desc linux_syscall_table[NR_LINUX_SYSCALLS] = {
+    [LINUX_SYS_READ]            = {"read", 3, linux_read},
+    [LINUX_SYS_WRITE]           = {"write", 3, linux_write},
+    [LINUX_SYS_OPEN]            = {"open", 3, linux_open},
+    [LINUX_SYS_CLOSE]           = {"close", 1, linux_close},
+    [LINUX_SYS_STAT]            = {"stat", 2, linux_stat},
+    [LINUX_SYS_FSTAT]           = {"fstat", 2, linux_fstat},
+    [LINUX_SYS_LSTAT]           = {"lstat", 2, linux_stat},
+    [LINUX_SYS_LSEEK]           = {"lseek", 3, linux_lseek},
+    [LINUX_SYS_MMAP]            = {"mmap", 6, linux_mmap},
+    [LINUX_SYS_MUNMAP]          = {"munmap", 2, linux_munmap},
+    [LINUX_SYS_BRK]             = {"brk", 1, linux_brk},
+    [LINUX_SYS_RT_SIGACTION]    = {"rt_sigaction", 4, linux_rt_sigaction},
+    [LINUX_SYS_RT_SIGPROCMASK]  = {"rt_sigprocmask", 4, linux_rt_sigprocmask},
+    [LINUX_SYS_IOCTL]           = {"ioctl", 3, linux_ioctl},
+    [LINUX_SYS_READV]           = {"readv", 3, linux_readv},
+    [LINUX_SYS_WRITEV]          = {"writev", 3, linux_writev},
+    [LINUX_SYS_SCHED_YIELD]     = {"sched_yield", 0, linux_sched_yield},
+    [LINUX_SYS_NANOSLEEP]       = {"nanosleep", 2, linux_nanosleep},
+    [LINUX_SYS_GETPID]          = {"getpid", 0, linux_getpid},
+    [LINUX_SYS_CLONE]           = {"clone", 5, linux_clone},
+    [LINUX_SYS_VFORK]           = {"vfork", 0, linux_vfork},
+    [LINUX_SYS_EXECVE]          = {"execve", 3, linux_execve},
+    [LINUX_SYS_EXIT]            = {"exit", 1, linux_exit},
+    [LINUX_SYS_UNAME]           = {"uname", 1, linux_uname},
+    [LINUX_SYS_FCNTL]           = {"fcntl", 3, linux_fcntl},
+    [LINUX_SYS_GETCWD]          = {"getcwd", 2, linux_getcwd},
+    [LINUX_SYS_GETUID]          = {"getuid", 0, linux_zero},
+    [LINUX_SYS_GETGID]          = {"getgid", 0, linux_zero},
+    [LINUX_SYS_GETEUID]         = {"geteuid", 0, linux_zero},
+    [LINUX_SYS_GETEGID]         = {"getegid", 0, linux_zero},
+    [LINUX_SYS_GETPPID]         = {"getppid", 0, linux_zero},
+    [LINUX_SYS_ARCH_PRCTL]      = {"arch_prctl", 2, linux_arch_prctl},
+    [LINUX_SYS_GETTID]          = {"gettid", 0, linux_gettid},
+    [LINUX_SYS_GETDENTS64]      = {"getdents64", 3, linux_getdents64},
+    [LINUX_SYS_SET_TID_ADDRESS] = {"set_tid_address", 1, linux_set_tid_address},
+    [LINUX_SYS_CLOCK_GETTIME]   = {"clock_gettime", 2, linux_clock_gettime},
+    [LINUX_SYS_EXIT_GROUP]      = {"exit_group", 1, linux_exit_group},
+    [LINUX_SYS_OPENAT]          = {"openat", 4, linux_openat},
+    [LINUX_SYS_NEWFSTATAT]      = {"newfstatat", 4, linux_newfstatat},
+    [LINUX_SYS_PIPE]            = {"pipe", 1, linux_pipe},
+    [LINUX_SYS_PIPE2]           = {"pipe2", 2, linux_pipe2},
+    [LINUX_SYS_SPLICE]          = {"splice", 6, linux_splice},
+    [LINUX_SYS_TEE]             = {"tee", 4, linux_tee},
+    [LINUX_SYS_SENDFILE]        = {"sendfile", 4, linux_sendfile},
+    [LINUX_SYS_FUTEX]           = {"futex", 6, linux_futex},
+    [LINUX_SYS_EPOLL_CREATE]    = {"epoll_create", 1, linux_epoll_create},
+    [LINUX_SYS_EPOLL_CREATE1]   = {"epoll_create1", 1, linux_epoll_create1},
+    [LINUX_SYS_EPOLL_CTL]       = {"epoll_ctl", 4, linux_epoll_ctl},
+    [LINUX_SYS_EPOLL_WAIT]      = {"epoll_wait", 4, linux_epoll_wait},
+    [LINUX_SYS_EPOLL_PWAIT]     = {"epoll_pwait", 6, linux_epoll_pwait},
+    [LINUX_SYS_EVENTFD]         = {"eventfd", 1, linux_eventfd},
+    [LINUX_SYS_EVENTFD2]        = {"eventfd2", 2, linux_eventfd2},
+    [LINUX_SYS_TIMERFD_CREATE]  = {"timerfd_create", 2, linux_timerfd_create},
+    [LINUX_SYS_TIMERFD_SETTIME] = {"timerfd_settime", 4, linux_timerfd_settime},
+    [LINUX_SYS_TIMERFD_GETTIME] = {"timerfd_gettime", 2, linux_timerfd_gettime},
+};
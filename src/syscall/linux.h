@@ -0,0 +1,13 @@
+#ifndef SYSCALL_LINUX_H
+#define SYSCALL_LINUX_H
+
+#include "syscall/linux_sysno.h"
+#include "syscall/syscall.h"
+
+// Linux x86-64 personality: handlers for LINUX_SYS_* calls, dispatched by
+// syscall_handler for tasks running with PERSONALITY_LINUX. They follow
+// the Linux conventions, returning -errno on failure.
+
+extern const struct syscall_desc linux_syscall_table[NR_LINUX_SYSCALLS];
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SYSCALL_LINUX_SYSNO_H
+#define SYSCALL_LINUX_SYSNO_H
+
+// Linux x86-64 system call numbers, for tasks with PERSONALITY_LINUX: the
+// subset a static musl binary (toybox) needs. Same registers as the native
+// calls; errors come back as -errno.
+
+#define LINUX_SYS_READ            0
+#define LINUX_SYS_WRITE           1
+#define LINUX_SYS_OPEN            2
+#define LINUX_SYS_CLOSE           3
+#define LINUX_SYS_STAT            4
+#define LINUX_SYS_FSTAT           5
+#define LINUX_SYS_LSTAT           6
+#define LINUX_SYS_LSEEK           8
+#define LINUX_SYS_MMAP            9
+#define LINUX_SYS_MUNMAP          11
+#define LINUX_SYS_BRK             12
+#define LINUX_SYS_RT_SIGACTION    13
+#define LINUX_SYS_RT_SIGPROCMASK  14
+#define LINUX_SYS_IOCTL           16
+#define LINUX_SYS_READV           19
+#define LINUX_SYS_WRITEV          20
+#define LINUX_SYS_PIPE            22
+#define LINUX_SYS_SCHED_YIELD     24
+#define LINUX_SYS_NANOSLEEP       35
+#define LINUX_SYS_GETPID          39
+#define LINUX_SYS_SENDFILE        40
+#define LINUX_SYS_CLONE           56
+#define LINUX_SYS_VFORK           58
+#define LINUX_SYS_EXECVE          59
+#define LINUX_SYS_EXIT            60
+#define LINUX_SYS_UNAME           63
+#define LINUX_SYS_FCNTL           72
+#define LINUX_SYS_GETCWD          79
+#define LINUX_SYS_GETUID          102
+#define LINUX_SYS_GETGID          104
+#define LINUX_SYS_GETEUID         107
+#define LINUX_SYS_GETEGID         108
+#define LINUX_SYS_GETPPID         110
+#define LINUX_SYS_ARCH_PRCTL      158
+#define LINUX_SYS_GETTID          186
+#define LINUX_SYS_FUTEX           202
+#define LINUX_SYS_EPOLL_CREATE    213
+#define LINUX_SYS_GETDENTS64      217
+#define LINUX_SYS_SET_TID_ADDRESS 218
+#define LINUX_SYS_CLOCK_GETTIME   228
+#define LINUX_SYS_EXIT_GROUP      231
+#define LINUX_SYS_EPOLL_WAIT      232
+#define LINUX_SYS_EPOLL_CTL       233
+#define LINUX_SYS_OPENAT          257
+#define LINUX_SYS_NEWFSTATAT      262
+#define LINUX_SYS_SPLICE          275
+#define LINUX_SYS_TEE             276
+#define LINUX_SYS_EPOLL_PWAIT     281
+#define LINUX_SYS_TIMERFD_CREATE  283
+#define LINUX_SYS_EVENTFD         284
+#define LINUX_SYS_TIMERFD_SETTIME 286
+#define LINUX_SYS_TIMERFD_GETTIME 287
+#define LINUX_SYS_EVENTFD2        290
+#define LINUX_SYS_EPOLL_CREATE1   291
+#define LINUX_SYS_PIPE2           293
+
+#define NR_LINUX_SYSCALLS         294      // size of the Linux dispatch table
+
+#endif
@@ -1,147 +1,731 @@
 // syscall.c
 #include "syscall.h"
+#include "syscall/linux.h"
+#include "syscall/sysno.h"
+#include "syscall/uring.h"
 #include "serial/serial.h"     // assuming you have serial output
 #include "console/console.h"   // optional: graphical console
 #include "utils/log.h"         // optional: kernel logging
+#include "time/clock.h"
+#include "time/timer.h"
+#include "boot/cpu.h"
+#include "boot/gdt.h"
+#include "boot/percpu.h"
+#include "fs/eventfd.h"
+#include "fs/eventpoll.h"
+#include "fs/fdtable.h"
+#include "fs/file.h"
+#include "fs/pipe.h"
+#include "fs/splice.h"
+#include "fs/timerfd.h"
+#include "lib/errno.h"
+#include "mem/mm.h"
+#include "mem/uaccess.h"
+#include "multitasking/futex.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "sys/proc.h"
+#include "sys/thread.h"
 
 #include <stdint.h>
 #include <stddef.h>
 
+
+// RFLAGS bits SYSCALL clears on entry: IF keeps interrupts off until the
+// stub is on the kernel stack; TF, DF, AC, NT and IOPL must not leak in
+// from user mode
+#define SYSCALL_RFLAGS_MASK 0x47700
+
+// Longest path open() copies in, NUL included
+#define PATH_MAX_LEN 128
+
+extern void __syscall_entry(void);
+
+static int fast_enabled = 0;
+
+int syscall_fast_enabled(void)
+{
+    return fast_enabled;
+}
+
+void syscall_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(0x80000001, 0, &a, &b, &c, &d);
+    if (!(d & (1U << 11)))
+    {
+        serial_puts("syscall: no SYSCALL/SYSRET, int 0x80 only\n");
+        return;
+    }
+
+    // SYSCALL loads CS = STAR[47:32] and SS = +8; SYSRET to 64-bit mode
+    // loads SS = STAR[63:48] + 8 and CS = +16 (with RPL 3)
+    uint64_t star = ((uint64_t)GDT_KERNEL_DS << 48) | ((uint64_t)GDT_KERNEL_CS << 32);
+    wrmsr(MSR_STAR, star);
+    wrmsr(MSR_LSTAR, (uint64_t)(uintptr_t)__syscall_entry);
+    wrmsr(MSR_SFMASK, SYSCALL_RFLAGS_MASK);
+    wrmsr(MSR_KERNEL_GS_BASE, (uint64_t)(uintptr_t)&percpu0);
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SCE);
+    fast_enabled = 1;
+    serial_puts("syscall: SYSCALL fast path enabled\n");
+}
+
+// ────────────────────────────────────────────────
+// Handlers. Each takes the raw argument registers and returns the value
+// for rax; a negative value counts as an error in the statistics.
+// ────────────────────────────────────────────────
+
+static uint64_t sys_exit(const uint64_t* args)
+{
+    // void exit(int status)
+    int status = (int)args[0];
+    serial_puts("syscall exit called with status ");
+    serial_putdec(status);
+    serial_puts("\n");
+
+    // End the calling thread; the scheduler reaps it once it has
+    // switched away for good
+    thread_exit();
+}
+
+static uint64_t sys_exit_group(const uint64_t* args)
+{
+    // void exit_group(int status) – what the user runtime's exit() ends with
+    (void)args;
+    thread_exit_group();
+}
+
+static uint64_t sys_write(const uint64_t* args)
+{
+    // ssize_t write(int fd, const void *buf, size_t count)
+    if (!access_ok((const void*)args[1], args[2]))
+        return -EFAULT;
+    struct file* f = fd_get(scheduler_get_files(), (int)args[0]);
+    if (!f)
+        return -EBADF;
+    long ret = file_write(f, (const void*)args[1], (size_t)args[2], NULL);
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+static uint64_t sys_read(const uint64_t* args)
+{
+    // ssize_t read(int fd, void *buf, size_t count) – regular files copy
+    // straight from the page cache into buf
+    if (!access_ok((void*)args[1], args[2]))
+        return -EFAULT;
+    struct file* f = fd_get(scheduler_get_files(), (int)args[0]);
+    if (!f)
+        return -EBADF;
+    long ret = file_read(f, (void*)args[1], (size_t)args[2], NULL);
+    file_put(f);
+    return (uint64_t)ret;
+}
+
+static uint64_t sys_puts(const uint64_t* args)
+{
+    // void puts(const char *s) – debug helper
+    const char* s = (const char*)args[0];
+    char        chunk[64];
+    long        n;
+    if (!s)
+        return 0;
+    do
+    {
+        n = strncpy_from_user(chunk, s, sizeof(chunk));
+        if (n < 0)
+            return (uint64_t)n;
+        for (long i = 0; i < n; i++)
+            serial_putc(chunk[i]);
+        s += n;
+    } while (n == (long)sizeof(chunk));
+    serial_putc('\n');
+    return 0;
+}
+
+static uint64_t sys_getpid(const uint64_t* args)
+{
+    // pid_t getpid(void) – the thread group id; the vDSO answers this
+    // without a trap
+    (void)args;
+    return (uint64_t)scheduler_get_tgid();
+}
+
+static uint64_t sys_yield(const uint64_t* args)
+{
+    // void yield(void) – give up the CPU
+    (void)args;
+    scheduler_yield();
+    return 0;
+}
+
+static uint64_t sys_sleep(const uint64_t* args)
+{
+    // int nanosleep(uint64_t ns) – blocks on the timer wheel, so a
+    // sleeping task costs nothing until its deadline
+    timer_sleep_ns(args[0]);
+    return 0;
+}
+
+static uint64_t sys_clock_gettime(const uint64_t* args)
+{
+    // int clock_gettime(clockid_t clk, struct timespec *ts) – the
+    // vDSO only traps here for clocks it does not handle itself
+    int clk = (int)args[0];
+    if ((clk != CLOCK_MONOTONIC && clk != CLOCK_REALTIME) || !args[1])
+        return -EINVAL;
+    uint64_t ns    = clock_now_ns();
+    uint64_t ts[2] = {ns / NSEC_PER_SEC, ns % NSEC_PER_SEC};
+    if (copy_to_user((void*)args[1], ts, sizeof(ts)))
+        return -EFAULT;
+    return 0;
+}
+
+static uint64_t sys_mmap(const uint64_t* args)
+{
+    // void *mmap(void *hint, size_t len, int prot) – anonymous memory, for
+    // allocations too big for the heap; only processes have an address
+    // space to put it in
+    struct mm* mm = scheduler_get_mm();
+    if (!mm)
+        return -ENOMEM;
+    uint32_t prot = (uint32_t)args[2] & (VMA_READ | VMA_WRITE | VMA_EXEC);
+    return (uint64_t)mm_mmap(mm, args[0], args[1], prot, 0);
+}
+
+static uint64_t sys_munmap(const uint64_t* args)
+{
+    // int munmap(void *addr, size_t len)
+    struct mm* mm = scheduler_get_mm();
+    return mm ? (uint64_t)(int64_t)mm_munmap(mm, args[0], args[1]) : (uint64_t)-EINVAL;
+}
+
+static uint64_t sys_brk(const uint64_t* args)
+{
+    // void *brk(void *addr) – the break in effect afterwards, unchanged if
+    // addr is 0 or cannot be reached; sbrk() is built on this in user space
+    struct mm* mm = scheduler_get_mm();
+    return mm ? mm_brk(mm, args[0]) : 0;
+}
+
+static uint64_t sys_set_tls(const uint64_t* args)
+{
+    // int set_tls(void *tp) – the thread pointer the user runtime reads
+    // through %fs
+    if (args[0] >= USER_STACK_TOP)
+        return -EPERM;
+    scheduler_set_fs_base(args[0]);
+    return 0;
+}
+
+static uint64_t sys_open(const uint64_t* args)
+{
+    // int open(const char *path, int flags)
+    struct fdtable* t = scheduler_get_files();
+    struct file*    f;
+    char            path[PATH_MAX_LEN];
+    if (!t)
+        return -EBADF;
+    if (!args[0])
+        return -EFAULT;
+    long len = strncpy_from_user(path, (const char*)args[0], sizeof(path));
+    if (len < 0)
+        return (uint64_t)len;
+    if (len == (long)sizeof(path))
+        return -ENAMETOOLONG;
+    int rc = file_open(path, (int)args[1], &f);
+    if (rc < 0)
+        return (uint64_t)(int64_t)rc;
+    int fd = fd_install(t, f, 0, 0);
+    if (fd < 0)
+        file_put(f);
+    return (uint64_t)(int64_t)fd;
+}
+
+static uint64_t sys_close(const uint64_t* args)
+{
+    // int close(int fd)
+    return (uint64_t)(int64_t)fd_close(scheduler_get_files(), (int)args[0]);
+}
+
+static uint64_t sys_readdir(const uint64_t* args)
+{
+    // int readdir(int fd, struct file_dirent *ent) – the next entry of a
+    // directory: 1 if *ent was filled, 0 at the end
+    struct file_dirent ent;
+    if (!args[1])
+        return -EFAULT;
+    struct file* f = fd_get(scheduler_get_files(), (int)args[0]);
+    if (!f)
+        return -EBADF;
+    int rc = file_readdir(f, f->pos, &ent);
+    if (rc > 0 && copy_to_user((void*)args[1], &ent, sizeof(ent)))
+        rc = -EFAULT;
+    else if (rc > 0)
+        f->pos++;
+    file_put(f);
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t sys_pipe(const uint64_t* args)
+{
+    // int pipe(int fds[2])
+    struct fdtable* t = scheduler_get_files();
+    struct file *   rd, *wr;
+    if (!t)
+        return -EBADF;
+    if (!args[0])
+        return -EFAULT;
+    int rc = pipe_create(&rd, &wr);
+    if (rc < 0)
+        return (uint64_t)(int64_t)rc;
+    int rfd = fd_install(t, rd, 0, 0);
+    int wfd = rfd < 0 ? rfd : fd_install(t, wr, 0, 0);
+    if (wfd < 0)
+    {
+        if (rfd >= 0)
+            fd_close(t, rfd);
+        else
+            file_put(rd);
+        file_put(wr);
+        return (uint64_t)(int64_t)wfd;
+    }
+    int fds[2] = {rfd, wfd};
+    if (copy_to_user((void*)args[0], fds, sizeof(fds)))
+    {
+        fd_close(t, rfd);
+        fd_close(t, wfd);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+static uint64_t sys_splice(const uint64_t* args)
+{
+    // ssize_t splice(int fd_in, uint64_t *off_in, int fd_out,
+    //                uint64_t *off_out, size_t len)
+    uint64_t* uoff_in  = (uint64_t*)args[1];
+    uint64_t* uoff_out = (uint64_t*)args[3];
+    uint64_t  off_in, off_out;
+    if ((uoff_in && copy_from_user(&off_in, uoff_in, sizeof(off_in))) ||
+        (uoff_out && copy_from_user(&off_out, uoff_out, sizeof(off_out))))
+        return -EFAULT;
+    struct file* in  = fd_get(scheduler_get_files(), (int)args[0]);
+    struct file* out = fd_get(scheduler_get_files(), (int)args[2]);
+    long         rc  = -EBADF;
+    if (in && out)
+        rc = splice_files(in, uoff_in ? &off_in : NULL, out, uoff_out ? &off_out : NULL,
+                          (size_t)args[4]);
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    if (rc > 0 && ((uoff_in && copy_to_user(uoff_in, &off_in, sizeof(off_in))) ||
+                   (uoff_out && copy_to_user(uoff_out, &off_out, sizeof(off_out)))))
+        rc = -EFAULT;
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t sys_tee(const uint64_t* args)
+{
+    // ssize_t tee(int fd_in, int fd_out, size_t len)
+    struct file* in  = fd_get(scheduler_get_files(), (int)args[0]);
+    struct file* out = fd_get(scheduler_get_files(), (int)args[1]);
+    long         rc  = in && out ? tee_pipes(in, out, (size_t)args[2]) : -EBADF;
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t sys_sendfile(const uint64_t* args)
+{
+    // ssize_t sendfile(int fd_out, int fd_in, uint64_t *off, size_t count)
+    uint64_t* uoff = (uint64_t*)args[2];
+    uint64_t  off;
+    if (uoff && copy_from_user(&off, uoff, sizeof(off)))
+        return -EFAULT;
+    struct file* out = fd_get(scheduler_get_files(), (int)args[0]);
+    struct file* in  = fd_get(scheduler_get_files(), (int)args[1]);
+    long rc = in && out ? sendfile_files(out, in, uoff ? &off : NULL, (size_t)args[3]) : -EBADF;
+    if (in)
+        file_put(in);
+    if (out)
+        file_put(out);
+    if (rc > 0 && uoff && copy_to_user(uoff, &off, sizeof(off)))
+        rc = -EFAULT;
+    return (uint64_t)(int64_t)rc;
+}
+
+static uint64_t sys_futex(const uint64_t* args)
+{
+    // long futex(uint32_t *uaddr, int op, uint32_t val,
+    //            const struct timespec *timeout, uint32_t *uaddr2, uint32_t val3)
+    return (uint64_t)futex_syscall((uint32_t*)args[0], (int)args[1], (uint32_t)args[2], args[3],
+                                   (uint32_t*)args[4], (uint32_t)args[5]);
+}
+
+static uint64_t sys_clone(const uint64_t* args)
+{
+    // long clone(uint64_t flags, void *stack, int *ptid, int *ctid, uint64_t tls)
+    return (uint64_t)(int64_t)thread_clone(args[0], args[1], (int*)args[2], (int*)args[3], args[4]);
+}
+
+static uint64_t sys_spawn(const uint64_t* args)
+{
+    // int spawn(const char *path, char *const argv[], char *const envp[],
+    //           const struct spawn_action *actions, int nactions,
+    //           const struct spawn_attr *attr) – the child's pid; it is
+    // built from the file, so this costs the same however big we are
+    char                path[PATH_MAX_LEN];
+    struct spawn_action actions[SPAWN_ACTIONS_MAX];
+    struct spawn_attr   attr;
+    int                 nactions = (int)args[4];
+    if (!args[0])
+        return -EFAULT;
+    long len = strncpy_from_user(path, (const char*)args[0], sizeof(path));
+    if (len < 0)
+        return (uint64_t)len;
+    if (len == (long)sizeof(path))
+        return -ENAMETOOLONG;
+    if (nactions < 0 || nactions > SPAWN_ACTIONS_MAX)
+        return -EINVAL;
+    if (nactions && copy_from_user(actions, (const void*)args[3], nactions * sizeof(actions[0])))
+        return -EFAULT;
+    if (args[5] && copy_from_user(&attr, (const void*)args[5], sizeof(attr)))
+        return -EFAULT;
+    return (uint64_t)(int64_t)proc_spawn(path, (const char* const*)args[1], (const char* const*)args[2],
+                                         actions, nactions, args[5] ? &attr : NULL);
+}
+
+static uint64_t sys_exec(const uint64_t* args)
+{
+    // int exec(const char *path, char *const argv[], char *const envp[]) –
+    // returns only on failure
+    char path[PATH_MAX_LEN];
+    if (!args[0])
+        return -EFAULT;
+    long len = strncpy_from_user(path, (const char*)args[0], sizeof(path));
+    if (len < 0)
+        return (uint64_t)len;
+    if (len == (long)sizeof(path))
+        return -ENAMETOOLONG;
+    return (uint64_t)(int64_t)proc_exec(path, (const char* const*)args[1], (const char* const*)args[2]);
+}
+
+static uint64_t sys_epoll_create(const uint64_t* args)
+{
+    // int epoll_create(int flags)
+    return (uint64_t)(int64_t)epoll_create((int)args[0]);
+}
+
+static uint64_t sys_epoll_ctl(const uint64_t* args)
+{
+    // int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+    return (uint64_t)(int64_t)epoll_ctl((int)args[0], (int)args[1], (int)args[2],
+                                        (const struct epoll_event*)args[3]);
+}
+
+static uint64_t sys_epoll_wait(const uint64_t* args)
+{
+    // int epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+    //                int64_t timeout_ns)
+    return (uint64_t)(int64_t)epoll_wait((int)args[0], (struct epoll_event*)args[1], (int)args[2],
+                                         (int64_t)args[3]);
+}
+
+static uint64_t sys_eventfd(const uint64_t* args)
+{
+    // int eventfd(unsigned int initval, int flags)
+    return (uint64_t)(int64_t)eventfd_create((uint32_t)args[0], (int)args[1]);
+}
+
+static uint64_t sys_timerfd_create(const uint64_t* args)
+{
+    // int timerfd_create(int clockid, int flags)
+    return (uint64_t)(int64_t)timerfd_create((int)args[0], (int)args[1]);
+}
+
+static uint64_t sys_timerfd_settime(const uint64_t* args)
+{
+    // int timerfd_settime(int fd, int flags, const struct itimerspec *new,
+    //                     struct itimerspec *old)
+    return (uint64_t)(int64_t)timerfd_settime((int)args[0], (int)args[1],
+                                              (const struct timerfd_itimerspec*)args[2],
+                                              (struct timerfd_itimerspec*)args[3]);
+}
+
+static uint64_t sys_timerfd_gettime(const uint64_t* args)
+{
+    // int timerfd_gettime(int fd, struct itimerspec *cur)
+    return (uint64_t)(int64_t)timerfd_gettime((int)args[0], (struct timerfd_itimerspec*)args[1]);
+}
+
+static uint64_t sys_uring_setup(const uint64_t* args)
+{
+    // int uring_setup(uint32_t entries, struct uring_params *p)
+    return (uint64_t)(int64_t)uring_setup((uint32_t)args[0], (struct uring_params*)args[1]);
+}
+
+static uint64_t sys_uring_enter(const uint64_t* args)
+{
+    // int uring_enter(int ring, uint32_t to_submit, uint32_t min_complete,
+    //                 uint32_t flags) – one trap for a whole batch
+    return (uint64_t)(int64_t)uring_enter((int)args[0], (uint32_t)args[1], (uint32_t)args[2],
+                                          (uint32_t)args[3]);
+}
+
+static uint64_t sys_uring_close(const uint64_t* args)
+{
+    // int uring_close(int ring)
+    return (uint64_t)(int64_t)uring_close((int)args[0]);
+}
+
+static const struct syscall_desc syscall_table[NR_SYSCALLS] = {
+    [SYS_EXIT]            = {"exit", 1, sys_exit},
+    [SYS_WRITE]           = {"write", 3, sys_write},
+    [SYS_READ]            = {"read", 3, sys_read},
+    [SYS_PUTS]            = {"puts", 1, sys_puts},
+    [SYS_GETPID]          = {"getpid", 0, sys_getpid},
+    [SYS_YIELD]           = {"yield", 0, sys_yield},
+    [SYS_SLEEP]           = {"nanosleep", 1, sys_sleep},
+    [SYS_CLOCK_GETTIME]   = {"clock_gettime", 2, sys_clock_gettime},
+    [SYS_MMAP]            = {"mmap", 3, sys_mmap},
+    [SYS_MUNMAP]          = {"munmap", 2, sys_munmap},
+    [SYS_BRK]             = {"brk", 1, sys_brk},
+    [SYS_EXIT_GROUP]      = {"exit_group", 1, sys_exit_group},
+    [SYS_SET_TLS]         = {"set_tls", 1, sys_set_tls},
+    [SYS_OPEN]            = {"open", 2, sys_open},
+    [SYS_CLOSE]           = {"close", 1, sys_close},
+    [SYS_READDIR]         = {"readdir", 2, sys_readdir},
+    [SYS_URING_SETUP]     = {"uring_setup", 2, sys_uring_setup},
+    [SYS_URING_ENTER]     = {"uring_enter", 4, sys_uring_enter},
+    [SYS_URING_CLOSE]     = {"uring_close", 1, sys_uring_close},
+    [SYS_PIPE]            = {"pipe", 1, sys_pipe},
+    [SYS_SPLICE]          = {"splice", 5, sys_splice},
+    [SYS_TEE]             = {"tee", 3, sys_tee},
+    [SYS_SENDFILE]        = {"sendfile", 4, sys_sendfile},
+    [SYS_FUTEX]           = {"futex", 6, sys_futex},
+    [SYS_CLONE]           = {"clone", 5, sys_clone},
+    [SYS_SPAWN]           = {"spawn", 6, sys_spawn},
+    [SYS_EXEC]            = {"exec", 3, sys_exec},
+    [SYS_EPOLL_CREATE]    = {"epoll_create", 1, sys_epoll_create},
+    [SYS_EPOLL_CTL]       = {"epoll_ctl", 4, sys_epoll_ctl},
+    [SYS_EPOLL_WAIT]      = {"epoll_wait", 4, sys_epoll_wait},
+    [SYS_EVENTFD]         = {"eventfd", 2, sys_eventfd},
+    [SYS_TIMERFD_CREATE]  = {"timerfd_create", 2, sys_timerfd_create},
+    [SYS_TIMERFD_SETTIME] = {"timerfd_settime", 4, sys_timerfd_settime},
+    [SYS_TIMERFD_GETTIME] = {"timerfd_gettime", 2, sys_timerfd_gettime},
+};
+
 // ────────────────────────────────────────────────
-// Syscall numbers (you can expand this list)
+// Statistics. Counters are bumped with relaxed atomics: handlers run with
+// interrupts on and can be preempted by another task's syscall, but the
+// numbers only need to be exact, not ordered.
 // ────────────────────────────────────────────────
 
-#define SYS_EXIT      0
-#define SYS_WRITE     1
-#define SYS_READ      2
-#define SYS_PUTS      3        // simple kernel puts (debug)
-#define SYS_GETPID    4
-#define SYS_YIELD     5
-#define SYS_SLEEP     6
-#define SYS_MMAP      10
-#define SYS_MUNMAP    11
-#define SYS_OPEN      20
-#define SYS_CLOSE     21
-#define SYS_READDIR   22
-
-// Current process ID (dummy – replace with real scheduler later)
-static uint64_t current_pid = 1;
+struct syscall_counters
+{
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint64_t hist[SYSCALL_HIST_BUCKETS];
+};
+
+static struct syscall_counters counters[NR_SYSCALL_SLOTS];
+static uint32_t                task_calls[SCHED_MAX_TASKS][NR_SYSCALL_SLOTS];
+static uint64_t                unknown_calls;
+
+static struct syscall_trace_entry trace_ring[SYSCALL_TRACE_ENTRIES];
+static uint64_t                   trace_head;
+static spinlock_t                 trace_lock = SPINLOCK_INIT;
+static int                        trace_on;
+
+// Table entry for a slot, NULL if nothing implements it
+static const struct syscall_desc* slot_desc(int nr)
+{
+    if (nr < 0 || nr >= NR_SYSCALL_SLOTS)
+        return NULL;
+    const struct syscall_desc* d = nr < SYSCALL_LINUX_BASE
+                                       ? &syscall_table[nr]
+                                       : &linux_syscall_table[nr - SYSCALL_LINUX_BASE];
+    return d->fn ? d : NULL;
+}
+
+static int hist_bucket(uint64_t cycles)
+{
+    int b = 63 - __builtin_clzll(cycles | 1) - SYSCALL_HIST_SHIFT;
+    if (b < 0)
+        return 0;
+    return b < SYSCALL_HIST_BUCKETS ? b : SYSCALL_HIST_BUCKETS - 1;
+}
+
+static void trace_record(int tid, uint64_t num, const uint64_t* args, uint64_t ret,
+                         uint64_t start, uint64_t cycles)
+{
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    struct syscall_trace_entry* e = &trace_ring[trace_head++ % SYSCALL_TRACE_ENTRIES];
+    e->tsc     = start;
+    e->cycles  = cycles;
+    e->tid     = tid;
+    e->nr      = (int)num;
+    for (int i = 0; i < SYSCALL_MAX_ARGS; i++)
+        e->args[i] = args[i];
+    e->ret     = (int64_t)ret;
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
 
 // ────────────────────────────────────────────────
-// Syscall handler – called from assembly interrupt handler
-// Arguments come in registers (System V AMD64 ABI style):
-//   num  = rdi
-//   a1   = rsi
-//   a2   = rdx
-//   a3   = rcx   (sometimes used, but often rdi/rsi/rdx/r10)
+// Syscall handler – called from both entry stubs (int 0x80 and SYSCALL)
+// with the number from rax and the arguments from rdi, rsi, rdx, r10, r8
+// and r9
 // ────────────────────────────────────────────────
 
-uint64_t syscall_handler(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3)
+uint64_t syscall_handler(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4,
+                         uint64_t a5, uint64_t a6)
+{
+    int            tid      = scheduler_get_current();
+    int            is_linux = scheduler_get_personality() == PERSONALITY_LINUX;
+    const uint64_t args[SYSCALL_MAX_ARGS] = {a1, a2, a3, a4, a5, a6};
+    uint64_t       limit    = is_linux ? NR_LINUX_SYSCALLS : NR_SYSCALLS;
+    int            slot     = (int)num + (is_linux ? SYSCALL_LINUX_BASE : 0);
+
+    const struct syscall_desc* d = num < limit ? slot_desc(slot) : NULL;
+    if (!d)
+    {
+        // Linux programs probe for optional calls and expect ENOSYS
+        uint64_t ret = is_linux ? (uint64_t)-ENOSYS : (uint64_t)-1;
+        __atomic_fetch_add(&unknown_calls, 1, __ATOMIC_RELAXED);
+        if (trace_on)
+            trace_record(tid, num + (is_linux ? SYSCALL_LINUX_BASE : 0), args, ret, rdtsc(), 0);
+        return ret;
+    }
+
+    // Count the call up front: exit never comes back to be timed
+    struct syscall_counters* c = &counters[slot];
+    __atomic_fetch_add(&c->calls, 1, __ATOMIC_RELAXED);
+    if (tid >= 0 && tid < SCHED_MAX_TASKS)
+        __atomic_fetch_add(&task_calls[tid][slot], 1, __ATOMIC_RELAXED);
+
+    uint64_t start  = rdtsc();
+    uint64_t ret    = d->fn(args);
+    uint64_t cycles = rdtsc() - start;
+
+    if ((int64_t)ret < 0)
+        __atomic_fetch_add(&c->errors, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->cycles, cycles, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->hist[hist_bucket(cycles)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&c->max_cycles, __ATOMIC_RELAXED);
+    while (cycles > max &&
+           !__atomic_compare_exchange_n(&c->max_cycles, &max, cycles, 0, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+        ;
+
+    if (trace_on)
+        trace_record(tid, (uint64_t)slot, args, ret, start, cycles);
+    return ret;
+}
+
+struct syscall_frame* syscall_user_frame(void)
+{
+    return (struct syscall_frame*)(uintptr_t)percpu0.kernel_rsp - 1;
+}
+
+const char* syscall_name(int nr)
+{
+    const struct syscall_desc* d = slot_desc(nr);
+    return d ? d->name : NULL;
+}
+
+int syscall_nargs(int nr)
+{
+    const struct syscall_desc* d = slot_desc(nr);
+    return d ? d->nargs : -1;
+}
+
+int syscall_get_stats(struct syscall_stat* out, int max)
 {
-    // Optional: log syscall entry (very useful for debugging)
-    // log("syscall: num=%llu arg1=0x%llx arg2=0x%llx arg3=0x%llx", num, a1, a2, a3);
+    int n = 0;
+    for (int i = 0; i < NR_SYSCALL_SLOTS && n < max; i++)
+    {
+        const struct syscall_desc* d = slot_desc(i);
+        if (!d)
+            continue;
+        struct syscall_counters* c = &counters[i];
+        struct syscall_stat*     s = &out[n++];
+        s->nr         = i;
+        s->name       = d->name;
+        s->nargs      = d->nargs;
+        s->calls      = __atomic_load_n(&c->calls, __ATOMIC_RELAXED);
+        s->errors     = __atomic_load_n(&c->errors, __ATOMIC_RELAXED);
+        s->cycles     = __atomic_load_n(&c->cycles, __ATOMIC_RELAXED);
+        s->max_cycles = __atomic_load_n(&c->max_cycles, __ATOMIC_RELAXED);
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++)
+            s->hist[b] = __atomic_load_n(&c->hist[b], __ATOMIC_RELAXED);
+    }
+    return n;
+}
+
+uint64_t syscall_unknown_calls(void)
+{
+    return __atomic_load_n(&unknown_calls, __ATOMIC_RELAXED);
+}
+
+uint64_t syscall_task_calls(int tid, int nr)
+{
+    if (tid < 0 || tid >= SCHED_MAX_TASKS || nr < 0 || nr >= NR_SYSCALL_SLOTS)
+        return 0;
+    return __atomic_load_n(&task_calls[tid][nr], __ATOMIC_RELAXED);
+}
+
+void syscall_task_reset(int tid)
+{
+    if (tid < 0 || tid >= SCHED_MAX_TASKS)
+        return;
+    for (int i = 0; i < NR_SYSCALL_SLOTS; i++)
+        __atomic_store_n(&task_calls[tid][i], 0, __ATOMIC_RELAXED);
+}
 
-    switch (num)
+void syscall_reset_stats(void)
+{
+    for (int i = 0; i < NR_SYSCALL_SLOTS; i++)
     {
-        case SYS_EXIT:
-        {
-            // void exit(int status)
-            int status = (int)a1;
-            serial_puts("syscall exit called with status ");
-            serial_putdec(status);
-            serial_puts("\n");
-
-            // In real kernel: terminate current task, schedule next
-            // For now: just halt (or panic in debug builds)
-            serial_puts("Kernel: process exited, halting.\n");
-            while (1) asm volatile("hlt");
-            return 0; // unreachable
-        }
-
-        case SYS_WRITE:
-        {
-            // ssize_t write(int fd, const void *buf, size_t count)
-            int    fd    = (int)a1;
-            char*  buf   = (char*)a2;
-            size_t count = (size_t)a3;
-
-            if (fd == 1 || fd == 2) // stdout / stderr
-            {
-                size_t i;
-                for (i = 0; i < count; i++)
-                {
-                    if (buf[i] == '\0') break;
-                    serial_putc(buf[i]);
-                    // console_putchar(buf[i]); // if you have graphical console
-                }
-                return i; // number of bytes written
-            }
-            else
-            {
-                serial_puts("syscall write: unsupported fd ");
-                serial_putdec(fd);
-                serial_puts("\n");
-                return -1; // EBADF
-            }
-        }
-
-        case SYS_READ:
-        {
-            // ssize_t read(int fd, void *buf, size_t count)
-            // For simplicity: no real input yet
-            serial_puts("syscall read: not implemented\n");
-            return -1; // ENOSYS or EAGAIN
-        }
-
-        case SYS_PUTS:
-        {
-            // void puts(const char *s) – debug helper
-            const char *s = (const char*)a1;
-            if (s)
-            {
-                while (*s)
-                {
-                    serial_putc(*s++);
-                }
-                serial_putc('\n');
-            }
-            return 0;
-        }
-
-        case SYS_GETPID:
-        {
-            // pid_t getpid(void)
-            return current_pid;
-        }
-
-        case SYS_YIELD:
-        {
-            // void yield(void) – give up CPU
-            // In real kernel: call scheduler_yield()
-            serial_puts("syscall yield called\n");
-            // asm volatile("int $0x20"); // example software interrupt to scheduler
-            return 0;
-        }
-
-        case SYS_SLEEP:
-        {
-            // unsigned int sleep(unsigned int seconds)
-            uint64_t seconds = a1;
-            serial_puts("syscall sleep(");
-            serial_putdec(seconds);
-            serial_puts(" seconds) – not implemented\n");
-            return seconds; // pretend we slept
-        }
-
-        default:
-        {
-            serial_puts("unknown syscall: ");
-            serial_puthex64(num);
-            serial_puts("\n");
-            return -1; // ENOSYS
-        }
+        uint64_t* p = (uint64_t*)&counters[i];
+        for (size_t w = 0; w < sizeof(counters[i]) / sizeof(uint64_t); w++)
+            __atomic_store_n(&p[w], 0, __ATOMIC_RELAXED);
     }
+    for (int t = 0; t < SCHED_MAX_TASKS; t++)
+        syscall_task_reset(t);
+    __atomic_store_n(&unknown_calls, 0, __ATOMIC_RELAXED);
+}
+
+void syscall_trace_enable(int on)
+{
+    __atomic_store_n(&trace_on, on ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+int syscall_trace_enabled(void)
+{
+    return __atomic_load_n(&trace_on, __ATOMIC_RELAXED);
+}
+
+int syscall_trace_read(struct syscall_trace_entry* out, int max)
+{
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    uint64_t avail = trace_head < SYSCALL_TRACE_ENTRIES ? trace_head : SYSCALL_TRACE_ENTRIES;
+    if ((uint64_t)max < avail)
+        avail = (uint64_t)max;
+    for (uint64_t i = 0; i < avail; i++)
+        out[i] = trace_ring[(trace_head - avail + i) % SYSCALL_TRACE_ENTRIES];
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return (int)avail;
+}
 
-    // Should never reach here
-    return -1;
-}
\ No newline at end of file
+void syscall_trace_clear(void)
+{
+    uint64_t flags = spin_lock_irqsave(&trace_lock);
+    trace_head     = 0;
+    spin_unlock_irqrestore(&trace_lock, flags);
+}
@@ -1,5 +1,86 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 #include <stdint.h>
-uint64_t syscall_handler(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3);
+#include "syscall/linux_sysno.h"
+#include "syscall/sysno.h"
+/* Arguments arrive in rdi, rsi, rdx, r10, r8 and r9 on both entry paths */
+#define SYSCALL_MAX_ARGS 6
+
+/* A dispatch table entry; fn gets the raw argument registers and returns
+   the value for rax, a negative value counting as an error */
+typedef uint64_t (*syscall_fn)(const uint64_t* args);
+
+struct syscall_desc {
+    const char* name;
+    int nargs; /* argument registers the call reads (for tracing) */
+    syscall_fn fn;
+};
+
+/* Statistics and traces number the calls of both personalities in one
+   space: native calls keep their number, Linux call n is slot
+   SYSCALL_LINUX_BASE + n */
+#define SYSCALL_LINUX_BASE NR_SYSCALLS
+#define NR_SYSCALL_SLOTS   (NR_SYSCALLS + NR_LINUX_SYSCALLS)
+/* User registers as both entry paths save them at the top of the task's
+   kernel stack: general registers under an iret frame. They are what the
+   task resumes with, so a handler may rewrite them. */
+struct syscall_frame {
+    uint64_t rax, rbx, rcx, rdx, rdi, rsi, r8, r9, r10, r11, r12, r13, r14, r15, rbp;
+    uint64_t rip, cs, rflags, rsp, ss;
+};
+
+/* Frame of the system call the current task is in (from user mode) */
+struct syscall_frame* syscall_user_frame(void);
+
+uint64_t syscall_handler(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4,
+                         uint64_t a5, uint64_t a6);
+/* Enable the SYSCALL/SYSRET fast path; int 0x80 keeps working either way */
+void syscall_init(void);
+int syscall_fast_enabled(void);
+
+/* Latency histogram: bucket b counts calls of [2^(b+SHIFT), 2^(b+SHIFT+1))
+   TSC cycles; the first and last buckets also take everything below and
+   above */
+#define SYSCALL_HIST_BUCKETS 16
+#define SYSCALL_HIST_SHIFT   6
+
+struct syscall_stat {
+    int nr;
+    const char* name;
+    int nargs;
+    uint64_t calls;
+    uint64_t errors;     /* calls that returned a negative value */
+    uint64_t cycles;     /* total TSC cycles spent in the handler */
+    uint64_t max_cycles;
+    uint64_t hist[SYSCALL_HIST_BUCKETS];
+};
+
+/* Fill out with one entry per implemented syscall slot; returns the count */
+int syscall_get_stats(struct syscall_stat* out, int max);
+const char* syscall_name(int nr); /* by slot; NULL if not implemented */
+int syscall_nargs(int nr);
+uint64_t syscall_unknown_calls(void);
+/* Calls of syscall slot nr made by task slot tid since it was created */
+uint64_t syscall_task_calls(int tid, int nr);
+void syscall_task_reset(int tid);
+void syscall_reset_stats(void);
+
+/* strace-style tracing into a ring that keeps the newest entries; cheap
+   enough to leave on, unlike logging every call to serial */
+#define SYSCALL_TRACE_ENTRIES 128
+
+struct syscall_trace_entry {
+    uint64_t tsc;    /* entry time */
+    uint64_t cycles; /* 0 for unknown syscalls */
+    int tid;
+    int nr;          /* slot; unknown Linux calls are recorded past the table too */
+    uint64_t args[SYSCALL_MAX_ARGS];
+    int64_t ret;
+};
+
+void syscall_trace_enable(int on);
+int syscall_trace_enabled(void);
+/* Copy up to max of the newest entries, oldest first; returns the count */
+int syscall_trace_read(struct syscall_trace_entry* out, int max);
+void syscall_trace_clear(void);
 #endif
@@ -0,0 +1,54 @@
+#ifndef SYSCALL_SYSNO_H
+#define SYSCALL_SYSNO_H
+
+// System call numbers, shared by the kernel, the vDSO and user code.
+// rax = number, rdi/rsi/rdx/r10/r8/r9 = arguments, result in rax (int 0x80
+// or SYSCALL).
+
+#define SYS_EXIT            0
+#define SYS_WRITE           1        // fd, buf, count
+#define SYS_READ            2        // fd, buf, count
+#define SYS_PUTS            3        // simple kernel puts (debug)
+#define SYS_GETPID          4
+#define SYS_YIELD           5
+#define SYS_SLEEP           6        // arg: nanoseconds
+#define SYS_CLOCK_GETTIME   7        // clockid, struct timespec*
+#define SYS_MMAP            10       // addr hint, len, prot (VMA_*): anonymous zero-fill
+#define SYS_MUNMAP          11       // addr, len
+#define SYS_BRK             12       // new break (0 asks); returns the break now in effect
+#define SYS_EXIT_GROUP      13       // status: ends every thread of the process
+#define SYS_SET_TLS         14       // FS base of the calling thread
+#define SYS_OPEN            20       // path, O_* flags (fs/file.h)
+#define SYS_CLOSE           21       // fd
+#define SYS_READDIR         22       // fd, struct file_dirent*; 1, or 0 at the end
+#define SYS_URING_SETUP     23       // entries, struct uring_params*
+#define SYS_URING_ENTER     24       // ring, to_submit, min_complete, flags
+#define SYS_URING_CLOSE     25       // ring
+#define SYS_PIPE            26       // int fds[2]: read end, write end
+#define SYS_SPLICE          27       // fd_in, off_in*, fd_out, off_out*, len
+#define SYS_TEE             28       // fd_in, fd_out, len
+#define SYS_SENDFILE        29       // fd_out, fd_in, off*, count
+#define SYS_FUTEX           30       // uaddr, op, val, timeout*, uaddr2, val3 (multitasking/futex.h)
+#define SYS_CLONE           31       // flags, stack, ptid*, ctid*, tls (sys/thread.h)
+#define SYS_SPAWN           32       // path, argv, envp, actions*, nactions, attr* (sys/proc.h)
+#define SYS_EXEC            33       // path, argv, envp
+#define SYS_EPOLL_CREATE    34       // flags (fs/eventpoll.h)
+#define SYS_EPOLL_CTL       35       // epfd, op, fd, struct epoll_event*
+#define SYS_EPOLL_WAIT      36       // epfd, events*, maxevents, timeout in ns (< 0: none)
+#define SYS_EVENTFD         37       // initial count, flags (fs/eventfd.h)
+#define SYS_TIMERFD_CREATE  38       // clockid, flags (fs/timerfd.h)
+#define SYS_TIMERFD_SETTIME 39       // fd, flags, new itimerspec*, old itimerspec*
+#define SYS_TIMERFD_GETTIME 40       // fd, itimerspec*
+
+#define NR_SYSCALLS         41       // size of the kernel dispatch table
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+// Which numbering a task's system calls use: native tasks and programs
+// built on the ByteOS runtime (an ELF_NOTE_BYTEOS note) the one above,
+// other ELF programs loaded from disk the Linux x86-64 one (linux_sysno.h)
+#define PERSONALITY_BYTEOS 0
+#define PERSONALITY_LINUX  1
+
+#endif
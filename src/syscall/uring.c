@@ -0,0 +1,500 @@
+#include "syscall/uring.h"
+#include "fs/fdtable.h"
+#include "fs/file.h"
+#include "lib/errno.h"
+#include "mem/alloc.h"
+#include "mem/mm.h"
+#include "mem/paging.h"
+#include "mem/uaccess.h"
+#include "multitasking/preempt.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/spinlock.h"
+#include "multitasking/waitqueue.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include "time/timer.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define URING_MAX_RINGS     8
+#define URING_MAX_TIMEOUTS  16
+#define URING_PAGE_SIZE     4096
+#define URING_IDLE_DEFAULT  (10 * NSEC_PER_MSEC)
+#define URING_PATH_MAX      128 /* OPENAT paths, NUL included */
+
+struct uring;
+
+/* A pending URING_OP_TIMEOUT; the only op that completes asynchronously,
+   everything else finishes inside the submit loop */
+struct uring_timeout
+{
+  struct uring* ring;
+  struct timer  timer;
+  uint64_t      user_data;
+  uint64_t      target; /* r->completions value that ends it early; 0 = none */
+  int           used;
+};
+
+struct uring
+{
+  int                   used;
+  int                   closing;
+  int                   submitting; /* one submitter at a time */
+  struct uring_shared*  shared;
+  struct uring_sqe*     sqes;
+  struct uring_cqe*     cqes;
+  uint32_t              sq_entries;
+  uint32_t              cq_entries;
+  uint32_t              inflight; /* consumed SQEs still owed a CQE */
+  uint64_t              completions;
+  spinlock_t            cq_lock; /* CQ producers: submitter and timer softirq */
+  struct waitqueue      cq_wait;
+  struct waitqueue      sq_wait; /* SQPOLL thread sleeps here */
+  int                   sqpoll;
+  uint64_t              idle_ns;
+  struct completion     poll_exit;
+  struct fdtable*       files; /* the owner's descriptors, shared with the poll thread */
+  struct uring_timeout  timeouts[URING_MAX_TIMEOUTS];
+};
+
+static struct uring rings[URING_MAX_RINGS];
+static spinlock_t   rings_lock = SPINLOCK_INIT;
+static uint64_t     stat_enters, stat_submitted, stat_completed, stat_poll_wakeups;
+
+static struct uring* ring_get(int id)
+{
+  if (id < 0 || id >= URING_MAX_RINGS)
+    return NULL;
+  struct uring* r = &rings[id];
+  if (__atomic_load_n(&r->used, __ATOMIC_ACQUIRE) != 1 || r->closing)
+    return NULL;
+  return r;
+}
+
+static uint32_t cq_pending(struct uring* r)
+{
+  return r->shared->cq.tail - __atomic_load_n(&r->shared->cq.head, __ATOMIC_ACQUIRE);
+}
+
+/* Caller holds cq_lock */
+static void cq_post_locked(struct uring* r, uint64_t user_data, int32_t res)
+{
+  struct uring_ring_hdr* cq = &r->shared->cq;
+  uint32_t               tail = cq->tail;
+  --r->inflight;
+  ++r->completions;
+  __atomic_fetch_add(&stat_completed, 1, __ATOMIC_RELAXED);
+  if (tail - __atomic_load_n(&cq->head, __ATOMIC_ACQUIRE) >= r->cq_entries)
+  {
+    /* only if user code moved cq.head backwards: submission never lets
+       completions outrun the ring */
+    cq->dropped++;
+    return;
+  }
+  struct uring_cqe* cqe = &r->cqes[tail & (r->cq_entries - 1)];
+  cqe->user_data        = user_data;
+  cqe->res              = res;
+  cqe->flags            = 0;
+  __atomic_store_n(&cq->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void cq_post(struct uring* r, uint64_t user_data, int32_t res)
+{
+  uint64_t flags = spin_lock_irqsave(&r->cq_lock);
+  cq_post_locked(r, user_data, res);
+  /* counted timeouts end once enough other completions are in */
+  for (int i = 0; i < URING_MAX_TIMEOUTS; ++i)
+  {
+    struct uring_timeout* t = &r->timeouts[i];
+    if (t->used && t->target && r->completions >= t->target && timer_cancel(&t->timer))
+    {
+      t->used = 0;
+      cq_post_locked(r, t->user_data, 0);
+    }
+  }
+  spin_unlock_irqrestore(&r->cq_lock, flags);
+  waitqueue_wake_all(&r->cq_wait);
+}
+
+static void timeout_fire(void* arg)
+{
+  struct uring_timeout* t = arg;
+  struct uring*         r = t->ring;
+  spin_lock(&r->cq_lock);
+  t->used = 0;
+  cq_post_locked(r, t->user_data, -ETIME);
+  spin_unlock(&r->cq_lock);
+  waitqueue_wake_all(&r->cq_wait);
+}
+
+static int issue_timeout(struct uring* r, const struct uring_sqe* sqe)
+{
+  struct uring_timespec ts;
+  if (!sqe->addr || copy_from_user(&ts, (const void*) (uintptr_t) sqe->addr, sizeof(ts)))
+    return -EFAULT;
+  if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= (int64_t) NSEC_PER_SEC)
+    return -EINVAL;
+  uint64_t ns = (uint64_t) ts.tv_sec * NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+
+  uint64_t flags = spin_lock_irqsave(&r->cq_lock);
+  for (int i = 0; i < URING_MAX_TIMEOUTS; ++i)
+  {
+    struct uring_timeout* t = &r->timeouts[i];
+    if (t->used)
+      continue;
+    t->used      = 1;
+    t->user_data = sqe->user_data;
+    t->target    = sqe->off ? r->completions + sqe->off : 0;
+    timer_arm(&t->timer, clock_now_ns() + ns);
+    spin_unlock_irqrestore(&r->cq_lock, flags);
+    return 0;
+  }
+  spin_unlock_irqrestore(&r->cq_lock, flags);
+  return -EBUSY;
+}
+
+/* Run one SQE. Returns 1 with *res set if it completed, 0 if it went
+   asynchronous and will post its own CQE. */
+static int issue(struct uring* r, const struct uring_sqe* sqe, int32_t* res)
+{
+  struct file* f;
+  uint64_t     off = sqe->off;
+  char         path[URING_PATH_MAX];
+  long         len;
+  switch (sqe->opcode)
+  {
+    case URING_OP_NOP:
+      *res = 0;
+      return 1;
+    case URING_OP_READ:
+    case URING_OP_WRITE:
+      if (!(f = fd_get(r->files, sqe->fd)))
+        *res = -EBADF;
+      else
+      {
+        /* the file layer copies with the unchecked __copy_user */
+        if ((!sqe->addr && sqe->len) || !access_ok((const void*) (uintptr_t) sqe->addr, sqe->len))
+          *res = -EFAULT;
+        else if (sqe->opcode == URING_OP_READ)
+          *res = (int32_t) file_read(
+              f, (void*) (uintptr_t) sqe->addr, sqe->len, off == (uint64_t) -1 ? NULL : &off);
+        else
+          *res = (int32_t) file_write(f,
+                                      (const void*) (uintptr_t) sqe->addr,
+                                      sqe->len,
+                                      off == (uint64_t) -1 ? NULL : &off);
+        file_put(f);
+      }
+      return 1;
+    case URING_OP_OPENAT:
+      /* no working directories yet: dirfd is ignored and paths are absolute */
+      if (!sqe->addr)
+      {
+        *res = -EFAULT;
+        return 1;
+      }
+      len = strncpy_from_user(path, (const char*) (uintptr_t) sqe->addr, sizeof(path));
+      if (len < 0 || len == (long) sizeof(path))
+      {
+        *res = len < 0 ? (int32_t) len : -ENAMETOOLONG;
+        return 1;
+      }
+      *res = file_open(path, (int) sqe->op_flags, &f);
+      if (*res == 0 && (*res = fd_install(r->files, f, 0, 0)) < 0)
+        file_put(f);
+      return 1;
+    case URING_OP_CLOSE:
+      *res = fd_close(r->files, sqe->fd);
+      return 1;
+    case URING_OP_TIMEOUT:
+      *res = issue_timeout(r, sqe);
+      return *res != 0;
+    default:
+      *res = -EINVAL;
+      return 1;
+  }
+}
+
+/* Consume up to max SQEs; returns how many */
+static uint32_t submit(struct uring* r, uint32_t max)
+{
+  struct uring_ring_hdr* sq    = &r->shared->sq;
+  uint32_t               head  = sq->head;
+  uint32_t               avail = __atomic_load_n(&sq->tail, __ATOMIC_ACQUIRE) - head;
+  if (avail > r->sq_entries)
+    avail = r->sq_entries; /* garbage tail: do not read past the ring */
+  if (max > avail)
+    max = avail;
+
+  uint32_t n = 0;
+  for (; n < max; ++n)
+  {
+    /* leave room in the CQ for everything already consumed */
+    uint64_t flags = spin_lock_irqsave(&r->cq_lock);
+    int      full  = cq_pending(r) + r->inflight >= r->cq_entries;
+    if (!full)
+      ++r->inflight;
+    spin_unlock_irqrestore(&r->cq_lock, flags);
+    if (full)
+      break;
+
+    /* copy first: user code may reuse the slot once head moves */
+    struct uring_sqe sqe = r->sqes[head & (r->sq_entries - 1)];
+    __atomic_store_n(&sq->head, ++head, __ATOMIC_RELEASE);
+
+    int32_t res;
+    if (issue(r, &sqe, &res))
+      cq_post(r, sqe.user_data, res);
+  }
+  __atomic_fetch_add(&stat_submitted, n, __ATOMIC_RELAXED);
+  return n;
+}
+
+static int sq_ready(void* arg)
+{
+  struct uring* r = arg;
+  return r->closing ||
+         __atomic_load_n(&r->shared->sq.tail, __ATOMIC_ACQUIRE) != r->shared->sq.head;
+}
+
+static void sqpoll_thread(void* arg)
+{
+  struct uring* r         = arg;
+  uint64_t      idle_from = clock_now_ns();
+  while (!r->closing)
+  {
+    if (submit(r, r->sq_entries))
+    {
+      idle_from = clock_now_ns();
+      continue;
+    }
+    if (clock_now_ns() - idle_from < r->idle_ns)
+    {
+      scheduler_yield();
+      continue;
+    }
+    /* advertise first, then re-check the tail in sq_ready, so a
+       submission racing with us either sees the flag or is seen */
+    __atomic_or_fetch(&r->shared->sq.flags, URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+    waitqueue_wait(&r->sq_wait, sq_ready, r);
+    __atomic_and_fetch(&r->shared->sq.flags, ~URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&stat_poll_wakeups, 1, __ATOMIC_RELAXED);
+    idle_from = clock_now_ns();
+  }
+  completion_complete(&r->poll_exit);
+}
+
+static uint32_t round_pow2(uint32_t n)
+{
+  uint32_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+int uring_setup(uint32_t entries, struct uring_params* up)
+{
+  struct uring_params  params;
+  struct uring_params* p = &params;
+  if (!up || copy_from_user(p, up, sizeof(*p)))
+    return -EFAULT;
+  if (entries == 0 || entries > URING_MAX_ENTRIES)
+    return -EINVAL;
+
+  spin_lock(&rings_lock);
+  int id = 0;
+  while (id < URING_MAX_RINGS && rings[id].used)
+    ++id;
+  if (id == URING_MAX_RINGS)
+  {
+    spin_unlock(&rings_lock);
+    return -EMFILE;
+  }
+  rings[id].used = -1; /* reserved; ring_get still refuses it */
+  spin_unlock(&rings_lock);
+
+  struct uring* r  = &rings[id];
+  uint32_t      sq = round_pow2(entries);
+  uint32_t      cq = sq * 2;
+
+  /* The shared region gets whole pages of its own: paging_set_user works
+     at page granularity and must not expose neighbouring kernel data */
+  size_t sqes_off = (sizeof(struct uring_shared) + 63) & ~(size_t) 63;
+  size_t cqes_off = sqes_off + sq * sizeof(struct uring_sqe);
+  size_t size     = cqes_off + cq * sizeof(struct uring_cqe);
+  size            = (size + URING_PAGE_SIZE - 1) & ~(size_t) (URING_PAGE_SIZE - 1);
+  uint8_t* raw    = kmalloc(size + URING_PAGE_SIZE);
+  if (!raw)
+  {
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+    return -ENOMEM;
+  }
+  uint8_t* base = (uint8_t*) (((uintptr_t) raw + URING_PAGE_SIZE - 1) &
+                             ~(uintptr_t) (URING_PAGE_SIZE - 1));
+  memset(base, 0, size);
+  if (paging_set_user(base, size) != 0)
+  {
+    kfree(raw);
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+    return -ENOMEM;
+  }
+
+  r->closing     = 0;
+  r->submitting  = 0;
+  r->shared      = (struct uring_shared*) base;
+  r->sqes        = (struct uring_sqe*) (base + sqes_off);
+  r->cqes        = (struct uring_cqe*) (base + cqes_off);
+  r->sq_entries  = sq;
+  r->cq_entries  = cq;
+  r->inflight    = 0;
+  r->completions = 0;
+  r->sqpoll      = !!(p->flags & URING_SETUP_SQPOLL);
+  r->idle_ns = p->sq_thread_idle_ms ? p->sq_thread_idle_ms * NSEC_PER_MSEC : URING_IDLE_DEFAULT;
+  spin_lock_init(&r->cq_lock);
+  waitqueue_init(&r->cq_wait);
+  waitqueue_init(&r->sq_wait);
+  completion_init(&r->poll_exit);
+  /* ops act on the caller's descriptors; a caller without any gets a
+     table of its own with the console on 0-2 */
+  r->files = scheduler_get_files();
+  if (r->files)
+    fdtable_get(r->files);
+  else if (!(r->files = fdtable_create()))
+  {
+    kfree(raw);
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+    return -ENOMEM;
+  }
+  for (int i = 0; i < URING_MAX_TIMEOUTS; ++i)
+  {
+    r->timeouts[i].ring = r;
+    r->timeouts[i].used = 0;
+    timer_setup(&r->timeouts[i].timer, timeout_fire, &r->timeouts[i]);
+  }
+
+  r->shared->sq.mask    = sq - 1;
+  r->shared->sq.entries = sq;
+  r->shared->cq.mask    = cq - 1;
+  r->shared->cq.entries = cq;
+  r->shared->sqes_off   = (uint32_t) sqes_off;
+  r->shared->cqes_off   = (uint32_t) cqes_off;
+
+  __atomic_store_n(&r->used, 1, __ATOMIC_RELEASE);
+  /* the poll thread dereferences user pointers, so it runs on the
+     caller's address space rather than borrowing whichever is loaded */
+  int tid = -1;
+  if (r->sqpoll)
+  {
+    struct mm* mm = mm_loaded();
+    preempt_disable();
+    tid = task_create(sqpoll_thread, r);
+    if (tid >= 0 && mm != &init_mm)
+      scheduler_set_mm(tid, mm);
+    if (tid >= 0)
+      scheduler_set_user(tid, scheduler_is_user());
+    preempt_enable();
+  }
+  if (r->sqpoll && tid < 0)
+  {
+    r->sqpoll = 0;
+    uring_close(id);
+    return -ENOMEM;
+  }
+
+  p->sq_entries = sq;
+  p->cq_entries = cq;
+  p->ring_addr  = (uint64_t) (uintptr_t) base;
+  if (copy_to_user(up, p, sizeof(*p)))
+  {
+    uring_close(id);
+    return -EFAULT;
+  }
+  return id;
+}
+
+struct cq_wait_arg
+{
+  struct uring* r;
+  uint32_t      min;
+};
+
+static int cq_ready(void* arg)
+{
+  struct cq_wait_arg* w = arg;
+  /* without a poll thread nothing more can arrive once inflight hits 0 */
+  return w->r->closing || cq_pending(w->r) >= w->min || (!w->r->sqpoll && w->r->inflight == 0);
+}
+
+int uring_enter(int ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+  struct uring* r = ring_get(ring);
+  if (!r)
+    return -EBADF;
+  __atomic_fetch_add(&stat_enters, 1, __ATOMIC_RELAXED);
+
+  int submitted;
+  if (r->sqpoll)
+  {
+    if (flags & URING_ENTER_SQ_WAKEUP)
+      waitqueue_wake_all(&r->sq_wait);
+    submitted = (int) to_submit;
+  }
+  else
+  {
+    if (__atomic_exchange_n(&r->submitting, 1, __ATOMIC_ACQUIRE))
+      return -EBUSY;
+    submitted = (int) submit(r, to_submit);
+    __atomic_store_n(&r->submitting, 0, __ATOMIC_RELEASE);
+  }
+
+  if ((flags & URING_ENTER_GETEVENTS) && min_complete)
+  {
+    struct cq_wait_arg w = {r, min_complete < r->cq_entries ? min_complete : r->cq_entries};
+    waitqueue_wait(&r->cq_wait, cq_ready, &w);
+  }
+  return submitted;
+}
+
+int uring_close(int ring)
+{
+  struct uring* r = ring_get(ring);
+  if (!r)
+    return -EBADF;
+  if (__atomic_exchange_n(&r->submitting, 1, __ATOMIC_ACQUIRE))
+    return -EBUSY;
+  r->closing = 1;
+  if (r->sqpoll)
+  {
+    waitqueue_wake_all(&r->sq_wait);
+    completion_wait(&r->poll_exit);
+  }
+  waitqueue_wake_all(&r->cq_wait);
+
+  uint64_t flags = spin_lock_irqsave(&r->cq_lock);
+  for (int i = 0; i < URING_MAX_TIMEOUTS; ++i)
+  {
+    timer_cancel(&r->timeouts[i].timer);
+    r->timeouts[i].used = 0;
+  }
+  spin_unlock_irqrestore(&r->cq_lock, flags);
+
+  fdtable_put(r->files);
+  r->files = NULL;
+  /* the shared pages stay mapped: with the bump allocator they are never
+     handed out again */
+  __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void uring_get_stats(struct uring_stats* out)
+{
+  out->rings = 0;
+  for (int i = 0; i < URING_MAX_RINGS; ++i)
+    if (ring_get(i))
+      ++out->rings;
+  out->enters       = __atomic_load_n(&stat_enters, __ATOMIC_RELAXED);
+  out->submitted    = __atomic_load_n(&stat_submitted, __ATOMIC_RELAXED);
+  out->completed    = __atomic_load_n(&stat_completed, __ATOMIC_RELAXED);
+  out->poll_wakeups = __atomic_load_n(&stat_poll_wakeups, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,118 @@
+#ifndef SYSCALL_URING_H
+#define SYSCALL_URING_H
+
+#include <stdint.h>
+
+/* Submission/completion rings: batched, asynchronous system calls.
+
+   uring_setup maps a region shared with user space holding two
+   single-producer/single-consumer rings. User code fills submission queue
+   entries (SQEs), publishes them by advancing sq.tail and makes one
+   uring_enter call to submit the whole batch; results come back as
+   completion queue entries (CQEs) that it reaps by advancing cq.head. With
+   URING_SETUP_SQPOLL a kernel thread polls the SQ, so a busy program
+   submits without any trap at all.
+
+   Ordering: the producer writes entries before a release store of the
+   tail; the consumer reads the tail with acquire and entries after it.
+   This header is the ABI and is shared with user code. */
+
+#define URING_MAX_ENTRIES 256
+
+/* opcodes */
+#define URING_OP_NOP     0
+/* fds are the submitting process's descriptors (SYS_OPEN and friends) */
+#define URING_OP_READ    1 /* fd, addr = buf, len, off (-1: file position) */
+#define URING_OP_WRITE   2 /* fd, addr = buf, len, off (-1: file position) */
+#define URING_OP_OPENAT  3 /* fd = dirfd (ignored), addr = path, op_flags = O_* */
+#define URING_OP_CLOSE   4 /* fd */
+#define URING_OP_TIMEOUT 5 /* addr = struct uring_timespec*, off = completion count;
+                              res -ETIME on expiry, 0 once off other CQEs were posted */
+
+struct uring_sqe
+{
+  uint8_t  opcode;
+  uint8_t  flags;
+  uint16_t pad;
+  int32_t  fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t op_flags;
+  uint64_t user_data; /* copied to the CQE untouched */
+};
+
+struct uring_cqe
+{
+  uint64_t user_data;
+  int32_t  res; /* result or -errno */
+  uint32_t flags;
+};
+
+struct uring_timespec
+{
+  int64_t tv_sec;
+  int64_t tv_nsec;
+};
+
+/* sq.flags, set by the kernel. The poll thread sets NEED_WAKEUP and then
+   re-reads sq.tail before it sleeps, so user code must order its tail
+   store before the flags load (a full fence, e.g. __ATOMIC_SEQ_CST). */
+#define URING_SQ_NEED_WAKEUP (1U << 0) /* poll thread asleep: enter with SQ_WAKEUP */
+
+struct uring_ring_hdr
+{
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  uint32_t          mask; /* entries - 1 */
+  uint32_t          entries;
+  volatile uint32_t flags;
+  volatile uint32_t dropped; /* CQ: completions lost to a full ring */
+};
+
+/* Start of the shared region; the entry arrays follow at the given byte
+   offsets from it */
+struct uring_shared
+{
+  struct uring_ring_hdr sq;
+  struct uring_ring_hdr cq;
+  uint32_t              sqes_off;
+  uint32_t              cqes_off;
+};
+
+/* uring_setup flags */
+#define URING_SETUP_SQPOLL (1U << 0)
+
+struct uring_params
+{
+  uint32_t flags;
+  uint32_t sq_thread_idle_ms; /* SQPOLL: spin this long before sleeping */
+  /* out */
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint64_t ring_addr; /* struct uring_shared* */
+};
+
+/* uring_enter flags */
+#define URING_ENTER_GETEVENTS (1U << 0) /* wait for min_complete CQEs */
+#define URING_ENTER_SQ_WAKEUP (1U << 1) /* wake a sleeping poll thread */
+
+/* Kernel side, reached through SYS_URING_SETUP/ENTER/CLOSE. Results are
+   >= 0 on success or -errno. */
+int uring_setup(uint32_t entries, struct uring_params* p);
+/* Returns the number of SQEs consumed */
+int uring_enter(int ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+int uring_close(int ring);
+
+struct uring_stats
+{
+  int      rings;
+  uint64_t enters;
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t poll_wakeups; /* SQPOLL threads woken from sleep */
+};
+
+void uring_get_stats(struct uring_stats* out);
+
+#endif
@@ -0,0 +1,124 @@
+#include "time/clock.h"
+#include "boot/cpu.h"
+#include "serial/serial.h"
+#include <stdint.h>
+
+static inline void outb(uint16_t port, uint8_t val)
+{
+  asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+static inline uint8_t inb(uint16_t port)
+{
+  uint8_t v;
+  asm volatile("inb %1, %0" : "=a"(v) : "Nd"(port));
+  return v;
+}
+
+#define PIT_HZ          1193182ULL
+#define PIT_CALIB_MS    10
+#define TSC_FALLBACK_HZ 2000000000ULL /* used only if calibration fails */
+
+static uint64_t tsc_hz = 0;
+/* ns = (tsc * tsc_mult) >> 32, precomputed so the hot path never divides */
+static uint64_t tsc_mult = 0;
+
+/* (a * b) / c with a 128-bit intermediate; the quotient must fit in 64 bits.
+   Done with mul/div directly since we do not link libgcc's __udivti3. */
+static inline uint64_t mul_div_u64(uint64_t a, uint64_t b, uint64_t c)
+{
+  uint64_t q, r;
+  asm("mulq %3\n\tdivq %4" : "=a"(q), "=&d"(r) : "a"(a), "rm"(b), "rm"(c) : "cc");
+  return q;
+}
+
+/* Count TSC ticks across a PIT channel 2 one-shot of PIT_CALIB_MS. Channel 2
+   is gated through port 0x61 and its OUT pin is readable there, so this
+   works without any interrupt routing. */
+static uint64_t calibrate_tsc_pit(void)
+{
+  uint16_t count = (uint16_t) (PIT_HZ * PIT_CALIB_MS / 1000);
+
+  uint8_t gate = inb(0x61);
+  outb(0x61, (gate & ~0x02) | 0x01); /* speaker off, gate on */
+  outb(0x43, 0xB0);                  /* ch2, lo/hi byte, mode 0 */
+  outb(0x42, count & 0xFF);
+  outb(0x42, count >> 8);
+
+  /* restart the count by toggling the gate */
+  gate = inb(0x61) & ~0x01;
+  outb(0x61, gate);
+  outb(0x61, gate | 0x01);
+
+  uint64_t start = rdtsc();
+  uint64_t spins = 0;
+  while (!(inb(0x61) & 0x20))
+  {
+    if (++spins > 100000000ULL)
+      return 0;
+  }
+  uint64_t end = rdtsc();
+  return (end - start) * (1000 / PIT_CALIB_MS);
+}
+
+int clock_init(void)
+{
+  serial_puts("clock: calibrating TSC\n");
+
+  /* Prefer the architectural frequency from CPUID 0x15 when it is reported */
+  uint32_t a, b, c, d;
+  cpuid(0, 0, &a, &b, &c, &d);
+  if (a >= 0x15)
+  {
+    cpuid(0x15, 0, &a, &b, &c, &d);
+    if (a && b && c)
+      tsc_hz = (uint64_t) c * b / a;
+  }
+  if (!tsc_hz)
+    tsc_hz = calibrate_tsc_pit();
+  if (!tsc_hz)
+  {
+    serial_puts("clock: calibration failed, assuming 2 GHz\n");
+    tsc_hz = TSC_FALLBACK_HZ;
+  }
+
+  tsc_mult = mul_div_u64(NSEC_PER_SEC, 1ULL << 32, tsc_hz);
+
+  serial_puts("clock: TSC Hz = ");
+  serial_putdec(tsc_hz);
+  return 0;
+}
+
+uint64_t clock_tsc_hz(void)
+{
+  return tsc_hz;
+}
+
+uint64_t clock_tsc_mult(void)
+{
+  return tsc_mult;
+}
+
+uint64_t clock_tsc_to_ns(uint64_t tsc)
+{
+  return (uint64_t) (((unsigned __int128) tsc * tsc_mult) >> 32);
+}
+
+uint64_t clock_ns_to_tsc(uint64_t ns)
+{
+  /* saturate instead of letting divq raise #DE on overflow */
+  if (ns / NSEC_PER_SEC >= UINT64_MAX / tsc_hz)
+    return UINT64_MAX;
+  return mul_div_u64(ns, tsc_hz, NSEC_PER_SEC);
+}
+
+uint64_t clock_now_ns(void)
+{
+  return clock_tsc_to_ns(rdtsc());
+}
+
+void clock_spin_ns(uint64_t ns)
+{
+  uint64_t end = rdtsc() + clock_ns_to_tsc(ns);
+  while (rdtsc() < end)
+    cpu_relax();
+}
@@ -0,0 +1,26 @@
+#ifndef TIME_CLOCK_H
+#define TIME_CLOCK_H
+
+#include <stdint.h>
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC  1000000000ULL
+
+/* Calibrate the TSC against the PIT; must run before any timer is armed */
+int clock_init(void);
+
+/* Monotonic time since reset, derived from the TSC */
+uint64_t clock_now_ns(void);
+
+/* TSC <-> nanosecond conversion using the calibrated frequency */
+uint64_t clock_tsc_to_ns(uint64_t tsc);
+uint64_t clock_ns_to_tsc(uint64_t ns);
+uint64_t clock_tsc_hz(void);
+/* ns = (tsc * mult) >> 32; published to user space through the vvar page */
+uint64_t clock_tsc_mult(void);
+
+/* Busy-wait for short delays where arming a timer would cost more */
+void clock_spin_ns(uint64_t ns);
+
+#endif
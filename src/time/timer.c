@@ -0,0 +1,282 @@
+#include "time/timer.h"
+#include "boot/cpu.h"
+#include "boot/lapic.h"
+#include "multitasking/scheduler.h"
+#include "multitasking/softirq.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hashed hierarchical timer wheel (Varghese & Lauck).
+
+   Level L has 64 slots of 64^L ticks each, so 6 levels cover 2^36 us (~19 h)
+   and anything further is parked in the last level and re-queued when it
+   comes round. A timer sits in the lowest level whose span covers its
+   distance from wheel_clk; when the clock reaches the start of a higher-level
+   slot that slot is cascaded down. Per-level occupancy bitmaps let us jump
+   straight to the next non-empty slot instead of stepping tick by tick, which
+   is what makes one-shot (tickless) programming possible. */
+
+#define WHEEL_BITS      6
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    6
+#define WHEEL_MAX_DELTA (1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+/* below this a sleep just spins: arming would cost more than it saves */
+#define TIMER_SPIN_NS (2 * NSEC_PER_USEC)
+
+static struct timer* wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t      wheel_bitmap[WHEEL_LEVELS];
+static uint64_t      wheel_clk     = 0; /* next tick to be processed */
+static int           wheel_count   = 0;
+static uint64_t      programmed_at = UINT64_MAX; /* tick the hardware will fire at */
+
+static inline uint64_t ns_to_tick(uint64_t ns)
+{
+  return (ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+}
+
+static void wheel_enqueue(struct timer* t)
+{
+  uint64_t exp = t->expires < wheel_clk ? wheel_clk : t->expires;
+  if (exp - wheel_clk >= WHEEL_MAX_DELTA)
+    exp = wheel_clk + WHEEL_MAX_DELTA - 1;
+
+  uint64_t delta = exp - wheel_clk;
+  int      lvl   = 0;
+  while (lvl < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (lvl + 1))))
+    ++lvl;
+  int idx = (int) ((exp >> (WHEEL_BITS * lvl)) & WHEEL_MASK);
+
+  struct timer** head = &wheel[lvl][idx];
+  t->next             = *head;
+  if (*head)
+    (*head)->pprev = &t->next;
+  t->pprev = head;
+  *head    = t;
+  wheel_bitmap[lvl] |= 1ULL << idx;
+  ++wheel_count;
+}
+
+static void wheel_dequeue(struct timer* t)
+{
+  *t->pprev = t->next;
+  if (t->next)
+    t->next->pprev = t->pprev;
+  t->next  = NULL;
+  t->pprev = NULL;
+  --wheel_count;
+}
+
+static struct timer* wheel_detach(int lvl, int idx)
+{
+  struct timer* list = wheel[lvl][idx];
+  wheel[lvl][idx]    = NULL;
+  wheel_bitmap[lvl] &= ~(1ULL << idx);
+  for (struct timer* t = list; t; t = t->next)
+  {
+    t->pprev = NULL;
+    --wheel_count;
+  }
+  return list;
+}
+
+/* First tick >= wheel_clk at which some slot must be expired or cascaded */
+static uint64_t wheel_next_tick(void)
+{
+  uint64_t best = UINT64_MAX;
+  for (int lvl = 0; lvl < WHEEL_LEVELS; ++lvl)
+  {
+    uint64_t map = wheel_bitmap[lvl];
+    if (!map)
+      continue;
+    int      shift = WHEEL_BITS * lvl;
+    int      cur   = (int) ((wheel_clk >> shift) & WHEEL_MASK);
+    uint64_t rot   = cur ? (map >> cur) | (map << (WHEEL_SIZE - cur)) : map;
+    uint64_t base  = wheel_clk & ~((1ULL << shift) - 1);
+
+    /* The current slot is only due now if the clock sits exactly on its
+       start; otherwise it was already cascaded and holds next-round timers. */
+    uint64_t dist;
+    if (base == wheel_clk && (rot & 1))
+      dist = 0;
+    else if (rot & ~1ULL)
+      dist = (uint64_t) __builtin_ctzll(rot & ~1ULL);
+    else
+      dist = WHEEL_SIZE;
+
+    uint64_t when = base + (dist << shift);
+    if (when < best)
+      best = when;
+  }
+  return best;
+}
+
+static void wheel_advance(uint64_t now_tick)
+{
+  while (wheel_clk <= now_tick)
+  {
+    uint64_t next = wheel_next_tick();
+    if (next > now_tick)
+    {
+      wheel_clk = now_tick + 1;
+      break;
+    }
+    wheel_clk = next;
+
+    for (int lvl = 1; lvl < WHEEL_LEVELS; ++lvl)
+    {
+      if (wheel_clk & ((1ULL << (WHEEL_BITS * lvl)) - 1))
+        break;
+      int           idx  = (int) ((wheel_clk >> (WHEEL_BITS * lvl)) & WHEEL_MASK);
+      struct timer* list = wheel_detach(lvl, idx);
+      while (list)
+      {
+        struct timer* n = list->next;
+        wheel_enqueue(list);
+        list = n;
+      }
+    }
+
+    uint64_t      tick = wheel_clk;
+    struct timer* list = wheel_detach(0, (int) (tick & WHEEL_MASK));
+    /* advance first so callbacks re-arming for "now" land in a future slot */
+    wheel_clk = tick + 1;
+    while (list)
+    {
+      struct timer* n = list->next;
+      list->next      = NULL;
+      if (list->expires > tick)
+        wheel_enqueue(list); /* was parked beyond the wheel's span */
+      else if (list->fn)
+        list->fn(list->arg);
+      list = n;
+    }
+  }
+}
+
+static void timer_reprogram(int force)
+{
+  uint64_t next = wheel_next_tick();
+  if (!force && next == programmed_at)
+    return;
+  programmed_at = next;
+  lapic_timer_program(next == UINT64_MAX ? 0 : next * TIMER_TICK_NS);
+}
+
+void timer_init(void)
+{
+  serial_puts("timer: init wheel\n");
+  for (int l = 0; l < WHEEL_LEVELS; ++l)
+  {
+    wheel_bitmap[l] = 0;
+    for (int i = 0; i < WHEEL_SIZE; ++i)
+      wheel[l][i] = NULL;
+  }
+  wheel_count   = 0;
+  wheel_clk     = ns_to_tick(clock_now_ns());
+  programmed_at = UINT64_MAX;
+  softirq_register(SOFTIRQ_TIMER, timer_run_expired);
+}
+
+void timer_setup(struct timer* t, timer_fn fn, void* arg)
+{
+  t->next    = NULL;
+  t->pprev   = NULL;
+  t->expires = 0;
+  t->fn      = fn;
+  t->arg     = arg;
+}
+
+int timer_pending(const struct timer* t)
+{
+  return t->pprev != NULL;
+}
+
+void timer_arm(struct timer* t, uint64_t expires_ns)
+{
+  uint64_t flags = irq_save();
+  if (t->pprev)
+    wheel_dequeue(t);
+  /* an idle wheel may lag far behind; catch up so placement stays precise */
+  if (wheel_count == 0)
+  {
+    uint64_t now = ns_to_tick(clock_now_ns());
+    if (now > wheel_clk)
+      wheel_clk = now;
+  }
+  t->expires = ns_to_tick(expires_ns);
+  wheel_enqueue(t);
+  timer_reprogram(0);
+  irq_restore(flags);
+}
+
+int timer_cancel(struct timer* t)
+{
+  uint64_t flags   = irq_save();
+  int      pending = t->pprev != NULL;
+  if (pending)
+    wheel_dequeue(t);
+  irq_restore(flags);
+  return pending;
+}
+
+uint64_t timer_next_event_ns(void)
+{
+  uint64_t flags = irq_save();
+  uint64_t next  = wheel_next_tick();
+  irq_restore(flags);
+  return next == UINT64_MAX ? UINT64_MAX : next * TIMER_TICK_NS;
+}
+
+void timer_run_expired(void)
+{
+  uint64_t flags = irq_save();
+  wheel_advance(clock_now_ns() / TIMER_TICK_NS);
+  /* the hardware has fired (or we are polling): always set a fresh deadline */
+  timer_reprogram(1);
+  irq_restore(flags);
+}
+
+/* Hard-IRQ half: acknowledge and leave; the wheel runs as a bottom half */
+void timer_interrupt(void)
+{
+  lapic_eoi();
+  softirq_raise(SOFTIRQ_TIMER);
+}
+
+static void sleep_wake(void* arg)
+{
+  scheduler_wake((int) (intptr_t) arg);
+}
+
+static void sleep_cancel(void* arg)
+{
+  timer_cancel(arg);
+}
+
+void timer_sleep_ns(uint64_t ns)
+{
+  int self = scheduler_get_current();
+  if (ns < TIMER_SPIN_NS || self < 0)
+  {
+    clock_spin_ns(ns);
+    return;
+  }
+
+  struct timer t;
+  timer_setup(&t, sleep_wake, (void*) (intptr_t) self);
+  scheduler_set_wait_cancel(sleep_cancel, &t);
+
+  /* mark ourselves blocked before arming so an early expiry cannot be lost */
+  uint64_t flags = irq_save();
+  scheduler_prepare_wait();
+  timer_arm(&t, clock_now_ns() + ns);
+  irq_restore(flags);
+
+  scheduler_wait();
+  timer_cancel(&t);
+  scheduler_set_wait_cancel(NULL, NULL);
+}
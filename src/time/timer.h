@@ -0,0 +1,51 @@
+#ifndef TIME_TIMER_H
+#define TIME_TIMER_H
+
+#include <stdint.h>
+
+/* Kernel timers on a hashed hierarchical timer wheel.
+
+   Expiry times are absolute clock_now_ns() values, rounded up to the wheel
+   tick (TIMER_TICK_NS). Callbacks run from the timer softirq with
+   interrupts disabled, so they must be short and must not block; anything
+   heavier should queue a work item. */
+
+#define TIMER_TICK_NS 1000ULL /* wheel granularity: 1 us */
+
+typedef void (*timer_fn)(void*);
+
+struct timer
+{
+  struct timer*  next;
+  struct timer** pprev; /* NULL when not queued */
+  uint64_t       expires; /* absolute, in wheel ticks */
+  timer_fn       fn;
+  void*          arg;
+};
+
+void timer_init(void);
+
+void timer_setup(struct timer* t, timer_fn fn, void* arg);
+
+/* Queue (or re-queue) t to fire at absolute time expires_ns */
+void timer_arm(struct timer* t, uint64_t expires_ns);
+
+/* Remove t if pending; returns 1 if it was pending */
+int timer_cancel(struct timer* t);
+
+int timer_pending(const struct timer* t);
+
+/* Time the wheel next needs service (an expiry or a cascade), in ns;
+   UINT64_MAX when the wheel is empty */
+uint64_t timer_next_event_ns(void);
+
+/* Run all expired timers and reprogram the hardware for the next one */
+void timer_run_expired(void);
+
+/* LAPIC timer interrupt entry (called from the IRQ stub) */
+void timer_interrupt(void);
+
+/* Block the current task for at least ns nanoseconds */
+void timer_sleep_ns(uint64_t ns);
+
+#endif
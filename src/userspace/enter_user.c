@@ -1,6 +1,11 @@
+#include "boot/gdt.h"
+#include "fs/fdtable.h"
 #include "mem/alloc.h"
 #include "mem/paging.h"
+#include "multitasking/scheduler.h"
 #include "serial/serial.h"
+#include "syscall/syscall.h"
+#include "userspace/enter_user.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -11,6 +16,17 @@ extern void user_main(void);
 void enter_user_task(void* arg)
 {
   void (*entry)(void) = (void (*)(void)) arg;
+
+  /* descriptors 0-2 start out on the console */
+  struct fdtable* files = fdtable_create();
+  if (!files || scheduler_set_files(scheduler_get_current(), files) != 0)
+  {
+    serial_puts("enter_user: no descriptor table\n");
+    fdtable_put(files);
+    return;
+  }
+  fdtable_put(files);
+
   serial_puts("enter_user: preparing user stack\n");
 
   /* allocate a user stack */
@@ -32,18 +48,68 @@ void enter_user_task(void* arg)
   }
   uint64_t user_sp = (uint64_t) ustack + 16 * 1024 - 8;
 
+  enter_user_mode((uint64_t) entry, user_sp);
+}
+
+void enter_user_mode(uint64_t entry, uint64_t user_sp)
+{
+  scheduler_set_user(scheduler_get_current(), 1);
   /* prepare iret frame and iret to user code (ring3) */
   asm volatile("cli\n"
-               "pushq $0x23\n" /* user SS selector */
-               "pushq %0\n"    /* user RSP */
+               "pushq %2\n" /* user SS selector */
+               "pushq %0\n" /* user RSP */
                "pushfq\n"
-               "pushq $0x1b\n" /* user CS selector */
-               "pushq %1\n"    /* user RIP */
+               "orq $0x200, (%%rsp)\n" /* user mode always runs with IF set */
+               "pushq %3\n" /* user CS selector */
+               "pushq %1\n" /* user RIP */
+               "xorl %%eax, %%eax\n"
+               "xorl %%ebx, %%ebx\n"
+               "xorl %%ecx, %%ecx\n"
+               "xorl %%edx, %%edx\n"
+               "xorl %%esi, %%esi\n"
+               "xorl %%edi, %%edi\n"
+               "xorl %%ebp, %%ebp\n"
+               "xorl %%r8d, %%r8d\n"
+               "xorl %%r9d, %%r9d\n"
+               "xorl %%r10d, %%r10d\n"
+               "xorl %%r11d, %%r11d\n"
+               "xorl %%r12d, %%r12d\n"
+               "xorl %%r13d, %%r13d\n"
+               "xorl %%r14d, %%r14d\n"
+               "xorl %%r15d, %%r15d\n"
                "iretq\n"
                :
-               : "r"(user_sp), "r"(entry));
+               : "r"(user_sp), "r"(entry), "i"(GDT_USER_DS), "i"(GDT_USER_CS));
 
   /* should not return */
   for (;;)
     asm volatile("hlt");
 }
+
+void enter_user_frame(const struct syscall_frame* f)
+{
+  /* the frame is laid out in pop order, iret frame last */
+  asm volatile("cli\n"
+               "mov %0, %%rsp\n"
+               "popq %%rax\n"
+               "popq %%rbx\n"
+               "popq %%rcx\n"
+               "popq %%rdx\n"
+               "popq %%rdi\n"
+               "popq %%rsi\n"
+               "popq %%r8\n"
+               "popq %%r9\n"
+               "popq %%r10\n"
+               "popq %%r11\n"
+               "popq %%r12\n"
+               "popq %%r13\n"
+               "popq %%r14\n"
+               "popq %%r15\n"
+               "popq %%rbp\n"
+               "iretq\n"
+               :
+               : "r"(f)
+               : "memory");
+  for (;;)
+    asm volatile("hlt");
+}
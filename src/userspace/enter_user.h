@@ -0,0 +1,19 @@
+#ifndef USERSPACE_ENTER_USER_H
+#define USERSPACE_ENTER_USER_H
+
+#include <stdint.h>
+
+/* Kernel task body: give the task a 16 KiB user stack and drop to ring 3
+   at arg (a function in a user-accessible section) */
+void enter_user_task(void* arg);
+
+/* iret to ring 3 at entry with the given stack; general registers are
+   cleared so no kernel values leak to user space */
+__attribute__((noreturn)) void enter_user_mode(uint64_t entry, uint64_t user_sp);
+
+struct syscall_frame;
+/* iret to ring 3 with every register taken from f (syscall/syscall.h);
+   a new thread starts this way from a copy of its creator's frame */
+__attribute__((noreturn)) void enter_user_frame(const struct syscall_frame* f);
+
+#endif
@@ -0,0 +1,219 @@
+#include "userspace/sysbench.h"
+#include "lib/elf.h"
+#include "mem/paging.h"
+#include "multitasking/scheduler.h"
+#include "serial/serial.h"
+#include "syscall/syscall.h"
+#include "syscall/sysno.h"
+#include "syscall/uring.h"
+#include "userspace/enter_user.h"
+#include "vdso/vvar.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Everything the benchmark touches from ring 3 goes in the .user output
+   section, which sysbench_spawn() maps user-accessible. Helpers must be
+   inlined (or live in the section themselves) and strings must be
+   explicit arrays, or the compiler would leave them in kernel pages. */
+#define USER_TEXT   __attribute__((section(".user_text"), noinline))
+#define USER_RODATA __attribute__((section(".user_rodata")))
+#define USER_INLINE static inline __attribute__((always_inline))
+
+#define SYSBENCH_ITERATIONS 100000
+
+extern char _user_start[], _user_end[];
+
+USER_RODATA static const char label_int80[]   = "sysbench: int 0x80 ";
+USER_RODATA static const char label_syscall[] = "sysbench: syscall  ";
+USER_RODATA static const char label_vdso_pid[] = "sysbench: vdso getpid ";
+USER_RODATA static const char label_sys_time[] = "sysbench: syscall clock_gettime ";
+USER_RODATA static const char label_vdso_time[] = "sysbench: vdso clock_gettime ";
+USER_RODATA static const char label_uring[]   = "sysbench: uring nop batch ";
+USER_RODATA static const char label_unit[]    = " cycles/call\n";
+USER_RODATA static const char sym_getpid[]    = "__vdso_getpid";
+USER_RODATA static const char sym_gettime[]   = "__vdso_clock_gettime";
+
+typedef long (*vdso_getpid_fn)(void);
+typedef int (*vdso_gettime_fn)(int, uint64_t*);
+
+USER_INLINE uint64_t u_rdtsc(void)
+{
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+USER_INLINE uint64_t u_int80(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+  uint64_t ret;
+  asm volatile("int $0x80" : "=a"(ret) : "a"(num), "D"(a1), "S"(a2), "d"(a3) : "memory");
+  return ret;
+}
+
+USER_INLINE uint64_t u_syscall(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+  uint64_t ret;
+  asm volatile("syscall"
+               : "=a"(ret)
+               : "a"(num), "D"(a1), "S"(a2), "d"(a3)
+               : "rcx", "r11", "memory");
+  return ret;
+}
+
+USER_INLINE uint64_t u_syscall4(uint64_t num, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4)
+{
+  uint64_t          ret;
+  register uint64_t r10 asm("r10") = a4;
+  asm volatile("syscall"
+               : "=a"(ret)
+               : "a"(num), "D"(a1), "S"(a2), "d"(a3), "r"(r10)
+               : "rcx", "r11", "memory");
+  return ret;
+}
+
+USER_TEXT static void report(const char* label, size_t len, uint64_t cycles)
+{
+  char buf[24];
+  int  i = sizeof(buf);
+  do
+  {
+    buf[--i] = (char) ('0' + cycles % 10);
+    cycles /= 10;
+  } while (cycles && i > 0);
+  u_syscall(SYS_WRITE, 1, (uint64_t) label, len);
+  u_syscall(SYS_WRITE, 1, (uint64_t) &buf[i], sizeof(buf) - i);
+  u_syscall(SYS_WRITE, 1, (uint64_t) label_unit, sizeof(label_unit) - 1);
+}
+
+USER_INLINE int u_streq(const char* a, const char* b)
+{
+  while (*a && *a == *b)
+    ++a, ++b;
+  return *a == *b;
+}
+
+/* What a libc does with AT_SYSINFO_EHDR: walk the vDSO's dynamic symbol
+   table for name */
+USER_TEXT static void* vdso_sym(const char* name)
+{
+  const uint8_t*    base = (const uint8_t*) VDSO_TEXT_ADDR;
+  const Elf64_Ehdr* eh   = (const Elf64_Ehdr*) base;
+  const Elf64_Phdr* ph   = (const Elf64_Phdr*) (base + eh->e_phoff);
+  const Elf64_Dyn*  dyn  = NULL;
+  for (int i = 0; i < eh->e_phnum; ++i)
+    if (ph[i].p_type == PT_DYNAMIC)
+      dyn = (const Elf64_Dyn*) (base + ph[i].p_offset);
+  if (!dyn)
+    return NULL;
+
+  const Elf64_Sym* symtab = NULL;
+  const char*      strtab = NULL;
+  const uint32_t*  hash   = NULL;
+  for (; dyn->d_tag != DT_NULL; ++dyn)
+  {
+    if (dyn->d_tag == DT_SYMTAB)
+      symtab = (const Elf64_Sym*) (base + dyn->d_val);
+    else if (dyn->d_tag == DT_STRTAB)
+      strtab = (const char*) (base + dyn->d_val);
+    else if (dyn->d_tag == DT_HASH)
+      hash = (const uint32_t*) (base + dyn->d_val);
+  }
+  if (!symtab || !strtab || !hash)
+    return NULL;
+
+  /* nchain in the SysV hash table is the number of symbols */
+  for (uint32_t i = 0; i < hash[1]; ++i)
+  {
+    if (ELF64_ST_TYPE(symtab[i].st_info) == STT_FUNC && symtab[i].st_shndx != SHN_UNDEF &&
+        u_streq(strtab + symtab[i].st_name, name))
+      return (void*) (base + symtab[i].st_value);
+  }
+  return NULL;
+}
+
+/* Push SYSBENCH_ITERATIONS NOPs through a ring in batches of a full SQ,
+   one uring_enter per batch; returns cycles per operation, 0 on failure */
+USER_TEXT static uint64_t bench_uring(void)
+{
+  struct uring_params p = {0};
+  long                ring = (long) u_syscall(SYS_URING_SETUP, URING_MAX_ENTRIES, (uint64_t) &p, 0);
+  if (ring < 0)
+    return 0;
+  struct uring_shared* sh   = (struct uring_shared*) p.ring_addr;
+  struct uring_sqe*    sqes = (struct uring_sqe*) ((uint8_t*) sh + sh->sqes_off);
+
+  uint64_t t0 = u_rdtsc();
+  for (int done = 0; done < SYSBENCH_ITERATIONS; done += p.sq_entries)
+  {
+    uint32_t tail = sh->sq.tail;
+    for (uint32_t i = 0; i < p.sq_entries; ++i, ++tail)
+    {
+      struct uring_sqe* sqe = &sqes[tail & sh->sq.mask];
+      sqe->opcode           = URING_OP_NOP;
+      sqe->user_data        = i;
+    }
+    __atomic_store_n(&sh->sq.tail, tail, __ATOMIC_RELEASE);
+    u_syscall4(SYS_URING_ENTER, ring, p.sq_entries, p.sq_entries, URING_ENTER_GETEVENTS);
+    /* reap: NOPs carry no result worth reading */
+    __atomic_store_n(&sh->cq.head, __atomic_load_n(&sh->cq.tail, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+  }
+  uint64_t t1 = u_rdtsc();
+  u_syscall(SYS_URING_CLOSE, ring, 0, 0);
+  return (t1 - t0) / SYSBENCH_ITERATIONS;
+}
+
+USER_TEXT static void user_sysbench(void)
+{
+  /* warm both paths up first */
+  u_int80(SYS_GETPID, 0, 0, 0);
+  u_syscall(SYS_GETPID, 0, 0, 0);
+
+  uint64_t t0 = u_rdtsc();
+  for (int i = 0; i < SYSBENCH_ITERATIONS; ++i)
+    u_int80(SYS_GETPID, 0, 0, 0);
+  uint64_t t1 = u_rdtsc();
+  for (int i = 0; i < SYSBENCH_ITERATIONS; ++i)
+    u_syscall(SYS_GETPID, 0, 0, 0);
+  uint64_t t2 = u_rdtsc();
+
+  report(label_int80, sizeof(label_int80) - 1, (t1 - t0) / SYSBENCH_ITERATIONS);
+  report(label_syscall, sizeof(label_syscall) - 1, (t2 - t1) / SYSBENCH_ITERATIONS);
+
+  vdso_getpid_fn  vgetpid  = (vdso_getpid_fn) vdso_sym(sym_getpid);
+  vdso_gettime_fn vgettime = (vdso_gettime_fn) vdso_sym(sym_gettime);
+  if (vgetpid && vgettime)
+  {
+    uint64_t ts[2];
+    t0 = u_rdtsc();
+    for (int i = 0; i < SYSBENCH_ITERATIONS; ++i)
+      vgetpid();
+    t1 = u_rdtsc();
+    for (int i = 0; i < SYSBENCH_ITERATIONS; ++i)
+      u_syscall(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (uint64_t) ts, 0);
+    t2 = u_rdtsc();
+    for (int i = 0; i < SYSBENCH_ITERATIONS; ++i)
+      vgettime(CLOCK_MONOTONIC, ts);
+    uint64_t t3 = u_rdtsc();
+    report(label_vdso_pid, sizeof(label_vdso_pid) - 1, (t1 - t0) / SYSBENCH_ITERATIONS);
+    report(label_sys_time, sizeof(label_sys_time) - 1, (t2 - t1) / SYSBENCH_ITERATIONS);
+    report(label_vdso_time, sizeof(label_vdso_time) - 1, (t3 - t2) / SYSBENCH_ITERATIONS);
+  }
+
+  uint64_t per_op = bench_uring();
+  if (per_op)
+    report(label_uring, sizeof(label_uring) - 1, per_op);
+  u_syscall(SYS_EXIT, 0, 0, 0);
+}
+
+int sysbench_spawn(void)
+{
+  if (!syscall_fast_enabled())
+    return -1;
+  if (paging_set_user(_user_start, (size_t) (_user_end - _user_start)) != 0)
+  {
+    serial_puts("sysbench: cannot map user section\n");
+    return -1;
+  }
+  return task_create(enter_user_task, (void*) user_sysbench);
+}
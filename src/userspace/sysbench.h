@@ -0,0 +1,10 @@
+#ifndef USERSPACE_SYSBENCH_H
+#define USERSPACE_SYSBENCH_H
+
+/* Start a ring 3 task that times getpid through int 0x80, SYSCALL and the
+   vDSO, clock_gettime through SYSCALL and the vDSO, and NOPs batched
+   through a submission ring, and writes cycles per call to fd 1 (serial). Returns the task id, or -1 if the fast path
+   is unavailable. */
+int sysbench_spawn(void);
+
+#endif
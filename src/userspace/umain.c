@@ -18,7 +18,7 @@ static inline uint64_t u_syscall(uint64_t num, uint64_t a1, uint64_t a2, uint64_
 void user_main(void)
 {
   const char* hello = "user: Hello from user mode!\n";
-  u_syscall(1, 1, (uint64_t) hello, 29);
+  u_syscall(1, 1, (uint64_t) hello, 28);
 
   /* simple echo loop */
   char buf[128];
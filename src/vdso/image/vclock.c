@@ -0,0 +1,73 @@
+/* vDSO: user-callable code the kernel maps into every process, so getpid,
+   clock_gettime and getcpu are plain calls instead of system calls. Built
+   as a separate position-independent shared object (see CMakeLists.txt);
+   it has no relocations, no data and no stack protector, and reads
+   everything from the vvar page. */
+#include "syscall/linux_sysno.h"
+#include "syscall/sysno.h"
+#include "vdso/vvar.h"
+#include <stdint.h>
+
+struct timespec
+{
+  int64_t tv_sec;
+  int64_t tv_nsec;
+};
+
+/* placed one page below the image by vdso.lds */
+extern const struct vvar_data vvar_page __attribute__((visibility("hidden")));
+
+static inline uint64_t vdso_rdtsc(void)
+{
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static inline long vdso_syscall2(long num, long a1, long a2)
+{
+  long ret;
+  asm volatile("syscall" : "=a"(ret) : "a"(num), "D"(a1), "S"(a2) : "rcx", "r11", "memory");
+  return ret;
+}
+
+int __vdso_clock_gettime(int clk, struct timespec* ts)
+{
+  if (clk != CLOCK_MONOTONIC && clk != CLOCK_REALTIME)
+    return (int) vdso_syscall2(vvar_page.personality == PERSONALITY_LINUX
+                                   ? LINUX_SYS_CLOCK_GETTIME
+                                   : SYS_CLOCK_GETTIME,
+                               clk,
+                               (long) ts);
+
+  uint32_t seq;
+  uint64_t ns;
+  do
+  {
+    seq = vvar_page.seq;
+    asm volatile("" : : : "memory");
+    ns = (uint64_t) (((unsigned __int128) vdso_rdtsc() * vvar_page.tsc_mult) >> 32);
+    if (clk == CLOCK_REALTIME)
+      ns += (uint64_t) vvar_page.realtime_offset_ns;
+    asm volatile("" : : : "memory");
+  } while ((seq & 1) || seq != vvar_page.seq);
+
+  ts->tv_sec  = (int64_t) (ns / 1000000000ULL);
+  ts->tv_nsec = (int64_t) (ns % 1000000000ULL);
+  return 0;
+}
+
+long __vdso_getpid(void)
+{
+  return vvar_page.pid;
+}
+
+int __vdso_getcpu(unsigned* cpu, unsigned* node, void* unused)
+{
+  (void) unused;
+  if (cpu)
+    *cpu = vvar_page.cpu;
+  if (node)
+    *node = 0;
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include "vdso/vdso.h"
+#include "lib/elf.h"
+#include "mem/paging.h"
+#include "serial/serial.h"
+#include "time/clock.h"
+#include "vdso/vvar.h"
+#include <stddef.h>
+#include <stdint.h>
+
+extern const uint8_t vdso_image_start[], vdso_image_end[];
+
+/* Backing page for the vvar mapping; the kernel writes it directly */
+static union
+{
+  struct vvar_data data;
+  uint8_t          bytes[4096];
+} vvar_store __attribute__((aligned(4096)));
+
+static int    mapped     = 0;
+static size_t image_size = 0;
+
+int vdso_init(void)
+{
+  struct vvar_data* vv = &vvar_store.data;
+  vv->seq++;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  vv->tsc_mult = clock_tsc_mult();
+  vv->tsc_hz   = clock_tsc_hz();
+  /* no wall clock source yet: CLOCK_REALTIME counts from boot as well */
+  vv->realtime_offset_ns = 0;
+  vv->cpu                = 0;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  vv->seq++;
+
+  size_t size = (size_t) (vdso_image_end - vdso_image_start);
+  if (size < sizeof(Elf64_Ehdr) || !elf_check_header((const Elf64_Ehdr*) vdso_image_start))
+  {
+    serial_puts("vdso: bad image\n");
+    return -1;
+  }
+  size = (size + 0xFFF) & ~(size_t) 0xFFF;
+  if (size > VDSO_MAX_PAGES * 0x1000)
+  {
+    serial_puts("vdso: image too large\n");
+    return -1;
+  }
+
+  image_size = size;
+  if (vdso_map() != 0)
+  {
+    serial_puts("vdso: mapping failed\n");
+    return -1;
+  }
+  mapped = 1;
+  serial_puts("vdso: mapped at ");
+  serial_puthex64(VDSO_TEXT_ADDR);
+  serial_puts("\n");
+  return 0;
+}
+
+int vdso_map(void)
+{
+  if (!image_size)
+    return -1;
+  if (paging_map_user_va_ro(VDSO_VVAR_ADDR, (uint64_t) (uintptr_t) &vvar_store, 0x1000) != 0 ||
+      paging_map_user_va_ro(VDSO_TEXT_ADDR, (uint64_t) (uintptr_t) vdso_image_start, image_size) != 0)
+    return -1;
+  return 0;
+}
+
+uint64_t vdso_base(void)
+{
+  return mapped ? VDSO_TEXT_ADDR : 0;
+}
+
+void vdso_note_switch(int pid, int personality)
+{
+  vvar_store.data.pid         = pid;
+  vvar_store.data.personality = personality;
+}
@@ -0,0 +1,21 @@
+#ifndef VDSO_VDSO_H
+#define VDSO_VDSO_H
+
+#include <stdint.h>
+
+/* Fill the vvar page and map it and the vDSO image into user space.
+   Needs the calibrated clock. */
+int vdso_init(void);
+
+/* Map the vvar page and the vDSO into the loaded address space; every new
+   process address space needs this once (vdso_init does the boot one) */
+int vdso_map(void);
+
+/* User address of the vDSO ELF header (AT_SYSINFO_EHDR), 0 if unmapped */
+uint64_t vdso_base(void);
+
+/* Scheduler hook: publish the process (thread group) now running, and the
+   syscall numbering its fallback traps must use, to the vvar page */
+void vdso_note_switch(int pid, int personality);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef VDSO_VVAR_H
+#define VDSO_VVAR_H
+
+#include <stdint.h>
+
+/* The vvar page is kernel data mapped read-only into user space, right
+   below the vDSO image, which reaches it RIP-relatively. Both sit at fixed
+   addresses at the top of the user half. */
+#define VDSO_VVAR_ADDR  0x00007FFFFFF00000ULL
+#define VDSO_TEXT_ADDR  (VDSO_VVAR_ADDR + 0x1000)
+#define VDSO_MAX_PAGES  4
+
+struct vvar_data
+{
+  volatile uint32_t seq;                /* odd while the clock fields change */
+  volatile uint32_t cpu;                /* CPU the reader is running on */
+  uint64_t          tsc_mult;           /* ns = (tsc * tsc_mult) >> 32 */
+  uint64_t          tsc_hz;
+  int64_t           realtime_offset_ns; /* CLOCK_REALTIME - CLOCK_MONOTONIC */
+  volatile int32_t  pid;                /* running thread group, updated on every switch */
+  volatile int32_t  personality;        /* its syscall numbering (PERSONALITY_*) */
+};
+
+#endif